@@ -2,6 +2,7 @@
 #include <cstdio>
 #include <cstring>
 #include <getopt.h>
+#include <limits.h>
 #include <stdlib.h>
 #include <string>
 #include <unistd.h>
@@ -9,11 +10,24 @@
 #include <linux/input.h>
 
 #include "base.hpp"
+#include "gl-calls.hpp"
+#include "gl-ext.hpp"
+#include "shader.hpp"
+#include "trace.hpp"
 
-const struct wl_registry_listener WaylandWindow::s_registryListener = {
-    &WaylandWindow::handleRegistryGlobal,
-    &WaylandWindow::handleRegistryGlobalRemove,
-};
+// Resizes closer together than this are taken to be one interactive
+// resize, which has settled once this long has gone by without another
+static const uint64_t RESIZE_SETTLE_NS = 200000000;
+
+// Frames allowed to allocate (caches filling, buffers growing to size)
+// before --count-allocations builds insist on a heap-free redraw()
+static const uint32_t ALLOCATION_WARMUP_FRAMES = 120;
+
+// Once a window has settled, GPU memory is sampled this often. Growth
+// between this many samples in a row, with no resize or lazy setup in
+// between, looks like a leak rather than a cache filling up.
+static const uint32_t GPU_GROWTH_INTERVAL = 600;
+static const int GPU_GROWTH_SAMPLES = 3;
 
 const struct wl_callback_listener WaylandWindow::s_configureCallbackListener = {
     &WaylandWindow::handleConfigureCallback,
@@ -29,87 +43,88 @@ const struct wl_shell_surface_listener WaylandWindow::s_shellSurfaceListener = {
     &WaylandWindow::handlePopupDone,
 };
 
-const struct wl_seat_listener WaylandWindow::s_seatListener = {
-    &WaylandWindow::handleSeatCapabilities,
-    &WaylandWindow::handleSeatName,
-};
-
-const struct wl_keyboard_listener WaylandWindow::s_keyboardListener = {
-    &WaylandWindow::handleKeyboardKeymap,
-    &WaylandWindow::handleKeyboardEnter,
-    &WaylandWindow::handleKeyboardLeave,
-    &WaylandWindow::handleKeyboardKey,
-    &WaylandWindow::handleKeyboardModifiers,
-    &WaylandWindow::handleKeyboardRepeatInfo,
-};
-
-const struct wl_pointer_listener WaylandWindow::s_pointerListener = {
-    &WaylandWindow::handlePointerEnter,
-    &WaylandWindow::handlePointerLeave,
-    &WaylandWindow::handlePointerMotion,
-    &WaylandWindow::handlePointerButton,
-    &WaylandWindow::handlePointerAxis,
-};
-
-static bool s_running = true;
-
-WaylandWindow::WaylandWindow()
-    : m_display(NULL)
-    , m_registry(NULL)
-    , m_compositor(NULL)
-    , m_shell(NULL)
-    , m_seat(NULL)
-    , m_keyboard(NULL)
-    , m_pointer(NULL)
+WaylandWindow::WaylandWindow(WaylandDisplay* display)
+    : m_display(display)
+    , m_ownsDisplay(display == NULL)
+    , m_surface(NULL)
+    , m_shellSurface(NULL)
+    , m_eglWindow(NULL)
+    , m_eglSurface(EGL_NO_SURFACE)
     , m_configured(false)
     , m_callback(NULL)
+    , m_glReady(false)
+    , m_opaque(true)
     , m_nonFullscreenSize(1, 1)
     , m_currentSize(1, 1)
+    , m_pendingSize(1, 1)
+    , m_resizePending(false)
+    , m_lastResize(0)
+    , m_previousResize(0)
     , m_fullscreen(false)
+    , m_hudVisible(false)
+    , m_gpuProfiler(m_frameStats)
+    , m_gpuProfiling(false)
+    , m_dragMovesWindow(true)
+    , m_renderPolicy(RENDER_CONTINUOUS)
+    , m_maxFps(0)
+    , m_dirty(true)
+    , m_drawing(false)
+    , m_redrawTimer(-1)
+    , m_lastRender(0)
+    , m_lastCallback(0)
+    , m_callbackInterval(16666667)
+    , m_framesSkipped(0)
+    , m_steadyFrame(ALLOCATION_WARMUP_FRAMES)
+    , m_gpuSampled(false)
+    , m_gpuSampleFrame(0)
+    , m_gpuSampleBytes(0)
+    , m_gpuSampleCount(0)
+    , m_gpuGrowthBytes(0)
+    , m_gpuGrowthCount(0)
+    , m_gpuGrowthSamples(0)
 {
+    if (m_ownsDisplay) {
+        m_display = new WaylandDisplay();
+    }
 }
 
 WaylandWindow::~WaylandWindow()
 {
-    // EGL wrapper around surface
-    eglMakeCurrent(m_eglDisplay, EGL_NO_SURFACE, EGL_NO_CONTEXT, EGL_NO_CONTEXT);
-    eglDestroySurface(m_eglDisplay, m_eglSurface);
-    wl_egl_window_destroy(m_eglWindow);
+    if (m_surface) {
+        EGLDisplay eglDisplay = m_display->eglDisplay();
 
-    // surface
-    wl_shell_surface_destroy(m_shellSurface);
-    wl_surface_destroy(m_surface);
+        // Subsurfaces before the surface they hang off
+        destroyLayers();
 
-    if (m_callback) {
-        wl_callback_destroy(m_callback);
-    }
+        // EGL wrapper around surface
+        if (eglGetCurrentSurface(EGL_DRAW) == m_eglSurface) {
+            eglMakeCurrent(eglDisplay, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+        }
+        eglDestroySurface(eglDisplay, m_eglSurface);
+        wl_egl_window_destroy(m_eglWindow);
 
-    // EGL
-    eglTerminate(m_eglDisplay);
-    eglReleaseThread();
+        // surface
+        wl_shell_surface_destroy(m_shellSurface);
+        wl_surface_destroy(m_surface);
 
-    // Wayland interfaces
-    if (m_pointer) {
-        wl_pointer_destroy(m_pointer);
-    }
-    if (m_keyboard) {
-        wl_keyboard_destroy(m_keyboard);
-    }
-    if (m_seat) {
-        wl_seat_destroy(m_seat);
+        if (m_callback) {
+            wl_callback_destroy(m_callback);
+        }
+        if (m_redrawTimer >= 0) {
+            eventLoop().cancelTimer(m_redrawTimer);
+        }
+
+        m_display->removeWindow(this);
     }
-    wl_shell_destroy(m_shell);
-    wl_compositor_destroy(m_compositor);
-    wl_registry_destroy(m_registry);
 
-    // Finally, the connection to the compositor
-    wl_display_flush(m_display);
-    wl_display_disconnect(m_display);
+    if (m_ownsDisplay) {
+        delete m_display;
+    }
 }
 
 static void print_usage(FILE* stream, char* const argv[])
 {
-    fprintf(stream, "Usage: %s [-h] [-f]\n", argv[0]);
+    fprintf(stream, "Usage: %s [-h] [-f] [-D NAME[=VALUE]]... [-F FRAMELOG] [-i] [-j THREADS] [-l] [-m] [-p] [-r continuous|on-demand|FPS] [-s] [-u] [-g WIDTHxHEIGHT] [-t TRACEFILE]\n", argv[0]);
 }
 
 static WaylandWindow::Size parseSize(char const* value)
@@ -119,28 +134,42 @@ static WaylandWindow::Size parseSize(char const* value)
         throw std::exception();
     }
 
-    size_t len = strchr(value, 'x') - value + 1;
-
-    char* width_str = new char[len + 1];
-    width_str[len] = '\0';
-    strncpy(width_str, value, len);
-
-    WaylandWindow::Size size(atoi(width_str), atoi(&strrchr(value, 'x')[1]));
-    delete[] width_str;
-    return size;
+    // atoi() stops at the 'x', so there's no need to copy the width out
+    return WaylandWindow::Size(atoi(value), atoi(&strrchr(value, 'x')[1]));
 }
 
-void WaylandWindow::init(int* argc, char* argv[])
+void WaylandWindow::parseOptions(int* argc, char* argv[])
 {
     m_nonFullscreenSize = m_currentSize = Size(250, 250);
 
+    // Windows sharing a display each parse the same arguments, but only
+    // the first applies the display's
+    m_display->parseOptions(*argc, argv);
+    optind = 1;
+
     int opt;
-    while ((opt = getopt(*argc, argv, "fg:h")) != -1) {
+    while ((opt = getopt(*argc, argv, WaylandDisplay::OPTIONS)) != -1) {
         switch (opt) {
+            case 'D':
+                m_shaderDefines.push_back(optarg);
+                break;
+
             case 'f':
                 m_fullscreen = true;
                 break;
 
+            case 'F':
+                if (m_display->m_windows.empty()) {
+                    m_frameLog.open(optarg, argv[0]);
+                }
+                else {
+                    // One log per window: FRAMELOG.1 for the second, and so on
+                    char path[PATH_MAX];
+                    snprintf(path, sizeof(path), "%s.%zu", optarg, m_display->m_windows.size());
+                    m_frameLog.open(path, argv[0]);
+                }
+                break;
+
             case 'g':
                 try {
                     m_nonFullscreenSize = m_currentSize = parseSize(optarg);
@@ -151,6 +180,42 @@ void WaylandWindow::init(int* argc, char* argv[])
                 }
                 break;
 
+            case 'i':
+                m_inputLatency.enable();
+                break;
+
+            case 'j':
+            case 'l':
+            case 'm':
+            case 't':
+            case 'u':
+                // The display's, applied above
+                break;
+
+            case 'p':
+                m_gpuProfiling = true;
+                break;
+
+            case 'r':
+                if (strcmp(optarg, "continuous") == 0) {
+                    setRenderPolicy(RENDER_CONTINUOUS);
+                }
+                else if (strcmp(optarg, "on-demand") == 0) {
+                    setRenderPolicy(RENDER_ON_DEMAND);
+                }
+                else if (atof(optarg) > 0) {
+                    setRenderPolicy(RENDER_CAPPED, atof(optarg));
+                }
+                else {
+                    fprintf(stderr, "Bad render policy \"%s\"\n", optarg);
+                    exit(EXIT_FAILURE);
+                }
+                break;
+
+            case 's':
+                m_hudVisible = true;
+                break;
+
             case 'h':
                 print_usage(stdout, argv);
                 exit(EXIT_SUCCESS);
@@ -163,121 +228,122 @@ void WaylandWindow::init(int* argc, char* argv[])
                 break;
         }
     }
+}
 
-    m_display = wl_display_connect(NULL);
-    assert(m_display);
-
-    m_registry = wl_display_get_registry(m_display);
-    wl_registry_add_listener(m_registry, &s_registryListener, this);
-    wl_display_dispatch(m_display);
-    assert(m_compositor);
-    assert(m_shell);
+void WaylandWindow::init(int* argc, char* argv[])
+{
+    // Options come first so that -t can turn tracing on for the rest
+    parseOptions(argc, argv);
 
-    static const EGLint context_attribs[] = {
-        EGL_CONTEXT_CLIENT_VERSION, 2,
-        EGL_NONE,
-    };
+    TRACE_SCOPE("WaylandWindow::init");
 
-    const char* extensions;
+    if (!m_display->isInitialized()) {
+        m_display->init(requiredEglConfigAttribs());
+    }
+    m_display->addWindow(this);
 
-    EGLint stock_config_attribs[] = {
-        EGL_SURFACE_TYPE, EGL_WINDOW_BIT,
-        EGL_RED_SIZE, 1,
-        EGL_GREEN_SIZE, 1,
-        EGL_BLUE_SIZE, 1,
-        EGL_ALPHA_SIZE, 1,
-        EGL_RENDERABLE_TYPE, EGL_OPENGL_ES2_BIT,
-    };
+    {
+        TRACE_SCOPE("create surface");
 
-    // First populate the boilerplate EGL config attributes into a
-    // vector
-    std::vector<EGLint> config_attribs;
+        m_surface = wl_compositor_create_surface(m_display->compositor());
+        m_shellSurface = wl_shell_get_shell_surface(m_display->shell(), m_surface);
 
-    for (int i = 0; i < sizeof(stock_config_attribs) / sizeof(stock_config_attribs[0]);) {
-        config_attribs.push_back(stock_config_attribs[i]);
-        config_attribs.push_back(stock_config_attribs[i + 1]);
+        wl_shell_surface_add_listener(m_shellSurface, &s_shellSurfaceListener, this);
 
-        i += 2;
+        m_eglWindow = wl_egl_window_create(m_surface,
+                                           m_currentSize.m_width,
+                                           m_currentSize.m_height);
+        m_eglSurface = eglCreateWindowSurface(m_display->eglDisplay(),
+                                              m_display->eglConfig(),
+                                              m_eglWindow, NULL);
     }
 
-    // Fetch any additional EGL config attributes that the specific
-    // application uses.
-    std::vector<EGLint> custom_config_attribs = requiredEglConfigAttribs();
-
-    config_attribs.insert(
-            config_attribs.end(),
-            custom_config_attribs.begin(),
-            custom_config_attribs.end()
-    );
-
-    // Terminate the vector of EGL config attributes
-    config_attribs.push_back(EGL_NONE);
-
-    m_eglDisplay = eglGetDisplay(m_display);
-    assert(m_eglDisplay);
+    setFullscreen(m_fullscreen);
 
-    int major, minor;
-    int ret = eglInitialize(m_eglDisplay, &major, &minor);
-    assert(ret == EGL_TRUE);
+    makeCurrent();
 
-    ret = eglBindAPI(EGL_OPENGL_ES_API);
-    assert(ret == EGL_TRUE);
+    // Frame pacing comes from our own frame callbacks. Don't let a swap
+    // on one surface block waiting for the compositor, which would stall
+    // every other window sharing this thread.
+    eglSwapInterval(m_display->eglDisplay(), 0);
 
-    int count;
-    if (!eglGetConfigs(m_eglDisplay, NULL, 0, &count) || count < 1) {
-        assert(false);
+    {
+        TRACE_SCOPE("setupGl");
+        setupGl();
     }
+    m_glReady = true;
+}
 
-    EGLConfig* configs = new EGLConfig[count];
-
-    int n;
-    ret = eglChooseConfig(m_eglDisplay, &config_attribs[0], configs, count, &n);
-    assert(ret && n >= 1);
+void WaylandWindow::makeCurrent()
+{
+    int ret = eglMakeCurrent(m_display->eglDisplay(), m_eglSurface,
+                             m_eglSurface, m_display->eglContext());
+    assert(ret);
+}
 
-    m_eglConfig = NULL;
-    int buffer_size = 32;
+void WaylandWindow::destroyGl()
+{
+    if (!m_glReady) {
+        return;
+    }
 
-    for (int i = 0; i < n; i++) {
-        EGLint size;
-        eglGetConfigAttrib(m_eglDisplay, configs[i], EGL_BUFFER_SIZE, &size);
+    makeCurrent();
 
-        if (buffer_size == size) {
-            m_eglConfig = configs[i];
-            break;
-        }
+    if (m_hud.isSetUp()) {
+        m_hud.teardownGl();
     }
 
-    delete[] configs;
+    if (m_gpuProfiler.isSetUp()) {
+        m_gpuProfiler.teardownGl();
+        m_gpuProfiler.printSummary(stdout);
+    }
 
-    if (m_eglConfig == NULL) {
-        std::fprintf(stderr, "did not find config with buffer size %d\n", buffer_size);
-        exit(EXIT_FAILURE);
+    if (m_frameLog.isOpen()) {
+        m_frameLog.write(m_currentSize.m_width, m_currentSize.m_height);
     }
 
-    m_eglContext = eglCreateContext(m_eglDisplay, m_eglConfig, EGL_NO_CONTEXT, context_attribs);
-    assert(m_eglContext);
+    if (m_inputLatency.isEnabled()) {
+        m_inputLatency.printSummary(stdout);
+    }
 
-    m_surface = wl_compositor_create_surface(m_compositor);
-    m_shellSurface = wl_shell_get_shell_surface(m_shell, m_surface);
+    teardownGl();
 
-    wl_shell_surface_add_listener(m_shellSurface, &s_shellSurfaceListener, this);
+    // After the application has let go of its targets
+    if (m_renderTargets.allocations() > 0) {
+        m_renderTargets.printSummary(stdout);
+        m_renderTargets.teardownGl();
+    }
+    m_glReady = false;
+}
 
-    m_eglWindow = wl_egl_window_create(m_surface,
-                                       m_currentSize.m_width,
-                                       m_currentSize.m_height);
-    m_eglSurface = eglCreateWindowSurface(m_eglDisplay, m_eglConfig, m_eglWindow, NULL);
+void WaylandWindow::setRenderPolicy(RenderPolicy policy, float maxFps)
+{
+    m_renderPolicy = policy;
+    m_maxFps = maxFps;
 
-    setFullscreen(m_fullscreen);
+    // Whatever the old policy was, there is a frame to draw under the
+    // new one
+    scheduleRedraw();
+}
 
-    ret = eglMakeCurrent(m_eglDisplay, m_eglSurface,
-                         m_eglSurface, m_eglContext);
-    assert(ret);
+void WaylandWindow::scheduleRedraw()
+{
+    m_dirty = true;
 
-    setupGl();
+    // Normally a pending frame callback or the frame being drawn right
+    // now will pick this up. Only an idle on-demand window needs waking,
+    // which a zero-length timer does from the main loop rather than from
+    // inside whatever callback is asking.
+    if (m_callback || m_drawing || m_redrawTimer >= 0 || !m_configured || !m_glReady) {
+        return;
+    }
+    m_redrawTimer = eventLoop().addTimer(EventLoop::now(), &handleRedrawTimer, this);
 }
 
 void WaylandWindow::setFullscreen(bool fullscreen)
 {
+    TRACE_SCOPE("WaylandWindow::setFullscreen");
+
     m_fullscreen = fullscreen;
     m_configured = false;
 
@@ -296,190 +362,199 @@ void WaylandWindow::setFullscreen(bool fullscreen)
     }
 
     struct wl_callback* callback;
-    callback = wl_display_sync(m_display);
+    callback = wl_display_sync(m_display->wlDisplay());
     wl_callback_add_listener(callback, &s_configureCallbackListener, this);
 }
 
-void WaylandWindow::handleRegistryGlobal(
-        void* data,
-        struct wl_registry* registry,
-        uint32_t name,
-        const char* interface,
-        uint32_t version)
+void WaylandWindow::setOpaque(bool opaque)
 {
-    WaylandWindow* self = static_cast<WaylandWindow*>(data);
+    m_opaque = opaque;
 
-    if (std::string("wl_compositor") == interface) {
-        self->m_compositor = (struct wl_compositor*)wl_registry_bind(
-                registry,
-                name,
-                &wl_compositor_interface,
-                1);
-    }
-    else if (std::string("wl_shell") == interface) {
-        self->m_shell = (struct wl_shell*)wl_registry_bind(
-                registry,
-                name,
-                &wl_shell_interface,
-                1);
-    }
-    else if (std::string("wl_seat") == interface) {
-        self->m_seat = (struct wl_seat*)wl_registry_bind(
-                registry,
-                name,
-                &wl_seat_interface,
-                1);
-        wl_seat_add_listener(self->m_seat, &s_seatListener, self);
+    if (m_surface) {
+        updateOpaqueRegion();
     }
 }
 
-void WaylandWindow::handleRegistryGlobalRemove(
-        void* data,
-        struct wl_registry* registry,
-        uint32_t name)
+void WaylandWindow::updateOpaqueRegion()
 {
+    setOpaqueRegion(m_surface, m_opaque, m_currentSize.m_width, m_currentSize.m_height);
 }
 
-void WaylandWindow::handleSeatCapabilities(
-        void* data,
-        struct wl_seat* seat,
-        uint32_t caps)
+void WaylandWindow::setOpaqueRegion(struct wl_surface* surface, bool opaque,
+                                    uint32_t width, uint32_t height)
 {
-    WaylandWindow* self = static_cast<WaylandWindow*>(data);
-
-    if ((caps & WL_SEAT_CAPABILITY_KEYBOARD) && !self->m_keyboard) {
-        self->m_keyboard = wl_seat_get_keyboard(seat);
-        wl_keyboard_add_listener(self->m_keyboard, &self->s_keyboardListener, self);
+    // Without alpha in the config nothing drawn can be see-through
+    EGLint alpha = 0;
+    eglGetConfigAttrib(m_display->eglDisplay(), m_display->eglConfig(),
+                       EGL_ALPHA_SIZE, &alpha);
+
+    // Takes effect with the next commit, i.e. the next eglSwapBuffers()
+    if (opaque || alpha == 0) {
+        struct wl_region* region = wl_compositor_create_region(m_display->compositor());
+        wl_region_add(region, 0, 0, width, height);
+        wl_surface_set_opaque_region(surface, region);
+        wl_region_destroy(region);
     }
-    else if (!(caps & WL_SEAT_CAPABILITY_KEYBOARD) && self->m_keyboard) {
-        wl_keyboard_destroy(self->m_keyboard);
-        self->m_keyboard = NULL;
-    }
-
-    if ((caps & WL_SEAT_CAPABILITY_POINTER) && !self->m_pointer) {
-        self->m_pointer = wl_seat_get_pointer(seat);
-        wl_pointer_add_listener(self->m_pointer, &self->s_pointerListener, self);
-    } else if (!(caps & WL_SEAT_CAPABILITY_POINTER) && self->m_pointer) {
-        wl_pointer_destroy(self->m_pointer);
-        self->m_pointer = NULL;
+    else {
+        wl_surface_set_opaque_region(surface, NULL);
     }
 }
 
-void WaylandWindow::handleSeatName(
-        void* data,
-        struct wl_seat* seat,
-        char const* name)
+int WaylandWindow::addLayer(LayerOrder order, bool opaque)
 {
-}
+    assert(m_surface);
 
-void WaylandWindow::handleKeyboardKeymap(void *data,
-                                         struct wl_keyboard* keyboard,
-                                         uint32_t format,
-                                         int32_t fd,
-                                         uint32_t size)
-{
-}
+    struct wl_subcompositor* subcompositor = m_display->subcompositor();
+    if (!subcompositor) {
+        return -1;
+    }
 
-void WaylandWindow::handleKeyboardEnter(void* data,
-                                        struct wl_keyboard* keyboard,
-                                        uint32_t serial,
-                                        struct wl_surface* surface,
-                                        struct wl_array* keys)
-{
-}
+    Layer layer;
+    layer.m_opaque = opaque;
+    layer.m_followsWindow = true;
+    layer.m_width = m_currentSize.m_width;
+    layer.m_height = m_currentSize.m_height;
+    layer.m_dirty = true;
+
+    layer.m_surface = wl_compositor_create_surface(m_display->compositor());
+    layer.m_subsurface = wl_subcompositor_get_subsurface(subcompositor,
+                                                         layer.m_surface, m_surface);
+
+    // Synchronized (the default): what a layer commits is held back
+    // until the window's own surface commits, so layers never show up a
+    // frame ahead of the content they go with
+    if (order == LAYER_BELOW) {
+        wl_subsurface_place_below(layer.m_subsurface, m_surface);
+    }
+    else {
+        wl_subsurface_place_above(layer.m_subsurface, m_surface);
+    }
 
-void WaylandWindow::handleKeyboardLeave(void* data,
-                                        struct wl_keyboard* keyboard,
-                                        uint32_t serial,
-                                        struct wl_surface* surface)
-{
-}
+    // Pointer and keyboard focus stay with the window's own surface
+    struct wl_region* empty = wl_compositor_create_region(m_display->compositor());
+    wl_surface_set_input_region(layer.m_surface, empty);
+    wl_region_destroy(empty);
 
-void WaylandWindow::handleKeyboardKey(void* data,
-                                      struct wl_keyboard* keyboard,
-                                      uint32_t serial,
-                                      uint32_t time,
-                                      uint32_t key,
-                                      uint32_t state)
+    setOpaqueRegion(layer.m_surface, opaque, layer.m_width, layer.m_height);
 
-{
-    WaylandWindow* self = static_cast<WaylandWindow*>(data);
+    layer.m_eglWindow = wl_egl_window_create(layer.m_surface, layer.m_width, layer.m_height);
+    layer.m_eglSurface = eglCreateWindowSurface(m_display->eglDisplay(),
+                                                m_display->eglConfig(),
+                                                layer.m_eglWindow, NULL);
 
-    switch (key) {
-        case KEY_F11:
-            if (state) {
-                self->setFullscreen(!self->m_fullscreen);
-            }
-            break;
+    // Paced by the window's frame callbacks like everything else. The
+    // swap interval belongs to whichever surface is current.
+    eglMakeCurrent(m_display->eglDisplay(), layer.m_eglSurface,
+                   layer.m_eglSurface, m_display->eglContext());
+    eglSwapInterval(m_display->eglDisplay(), 0);
+    makeCurrent();
 
-        case KEY_Q:
-        case KEY_ESC:
-            s_running = false;
-            break;
-    }
+    m_layers.push_back(layer);
+    scheduleRedraw();
+    return m_layers.size() - 1;
 }
 
-void WaylandWindow::handleKeyboardModifiers(void* data,
-                                            struct wl_keyboard* keyboard,
-                                            uint32_t serial,
-                                            uint32_t mods_depressed,
-                                            uint32_t mods_latched,
-                                            uint32_t mods_locked,
-                                            uint32_t group)
+void WaylandWindow::setLayerGeometry(int index, int32_t x, int32_t y,
+                                     uint32_t width, uint32_t height)
 {
-}
+    Layer& layer = m_layers[index];
 
-void WaylandWindow::handleKeyboardRepeatInfo(void* data,
-                                             struct wl_keyboard* keyboard,
-                                             int32_t rate,
-                                             int32_t delay)
-{
+    wl_subsurface_set_position(layer.m_subsurface, x, y);
+
+    layer.m_followsWindow = false;
+    if (width != layer.m_width || height != layer.m_height) {
+        layer.m_width = width;
+        layer.m_height = height;
+        wl_egl_window_resize(layer.m_eglWindow, width, height, 0, 0);
+        setOpaqueRegion(layer.m_surface, layer.m_opaque, width, height);
+        invalidateLayer(index);
+    }
 }
 
-void WaylandWindow::handlePointerEnter(void* data,
-                                       struct wl_pointer* pointer,
-                                       uint32_t serial,
-                                       struct wl_surface* surface,
-                                       wl_fixed_t sx,
-                                       wl_fixed_t sy)
+WaylandWindow::Size WaylandWindow::layerSize(int layer) const
 {
+    return Size(m_layers[layer].m_width, m_layers[layer].m_height);
 }
 
-void WaylandWindow::handlePointerLeave(void* data,
-                                       struct wl_pointer* pointer,
-                                       uint32_t serial,
-                                       struct wl_surface* surface)
+void WaylandWindow::invalidateLayer(int layer)
 {
+    m_layers[layer].m_dirty = true;
+    scheduleRedraw();
 }
 
-void WaylandWindow::handlePointerMotion(void* data,
-                                        struct wl_pointer* pointer,
-                                        uint32_t time,
-                                        wl_fixed_t sx,
-                                        wl_fixed_t sy)
+void WaylandWindow::drawLayers(uint32_t time)
 {
+    bool drawn = false;
+
+    for (size_t i = 0; i < m_layers.size(); i++) {
+        Layer& layer = m_layers[i];
+        if (!layer.m_dirty) {
+            continue;
+        }
+
+        if (!drawn) {
+            m_gpuProfiler.beginPass("subsurfaces");
+            drawn = true;
+        }
+
+        eglMakeCurrent(m_display->eglDisplay(), layer.m_eglSurface,
+                       layer.m_eglSurface, m_display->eglContext());
+        glViewport(0, 0, layer.m_width, layer.m_height);
+
+        {
+            TRACE_SCOPE("drawLayer");
+            drawLayer(i, time);
+        }
+
+        // Commits the subsurface, which waits on the window's commit
+        eglSwapBuffers(m_display->eglDisplay(), layer.m_eglSurface);
+        layer.m_dirty = false;
+    }
+
+    if (drawn) {
+        makeCurrent();
+    }
 }
 
-void WaylandWindow::handlePointerButton(void* data,
-                                        struct wl_pointer* pointer,
-                                        uint32_t serial,
-                                        uint32_t time,
-                                        uint32_t button,
-                                        uint32_t state)
+void WaylandWindow::destroyLayers()
 {
-    WaylandWindow* self = static_cast<WaylandWindow*>(data);
+    EGLDisplay eglDisplay = m_display->eglDisplay();
+
+    for (size_t i = 0; i < m_layers.size(); i++) {
+        Layer& layer = m_layers[i];
 
-    if (button == BTN_LEFT && state == WL_POINTER_BUTTON_STATE_PRESSED) {
-        wl_shell_surface_move(self->m_shellSurface, self->m_seat, serial);
+        if (eglGetCurrentSurface(EGL_DRAW) == layer.m_eglSurface) {
+            eglMakeCurrent(eglDisplay, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+        }
+        eglDestroySurface(eglDisplay, layer.m_eglSurface);
+        wl_egl_window_destroy(layer.m_eglWindow);
+        wl_subsurface_destroy(layer.m_subsurface);
+        wl_surface_destroy(layer.m_surface);
     }
+    m_layers.clear();
 }
 
-void WaylandWindow::handlePointerAxis(void* data,
-                                      struct wl_pointer* pointer,
-                                      uint32_t time,
-                                      uint32_t axis,
-                                      wl_fixed_t value)
+void WaylandWindow::handleInput(InputFrame const& input)
 {
+    for (size_t i = 0; i < input.m_events.size(); i++) {
+        InputEvent const& event = input.m_events[i];
+        if (!event.m_state) {
+            continue;
+        }
+
+        if (event.m_type == InputEvent::KEY && event.m_code == KEY_F11) {
+            setFullscreen(!m_fullscreen);
+        }
+        else if (event.m_type == InputEvent::KEY && event.m_code == KEY_H) {
+            m_hudVisible = !m_hudVisible;
+        }
+        else if (event.m_type == InputEvent::BUTTON && event.m_code == BTN_LEFT &&
+                 m_dragMovesWindow) {
+            // The press's serial is still the latest one, so the
+            // compositor will take the move a frame late
+            wl_shell_surface_move(m_shellSurface, m_display->seat(), event.m_serial);
+        }
+    }
 }
 
 void WaylandWindow::handleConfigureCallback(
@@ -512,15 +587,49 @@ void WaylandWindow::handleConfigure(
         return;
     }
 
-    if (self->m_eglWindow) {
-        wl_egl_window_resize(self->m_eglWindow, width, height, 0, 0);
+    // An interactive resize sends a configure for every pointer motion,
+    // far more often than frames get drawn
+    self->m_pendingSize = Size(width, height);
+    self->m_resizePending = true;
+
+    if (!self->m_fullscreen) {
+        self->m_nonFullscreenSize = self->m_pendingSize;
     }
 
-    self->m_currentSize = Size(width, height);
+    self->scheduleRedraw();
+}
+
+void WaylandWindow::applyResize(uint64_t now)
+{
+    m_resizePending = false;
 
-    if (!self->m_fullscreen) {
-        self->m_nonFullscreenSize = self->m_currentSize;
+    if (m_pendingSize.m_width == m_currentSize.m_width &&
+        m_pendingSize.m_height == m_currentSize.m_height) {
+        return;
+    }
+
+    wl_egl_window_resize(m_eglWindow, m_pendingSize.m_width, m_pendingSize.m_height, 0, 0);
+    m_currentSize = m_pendingSize;
+
+    // Targets sized to the window come and go; start watching over
+    m_gpuSampled = false;
+    updateOpaqueRegion();
+
+    for (size_t i = 0; i < m_layers.size(); i++) {
+        Layer& layer = m_layers[i];
+        if (!layer.m_followsWindow) {
+            continue;
+        }
+
+        layer.m_width = m_currentSize.m_width;
+        layer.m_height = m_currentSize.m_height;
+        wl_egl_window_resize(layer.m_eglWindow, layer.m_width, layer.m_height, 0, 0);
+        setOpaqueRegion(layer.m_surface, layer.m_opaque, layer.m_width, layer.m_height);
+        layer.m_dirty = true;
     }
+
+    m_previousResize = m_lastResize;
+    m_lastResize = now;
 }
 
 void WaylandWindow::handlePing(void* data,
@@ -540,9 +649,63 @@ void WaylandWindow::handleFrameCallback(
         uint32_t time)
 {
     WaylandWindow* self = static_cast<WaylandWindow*>(data);
+    uint64_t now = EventLoop::now();
+
+    // The compositor is done with the frame this callback was requested
+    // with
+    self->m_inputLatency.framePresented(now);
+
+    if (self->m_renderPolicy == RENDER_ON_DEMAND && !self->m_dirty) {
+        // Nothing to draw: go idle until scheduleRedraw()
+        wl_callback_destroy(callback);
+        self->m_callback = NULL;
+        return;
+    }
+
+    if (self->m_renderPolicy == RENDER_CAPPED && self->skipFrame(now)) {
+        // Keep the callbacks coming without drawing. A commit with
+        // nothing attached changes nothing on screen.
+        wl_callback_destroy(callback);
+        self->m_callback = wl_surface_frame(self->m_surface);
+        wl_callback_add_listener(self->m_callback, &s_frameCallbackListener, self);
+        wl_surface_commit(self->m_surface);
+        self->m_framesSkipped++;
+        return;
+    }
+
     self->redraw(callback, time);
 }
 
+void WaylandWindow::handleRedrawTimer(void* data)
+{
+    WaylandWindow* self = static_cast<WaylandWindow*>(data);
+
+    self->m_redrawTimer = -1;
+    if (!self->m_callback) {
+        self->redraw(NULL, EventLoop::now() / 1000000);
+    }
+}
+
+bool WaylandWindow::skipFrame(uint64_t now)
+{
+    // Learn how often callbacks come, leaving out gaps where the
+    // compositor wasn't repainting at all
+    if (m_lastCallback && now - m_lastCallback < 250000000ull) {
+        m_callbackInterval = (m_callbackInterval * 7 + (now - m_lastCallback)) / 8;
+    }
+    m_lastCallback = now;
+
+    if (m_maxFps <= 0 || !m_lastRender) {
+        return false;
+    }
+
+    // Draw on whichever callback lands nearest the target time, rather
+    // than the first one after it; at 60Hz a 30fps cap would otherwise
+    // come out at 20fps whenever a callback is a little early
+    uint64_t target = 1000000000ull / m_maxFps;
+    return now - m_lastRender + m_callbackInterval / 2 < target;
+}
+
 void WaylandWindow::redraw(struct wl_callback* callback, uint32_t time)
 {
     assert(m_callback == callback);
@@ -556,49 +719,169 @@ void WaylandWindow::redraw(struct wl_callback* callback, uint32_t time)
         return;
     }
 
-    drawGl(time);
+    TRACE_SCOPE("WaylandWindow::redraw");
+
+    uint64_t allocations = heapAllocationCount();
+
+    m_lastRender = EventLoop::now();
+    m_display->eventLoop().frameRendered(m_lastRender);
+
+    // Anything asking for a frame from here on wants the next one
+    m_dirty = false;
+    m_drawing = true;
+
+    // Windows sharing the display take turns with the one context
+    makeCurrent();
+
+    // However many configures came in since the last frame, the window
+    // only changes size once
+    if (m_resizePending) {
+        applyResize(m_lastRender);
+    }
+
+    // A single jump in size (going fullscreen, say) isn't a resize in
+    // progress: targets can be reallocated at the new size straight away
+    bool resizing = m_lastResize - m_previousResize < RESIZE_SETTLE_NS &&
+                    m_lastRender - m_lastResize < RESIZE_SETTLE_NS;
+    m_renderTargets.beginFrame(resizing);
+
+    if (m_gpuProfiling && !m_gpuProfiler.isSetUp()) {
+        m_gpuProfiler.setupGl();
+        m_steadyFrame = m_frameStats.frameCount() + ALLOCATION_WARMUP_FRAMES;
+    }
+
+    InputFrame const& input = m_input.beginFrame();
+    handleInput(input);
+
+    m_frameStats.beginFrame();
+    m_gpuProfiler.beginFrame();
+    drawLayers(time);
+    {
+        TRACE_SCOPE("drawGl");
+        m_gpuProfiler.beginPass("scene");
+        drawGl(time);
+        m_gpuProfiler.endPass();
+    }
+    m_frameStats.endFrame();
+
+    if (m_frameLog.isOpen()) {
+        m_frameLog.record(m_frameStats);
+    }
+
+    if (m_hudVisible) {
+        // Built on first use so that runs without the overlay don't pay
+        // for its shader compilation at startup
+        if (!m_hud.isSetUp()) {
+            m_hud.setupGl();
+            m_steadyFrame = m_frameStats.frameCount() + ALLOCATION_WARMUP_FRAMES;
+        }
+        TRACE_SCOPE("Hud::draw");
+        m_gpuProfiler.beginPass("hud");
+        m_hud.draw(m_frameStats, m_currentSize.m_width, m_currentSize.m_height);
+        m_gpuProfiler.endPass();
+    }
+
+    m_gpuProfiler.endFrame();
+
+    if (m_display->lowBandwidth() && glExtensions().m_discardFramebuffer) {
+        // Nothing reads depth or stencil after the frame is done, so let
+        // a tiler skip writing them back to memory
+        static const GLenum attachments[] = { GL_DEPTH_EXT, GL_STENCIL_EXT };
+        glExtensions().DiscardFramebufferEXT(GL_FRAMEBUFFER, 2, attachments);
+    }
 
     m_callback = wl_surface_frame(m_surface);
     wl_callback_add_listener(m_callback, &s_frameCallbackListener, this);
 
-    eglSwapBuffers(m_eglDisplay, m_eglSurface);
+    {
+        TRACE_SCOPE("eglSwapBuffers");
+        eglSwapBuffers(m_display->eglDisplay(), m_eglSurface);
+    }
+    m_inputLatency.frameSwapped(input, EventLoop::now());
+    m_drawing = false;
+    GlCalls::endFrame();
+
+    m_frameArena.reset();
+    checkFrameAllocations(allocations);
+    checkGpuGrowth();
 }
 
-void WaylandWindow::run()
+void WaylandWindow::checkFrameAllocations(uint64_t before)
 {
-    for (int ret = 0; ret != -1 && s_running;) {
-        ret = wl_display_dispatch(m_display);
+#ifdef COUNT_ALLOCATIONS
+    uint64_t count = heapAllocationCount() - before;
+
+    if (count > 0 && m_frameStats.frameCount() >= m_steadyFrame) {
+        fprintf(stderr, "Frame %u made %llu heap allocations; "
+                "use frameArena() for per-frame data\n",
+                m_frameStats.frameCount(), (unsigned long long)count);
+        assert(count == 0);
     }
-
-    teardownGl();
+#else
+    (void)before;
+#endif
 }
 
-GLuint WaylandWindow::createShader(std::string const& shaderText, GLenum shaderType)
+void WaylandWindow::checkGpuGrowth()
 {
-    GLuint shader;
-    GLint status;
+    uint32_t frame = m_frameStats.frameCount();
+
+    // Whatever was set up lazily is still settling
+    if (frame < m_steadyFrame) {
+        m_gpuSampled = false;
+        return;
+    }
+
+    size_t bytes = GpuResources::totalBytes();
+    size_t count = GpuResources::totalCount();
+
+    if (!m_gpuSampled) {
+        m_gpuSampled = true;
+        m_gpuSampleFrame = frame;
+        m_gpuSampleBytes = m_gpuGrowthBytes = bytes;
+        m_gpuSampleCount = m_gpuGrowthCount = count;
+        m_gpuGrowthSamples = 0;
+        return;
+    }
+
+    if (frame - m_gpuSampleFrame < GPU_GROWTH_INTERVAL) {
+        return;
+    }
 
-    shader = glCreateShader(shaderType);
-    assert(shader != 0);
+    if (bytes > m_gpuSampleBytes || count > m_gpuSampleCount) {
+        m_gpuGrowthSamples++;
+    }
+    else {
+        m_gpuGrowthSamples = 0;
+        m_gpuGrowthBytes = bytes;
+        m_gpuGrowthCount = count;
+    }
 
-    GLchar* sources[] = {
-        (GLchar*)shaderText.c_str(),
-        NULL
-    };
+    m_gpuSampleFrame = frame;
+    m_gpuSampleBytes = bytes;
+    m_gpuSampleCount = count;
 
-    glShaderSource(shader, 1, sources, NULL);
-    glCompileShader(shader);
+    if (m_gpuGrowthSamples == GPU_GROWTH_SAMPLES) {
+        fprintf(stderr, "GPU resources grew for %u frames straight, "
+                "from %zu objects (%.1f KB) to %zu (%.1f KB)\n",
+                GPU_GROWTH_INTERVAL * GPU_GROWTH_SAMPLES,
+                m_gpuGrowthCount, m_gpuGrowthBytes / 1024.0, count, bytes / 1024.0);
+        GpuResources::printSummary(stderr);
 
-    glGetShaderiv(shader, GL_COMPILE_STATUS, &status);
-    if (!status) {
-        char log[1000];
-        GLsizei len;
-        glGetShaderInfoLog(shader, 1000, &len, log);
-        std::fprintf(stderr, "Error: compiling %s: %*s\n",
-                     shaderType == GL_VERTEX_SHADER ? "vertex" : "fragment",
-                     len, log);
-        exit(EXIT_FAILURE);
+        if (m_display->watchGpuMemory()) {
+            exit(EXIT_FAILURE);
+        }
     }
+}
 
-    return shader;
+void WaylandWindow::run()
+{
+    assert(m_ownsDisplay);
+    m_display->run();
+}
+
+GLuint WaylandWindow::createShader(std::string const& shaderText, GLenum shaderType)
+{
+    TRACE_SCOPE("WaylandWindow::createShader");
+    return compileShader(shaderText, shaderType);
 }
@@ -9,6 +9,17 @@
 #include <string>
 #include <vector>
 
+#include "display.hpp"
+#include "frame-arena.hpp"
+#include "frame-log.hpp"
+#include "frame-stats.hpp"
+#include "gpu-profiler.hpp"
+#include "gpu-resources.hpp"
+#include "hud.hpp"
+#include "input.hpp"
+#include "job-system.hpp"
+#include "render-target-pool.hpp"
+
 class WaylandWindow
 {
 public:
@@ -24,19 +35,57 @@ public:
         uint32_t m_height;
     };
 
+    // When frames get drawn, chosen with -r or setRenderPolicy()
+    enum RenderPolicy
+    {
+        // Whenever the compositor is ready for another one
+        RENDER_CONTINUOUS,
+
+        // Only after scheduleRedraw(), input or a configure; otherwise
+        // the window sleeps
+        RENDER_ON_DEMAND,
+
+        // Like continuous, but frame callbacks arriving sooner than
+        // the maximum rate allows are skipped without drawing
+        RENDER_CAPPED,
+    };
+
+    // Where a layer goes relative to the window's own surface
+    enum LayerOrder
+    {
+        LAYER_BELOW,
+        LAYER_ABOVE,
+    };
+
 public:
-    WaylandWindow();
+    // With no display, init() connects to the compositor on its own and
+    // run() drives just this window. Pass a shared WaylandDisplay to
+    // render several windows from one connection and one EGL context;
+    // then call WaylandDisplay::run() instead of run().
+    WaylandWindow(WaylandDisplay* display = NULL);
     virtual ~WaylandWindow();
 
     void init(int* argc, char* argv[]);
     void run();
 
+    // 'maxFps' is only used by RENDER_CAPPED
+    void setRenderPolicy(RenderPolicy policy, float maxFps = 0);
+    RenderPolicy renderPolicy() const       { return m_renderPolicy; }
+
+    // Frame callbacks that RENDER_CAPPED let go by without drawing
+    uint32_t framesSkipped() const          { return m_framesSkipped; }
+
 // Override these
 protected:
     virtual void setupGl() = 0;
     virtual void drawGl(uint32_t time) = 0;
     virtual void teardownGl() = 0;
 
+    // Draws a layer from addLayer(), with its surface current and the
+    // viewport covering it. Only called when the layer is new, resized
+    // or invalidated.
+    virtual void drawLayer(int layer, uint32_t time) {}
+
     virtual std::vector<EGLint> requiredEglConfigAttribs() {
         return std::vector<EGLint>();
     }
@@ -50,28 +99,109 @@ protected:
 
     void setFullscreen(bool fullscreen);
 
+    // Everything drawGl() draws has alpha 1, so the compositor can skip
+    // blending the window over whatever is behind it. On by default;
+    // turn it off for a window that is meant to be see-through, or that
+    // lets a LAYER_BELOW show through.
+    void setOpaque(bool opaque);
+
+    // Layers are wl_subsurfaces stacked below or above the window's own
+    // surface, each with an EGL surface of its own. drawLayer() redraws
+    // one only when asked to, and the compositor keeps showing what it
+    // drew last, so content that rarely changes can live in a layer and
+    // leave drawGl() with just what animates. Layer updates show up
+    // together with the window's next frame.
+    //
+    // A layer covers the whole window unless given a geometry, and never
+    // takes input. 'opaque' is as for setOpaque(). Call from setupGl()
+    // on; returns the layer's number, or -1 if the compositor has no
+    // subsurfaces, in which case the content has to go into drawGl().
+    int addLayer(LayerOrder order, bool opaque);
+    void setLayerGeometry(int layer, int32_t x, int32_t y,
+                          uint32_t width, uint32_t height);
+    Size layerSize(int layer) const;
+
+    // Has drawLayer() called for 'layer' before the next frame
+    void invalidateLayer(int layer);
+
+    // Asks for another frame. Only needed with RENDER_ON_DEMAND, where
+    // nothing is drawn until something calls this; input and configures
+    // call it on the application's behalf. Can be called from drawGl()
+    // to keep an animation going.
+    void scheduleRedraw();
+
+    // Subclasses report each draw they issue so that it shows up in the
+    // frame statistics and the HUD
+    void recordDraw(GLenum mode, GLsizei vertexCount) {
+        m_frameStats.recordDraw(mode, vertexCount);
+    }
+
+    FrameStats const& frameStats() const    { return m_frameStats; }
+
+    // Input that arrived since the previous frame, for drawGl() to act
+    // on. Motion is coalesced into one update per frame.
+    InputFrame const& input() const         { return m_input.current(); }
+
+    // Dragging with the left button moves the window, unless the
+    // application wants the drag for itself
+    void setDragMovesWindow(bool moves)     { m_dragMovesWindow = moves; }
+
+    // Names given with -D, for picking shader variants per device
+    std::vector<std::string> const& shaderDefines() const {
+        return m_shaderDefines;
+    }
+
+    // With -p, drawGl() runs as one GPU-timed pass called "scene".
+    // Calling this ends the current pass and starts another one under
+    // 'name', so a demo can split its frame into separately timed
+    // stages. Does nothing without -p.
+    void gpuPass(char const* name)          { m_gpuProfiler.beginPass(name); }
+
+    // Scratch memory for data that only lives until the end of the
+    // frame. Reset after every redraw().
+    FrameArena& frameArena()                { return m_frameArena; }
+
+    // Offscreen targets for this window's passes (see PostChain). Told
+    // when the window is being resized so that it doesn't reallocate on
+    // every step.
+    RenderTargetPool& renderTargets()       { return m_renderTargets; }
+
+    WaylandDisplay* display() const         { return m_display; }
+
+    // For application fds, deadline timers and idle tasks. Shared by all
+    // windows on the display.
+    EventLoop& eventLoop()                  { return m_display->eventLoop(); }
+
+    // The display's thread pool, for fanning per-frame CPU work out from
+    // drawGl() and joining it before the GL calls that need the results
+    JobSystem& jobs()                       { return m_display->jobs(); }
+
 private:
+    friend class WaylandDisplay;
+
+    void parseOptions(int* argc, char* argv[]);
     void redraw(struct wl_callback* callback, uint32_t time);
+    bool skipFrame(uint64_t now);
+    void makeCurrent();
+    void destroyGl();
+    void updateOpaqueRegion();
+    void setOpaqueRegion(struct wl_surface* surface, bool opaque,
+                         uint32_t width, uint32_t height);
+    void drawLayers(uint32_t time);
+    void destroyLayers();
+    void applyResize(uint64_t now);
+    void checkFrameAllocations(uint64_t before);
+    void checkGpuGrowth();
+
+    // Window bindings (fullscreen, HUD, moving), at the start of a frame
+    void handleInput(InputFrame const& input);
 
 private:
-    // Server interfaces
-    struct wl_display* m_display;
-    struct wl_registry* m_registry;
-    struct wl_compositor* m_compositor;
-    struct wl_shell* m_shell;
-    struct wl_seat* m_seat;
-    struct wl_keyboard* m_keyboard;
-    struct wl_pointer* m_pointer;
+    // Shared connection, EGL display and context
+    WaylandDisplay* m_display;
+    bool m_ownsDisplay;
 
     // Callbacks
-    static void handleRegistryGlobal(void* data, struct wl_registry* registry,
-                                     uint32_t name, const char* interface,
-                                     uint32_t version);
-
-    static void handleRegistryGlobalRemove(void* data,
-                                           struct wl_registry* registry,
-                                           uint32_t name);
-
     static void handleConfigureCallback(void* data,
                                         struct wl_callback* callback,
                                         uint32_t time);
@@ -80,6 +210,8 @@ private:
                                     struct wl_callback* callback,
                                     uint32_t time);
 
+    static void handleRedrawTimer(void* data);
+
     static void handleConfigure(void* data,
                                 struct wl_shell_surface* shell_surface,
                                 uint32_t edges,
@@ -92,103 +224,97 @@ private:
     static void handlePopupDone(void* data,
                                 struct wl_shell_surface* shell_surface);
 
-    static void handleSeatCapabilities(void* data,
-                                       struct wl_seat* seat,
-                                       uint32_t capabilities);
-
-    static void handleSeatName(void* data,
-                               struct wl_seat* seat,
-                               char const* name);
-
-    static void handleKeyboardKeymap(void *data,
-                                     struct wl_keyboard* keyboard,
-                                     uint32_t format,
-                                     int32_t fd,
-                                     uint32_t size);
-
-    static void handleKeyboardEnter(void *data,
-                                    struct wl_keyboard* keyboard,
-                                    uint32_t serial,
-                                    struct wl_surface* surface,
-                                    struct wl_array* keys);
-
-    static void handleKeyboardLeave(void *data,
-                                    struct wl_keyboard* keyboard,
-                                    uint32_t serial,
-                                    struct wl_surface* surface);
-
-    static void handleKeyboardKey(void *data, struct wl_keyboard* keyboard,
-                                  uint32_t serial, uint32_t time,
-                                  uint32_t key, uint32_t state);
-
-    static void handleKeyboardModifiers(void* data,
-                                        struct wl_keyboard* keyboard,
-                                        uint32_t serial,
-                                        uint32_t mods_depressed,
-                                        uint32_t mods_latched,
-                                        uint32_t mods_locked,
-                                        uint32_t group);
-
-    static void handleKeyboardRepeatInfo(void* data,
-                                         struct wl_keyboard* keyboard,
-                                         int32_t rate,
-                                         int32_t delay);
-
-    static void handlePointerEnter(void* data,
-                                   struct wl_pointer* pointer,
-                                   uint32_t serial,
-                                   struct wl_surface* surface,
-                                   wl_fixed_t sx,
-                                   wl_fixed_t sy);
-
-    static void handlePointerLeave(void* data,
-                                   struct wl_pointer* pointer,
-                                   uint32_t serial,
-                                   struct wl_surface* surface);
-
-    static void handlePointerMotion(void* data,
-                                    struct wl_pointer* pointer,
-                                    uint32_t time,
-                                    wl_fixed_t sx,
-                                    wl_fixed_t sy);
-
-    static void handlePointerButton(void* data,
-                                    struct wl_pointer* pointer,
-                                    uint32_t serial,
-                                    uint32_t time,
-                                    uint32_t button,
-                                    uint32_t state);
-
-    static void handlePointerAxis(void* data,
-                                  struct wl_pointer* pointer,
-                                  uint32_t time,
-                                  uint32_t axis,
-                                  wl_fixed_t value);
-
     // Callback table structures
-    static const struct wl_registry_listener s_registryListener;
     static const struct wl_callback_listener s_configureCallbackListener;
     static const struct wl_callback_listener s_frameCallbackListener;
     static const struct wl_shell_surface_listener s_shellSurfaceListener;
-    static const struct wl_seat_listener s_seatListener;
-    static const struct wl_keyboard_listener s_keyboardListener;
-    static const struct wl_pointer_listener s_pointerListener;
 
     // Client objects
     struct wl_surface* m_surface;
     struct wl_shell_surface* m_shellSurface;
     struct wl_egl_window* m_eglWindow;
-    EGLDisplay m_eglDisplay;
-    EGLContext m_eglContext;
-    EGLConfig m_eglConfig;
     EGLSurface m_eglSurface;
     bool m_configured;
     struct wl_callback* m_callback;
+    bool m_glReady;
+
+    struct Layer
+    {
+        struct wl_surface* m_surface;
+        struct wl_subsurface* m_subsurface;
+        struct wl_egl_window* m_eglWindow;
+        EGLSurface m_eglSurface;
+        bool m_opaque;
+
+        // Covering the window, or pinned with setLayerGeometry()
+        bool m_followsWindow;
+        uint32_t m_width;
+        uint32_t m_height;
+
+        bool m_dirty;
+    };
+
+    std::vector<Layer> m_layers;
+    bool m_opaque;
 
     // Random data
     Size m_nonFullscreenSize;
     Size m_currentSize;
+
+    // Configures only record the size; the next frame resizes, once
+    Size m_pendingSize;
+    bool m_resizePending;
+    uint64_t m_lastResize;
+    uint64_t m_previousResize;
     bool m_fullscreen;
+    std::vector<std::string> m_shaderDefines;
+
+    // Performance overlay, toggled with 'H'
+    FrameStats m_frameStats;
+    Hud m_hud;
+    bool m_hudVisible;
+
+    // GPU pass timing, enabled with -p
+    GpuProfiler m_gpuProfiler;
+    bool m_gpuProfiling;
+
+    FrameArena m_frameArena;
+    RenderTargetPool m_renderTargets;
+
+    // Filled in by the display when this window has focus
+    InputQueue m_input;
+    bool m_dragMovesWindow;
+
+    // Input-to-photon latency, printed on exit with -i
+    InputLatency m_inputLatency;
+
+    // Frame pacing
+    RenderPolicy m_renderPolicy;
+    float m_maxFps;
+    bool m_dirty;
+    bool m_drawing;
+    int m_redrawTimer;          // Wakes an idle on-demand window; -1 if unset
+    uint64_t m_lastRender;
+    uint64_t m_lastCallback;
+    uint64_t m_callbackInterval;
+    uint32_t m_framesSkipped;
+
+    // Every frame's timings, written out on exit with -F
+    FrameLog m_frameLog;
+
+    // With --count-allocations, the first frame expected to make no heap
+    // allocations. Pushed back whenever something is set up lazily.
+    uint32_t m_steadyFrame;
+
+    // GPU memory as of the last sample, and where the current run of
+    // growth started
+    bool m_gpuSampled;
+    uint32_t m_gpuSampleFrame;
+    size_t m_gpuSampleBytes;
+    size_t m_gpuSampleCount;
+    size_t m_gpuGrowthBytes;
+    size_t m_gpuGrowthCount;
+    int m_gpuGrowthSamples;
 };
 
 #endif
@@ -0,0 +1,340 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <stdlib.h>
+#include <time.h>
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include "results.hpp"
+
+// Keeps benchmark results across commits and says whether a change made
+// things faster or slower.
+//
+//   benchdb add STORE RESULTS [COMMIT]
+//       Appends every result in RESULTS (glbench's results file, a demo's
+//       -F frame log, or - for stdin) to STORE, tagged with COMMIT (by
+//       default `git describe --always --dirty` of the working directory)
+//       and the current time as the run.
+//
+//   benchdb list STORE
+//       One line per run: when, commit, renderer and how many results.
+//
+//   benchdb compare STORE BASE NEW [THRESHOLD]
+//       Compares the results of the commits starting with BASE and NEW,
+//       test by test, pooling the samples of every run of each. Only
+//       results from the same GL_RENDERER, GL_VERSION and window size
+//       are compared. A two-sided Mann-Whitney U test on the samples
+//       says whether they differ at all; a difference counts as a
+//       regression if it is significant (p < ALPHA) and the mean got
+//       worse by more than THRESHOLD percent (default 5).
+//
+// The store is plain text, one JSON result per line, only ever appended
+// to. Exits with 1 when compare finds a regression, 2 on errors.
+
+static const double ALPHA = 0.05;
+static const double DEFAULT_THRESHOLD = 5.0;
+
+static void usage(FILE* stream)
+{
+    fprintf(stream,
+            "Usage: benchdb add STORE RESULTS [COMMIT]\n"
+            "       benchdb list STORE\n"
+            "       benchdb compare STORE BASE NEW [THRESHOLD]\n");
+}
+
+static bool readResults(char const* path, std::vector<BenchResult>& results)
+{
+    FILE* f = strcmp(path, "-") == 0 ? stdin : fopen(path, "r");
+    if (!f) {
+        perror(path);
+        return false;
+    }
+
+    char* line = NULL;
+    size_t size = 0;
+    int number = 0;
+
+    while (getline(&line, &size, f) > 0) {
+        number++;
+        if (line[strspn(line, " \t\r\n")] == '\0') {
+            continue;
+        }
+
+        BenchResult result;
+        if (!parseResult(line, result)) {
+            fprintf(stderr, "%s:%d: not a benchmark result\n", path, number);
+            continue;
+        }
+        results.push_back(result);
+    }
+
+    free(line);
+    if (f != stdin) {
+        fclose(f);
+    }
+    return true;
+}
+
+static std::string currentCommit()
+{
+    FILE* p = popen("git describe --always --dirty 2>/dev/null", "r");
+    if (!p) {
+        return "unknown";
+    }
+
+    char buffer[128] = "";
+    if (!fgets(buffer, sizeof(buffer), p)) {
+        buffer[0] = '\0';
+    }
+    pclose(p);
+
+    buffer[strcspn(buffer, "\r\n")] = '\0';
+    return buffer[0] ? buffer : "unknown";
+}
+
+static int add(char const* store, char const* path, char const* commit)
+{
+    std::vector<BenchResult> results;
+    if (!readResults(path, results)) {
+        return 2;
+    }
+    if (results.empty()) {
+        fprintf(stderr, "%s: no results\n", path);
+        return 2;
+    }
+
+    FILE* f = fopen(store, "a");
+    if (!f) {
+        perror(store);
+        return 2;
+    }
+
+    std::string tag = commit ? commit : currentCommit();
+    int64_t run = time(NULL);
+
+    for (size_t i = 0; i < results.size(); i++) {
+        results[i].m_commit = tag;
+        results[i].m_run = run;
+        writeResult(f, results[i]);
+    }
+    fclose(f);
+
+    printf("Added %d results for %s\n", (int)results.size(), tag.c_str());
+    return 0;
+}
+
+static int list(char const* store)
+{
+    std::vector<BenchResult> results;
+    if (!readResults(store, results)) {
+        return 2;
+    }
+
+    // Results of one run are contiguous, since they're appended together
+    for (size_t i = 0; i < results.size();) {
+        BenchResult const& first = results[i];
+        size_t end = i;
+        while (end < results.size() &&
+               results[end].m_run == first.m_run &&
+               results[end].m_commit == first.m_commit) {
+            end++;
+        }
+
+        time_t when = first.m_run;
+        char date[32];
+        strftime(date, sizeof(date), "%Y-%m-%d %H:%M:%S", localtime(&when));
+
+        printf("%s  %-20s %4d results  %s | %s\n", date, first.m_commit.c_str(),
+               (int)(end - i), first.m_renderer.c_str(), first.m_version.c_str());
+        i = end;
+    }
+    return 0;
+}
+
+// Two-sided p-value of the Mann-Whitney U test that 'a' and 'b' come
+// from the same distribution. Uses the normal approximation with a tie
+// correction, which is close enough from about 5 samples a side up and
+// copes with the heavy ties of vsync-quantized frame times.
+static double mannWhitney(std::vector<double> const& a, std::vector<double> const& b)
+{
+    size_t n1 = a.size(), n2 = b.size(), n = n1 + n2;
+    if (n1 == 0 || n2 == 0) {
+        return 1;
+    }
+
+    std::vector<std::pair<double, int> > all;
+    for (size_t i = 0; i < n1; i++) {
+        all.push_back(std::make_pair(a[i], 0));
+    }
+    for (size_t i = 0; i < n2; i++) {
+        all.push_back(std::make_pair(b[i], 1));
+    }
+    std::sort(all.begin(), all.end());
+
+    // Ranks from 1, ties sharing the average of the ranks they span
+    double rankSumA = 0;
+    double tieTerm = 0;
+    for (size_t i = 0; i < n;) {
+        size_t j = i;
+        while (j < n && all[j].first == all[i].first) {
+            j++;
+        }
+
+        double rank = (i + 1 + j) / 2.0;
+        for (size_t k = i; k < j; k++) {
+            if (all[k].second == 0) {
+                rankSumA += rank;
+            }
+        }
+
+        double t = j - i;
+        tieTerm += t * t * t - t;
+        i = j;
+    }
+
+    double u = rankSumA - n1 * (n1 + 1) / 2.0;
+    double mean = n1 * n2 / 2.0;
+    double variance = n1 * n2 / 12.0 * ((n + 1) - tieTerm / (n * (n - 1.0)));
+    if (variance <= 0) {
+        return 1;
+    }
+
+    // With continuity correction
+    double z = (fabs(u - mean) - 0.5) / sqrt(variance);
+    if (z < 0) {
+        z = 0;
+    }
+    return erfc(z / sqrt(2.0));
+}
+
+struct Group
+{
+    BenchResult m_first;
+    std::vector<double> m_samples;
+};
+
+typedef std::map<std::string, Group> Groups;
+
+// Pools the samples of every run of commits starting with 'commit', per
+// test and configuration
+static Groups collect(std::vector<BenchResult> const& results, char const* commit)
+{
+    Groups groups;
+    size_t len = strlen(commit);
+
+    for (size_t i = 0; i < results.size(); i++) {
+        BenchResult const& r = results[i];
+        if (r.m_commit.compare(0, len, commit) != 0) {
+            continue;
+        }
+
+        char size[32];
+        snprintf(size, sizeof(size), "%dx%d", r.m_width, r.m_height);
+        std::string key = r.id() + "\n" + r.m_renderer + "\n" + r.m_version + "\n" + size;
+
+        Group& group = groups[key];
+        if (group.m_samples.empty()) {
+            group.m_first = r;
+        }
+        group.m_samples.insert(group.m_samples.end(), r.m_samples.begin(), r.m_samples.end());
+    }
+
+    return groups;
+}
+
+static int compare(char const* store, char const* base, char const* next, double threshold)
+{
+    std::vector<BenchResult> results;
+    if (!readResults(store, results)) {
+        return 2;
+    }
+
+    Groups before = collect(results, base);
+    Groups after = collect(results, next);
+    if (before.empty() || after.empty()) {
+        fprintf(stderr, "No results for %s\n", before.empty() ? base : next);
+        return 2;
+    }
+
+    int regressions = 0, improvements = 0, compared = 0;
+
+    printf("%-32s %12s %12s %9s %9s\n", "test", base, next, "change", "p");
+
+    for (Groups::const_iterator it = after.begin(); it != after.end(); ++it) {
+        Groups::const_iterator match = before.find(it->first);
+        BenchResult const& r = it->second.m_first;
+
+        if (match == before.end()) {
+            printf("%-32s %12s %12s  (only in %s)\n", r.id().c_str(), "-", "-", next);
+            continue;
+        }
+
+        // Means rather than medians: for frame times the occasional long
+        // frame is exactly what shouldn't go unnoticed
+        double meanBefore = summarize(match->second.m_samples).m_mean;
+        double meanAfter = summarize(it->second.m_samples).m_mean;
+        double p = mannWhitney(match->second.m_samples, it->second.m_samples);
+
+        // Positive is better, whichever way the unit goes
+        double change = meanBefore != 0 ? (meanAfter - meanBefore) / meanBefore * 100 : 0;
+        if (!r.higherIsBetter()) {
+            change = -change;
+        }
+
+        char const* verdict = "";
+        if (p < ALPHA && change < -threshold) {
+            verdict = "  REGRESSION";
+            regressions++;
+        } else if (p < ALPHA && change > threshold) {
+            verdict = "  improved";
+            improvements++;
+        }
+        compared++;
+
+        printf("%-32s %12.4g %12.4g %+8.1f%% %9.2g%s\n", r.id().c_str(),
+               meanBefore, meanAfter, change, p, verdict);
+    }
+
+    for (Groups::const_iterator it = before.begin(); it != before.end(); ++it) {
+        if (after.find(it->first) == after.end()) {
+            printf("%-32s %12s %12s  (only in %s)\n",
+                   it->second.m_first.id().c_str(), "-", "-", base);
+        }
+    }
+
+    printf("%d compared, %d improved, %d regressed by more than %.1f%% (p < %.2f)\n",
+           compared, improvements, regressions, threshold, ALPHA);
+    if (compared == 0) {
+        fprintf(stderr, "Nothing in common: different renderers or window sizes?\n");
+        return 2;
+    }
+    return regressions > 0 ? 1 : 0;
+}
+
+int main(int argc, char* argv[])
+{
+    if (argc >= 2 && (strcmp(argv[1], "-h") == 0 || strcmp(argv[1], "--help") == 0)) {
+        usage(stdout);
+        return EXIT_SUCCESS;
+    }
+
+    if (argc >= 4 && argc <= 5 && strcmp(argv[1], "add") == 0) {
+        return add(argv[2], argv[3], argc == 5 ? argv[4] : NULL);
+    }
+
+    if (argc == 3 && strcmp(argv[1], "list") == 0) {
+        return list(argv[2]);
+    }
+
+    if (argc >= 5 && argc <= 6 && strcmp(argv[1], "compare") == 0) {
+        double threshold = argc == 6 ? atof(argv[5]) : DEFAULT_THRESHOLD;
+        return compare(argv[2], argv[3], argv[4], threshold);
+    }
+
+    usage(stderr);
+    return 2;
+}
@@ -0,0 +1,215 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <string>
+
+#include "base.hpp"
+#include "post-chain.hpp"
+#include "shader.hpp"
+
+// Bloom and tonemapping through PostChain. Bright blobs orbit over a
+// dark background; the chain picks out what is over the threshold at
+// half resolution, blurs it there in two separable passes, and adds it
+// back onto the scene while tonemapping into the window. The two blur
+// passes share one target with the bright pass, through the window's
+// RenderTargetPool.
+//
+// Prints the frame rate and the pool's GPU memory every few seconds.
+// Resize the window interactively to watch the pool ride it out on
+// rounded-up targets and settle on exact ones afterwards.
+//
+// Usage: bloom [window options] [strength [threshold]]
+
+static const char* vert_shader_text =
+    "uniform vec2 u_aspect;\n"
+    "attribute vec2 a_pos;\n"
+    "attribute vec4 a_color;\n"
+    "varying vec4 v_color;\n"
+    "void main() {\n"
+    "  gl_Position = vec4(a_pos * u_aspect, 0, 1);\n"
+    "  gl_PointSize = a_color.a;\n"
+    "  v_color = a_color;\n"
+    "}\n";
+
+static const char* frag_shader_text =
+    "precision mediump float;\n"
+    "varying vec4 v_color;\n"
+    "void main() {\n"
+    "  float r = length(gl_PointCoord - 0.5) * 2.0;\n"
+    "  gl_FragColor = vec4(v_color.rgb * smoothstep(1.0, 0.6, r), 1);\n"
+    "}\n";
+
+static const char* bright_pass_text =
+    "uniform float u_threshold;\n"
+    "void main() {\n"
+    "  vec3 c = source(v_uv).rgb;\n"
+    "  float peak = max(c.r, max(c.g, c.b));\n"
+    "  gl_FragColor = vec4(c * smoothstep(u_threshold, 1.0, peak), 1);\n"
+    "}\n";
+
+// Nine taps of a Gaussian, along BLUR_STEP texels of the source
+static const char* blur_pass_text =
+    "void main() {\n"
+    "  vec2 step = BLUR_STEP * u_source_texel;\n"
+    "  vec3 c = source(v_uv).rgb * 0.227027;\n"
+    "  c += (source(v_uv + step) + source(v_uv - step)).rgb * 0.1945946;\n"
+    "  c += (source(v_uv + 2.0 * step) + source(v_uv - 2.0 * step)).rgb * 0.1216216;\n"
+    "  c += (source(v_uv + 3.0 * step) + source(v_uv - 3.0 * step)).rgb * 0.054054;\n"
+    "  c += (source(v_uv + 4.0 * step) + source(v_uv - 4.0 * step)).rgb * 0.016216;\n"
+    "  gl_FragColor = vec4(c, 1);\n"
+    "}\n";
+
+static const char* composite_pass_text =
+    "uniform float u_strength;\n"
+    "uniform float u_exposure;\n"
+    "void main() {\n"
+    "  vec3 c = scene(v_uv).rgb + source(v_uv).rgb * u_strength;\n"
+    "  gl_FragColor = vec4(vec3(1.0) - exp(-c * u_exposure), 1);\n"
+    "}\n";
+
+// Frames between reports
+static const uint32_t REPORT_INTERVAL = 300;
+
+static const int BLOBS = 24;
+
+class BloomWindow: public WaylandWindow
+{
+public:
+    BloomWindow()
+        : m_program(0)
+        , m_uAspect(-1)
+        , m_bright(-1)
+        , m_composite(-1)
+    {
+    }
+
+    virtual ~BloomWindow() {}
+
+    void setStrength(float strength)    { m_chain.setParameter(m_composite, "u_strength", strength); }
+    void setThreshold(float threshold)  { m_chain.setParameter(m_bright, "u_threshold", threshold); }
+
+protected:
+    virtual void setupGl()
+    {
+        static char const* const attribs[] = { "a_pos", "a_color", NULL };
+
+        GLuint vert = createShader(vert_shader_text, GL_VERTEX_SHADER);
+        GLuint frag = createShader(frag_shader_text, GL_FRAGMENT_SHADER);
+        m_program = linkProgram(vert, frag, attribs);
+        GpuResources::deleteShader(vert);
+        GpuResources::deleteShader(frag);
+
+        m_uAspect = glGetUniformLocation(m_program, "u_aspect");
+
+        m_bright = m_chain.addPass("bright", bright_pass_text, 0.5f);
+        m_chain.addPass("blur-x", (std::string("#define BLUR_STEP vec2(1, 0)\n") + blur_pass_text).c_str(), 0.5f);
+        m_chain.addPass("blur-y", (std::string("#define BLUR_STEP vec2(0, 1)\n") + blur_pass_text).c_str(), 0.5f);
+        m_composite = m_chain.addPass("composite", composite_pass_text);
+
+        m_chain.setParameter(m_bright, "u_threshold", 0.6f);
+        m_chain.setParameter(m_composite, "u_strength", 1.5f);
+        m_chain.setParameter(m_composite, "u_exposure", 1.4f);
+        m_chain.setupGl();
+    }
+
+    virtual void drawGl(uint32_t time)
+    {
+        uint32_t width = currentSize().m_width;
+        uint32_t height = currentSize().m_height;
+
+        m_chain.begin(renderTargets(), width, height, false);
+
+        glClearColor(0.05f, 0.05f, 0.1f, 1);
+        glClear(GL_COLOR_BUFFER_BIT);
+
+        drawBlobs(time / 1000.0f, width, height);
+
+        gpuPass("post");
+        m_chain.end(renderTargets());
+
+        uint32_t frames = frameStats().frameCount();
+        if (frames > 0 && frames % REPORT_INTERVAL == 0) {
+            RenderTargetPool const& pool = renderTargets();
+            printf("%ux%u: %.1f fps, %zu render targets, %.1f MB (peak %.1f MB), %u allocations\n",
+                   width, height, frameStats().fps(), pool.targetCount(),
+                   pool.currentBytes() / 1048576.0, pool.peakBytes() / 1048576.0,
+                   pool.allocations());
+        }
+    }
+
+    virtual void teardownGl()
+    {
+        m_chain.teardownGl();
+        GpuResources::deleteProgram(m_program);
+    }
+
+private:
+    void drawBlobs(float seconds, uint32_t width, uint32_t height)
+    {
+        // x, y, then r, g, b and point size
+        GLfloat vertices[BLOBS * 6];
+
+        for (int i = 0; i < BLOBS; i++) {
+            float phase = i * 2.3999632f;
+            float radius = 0.25f + 0.6f * (i % 5) / 4;
+            float speed = 0.3f + 0.1f * (i % 3);
+            float pulse = 0.5f + 0.5f * sinf(seconds * 2 + phase);
+
+            GLfloat* v = &vertices[i * 6];
+            v[0] = radius * cosf(seconds * speed + phase);
+            v[1] = radius * sinf(seconds * speed + phase);
+            v[2] = 0.4f + 0.6f * (i % 2);
+            v[3] = 0.3f + 0.7f * pulse;
+            v[4] = 0.4f + 0.6f * ((i / 2) % 2);
+            v[5] = 8 + 24 * (i % 4);
+        }
+
+        // Keep the blobs round whatever the window's shape
+        float shortest = std::min(width, height);
+
+        glUseProgram(m_program);
+        glUniform2f(m_uAspect, shortest / width, shortest / height);
+
+        glBlendFunc(GL_ONE, GL_ONE);
+        glEnable(GL_BLEND);
+
+        glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 6 * sizeof(GLfloat), &vertices[0]);
+        glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, 6 * sizeof(GLfloat), &vertices[2]);
+        glEnableVertexAttribArray(0);
+        glEnableVertexAttribArray(1);
+
+        glDrawArrays(GL_POINTS, 0, BLOBS);
+        recordDraw(GL_POINTS, BLOBS);
+
+        glDisableVertexAttribArray(0);
+        glDisableVertexAttribArray(1);
+        glDisable(GL_BLEND);
+    }
+
+    GLuint m_program;
+    GLint m_uAspect;
+
+    PostChain m_chain;
+    int m_bright;
+    int m_composite;
+};
+
+int main(int argc, char* argv[])
+{
+    BloomWindow w;
+    w.init(&argc, argv);
+
+    // Positional arguments are what's left after the window options
+    if (optind < argc) {
+        w.setStrength(atof(argv[optind]));
+    }
+    if (optind + 1 < argc) {
+        w.setThreshold(atof(argv[optind + 1]));
+    }
+
+    w.run();
+    return EXIT_SUCCESS;
+}
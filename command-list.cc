@@ -0,0 +1,340 @@
+#include <assert.h>
+#include <string.h>
+
+#include "command-list.hpp"
+
+CommandList::CommandList()
+    : m_arena(NULL)
+    , m_first(NULL)
+    , m_last(NULL)
+    , m_size(0)
+{
+}
+
+void CommandList::begin(FrameArena& arena)
+{
+    m_arena = &arena;
+    m_first = m_last = NULL;
+    m_size = 0;
+}
+
+Command& CommandList::append(Command::Type type)
+{
+    assert(m_arena);
+
+    if (!m_last || m_last->m_count == CHUNK_COMMANDS) {
+        Chunk* chunk = m_arena->allocate<Chunk>(1);
+        chunk->m_next = NULL;
+        chunk->m_count = 0;
+
+        if (m_last) {
+            m_last->m_next = chunk;
+        }
+        else {
+            m_first = chunk;
+        }
+        m_last = chunk;
+    }
+
+    m_size++;
+    Command& command = m_last->m_commands[m_last->m_count++];
+    command.m_type = type;
+    return command;
+}
+
+void CommandList::useProgram(GLuint program)
+{
+    append(Command::USE_PROGRAM).m_name = program;
+}
+
+void CommandList::bindBuffer(GLenum target, GLuint buffer)
+{
+    Command& command = append(Command::BIND_BUFFER);
+    command.m_enum = target;
+    command.m_name = buffer;
+}
+
+void CommandList::vertexAttribPointer(GLuint index, GLint size, GLenum type,
+                                      GLboolean normalized, GLsizei stride,
+                                      void const* pointer)
+{
+    Command& command = append(Command::VERTEX_ATTRIB_POINTER);
+    command.m_name = index;
+    command.m_components = size;
+    command.m_dataType = type;
+    command.m_normalized = normalized;
+    command.m_size = stride;
+    command.m_pointer = pointer;
+}
+
+void CommandList::enableVertexAttribArray(GLuint index)
+{
+    append(Command::ENABLE_VERTEX_ATTRIB_ARRAY).m_name = index;
+}
+
+void CommandList::disableVertexAttribArray(GLuint index)
+{
+    append(Command::DISABLE_VERTEX_ATTRIB_ARRAY).m_name = index;
+}
+
+void CommandList::uniform(GLint location, int components, GLfloat const* values)
+{
+    assert(components >= 1 && components <= 4);
+
+    // GL ignores location -1, so there's no point replaying it
+    if (location < 0) {
+        return;
+    }
+
+    Command& command = append(Command::UNIFORM_F);
+    command.m_name = location;
+    command.m_components = components;
+    memcpy(command.m_values, values, components * sizeof(GLfloat));
+}
+
+void CommandList::uniform1f(GLint location, GLfloat x)
+{
+    uniform(location, 1, &x);
+}
+
+void CommandList::uniform4f(GLint location, GLfloat x, GLfloat y, GLfloat z, GLfloat w)
+{
+    GLfloat values[] = { x, y, z, w };
+    uniform(location, 4, values);
+}
+
+void CommandList::uniformMatrix4fv(GLint location, GLfloat const* matrix)
+{
+    if (location < 0) {
+        return;
+    }
+
+    GLfloat* copy = m_arena->allocate<GLfloat>(16);
+    memcpy(copy, matrix, 16 * sizeof(GLfloat));
+
+    Command& command = append(Command::UNIFORM_MATRIX_4FV);
+    command.m_name = location;
+    command.m_matrix = copy;
+}
+
+void CommandList::drawArrays(GLenum mode, GLint first, GLsizei count)
+{
+    Command& command = append(Command::DRAW_ARRAYS);
+    command.m_enum = mode;
+    command.m_first = first;
+    command.m_size = count;
+}
+
+void CommandList::drawElements(GLenum mode, GLsizei count, GLenum type, void const* indices)
+{
+    Command& command = append(Command::DRAW_ELEMENTS);
+    command.m_enum = mode;
+    command.m_size = count;
+    command.m_dataType = type;
+    command.m_pointer = indices;
+}
+
+CommandArenas::CommandArenas()
+{
+}
+
+CommandArenas::~CommandArenas()
+{
+    for (size_t i = 0; i < m_arenas.size(); i++) {
+        delete m_arenas[i];
+    }
+}
+
+void CommandArenas::reset(JobSystem& jobs)
+{
+    while (m_arenas.size() < (size_t)jobs.threads()) {
+        m_arenas.push_back(new FrameArena());
+    }
+
+    for (size_t i = 0; i < m_arenas.size(); i++) {
+        m_arenas[i]->reset();
+    }
+}
+
+size_t CommandArenas::bytesUsed() const
+{
+    size_t total = 0;
+    for (size_t i = 0; i < m_arenas.size(); i++) {
+        total += m_arenas[i]->bytesUsed();
+    }
+    return total;
+}
+
+CommandReplayer::CommandReplayer()
+    : m_issued(0)
+    , m_skipped(0)
+{
+    forget();
+}
+
+void CommandReplayer::forget()
+{
+    m_programValid = false;
+    m_arrayBufferValid = false;
+    m_elementBufferValid = false;
+
+    for (int i = 0; i < MAX_ATTRIBS; i++) {
+        m_attribs[i].m_enabledValid = false;
+        m_attribs[i].m_pointerValid = false;
+    }
+    for (int i = 0; i < MAX_UNIFORMS; i++) {
+        m_uniforms[i].m_components = 0;
+    }
+}
+
+void CommandReplayer::replay(CommandList const* lists, size_t count)
+{
+    // The application may have called GL directly since last time
+    forget();
+
+    for (size_t i = 0; i < count; i++) {
+        for (CommandList::Chunk const* chunk = lists[i].m_first; chunk; chunk = chunk->m_next) {
+            for (size_t c = 0; c < chunk->m_count; c++) {
+                if (execute(chunk->m_commands[c])) {
+                    m_issued++;
+                }
+                else {
+                    m_skipped++;
+                }
+            }
+        }
+    }
+}
+
+bool CommandReplayer::uniformChanged(GLint location, int components, GLfloat const* values)
+{
+    if (location >= MAX_UNIFORMS) {
+        return true;
+    }
+
+    Uniform& uniform = m_uniforms[location];
+    if (uniform.m_components == components &&
+        memcmp(uniform.m_values, values, components * sizeof(GLfloat)) == 0) {
+        return false;
+    }
+
+    uniform.m_components = components;
+    memcpy(uniform.m_values, values, components * sizeof(GLfloat));
+    return true;
+}
+
+// Returns false if the command was filtered out
+bool CommandReplayer::execute(Command const& command)
+{
+    switch (command.m_type) {
+        case Command::USE_PROGRAM:
+            if (m_programValid && m_program == (GLuint)command.m_name) {
+                return false;
+            }
+            glUseProgram(command.m_name);
+            m_program = command.m_name;
+            m_programValid = true;
+
+            // Uniform values belong to the program
+            for (int i = 0; i < MAX_UNIFORMS; i++) {
+                m_uniforms[i].m_components = 0;
+            }
+            return true;
+
+        case Command::BIND_BUFFER: {
+            bool array = command.m_enum == GL_ARRAY_BUFFER;
+            GLuint& bound = array ? m_arrayBuffer : m_elementBuffer;
+            bool& valid = array ? m_arrayBufferValid : m_elementBufferValid;
+
+            if (valid && bound == (GLuint)command.m_name) {
+                return false;
+            }
+            glBindBuffer(command.m_enum, command.m_name);
+            bound = command.m_name;
+            valid = true;
+            return true;
+        }
+
+        case Command::VERTEX_ATTRIB_POINTER: {
+            // An attribute pointer captures the array buffer binding, so
+            // that has to be known for the comparison to mean anything
+            Attrib* attrib = command.m_name < MAX_ATTRIBS ? &m_attribs[command.m_name] : NULL;
+
+            if (attrib && attrib->m_pointerValid && m_arrayBufferValid &&
+                attrib->m_buffer == m_arrayBuffer &&
+                attrib->m_size == command.m_components &&
+                attrib->m_type == command.m_dataType &&
+                attrib->m_normalized == command.m_normalized &&
+                attrib->m_stride == command.m_size &&
+                attrib->m_pointer == command.m_pointer) {
+                return false;
+            }
+
+            glVertexAttribPointer(command.m_name, command.m_components, command.m_dataType,
+                                  command.m_normalized, command.m_size, command.m_pointer);
+
+            if (attrib) {
+                attrib->m_pointerValid = m_arrayBufferValid;
+                attrib->m_buffer = m_arrayBuffer;
+                attrib->m_size = command.m_components;
+                attrib->m_type = command.m_dataType;
+                attrib->m_normalized = command.m_normalized;
+                attrib->m_stride = command.m_size;
+                attrib->m_pointer = command.m_pointer;
+            }
+            return true;
+        }
+
+        case Command::ENABLE_VERTEX_ATTRIB_ARRAY:
+        case Command::DISABLE_VERTEX_ATTRIB_ARRAY: {
+            bool enable = command.m_type == Command::ENABLE_VERTEX_ATTRIB_ARRAY;
+
+            if (command.m_name < MAX_ATTRIBS) {
+                Attrib& attrib = m_attribs[command.m_name];
+
+                if (attrib.m_enabledValid && attrib.m_enabled == enable) {
+                    return false;
+                }
+                attrib.m_enabled = enable;
+                attrib.m_enabledValid = true;
+            }
+
+            if (enable) {
+                glEnableVertexAttribArray(command.m_name);
+            }
+            else {
+                glDisableVertexAttribArray(command.m_name);
+            }
+            return true;
+        }
+
+        case Command::UNIFORM_F:
+            if (!uniformChanged(command.m_name, command.m_components, command.m_values)) {
+                return false;
+            }
+            switch (command.m_components) {
+                case 1: glUniform1fv(command.m_name, 1, command.m_values); break;
+                case 2: glUniform2fv(command.m_name, 1, command.m_values); break;
+                case 3: glUniform3fv(command.m_name, 1, command.m_values); break;
+                case 4: glUniform4fv(command.m_name, 1, command.m_values); break;
+            }
+            return true;
+
+        case Command::UNIFORM_MATRIX_4FV:
+            if (!uniformChanged(command.m_name, 16, command.m_matrix)) {
+                return false;
+            }
+            glUniformMatrix4fv(command.m_name, 1, GL_FALSE, command.m_matrix);
+            return true;
+
+        case Command::DRAW_ARRAYS:
+            glDrawArrays(command.m_enum, command.m_first, command.m_size);
+            return true;
+
+        case Command::DRAW_ELEMENTS:
+            glDrawElements(command.m_enum, command.m_size, command.m_dataType, command.m_pointer);
+            return true;
+    }
+
+    return true;
+}
@@ -0,0 +1,208 @@
+#ifndef __COMMAND_LIST_HPP__
+#define __COMMAND_LIST_HPP__
+
+#include <GLES2/gl2.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include <vector>
+
+#include "frame-arena.hpp"
+#include "job-system.hpp"
+
+// Draw submission recorded off the GL thread. Only the thread that made
+// the context current may call GL, but working out what to draw (which
+// program, which uniforms, which buffers) needn't: jobs record it into
+// CommandLists, and the GL thread replays them afterwards.
+//
+//     m_arenas.reset(jobs());
+//     jobs().parallelFor(recordDraws, this, m_lists.size(), 1, recorded);
+//     jobs().wait(recorded);
+//     m_replayer.replay(&m_lists[0], m_lists.size());
+//
+// where recordDraws() does, for each list it's given,
+//
+//     list.begin(m_arenas.current(jobs()));
+//     list.useProgram(...);
+//     ...
+//
+// Lists are replayed in the order they're passed in, whichever thread
+// recorded them, so splitting the scene the same way every frame draws
+// it the same way every frame.
+
+// One GL call with its arguments, copied, in 32 bytes. Matrices live in
+// the arena. Every GLenum the recorded calls take fits in 16 bits.
+struct Command
+{
+    enum Type
+    {
+        USE_PROGRAM,
+        BIND_BUFFER,
+        VERTEX_ATTRIB_POINTER,
+        ENABLE_VERTEX_ATTRIB_ARRAY,
+        DISABLE_VERTEX_ATTRIB_ARRAY,
+        UNIFORM_F,
+        UNIFORM_MATRIX_4FV,
+        DRAW_ARRAYS,
+        DRAW_ELEMENTS,
+    };
+
+    uint8_t m_type;
+    uint8_t m_components;       // Uniform or attribute size
+    uint8_t m_normalized;
+    uint16_t m_enum;            // Buffer target, draw mode
+    uint16_t m_dataType;        // Attribute or index type
+    GLint m_name;               // Program, buffer, attribute index, uniform location
+    GLsizei m_size;             // Attribute stride, vertex or index count
+
+    union
+    {
+        GLfloat m_values[4];
+        GLfloat const* m_matrix;
+        void const* m_pointer;  // Attribute or index offset
+        GLint m_first;
+    };
+};
+
+static_assert(sizeof(Command) == 32, "Command should pack into 32 bytes");
+
+// A sequence of commands, stored in chunks allocated from a FrameArena.
+// Recording and reading a list is for one thread at a time; different
+// lists can be recorded on different threads at once as long as their
+// arenas differ.
+class CommandList
+{
+public:
+    CommandList();
+
+    // Forgets what was recorded before and starts recording into 'arena'
+    void begin(FrameArena& arena);
+
+    size_t size() const         { return m_size; }
+
+    void useProgram(GLuint program);
+    void bindBuffer(GLenum target, GLuint buffer);
+    void vertexAttribPointer(GLuint index, GLint size, GLenum type, GLboolean normalized,
+                             GLsizei stride, void const* pointer);
+    void enableVertexAttribArray(GLuint index);
+    void disableVertexAttribArray(GLuint index);
+
+    // glUniform1f() to glUniform4f(), by 'components'
+    void uniform(GLint location, int components, GLfloat const* values);
+    void uniform1f(GLint location, GLfloat x);
+    void uniform4f(GLint location, GLfloat x, GLfloat y, GLfloat z, GLfloat w);
+
+    // One column-major matrix
+    void uniformMatrix4fv(GLint location, GLfloat const* matrix);
+
+    void drawArrays(GLenum mode, GLint first, GLsizei count);
+    void drawElements(GLenum mode, GLsizei count, GLenum type, void const* indices);
+
+private:
+    friend class CommandReplayer;
+
+    // Big enough that the links cost nothing, small enough that short
+    // lists don't waste much of the arena
+    static const size_t CHUNK_COMMANDS = 128;
+
+    struct Chunk
+    {
+        Chunk* m_next;
+        size_t m_count;
+        Command m_commands[CHUNK_COMMANDS];
+    };
+
+    Command& append(Command::Type type);
+
+    FrameArena* m_arena;
+    Chunk* m_first;
+    Chunk* m_last;
+    size_t m_size;
+};
+
+// An arena per job system thread, for recording lists from jobs
+class CommandArenas
+{
+public:
+    CommandArenas();
+    ~CommandArenas();
+
+    // Call on the GL thread before recording starts, once the lists
+    // recorded last time have been replayed
+    void reset(JobSystem& jobs);
+
+    // The calling thread's arena
+    FrameArena& current(JobSystem& jobs)    { return *m_arenas[jobs.currentThread()]; }
+
+    size_t bytesUsed() const;
+
+private:
+    CommandArenas(CommandArenas const&);
+    CommandArenas& operator=(CommandArenas const&);
+
+    std::vector<FrameArena*> m_arenas;
+};
+
+// Issues recorded commands on the GL thread, skipping those that would
+// set state to what it already is. Lists recorded on different threads
+// can't know what came before them, so each one sets up everything it
+// needs, and most of that turns out to be redundant once they're put
+// back in sequence.
+class CommandReplayer
+{
+public:
+    CommandReplayer();
+
+    // Assumes nothing about GL state on entry, and leaves it as the last
+    // commands set it
+    void replay(CommandList const* lists, size_t count);
+
+    // Since construction
+    uint64_t issued() const     { return m_issued; }
+    uint64_t skipped() const    { return m_skipped; }
+
+private:
+    // State tracked for filtering. Uniforms are only tracked for the
+    // current program and only at low locations, which is where GL
+    // implementations put them in small programs.
+    static const int MAX_ATTRIBS = 16;
+    static const int MAX_UNIFORMS = 16;
+
+    struct Attrib
+    {
+        bool m_enabled;
+        bool m_enabledValid;
+        bool m_pointerValid;    // The rest is known
+        GLuint m_buffer;
+        GLint m_size;
+        GLenum m_type;
+        GLboolean m_normalized;
+        GLsizei m_stride;
+        void const* m_pointer;
+    };
+
+    struct Uniform
+    {
+        int m_components;       // 0 if unknown, 16 for a matrix
+        GLfloat m_values[16];
+    };
+
+    void forget();
+    bool execute(Command const& command);
+    bool uniformChanged(GLint location, int components, GLfloat const* values);
+
+    GLuint m_program;
+    bool m_programValid;
+    GLuint m_arrayBuffer;
+    bool m_arrayBufferValid;
+    GLuint m_elementBuffer;
+    bool m_elementBufferValid;
+
+    Attrib m_attribs[MAX_ATTRIBS];
+    Uniform m_uniforms[MAX_UNIFORMS];
+
+    uint64_t m_issued;
+    uint64_t m_skipped;
+};
+
+#endif
@@ -0,0 +1,429 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <sys/time.h>
+
+#include <linux/input.h>
+
+#include "cube-window.hpp"
+#include "gpu-resources.hpp"
+#include "mesh-optimizer.hpp"
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/type_ptr.hpp>
+
+#define N_ELEMENTS(_a) (sizeof(_a) / sizeof(_a[0]))
+
+// Orbit camera response to the pointer
+static const float ORBIT_DEGREES_PER_PIXEL = 0.5f;
+static const float ZOOM_PER_SCROLL_UNIT = 1.01f;
+static const float MIN_DISTANCE = 4.0f;
+static const float MAX_DISTANCE = 20.0f;
+
+// Variants, chosen with the -D window option:
+//
+//   PER_VERTEX_LIGHTING  light at the vertices and interpolate the color,
+//                        rather than lighting every pixel
+//   HIGHP                highp fragment shading, where the GPU has it
+//
+// Everything derived from the matrices comes in precomputed by
+// Transforms, so the vertex shader does one matrix multiply per output.
+static const char *vert_shader_text =
+	"uniform mat4 u_mvp;\n"
+	"uniform mat4 u_model_view;\n"
+	"uniform mat3 u_normal_matrix;\n"
+
+	"attribute vec4 a_pos;\n"
+	"attribute vec4 a_norm;\n"
+	"attribute vec3 a_color;\n"
+
+	"varying vec3 v_color;\n"
+
+	"#ifdef PER_VERTEX_LIGHTING\n"
+	"uniform vec4 u_light_pos;\n"
+	"uniform float u_ambient;\n"
+	"uniform float u_diffuse;\n"
+	"#else\n"
+	"varying vec3 v_norm;\n"
+	"varying vec4 v_pos;\n"
+	"#endif\n"
+
+	"void main() {\n"
+	"  vec4 pos = u_model_view * a_pos;\n"
+	"  vec3 norm = u_normal_matrix * normalize(a_norm).xyz;\n"
+	"  gl_Position = u_mvp * a_pos;\n"
+	"#ifdef PER_VERTEX_LIGHTING\n"
+	"  float lambert = dot(normalize(u_light_pos.xyz - pos.xyz), norm);\n"
+	"  v_color = a_color * (u_ambient + u_diffuse * lambert);\n"
+	"#else\n"
+	"  v_pos = pos;\n"
+	"  v_norm = norm;\n"
+	"  v_color = a_color;\n"
+	"#endif\n"
+	"}\n";
+
+static const char *frag_shader_text =
+	"#if defined(HIGHP) && defined(GL_FRAGMENT_PRECISION_HIGH)\n"
+	"precision highp float;\n"
+	"#else\n"
+	"precision mediump float;\n"
+	"#endif\n"
+
+	"varying vec3 v_color;\n"
+
+	"#ifndef PER_VERTEX_LIGHTING\n"
+	"uniform vec4 u_light_pos;\n"
+	"uniform float u_ambient;\n"
+	"uniform float u_diffuse;\n"
+
+	"varying vec4 v_pos;\n"
+	"varying vec3 v_norm;\n"
+	"#endif\n"
+
+	"void main() {\n"
+	"#ifdef PER_VERTEX_LIGHTING\n"
+	"  gl_FragColor = vec4(v_color, 1);\n"
+	"#else\n"
+	"  vec4 L = u_light_pos - v_pos;\n"
+	"  float lambert = dot(normalize(L.xyz), v_norm);\n"
+	"  gl_FragColor = vec4(v_color * (u_ambient + u_diffuse * lambert), 1);\n"
+	"#endif\n"
+	"}\n";
+
+// Bound to locations 0, 1, 2 in every variant
+enum {
+	ATTRIB_POS,
+	ATTRIB_NORM,
+	ATTRIB_COLOR,
+};
+
+static char const* const attribs[] = { "a_pos", "a_norm", "a_color", NULL };
+
+static const GLfloat vertices[6 * 6 * 3] = {
+	-1, -1, -1, // left face (x == -1)
+	-1, -1, +1,
+	-1, +1, +1,
+	-1, +1, +1,
+	-1, -1, -1,
+	-1, +1, -1,
+
+	+1, -1, -1, // right face (x == +1)
+	+1, -1, +1,
+	+1, +1, +1,
+	+1, +1, +1,
+	+1, -1, -1,
+	+1, +1, -1,
+
+	-1, -1, +1, // front face (z == +1)
+	-1, +1, +1,
+	+1, +1, +1,
+	+1, +1, +1,
+	-1, -1, +1,
+	+1, -1, +1,
+
+	-1, -1, -1, // back face (z == -1)
+	-1, +1, -1,
+	+1, +1, -1,
+	+1, +1, -1,
+	-1, -1, -1,
+	+1, -1, -1,
+
+	-1, +1, -1, // top face (y == +1)
+	-1, +1, +1,
+	+1, +1, +1,
+	+1, +1, +1,
+	-1, +1, -1,
+	+1, +1, -1,
+
+	-1, -1, -1, // bottom face (y == -1)
+	-1, -1, +1,
+	+1, -1, +1,
+	+1, -1, +1,
+	-1, -1, -1,
+	+1, -1, -1,
+};
+
+static const GLfloat colors[6 * 6 * 3] = {
+	1.0, 1.0, 0.5, // left (yellow)
+	1.0, 1.0, 0.5,
+	1.0, 1.0, 0.5,
+	1.0, 1.0, 0.5,
+	1.0, 1.0, 0.5,
+	1.0, 1.0, 0.5,
+
+	1.0, 0.3, 0.3, // right (red)
+	1.0, 0.3, 0.3,
+	1.0, 0.3, 0.3,
+	1.0, 0.3, 0.3,
+	1.0, 0.3, 0.3,
+	1.0, 0.3, 0.3,
+
+	0.5, 0.5, 1.0, // front (light blue)
+	0.5, 0.5, 1.0,
+	0.5, 0.5, 1.0,
+	0.5, 0.5, 1.0,
+	0.5, 0.5, 1.0,
+	0.5, 0.5, 1.0,
+
+	0.5, 0.5, 0.5, // back (grey)
+	0.5, 0.5, 0.5,
+	0.5, 0.5, 0.5,
+	0.5, 0.5, 0.5,
+	0.5, 0.5, 0.5,
+	0.5, 0.5, 0.5,
+
+	0.5, 0.0, 1.0, // top (purple)
+	0.5, 0.0, 1.0,
+	0.5, 0.0, 1.0,
+	0.5, 0.0, 1.0,
+	0.5, 0.0, 1.0,
+	0.5, 0.0, 1.0,
+
+	1.0, 1.0, 1.0, // bottom (white)
+	1.0, 1.0, 1.0,
+	1.0, 1.0, 1.0,
+	1.0, 1.0, 1.0,
+	1.0, 1.0, 1.0,
+	1.0, 1.0, 1.0,
+};
+
+CubeWindow::Shared::Shared()
+	: m_refs(0)
+	, m_vertexBuffer(0)
+	, m_indexBuffer(0)
+	, m_indexCount(0)
+	, m_colorOffset(0)
+	, m_variants(vert_shader_text, frag_shader_text, attribs)
+{
+}
+
+// The faces above are 36 unindexed vertices. Welding the ones that match
+// in both position and color leaves the 24 a cube needs, which then get
+// put in the order the GPU will best reuse them.
+static void buildCube(std::vector<GLfloat>& positions,
+                      std::vector<GLfloat>& vertexColors,
+                      std::vector<GLushort>& indices)
+{
+	size_t count = N_ELEMENTS(vertices) / 3;
+
+	std::vector<MeshStream> streams;
+	streams.push_back(MeshStream(vertices, 3 * sizeof(GLfloat)));
+	streams.push_back(MeshStream(colors, 3 * sizeof(GLfloat)));
+
+	std::vector<uint32_t> remap;
+	size_t unique = generateVertexRemap(streams, count, remap);
+	indices.assign(remap.begin(), remap.end());
+
+	std::vector<GLfloat> weldedPositions(unique * 3);
+	std::vector<GLfloat> weldedColors(unique * 3);
+	remapVertices(&weldedPositions[0], streams[0], count, remap);
+	remapVertices(&weldedColors[0], streams[1], count, remap);
+
+	optimizeVertexCache(indices, unique);
+	optimizeOverdraw(indices, &weldedPositions[0], 3 * sizeof(GLfloat), unique);
+
+	size_t used = optimizeVertexFetchRemap(indices, unique, remap);
+	remapIndices(indices, remap);
+
+	positions.resize(used * 3);
+	vertexColors.resize(used * 3);
+	remapVertices(&positions[0], MeshStream(&weldedPositions[0], 3 * sizeof(GLfloat)),
+	              unique, remap);
+	remapVertices(&vertexColors[0], MeshStream(&weldedColors[0], 3 * sizeof(GLfloat)),
+	              unique, remap);
+
+	// Unindexed, every vertex was shaded once
+	std::vector<GLushort> unindexed(count);
+	for (size_t i = 0; i < count; i++) {
+		unindexed[i] = i;
+	}
+
+	printf("cube: %zu vertices -> %zu\n", count, used);
+	printVertexCacheStats(stdout, "cube", analyzeVertexCache(unindexed, count),
+	                      analyzeVertexCache(indices, used));
+}
+
+CubeWindow::Shared CubeWindow::s_shared;
+
+CubeWindow::CubeWindow(WaylandDisplay* display)
+	: WaylandWindow(display)
+	, m_program(0)
+	, m_uLightPos(-1)
+	, m_uAmbient(-1)
+	, m_uDiffuse(-1)
+	, m_yaw(0)
+	, m_pitch(0)
+	, m_distance(7)
+{
+	// Dragging turns the camera instead
+	setDragMovesWindow(false);
+}
+
+CubeWindow::~CubeWindow()
+{
+}
+
+void CubeWindow::setupGl()
+{
+	// Windows asking for the same variant get the same program
+	m_program = s_shared.m_variants.program(shaderDefines());
+	m_transforms.locate(m_program);
+	m_uLightPos = glGetUniformLocation(m_program, "u_light_pos");
+	m_uAmbient = glGetUniformLocation(m_program, "u_ambient");
+	m_uDiffuse = glGetUniformLocation(m_program, "u_diffuse");
+
+	// Every window on a display shares one context, so the geometry
+	// only needs to be uploaded by the first of them.
+	if (s_shared.m_refs++ > 0) {
+		return;
+	}
+
+	std::vector<GLfloat> positions;
+	std::vector<GLfloat> vertexColors;
+	std::vector<GLushort> indices;
+	buildCube(positions, vertexColors, indices);
+
+	// Positions followed by colors
+	GLsizeiptr size = positions.size() * sizeof(GLfloat);
+	s_shared.m_colorOffset = size;
+
+	s_shared.m_vertexBuffer = GpuResources::createBuffer("cube vertices");
+	glBindBuffer(GL_ARRAY_BUFFER, s_shared.m_vertexBuffer);
+	GpuResources::bufferData(s_shared.m_vertexBuffer, GL_ARRAY_BUFFER, size * 2, NULL,
+	                         GL_STATIC_DRAW);
+	glBufferSubData(GL_ARRAY_BUFFER, 0, size, &positions[0]);
+	glBufferSubData(GL_ARRAY_BUFFER, size, size, &vertexColors[0]);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+	s_shared.m_indexCount = indices.size();
+
+	s_shared.m_indexBuffer = GpuResources::createBuffer("cube indices");
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, s_shared.m_indexBuffer);
+	GpuResources::bufferData(s_shared.m_indexBuffer, GL_ELEMENT_ARRAY_BUFFER,
+	                         indices.size() * sizeof(GLushort), &indices[0], GL_STATIC_DRAW);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+}
+
+void CubeWindow::updateCamera()
+{
+	// Everything that arrived since the last frame, motion already
+	// coalesced into one delta
+	InputFrame const& in = input();
+
+	if (in.buttonHeld(BTN_LEFT)) {
+		m_yaw = fmodf(m_yaw + in.m_motionX * ORBIT_DEGREES_PER_PIXEL, 360);
+		m_pitch += in.m_motionY * ORBIT_DEGREES_PER_PIXEL;
+		m_pitch = std::max(-89.f, std::min(89.f, m_pitch));
+	}
+
+	m_distance *= powf(ZOOM_PER_SCROLL_UNIT, in.m_scroll);
+	m_distance = std::max(MIN_DISTANCE, std::min(MAX_DISTANCE, m_distance));
+}
+
+void CubeWindow::drawGl(uint32_t time)
+{
+	GLfloat angle;
+	static const uint32_t benchmark_interval = 5;
+	static const uint32_t speed_div = 20;
+	struct timeval tv;
+
+	gettimeofday(&tv, NULL);
+	time = tv.tv_sec * 1000 + tv.tv_usec / 1000;
+
+	angle = (time / speed_div) % 360 * M_PI / 180.0;
+
+	glViewport(0, 0, currentSize().m_width, currentSize().m_height);
+
+	updateCamera();
+
+	// Axes
+	glm::vec3 left(1.f, 0.f, 0.f);
+	glm::vec3 up(0.f, 1.f, 0.f);
+	glm::vec3 near(0.f, 0.f, 1.f);
+
+	// Rotation matrix. Use different primes to avoid gimbal lock.
+	glm::mat4 u_model = glm::rotate(glm::mat4(1.0f), float(angle * 3. / 10), up)
+	                  * glm::rotate(glm::mat4(1.0f), float(angle), left)
+	                  * glm::rotate(glm::mat4(1.0f), float(angle * 7. / 10), near);
+
+#if 0
+	glm::mat4 u_view = glm::translate(glm::mat4(1.f), glm::vec3(0.0, 0.0, -1 * sqrt(3)));
+
+	// Simple orthographic projection just barely large enough
+	// to be a bounding box on the radius of the vertices
+	glm::mat4 u_projection = glm::ortho(-sqrt(3), sqrt(3),
+	                                    -sqrt(3), sqrt(3),
+	                                    (double)(-2 * sqrt(3)), (double)(+2 * sqrt(3)));
+#else
+	// Orbiting camera m_distance away from the cube's center. The frustum
+	// hugs the cube: at the starting distance of 7 its front pane is from
+	// (-1.5, 1.5 * aspectRatio) to (1.5, -1.5 * aspectRatio) on the z=4.5
+	// plane and its back pane is on the z=10.0 plane.
+	glm::mat4 u_view = glm::translate(glm::mat4(1.f), glm::vec3(0.f, 0.f, -m_distance))
+	                 * glm::rotate(glm::mat4(1.0f), float(m_pitch * M_PI / 180), left)
+	                 * glm::rotate(glm::mat4(1.0f), float(m_yaw * M_PI / 180), up);
+	float aspectRatio = currentSize().m_width * 1.0f / currentSize().m_height;
+	float zNear = m_distance - 2.5f;
+	float zFar = m_distance + 3.0f;
+	float halfHeight = zNear / 3;
+	glm::mat4 u_projection = glm::frustum(-halfHeight * aspectRatio, halfHeight * aspectRatio,
+	                                      halfHeight, -halfHeight, zNear, zFar);
+#endif
+
+	glm::vec4 u_light_pos = glm::vec4(10.0, 10.0, +10.0, 1);
+	float u_ambient = .5;
+
+	Transforms transforms(u_model, u_view, u_projection);
+
+	glUseProgram(m_program);
+
+	m_transforms.upload(transforms);
+
+	glUniform4fv(m_uLightPos, 1, glm::value_ptr(u_light_pos));
+
+	glUniform1f(m_uAmbient, u_ambient);
+
+	glUniform1f(m_uDiffuse, 1 - u_ambient);
+
+	glClearColor(0.0, 0.0, 0.0, 1.0);
+	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+	glEnable(GL_DEPTH_TEST);
+
+	glBindBuffer(GL_ARRAY_BUFFER, s_shared.m_vertexBuffer);
+
+	glVertexAttribPointer(ATTRIB_POS, 3, GL_FLOAT, GL_FALSE, 0, 0);
+	glEnableVertexAttribArray(ATTRIB_POS);
+
+	glVertexAttribPointer(ATTRIB_NORM, 3, GL_FLOAT, GL_FALSE, 0, 0);
+	glEnableVertexAttribArray(ATTRIB_NORM);
+
+	glVertexAttribPointer(ATTRIB_COLOR, 3, GL_FLOAT, GL_FALSE, 0, (void*)s_shared.m_colorOffset);
+	glEnableVertexAttribArray(ATTRIB_COLOR);
+
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, s_shared.m_indexBuffer);
+	glDrawElements(GL_TRIANGLES, s_shared.m_indexCount, GL_UNSIGNED_SHORT, 0);
+	recordDraw(GL_TRIANGLES, s_shared.m_indexCount);
+
+	glDisableVertexAttribArray(ATTRIB_POS);
+	glDisableVertexAttribArray(ATTRIB_NORM);
+	glDisableVertexAttribArray(ATTRIB_COLOR);
+
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+
+	glDisable(GL_DEPTH_TEST);
+}
+
+void CubeWindow::teardownGl()
+{
+	if (--s_shared.m_refs > 0) {
+		return;
+	}
+
+	glUseProgram(0);
+	GpuResources::deleteBuffer(s_shared.m_vertexBuffer);
+	GpuResources::deleteBuffer(s_shared.m_indexBuffer);
+	s_shared.m_variants.teardownGl();
+}
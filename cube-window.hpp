@@ -0,0 +1,59 @@
+#ifndef __CUBE_WINDOW_HPP__
+#define __CUBE_WINDOW_HPP__
+
+#include "base.hpp"
+#include "shader.hpp"
+#include "transforms.hpp"
+
+class CubeWindow: public WaylandWindow
+{
+public:
+    CubeWindow(WaylandDisplay* display = NULL);
+    virtual ~CubeWindow();
+
+protected:
+    virtual void setupGl();
+    virtual void drawGl(uint32_t time);
+    virtual void teardownGl();
+
+    virtual std::vector<EGLint> requiredEglConfigAttribs() {
+        std::vector<EGLint> ret;
+        ret.push_back(EGL_DEPTH_SIZE);
+        ret.push_back(4);
+        return ret;
+    }
+
+private:
+    // GL objects shared by every CubeWindow in the process. All of them
+    // are expected to be on one WaylandDisplay, and so one context.
+    struct Shared
+    {
+        Shared();
+
+        int m_refs;
+        GLuint m_vertexBuffer;
+        GLuint m_indexBuffer;
+        GLsizei m_indexCount;
+        GLintptr m_colorOffset;
+        ShaderVariants m_variants;
+    };
+
+    static Shared s_shared;
+
+    // The variant this window draws with, and where its uniforms are
+    GLuint m_program;
+    TransformUniforms m_transforms;
+    GLint m_uLightPos;
+    GLint m_uAmbient;
+    GLint m_uDiffuse;
+
+    // Orbit camera: drag with the left button to turn around the cube,
+    // scroll to move in and out. Angles in degrees.
+    void updateCamera();
+
+    float m_yaw;
+    float m_pitch;
+    float m_distance;
+};
+
+#endif
@@ -0,0 +1,732 @@
+#include <assert.h>
+#include <algorithm>
+#include <cstdio>
+#include <getopt.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <sys/epoll.h>
+#include <sys/resource.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <linux/input.h>
+
+#include "base.hpp"
+#include "display.hpp"
+#include "gpu-resources.hpp"
+#include "job-system.hpp"
+#include "trace.hpp"
+
+const struct wl_registry_listener WaylandDisplay::s_registryListener = {
+    &WaylandDisplay::handleRegistryGlobal,
+    &WaylandDisplay::handleRegistryGlobalRemove,
+};
+
+const struct wl_seat_listener WaylandDisplay::s_seatListener = {
+    &WaylandDisplay::handleSeatCapabilities,
+    &WaylandDisplay::handleSeatName,
+};
+
+const struct wl_keyboard_listener WaylandDisplay::s_keyboardListener = {
+    &WaylandDisplay::handleKeyboardKeymap,
+    &WaylandDisplay::handleKeyboardEnter,
+    &WaylandDisplay::handleKeyboardLeave,
+    &WaylandDisplay::handleKeyboardKey,
+    &WaylandDisplay::handleKeyboardModifiers,
+    &WaylandDisplay::handleKeyboardRepeatInfo,
+};
+
+const struct wl_pointer_listener WaylandDisplay::s_pointerListener = {
+    &WaylandDisplay::handlePointerEnter,
+    &WaylandDisplay::handlePointerLeave,
+    &WaylandDisplay::handlePointerMotion,
+    &WaylandDisplay::handlePointerButton,
+    &WaylandDisplay::handlePointerAxis,
+    &WaylandDisplay::handlePointerFrame,
+    &WaylandDisplay::handlePointerAxisSource,
+    &WaylandDisplay::handlePointerAxisStop,
+    &WaylandDisplay::handlePointerAxisDiscrete,
+};
+
+WaylandDisplay::WaylandDisplay()
+    : m_display(NULL)
+    , m_registry(NULL)
+    , m_compositor(NULL)
+    , m_shell(NULL)
+    , m_subcompositor(NULL)
+    , m_seat(NULL)
+    , m_seatVersion(0)
+    , m_keyboard(NULL)
+    , m_pointer(NULL)
+    , m_eglDisplay(EGL_NO_DISPLAY)
+    , m_eglConfig(NULL)
+    , m_eglContext(EGL_NO_CONTEXT)
+    , m_keyboardFocus(NULL)
+    , m_pointerFocus(NULL)
+    , m_jobs(NULL)
+    , m_jobThreads(0)
+    , m_running(true)
+    , m_reportUsage(false)
+    , m_watchGpuMemory(false)
+    , m_lowBandwidth(false)
+    , m_optionsParsed(false)
+{
+}
+
+WaylandDisplay::~WaylandDisplay()
+{
+    // Windows hold surfaces on this connection, so they have to go first
+    assert(m_windows.empty());
+
+    delete m_jobs;
+
+    if (!isInitialized()) {
+        return;
+    }
+
+    // EGL
+    eglMakeCurrent(m_eglDisplay, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+    eglDestroyContext(m_eglDisplay, m_eglContext);
+    eglTerminate(m_eglDisplay);
+    eglReleaseThread();
+
+    // Wayland interfaces
+    if (m_pointer) {
+        wl_pointer_destroy(m_pointer);
+    }
+    if (m_keyboard) {
+        wl_keyboard_destroy(m_keyboard);
+    }
+    if (m_seat) {
+        wl_seat_destroy(m_seat);
+    }
+    if (m_subcompositor) {
+        wl_subcompositor_destroy(m_subcompositor);
+    }
+    wl_shell_destroy(m_shell);
+    wl_compositor_destroy(m_compositor);
+    wl_registry_destroy(m_registry);
+
+    // Finally, the connection to the compositor
+    wl_display_flush(m_display);
+    wl_display_disconnect(m_display);
+}
+
+char const WaylandDisplay::OPTIONS[] = "D:fF:g:hij:lmpr:st:u";
+
+void WaylandDisplay::parseOptions(int argc, char* argv[])
+{
+    if (m_optionsParsed) {
+        return;
+    }
+    m_optionsParsed = true;
+
+    // Mistakes are reported by the window, which knows the usage
+    int savedOpterr = opterr;
+    opterr = 0;
+    optind = 1;
+
+    int opt;
+    while ((opt = getopt(argc, argv, OPTIONS)) != -1) {
+        switch (opt) {
+            case 'j':
+                if (atoi(optarg) <= 0) {
+                    fprintf(stderr, "Bad thread count \"%s\"\n", optarg);
+                    exit(EXIT_FAILURE);
+                }
+                setJobThreads(atoi(optarg));
+                break;
+
+            case 'l':
+                setLowBandwidth(true);
+                break;
+
+            case 'm':
+                setWatchGpuMemory(true);
+                break;
+
+            case 't':
+                Trace::start(optarg);
+                break;
+
+            case 'u':
+                setReportUsage(true);
+                break;
+
+            default:
+                break;
+        }
+    }
+
+    opterr = savedOpterr;
+}
+
+JobSystem& WaylandDisplay::jobs()
+{
+    if (!m_jobs) {
+        int threads = m_jobThreads > 0 ? m_jobThreads : sysconf(_SC_NPROCESSORS_ONLN);
+        m_jobs = new JobSystem(threads);
+    }
+    return *m_jobs;
+}
+
+void WaylandDisplay::init(std::vector<EGLint> const& custom_config_attribs)
+{
+    TRACE_SCOPE("WaylandDisplay::init");
+
+    {
+        TRACE_SCOPE("wl_display_connect");
+        m_display = wl_display_connect(NULL);
+        assert(m_display);
+    }
+
+    {
+        TRACE_SCOPE("registry roundtrip");
+        m_registry = wl_display_get_registry(m_display);
+        wl_registry_add_listener(m_registry, &s_registryListener, this);
+        wl_display_dispatch(m_display);
+        assert(m_compositor);
+        assert(m_shell);
+    }
+
+    static const EGLint context_attribs[] = {
+        EGL_CONTEXT_CLIENT_VERSION, 2,
+        EGL_NONE,
+    };
+
+    // The low-bandwidth profile leaves alpha out: every demo's output is
+    // opaque anyway, and RGB565 with no alpha halves the bytes per pixel
+    EGLint stock_config_attribs[] = {
+        EGL_SURFACE_TYPE, EGL_WINDOW_BIT,
+        EGL_RED_SIZE, 1,
+        EGL_GREEN_SIZE, 1,
+        EGL_BLUE_SIZE, 1,
+        EGL_ALPHA_SIZE, m_lowBandwidth ? 0 : 1,
+        EGL_RENDERABLE_TYPE, EGL_OPENGL_ES2_BIT,
+    };
+
+    // First populate the boilerplate EGL config attributes into a
+    // vector
+    std::vector<EGLint> config_attribs;
+
+    for (int i = 0; i < sizeof(stock_config_attribs) / sizeof(stock_config_attribs[0]);) {
+        config_attribs.push_back(stock_config_attribs[i]);
+        config_attribs.push_back(stock_config_attribs[i + 1]);
+
+        i += 2;
+    }
+
+    // Add any additional EGL config attributes that the specific
+    // application uses.
+    config_attribs.insert(
+            config_attribs.end(),
+            custom_config_attribs.begin(),
+            custom_config_attribs.end()
+    );
+
+    // Terminate the vector of EGL config attributes
+    config_attribs.push_back(EGL_NONE);
+
+    m_eglDisplay = eglGetDisplay(m_display);
+    assert(m_eglDisplay);
+
+    int major, minor;
+    int ret;
+    {
+        TRACE_SCOPE("eglInitialize");
+        ret = eglInitialize(m_eglDisplay, &major, &minor);
+        assert(ret == EGL_TRUE);
+    }
+
+    ret = eglBindAPI(EGL_OPENGL_ES_API);
+    assert(ret == EGL_TRUE);
+
+    {
+        TRACE_SCOPE("choose config");
+
+        int count;
+        if (!eglGetConfigs(m_eglDisplay, NULL, 0, &count) || count < 1) {
+            assert(false);
+        }
+
+        EGLConfig* configs = new EGLConfig[count];
+
+        int n;
+        ret = eglChooseConfig(m_eglDisplay, &config_attribs[0], configs, count, &n);
+        assert(ret && n >= 1);
+
+        // Pick the closest match to the profile rather than the first one
+        // the driver lists
+        EGLint min_depth = attribValue(custom_config_attribs, EGL_DEPTH_SIZE, 0);
+        EGLint min_stencil = attribValue(custom_config_attribs, EGL_STENCIL_SIZE, 0);
+
+        m_eglConfig = NULL;
+        int best_score = 0;
+
+        for (int i = 0; i < n; i++) {
+            int score = scoreConfig(configs[i], min_depth, min_stencil);
+
+            if (m_eglConfig == NULL || score < best_score) {
+                m_eglConfig = configs[i];
+                best_score = score;
+            }
+        }
+
+        delete[] configs;
+    }
+
+    TRACE_SCOPE("eglCreateContext");
+    m_eglContext = eglCreateContext(m_eglDisplay, m_eglConfig, EGL_NO_CONTEXT, context_attribs);
+    assert(m_eglContext);
+}
+
+EGLint WaylandDisplay::attribValue(std::vector<EGLint> const& attribs,
+                                   EGLint attrib, EGLint fallback)
+{
+    for (size_t i = 0; i + 1 < attribs.size(); i += 2) {
+        if (attribs[i] == attrib) {
+            return attribs[i + 1];
+        }
+    }
+    return fallback;
+}
+
+int WaylandDisplay::scoreConfig(EGLConfig config, EGLint minDepth, EGLint minStencil) const
+{
+    EGLint buffer, red, green, blue, alpha, depth, stencil, samples;
+
+    eglGetConfigAttrib(m_eglDisplay, config, EGL_BUFFER_SIZE, &buffer);
+    eglGetConfigAttrib(m_eglDisplay, config, EGL_RED_SIZE, &red);
+    eglGetConfigAttrib(m_eglDisplay, config, EGL_GREEN_SIZE, &green);
+    eglGetConfigAttrib(m_eglDisplay, config, EGL_BLUE_SIZE, &blue);
+    eglGetConfigAttrib(m_eglDisplay, config, EGL_ALPHA_SIZE, &alpha);
+    eglGetConfigAttrib(m_eglDisplay, config, EGL_DEPTH_SIZE, &depth);
+    eglGetConfigAttrib(m_eglDisplay, config, EGL_STENCIL_SIZE, &stencil);
+    eglGetConfigAttrib(m_eglDisplay, config, EGL_SAMPLES, &samples);
+
+    // Lower is better. Multisampling is never asked for, so always
+    // counts against a config.
+    int score = samples * 1000;
+
+    if (m_lowBandwidth) {
+        // As close to RGB565 as possible, then as little depth and
+        // stencil as the application asked for
+        score += (abs(red - 5) + abs(green - 6) + abs(blue - 5)) * 10;
+        score += alpha * 10;
+        score += (depth - minDepth) + (stencil - minStencil);
+    }
+    else {
+        // The traditional 32-bit path: exactly 32 bits per pixel if the
+        // driver has it, else whatever is nearest
+        score += abs(buffer - 32) * 10;
+        score += (depth - minDepth) + (stencil - minStencil);
+    }
+
+    return score;
+}
+
+void WaylandDisplay::addWindow(WaylandWindow* window)
+{
+    m_windows.push_back(window);
+}
+
+void WaylandDisplay::removeWindow(WaylandWindow* window)
+{
+    m_windows.erase(std::remove(m_windows.begin(), m_windows.end(), window),
+                    m_windows.end());
+
+    if (m_keyboardFocus == window) {
+        m_keyboardFocus = NULL;
+    }
+    if (m_pointerFocus == window) {
+        m_pointerFocus = NULL;
+    }
+}
+
+WaylandWindow* WaylandDisplay::findWindow(struct wl_surface* surface) const
+{
+    for (size_t i = 0; i < m_windows.size(); i++) {
+        if (m_windows[i]->m_surface == surface) {
+            return m_windows[i];
+        }
+    }
+    return NULL;
+}
+
+static double monotonic_seconds()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+void WaylandDisplay::run()
+{
+    double start = monotonic_seconds();
+
+    int fd = wl_display_get_fd(m_display);
+    m_eventLoop.addFd(fd, EPOLLIN, NULL, NULL);
+
+    while (m_running && !m_windows.empty()) {
+        // Queue up everything already read before blocking, then send
+        // our own requests out
+        while (wl_display_prepare_read(m_display) != 0) {
+            wl_display_dispatch_pending(m_display);
+        }
+        wl_display_flush(m_display);
+
+        // With idle work pending, wake up again when the next frame's
+        // budget opens even if nothing else happens
+        int timeout = -1;
+        if (m_eventLoop.hasIdle()) {
+            uint64_t now = EventLoop::now();
+            timeout = (m_eventLoop.nextFrameDeadline(now) - now) / 1000000 + 1;
+        }
+
+        if (!m_eventLoop.wait(timeout)) {
+            wl_display_cancel_read(m_display);
+            break;
+        }
+
+        uint32_t events;
+        if (m_eventLoop.isReady(fd, &events)) {
+            if ((events & (EPOLLERR | EPOLLHUP)) ||
+                wl_display_read_events(m_display) == -1) {
+                break;
+            }
+        }
+        else {
+            wl_display_cancel_read(m_display);
+        }
+
+        if (wl_display_dispatch_pending(m_display) == -1) {
+            break;
+        }
+
+        // Application fds and timers, then whatever idle work fits in
+        // before the next frame
+        m_eventLoop.dispatch();
+        m_eventLoop.runIdle();
+    }
+
+    m_eventLoop.removeFd(fd);
+
+    for (size_t i = 0; i < m_windows.size(); i++) {
+        m_windows[i]->destroyGl();
+    }
+
+    size_t leaks = GpuResources::reportLeaks(stderr);
+
+    if (m_reportUsage) {
+        printUsage(monotonic_seconds() - start);
+    }
+
+    Trace::finish();
+
+    if (m_watchGpuMemory) {
+        GpuResources::printSummary(stdout);
+        if (leaks > 0) {
+            exit(EXIT_FAILURE);
+        }
+    }
+}
+
+void WaylandDisplay::printUsage(double wallSeconds) const
+{
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+
+    double user = usage.ru_utime.tv_sec + usage.ru_utime.tv_usec / 1e6;
+    double sys = usage.ru_stime.tv_sec + usage.ru_stime.tv_usec / 1e6;
+
+    std::printf("%zu window(s): user %.2fs sys %.2fs wall %.2fs (%.1f%% of one core)\n",
+                m_windows.size(), user, sys, wallSeconds,
+                wallSeconds > 0 ? (user + sys) / wallSeconds * 100 : 0);
+
+    // Every wakeup of the main loop is the CPU leaving idle
+    std::printf("  %llu wakeups (%.1f/s)\n", (unsigned long long)m_eventLoop.wakeups(),
+                wallSeconds > 0 ? m_eventLoop.wakeups() / wallSeconds : 0);
+
+    for (size_t i = 0; i < m_windows.size(); i++) {
+        uint32_t frames = m_windows[i]->frameStats().frameCount();
+        std::printf("  window %zu: %u frames drawn (%.1f/s), %u skipped\n", i, frames,
+                    wallSeconds > 0 ? frames / wallSeconds : 0,
+                    m_windows[i]->framesSkipped());
+    }
+}
+
+void WaylandDisplay::handleRegistryGlobal(
+        void* data,
+        struct wl_registry* registry,
+        uint32_t name,
+        const char* interface,
+        uint32_t version)
+{
+    WaylandDisplay* self = static_cast<WaylandDisplay*>(data);
+
+    if (std::string("wl_compositor") == interface) {
+        self->m_compositor = (struct wl_compositor*)wl_registry_bind(
+                registry,
+                name,
+                &wl_compositor_interface,
+                1);
+    }
+    else if (std::string("wl_shell") == interface) {
+        self->m_shell = (struct wl_shell*)wl_registry_bind(
+                registry,
+                name,
+                &wl_shell_interface,
+                1);
+    }
+    else if (std::string("wl_subcompositor") == interface) {
+        self->m_subcompositor = (struct wl_subcompositor*)wl_registry_bind(
+                registry,
+                name,
+                &wl_subcompositor_interface,
+                1);
+    }
+    else if (std::string("wl_seat") == interface) {
+        // Version 5 for wl_pointer.frame, which groups pointer events
+        self->m_seatVersion = std::min(version, (uint32_t)WL_POINTER_FRAME_SINCE_VERSION);
+        self->m_seat = (struct wl_seat*)wl_registry_bind(
+                registry,
+                name,
+                &wl_seat_interface,
+                self->m_seatVersion);
+        wl_seat_add_listener(self->m_seat, &s_seatListener, self);
+    }
+}
+
+void WaylandDisplay::handleRegistryGlobalRemove(
+        void* data,
+        struct wl_registry* registry,
+        uint32_t name)
+{
+}
+
+void WaylandDisplay::handleSeatCapabilities(
+        void* data,
+        struct wl_seat* seat,
+        uint32_t caps)
+{
+    WaylandDisplay* self = static_cast<WaylandDisplay*>(data);
+
+    if ((caps & WL_SEAT_CAPABILITY_KEYBOARD) && !self->m_keyboard) {
+        self->m_keyboard = wl_seat_get_keyboard(seat);
+        wl_keyboard_add_listener(self->m_keyboard, &self->s_keyboardListener, self);
+    }
+    else if (!(caps & WL_SEAT_CAPABILITY_KEYBOARD) && self->m_keyboard) {
+        wl_keyboard_destroy(self->m_keyboard);
+        self->m_keyboard = NULL;
+        self->m_keyboardFocus = NULL;
+    }
+
+    if ((caps & WL_SEAT_CAPABILITY_POINTER) && !self->m_pointer) {
+        self->m_pointer = wl_seat_get_pointer(seat);
+        wl_pointer_add_listener(self->m_pointer, &self->s_pointerListener, self);
+    } else if (!(caps & WL_SEAT_CAPABILITY_POINTER) && self->m_pointer) {
+        wl_pointer_destroy(self->m_pointer);
+        self->m_pointer = NULL;
+        self->m_pointerFocus = NULL;
+    }
+}
+
+void WaylandDisplay::handleSeatName(
+        void* data,
+        struct wl_seat* seat,
+        char const* name)
+{
+}
+
+void WaylandDisplay::handleKeyboardKeymap(void *data,
+                                          struct wl_keyboard* keyboard,
+                                          uint32_t format,
+                                          int32_t fd,
+                                          uint32_t size)
+{
+}
+
+void WaylandDisplay::handleKeyboardEnter(void* data,
+                                         struct wl_keyboard* keyboard,
+                                         uint32_t serial,
+                                         struct wl_surface* surface,
+                                         struct wl_array* keys)
+{
+    WaylandDisplay* self = static_cast<WaylandDisplay*>(data);
+    self->m_keyboardFocus = self->findWindow(surface);
+}
+
+void WaylandDisplay::handleKeyboardLeave(void* data,
+                                         struct wl_keyboard* keyboard,
+                                         uint32_t serial,
+                                         struct wl_surface* surface)
+{
+    WaylandDisplay* self = static_cast<WaylandDisplay*>(data);
+    self->m_keyboardFocus = NULL;
+}
+
+void WaylandDisplay::handleKeyboardKey(void* data,
+                                       struct wl_keyboard* keyboard,
+                                       uint32_t serial,
+                                       uint32_t time,
+                                       uint32_t key,
+                                       uint32_t state)
+
+{
+    WaylandDisplay* self = static_cast<WaylandDisplay*>(data);
+
+    switch (key) {
+        case KEY_Q:
+        case KEY_ESC:
+            self->quit();
+            break;
+
+        default:
+            // Acted on by the focused window's next frame
+            if (self->m_keyboardFocus) {
+                self->m_keyboardFocus->m_input.key(
+                        serial, key, state,
+                        InputQueue::eventTime(time, EventLoop::now()));
+                self->m_keyboardFocus->scheduleRedraw();
+            }
+            break;
+    }
+}
+
+void WaylandDisplay::handleKeyboardModifiers(void* data,
+                                             struct wl_keyboard* keyboard,
+                                             uint32_t serial,
+                                             uint32_t mods_depressed,
+                                             uint32_t mods_latched,
+                                             uint32_t mods_locked,
+                                             uint32_t group)
+{
+}
+
+void WaylandDisplay::handleKeyboardRepeatInfo(void* data,
+                                              struct wl_keyboard* keyboard,
+                                              int32_t rate,
+                                              int32_t delay)
+{
+}
+
+void WaylandDisplay::handlePointerEnter(void* data,
+                                        struct wl_pointer* pointer,
+                                        uint32_t serial,
+                                        struct wl_surface* surface,
+                                        wl_fixed_t sx,
+                                        wl_fixed_t sy)
+{
+    WaylandDisplay* self = static_cast<WaylandDisplay*>(data);
+    self->m_pointerFocus = self->findWindow(surface);
+
+    if (self->m_pointerFocus) {
+        self->m_pointerFocus->m_input.pointerEnter(wl_fixed_to_double(sx),
+                                                   wl_fixed_to_double(sy));
+        self->endPointerEvent();
+    }
+}
+
+void WaylandDisplay::handlePointerLeave(void* data,
+                                        struct wl_pointer* pointer,
+                                        uint32_t serial,
+                                        struct wl_surface* surface)
+{
+    WaylandDisplay* self = static_cast<WaylandDisplay*>(data);
+
+    // Nothing else in this group can be for the window being left
+    if (self->m_pointerFocus) {
+        self->m_pointerFocus->m_input.pointerLeave();
+        self->m_pointerFocus->m_input.pointerFrame();
+        self->m_pointerFocus->scheduleRedraw();
+    }
+    self->m_pointerFocus = NULL;
+}
+
+void WaylandDisplay::handlePointerMotion(void* data,
+                                         struct wl_pointer* pointer,
+                                         uint32_t time,
+                                         wl_fixed_t sx,
+                                         wl_fixed_t sy)
+{
+    WaylandDisplay* self = static_cast<WaylandDisplay*>(data);
+
+    if (self->m_pointerFocus) {
+        self->m_pointerFocus->m_input.pointerMotion(
+                wl_fixed_to_double(sx), wl_fixed_to_double(sy),
+                InputQueue::eventTime(time, EventLoop::now()));
+        self->endPointerEvent();
+    }
+}
+
+void WaylandDisplay::handlePointerButton(void* data,
+                                         struct wl_pointer* pointer,
+                                         uint32_t serial,
+                                         uint32_t time,
+                                         uint32_t button,
+                                         uint32_t state)
+{
+    WaylandDisplay* self = static_cast<WaylandDisplay*>(data);
+
+    if (self->m_pointerFocus) {
+        self->m_pointerFocus->m_input.pointerButton(
+                serial, button, state,
+                InputQueue::eventTime(time, EventLoop::now()));
+        self->endPointerEvent();
+    }
+}
+
+void WaylandDisplay::handlePointerAxis(void* data,
+                                       struct wl_pointer* pointer,
+                                       uint32_t time,
+                                       uint32_t axis,
+                                       wl_fixed_t value)
+{
+    WaylandDisplay* self = static_cast<WaylandDisplay*>(data);
+
+    if (self->m_pointerFocus) {
+        self->m_pointerFocus->m_input.pointerAxis(
+                axis, wl_fixed_to_double(value),
+                InputQueue::eventTime(time, EventLoop::now()));
+        self->endPointerEvent();
+    }
+}
+
+void WaylandDisplay::handlePointerFrame(void* data, struct wl_pointer* pointer)
+{
+    WaylandDisplay* self = static_cast<WaylandDisplay*>(data);
+
+    if (self->m_pointerFocus) {
+        self->m_pointerFocus->m_input.pointerFrame();
+        self->m_pointerFocus->scheduleRedraw();
+    }
+}
+
+void WaylandDisplay::handlePointerAxisSource(void* data,
+                                             struct wl_pointer* pointer,
+                                             uint32_t source)
+{
+}
+
+void WaylandDisplay::handlePointerAxisStop(void* data,
+                                           struct wl_pointer* pointer,
+                                           uint32_t time,
+                                           uint32_t axis)
+{
+}
+
+void WaylandDisplay::handlePointerAxisDiscrete(void* data,
+                                               struct wl_pointer* pointer,
+                                               uint32_t axis,
+                                               int32_t discrete)
+{
+}
+
+void WaylandDisplay::endPointerEvent()
+{
+    if (m_seatVersion < WL_POINTER_FRAME_SINCE_VERSION && m_pointerFocus) {
+        m_pointerFocus->m_input.pointerFrame();
+        m_pointerFocus->scheduleRedraw();
+    }
+}
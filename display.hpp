@@ -0,0 +1,238 @@
+#ifndef __DISPLAY_HPP__
+#define __DISPLAY_HPP__
+
+#include <wayland-client.h>
+#include <EGL/egl.h>
+
+#include <vector>
+
+#include "event-loop.hpp"
+
+class JobSystem;
+class WaylandWindow;
+
+// The connection to the compositor plus everything that can be shared
+// between windows: the global interfaces, the input devices, and one
+// EGLDisplay/EGLContext. All windows created against the same
+// WaylandDisplay render with that one context, so GL objects created by
+// one of them are usable from all the others. Each window still has its
+// own surface and its own frame-callback pacing.
+class WaylandDisplay
+{
+public:
+    WaylandDisplay();
+    ~WaylandDisplay();
+
+    // Every option a window takes, for getopt()
+    static char const OPTIONS[];
+
+    // Applies the options that are about the whole process (-j, -l, -m,
+    // -t and -u) and skips the rest, which are each window's. Every
+    // window's init() calls this with the same arguments; only the first
+    // call does anything.
+    void parseOptions(int argc, char* argv[]);
+
+    // Connects and sets up EGL. 'configAttribs' are the EGL config
+    // attributes needed on top of the stock ones. This is done by the
+    // first window's init(), so every window sharing the display must
+    // be happy with the config that window asked for.
+    void init(std::vector<EGLint> const& configAttribs);
+    bool isInitialized() const  { return m_display != NULL; }
+
+    // Dispatches events until quit() or until there are no windows left,
+    // then tears down GL for every window still attached. Besides the
+    // compositor connection this services whatever fds, timers and idle
+    // tasks have been added to eventLoop().
+    void run();
+    void quit()                 { m_running = false; }
+
+    // Print process CPU usage against wall-clock time when run() returns
+    void setReportUsage(bool report)    { m_reportUsage = report; }
+
+    // GL objects still alive once every window has torn down are always
+    // listed on stderr. Watching (-m) also prints the totals on exit,
+    // fails the run if anything leaked, and makes each window treat
+    // steady growth in GPU memory while it draws as fatal.
+    void setWatchGpuMemory(bool watch)  { m_watchGpuMemory = watch; }
+    bool watchGpuMemory() const         { return m_watchGpuMemory; }
+
+    // Low-bandwidth rendering profile, chosen before init(): prefer an
+    // RGB565 config with no alpha and the least depth/stencil the
+    // application asked for, discard depth and stencil at the end of
+    // each frame, and mark window surfaces opaque.
+    void setLowBandwidth(bool lowBandwidth) { m_lowBandwidth = lowBandwidth; }
+    bool lowBandwidth() const               { return m_lowBandwidth; }
+
+    // The thread pool shared by every window for per-frame CPU work,
+    // started on first use with one thread per CPU unless
+    // setJobThreads() (or -j) has said otherwise
+    JobSystem& jobs();
+    void setJobThreads(int threads)     { m_jobThreads = threads; }
+
+    struct wl_display* wlDisplay() const        { return m_display; }
+    struct wl_compositor* compositor() const    { return m_compositor; }
+    struct wl_shell* shell() const              { return m_shell; }
+
+    // NULL if the compositor can't do subsurfaces
+    struct wl_subcompositor* subcompositor() const  { return m_subcompositor; }
+    struct wl_seat* seat() const                { return m_seat; }
+
+    EGLDisplay eglDisplay() const   { return m_eglDisplay; }
+    EGLConfig eglConfig() const     { return m_eglConfig; }
+    EGLContext eglContext() const   { return m_eglContext; }
+
+    EventLoop& eventLoop()          { return m_eventLoop; }
+
+private:
+    friend class WaylandWindow;
+
+    void addWindow(WaylandWindow* window);
+    void removeWindow(WaylandWindow* window);
+    WaylandWindow* findWindow(struct wl_surface* surface) const;
+
+    void printUsage(double wallSeconds) const;
+
+    static EGLint attribValue(std::vector<EGLint> const& attribs,
+                              EGLint attrib, EGLint fallback);
+    int scoreConfig(EGLConfig config, EGLint minDepth, EGLint minStencil) const;
+
+private:
+    // Server interfaces
+    struct wl_display* m_display;
+    struct wl_registry* m_registry;
+    struct wl_compositor* m_compositor;
+    struct wl_shell* m_shell;
+    struct wl_subcompositor* m_subcompositor;
+    struct wl_seat* m_seat;
+    uint32_t m_seatVersion;
+    struct wl_keyboard* m_keyboard;
+    struct wl_pointer* m_pointer;
+
+    // Callbacks
+    static void handleRegistryGlobal(void* data, struct wl_registry* registry,
+                                     uint32_t name, const char* interface,
+                                     uint32_t version);
+
+    static void handleRegistryGlobalRemove(void* data,
+                                           struct wl_registry* registry,
+                                           uint32_t name);
+
+    static void handleSeatCapabilities(void* data,
+                                       struct wl_seat* seat,
+                                       uint32_t capabilities);
+
+    static void handleSeatName(void* data,
+                               struct wl_seat* seat,
+                               char const* name);
+
+    static void handleKeyboardKeymap(void *data,
+                                     struct wl_keyboard* keyboard,
+                                     uint32_t format,
+                                     int32_t fd,
+                                     uint32_t size);
+
+    static void handleKeyboardEnter(void *data,
+                                    struct wl_keyboard* keyboard,
+                                    uint32_t serial,
+                                    struct wl_surface* surface,
+                                    struct wl_array* keys);
+
+    static void handleKeyboardLeave(void *data,
+                                    struct wl_keyboard* keyboard,
+                                    uint32_t serial,
+                                    struct wl_surface* surface);
+
+    static void handleKeyboardKey(void *data, struct wl_keyboard* keyboard,
+                                  uint32_t serial, uint32_t time,
+                                  uint32_t key, uint32_t state);
+
+    static void handleKeyboardModifiers(void* data,
+                                        struct wl_keyboard* keyboard,
+                                        uint32_t serial,
+                                        uint32_t mods_depressed,
+                                        uint32_t mods_latched,
+                                        uint32_t mods_locked,
+                                        uint32_t group);
+
+    static void handleKeyboardRepeatInfo(void* data,
+                                         struct wl_keyboard* keyboard,
+                                         int32_t rate,
+                                         int32_t delay);
+
+    static void handlePointerEnter(void* data,
+                                   struct wl_pointer* pointer,
+                                   uint32_t serial,
+                                   struct wl_surface* surface,
+                                   wl_fixed_t sx,
+                                   wl_fixed_t sy);
+
+    static void handlePointerLeave(void* data,
+                                   struct wl_pointer* pointer,
+                                   uint32_t serial,
+                                   struct wl_surface* surface);
+
+    static void handlePointerMotion(void* data,
+                                    struct wl_pointer* pointer,
+                                    uint32_t time,
+                                    wl_fixed_t sx,
+                                    wl_fixed_t sy);
+
+    static void handlePointerButton(void* data,
+                                    struct wl_pointer* pointer,
+                                    uint32_t serial,
+                                    uint32_t time,
+                                    uint32_t button,
+                                    uint32_t state);
+
+    static void handlePointerAxis(void* data,
+                                  struct wl_pointer* pointer,
+                                  uint32_t time,
+                                  uint32_t axis,
+                                  wl_fixed_t value);
+
+    static void handlePointerFrame(void* data, struct wl_pointer* pointer);
+
+    static void handlePointerAxisSource(void* data,
+                                        struct wl_pointer* pointer,
+                                        uint32_t source);
+
+    static void handlePointerAxisStop(void* data,
+                                      struct wl_pointer* pointer,
+                                      uint32_t time,
+                                      uint32_t axis);
+
+    static void handlePointerAxisDiscrete(void* data,
+                                          struct wl_pointer* pointer,
+                                          uint32_t axis,
+                                          int32_t discrete);
+
+    // Without wl_pointer.frame, each pointer event ends its own group
+    void endPointerEvent();
+
+    // Callback table structures
+    static const struct wl_registry_listener s_registryListener;
+    static const struct wl_seat_listener s_seatListener;
+    static const struct wl_keyboard_listener s_keyboardListener;
+    static const struct wl_pointer_listener s_pointerListener;
+
+    // EGL objects shared by every window
+    EGLDisplay m_eglDisplay;
+    EGLConfig m_eglConfig;
+    EGLContext m_eglContext;
+
+    // Windows driven by this display, and which of them has input focus
+    std::vector<WaylandWindow*> m_windows;
+    WaylandWindow* m_keyboardFocus;
+    WaylandWindow* m_pointerFocus;
+
+    EventLoop m_eventLoop;
+    JobSystem* m_jobs;
+    int m_jobThreads;
+    bool m_running;
+    bool m_reportUsage;
+    bool m_watchGpuMemory;
+    bool m_lowBandwidth;
+    bool m_optionsParsed;
+};
+
+#endif
@@ -0,0 +1,308 @@
+#include <cmath>
+#include <cstdio>
+#include <stdlib.h>
+#include <string>
+#include <time.h>
+#include <unistd.h>
+
+#include <vector>
+
+#include "base.hpp"
+#include "command-list.hpp"
+#include "shader.hpp"
+
+// Draw submission from many threads. A GRID x GRID field of spinning
+// quads, each its own draw with its own uniforms, 10000 in all. Every
+// frame each row of quads is recorded into a CommandList by a job,
+// and the lists are replayed in row order on the GL thread.
+//
+// Each quad records everything it needs (program, buffer, attribute
+// array, uniforms, draw) as if it knew nothing about its neighbours; the
+// replay drops whatever doesn't change anything.
+//
+// Prints the time spent recording and replaying per frame and how many
+// calls the replay issued and skipped. With 'direct', the same work is
+// done on the GL thread alone, calling GL as it goes, for comparison.
+// The thread count is one per CPU, or what -j says.
+//
+// Usage: drawlists [window options] [direct]
+
+static const char* vert_shader_text =
+    "uniform vec4 u_transform;\n"
+    "attribute vec2 a_pos;\n"
+    "varying vec2 v_pos;\n"
+    "void main() {\n"
+    "  mat2 m = mat2(u_transform.z, u_transform.w, -u_transform.w, u_transform.z);\n"
+    "  gl_Position = vec4(u_transform.xy + m * a_pos, 0, 1);\n"
+    "  v_pos = a_pos;\n"
+    "}\n";
+
+static const char* flat_shader_text =
+    "precision mediump float;\n"
+    "uniform vec4 u_color;\n"
+    "varying vec2 v_pos;\n"
+    "void main() {\n"
+    "  gl_FragColor = u_color;\n"
+    "}\n";
+
+static const char* ring_shader_text =
+    "precision mediump float;\n"
+    "uniform vec4 u_color;\n"
+    "varying vec2 v_pos;\n"
+    "void main() {\n"
+    "  float r = length(v_pos);\n"
+    "  gl_FragColor = u_color * smoothstep(1.0, 0.8, r) * (0.4 + 0.6 * smoothstep(0.3, 0.5, r));\n"
+    "}\n";
+
+// Frames between reports
+static const uint32_t REPORT_INTERVAL = 120;
+
+static const int GRID = 100;
+
+// Rows switch program every this many
+static const int PROGRAM_BAND = 10;
+
+enum {
+    ATTRIB_POS,
+};
+
+static double nowMs()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000.0 + ts.tv_nsec / 1000000.0;
+}
+
+class DrawListsWindow: public WaylandWindow
+{
+public:
+    DrawListsWindow()
+        : m_direct(false)
+        , m_lists(GRID)
+        , m_recordMs(0)
+        , m_replayMs(0)
+        , m_issued(0)
+        , m_skipped(0)
+    {
+    }
+
+    virtual ~DrawListsWindow() {}
+
+    void setDirect(bool direct)     { m_direct = direct; }
+
+protected:
+    virtual void setupGl()
+    {
+        static char const* const attribs[] = { "a_pos", NULL };
+        static const GLfloat quad[] = {
+            -1, -1,
+            +1, -1,
+            -1, +1,
+            +1, +1,
+        };
+
+        GLuint vert = createShader(vert_shader_text, GL_VERTEX_SHADER);
+        GLuint frag = createShader(flat_shader_text, GL_FRAGMENT_SHADER);
+        m_programs[0] = linkProgram(vert, frag, attribs);
+        GpuResources::deleteShader(frag);
+
+        frag = createShader(ring_shader_text, GL_FRAGMENT_SHADER);
+        m_programs[1] = linkProgram(vert, frag, attribs);
+        GpuResources::deleteShader(frag);
+        GpuResources::deleteShader(vert);
+
+        // Linked the same way, but locations are only promised per program
+        for (int i = 0; i < 2; i++) {
+            m_uTransform[i] = glGetUniformLocation(m_programs[i], "u_transform");
+            m_uColor[i] = glGetUniformLocation(m_programs[i], "u_color");
+        }
+
+        m_quad = GpuResources::createBuffer("drawlists quad");
+        glBindBuffer(GL_ARRAY_BUFFER, m_quad);
+        GpuResources::bufferData(m_quad, GL_ARRAY_BUFFER, sizeof(quad), quad, GL_STATIC_DRAW);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+    }
+
+    virtual void drawGl(uint32_t time)
+    {
+        glViewport(0, 0, currentSize().m_width, currentSize().m_height);
+        glClearColor(0.05f, 0.05f, 0.08f, 1);
+        glClear(GL_COLOR_BUFFER_BIT);
+
+        m_time = time / 1000.0f;
+
+        if (m_direct) {
+            double start = nowMs();
+            drawDirect();
+            m_recordMs += nowMs() - start;
+        }
+        else {
+            double start = nowMs();
+
+            m_arenas.reset(jobs());
+            JobCounter recorded;
+            jobs().parallelFor(recordRows, this, GRID, 1, recorded);
+            jobs().wait(recorded);
+
+            double replayStart = nowMs();
+            uint64_t issued = m_replayer.issued();
+            uint64_t skipped = m_replayer.skipped();
+
+            m_replayer.replay(&m_lists[0], m_lists.size());
+            glDisableVertexAttribArray(ATTRIB_POS);
+            glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+            m_recordMs += replayStart - start;
+            m_replayMs += nowMs() - replayStart;
+            m_issued += m_replayer.issued() - issued;
+            m_skipped += m_replayer.skipped() - skipped;
+        }
+
+        for (int i = 0; i < GRID * GRID; i++) {
+            recordDraw(GL_TRIANGLE_STRIP, 4);
+        }
+
+        report();
+    }
+
+    virtual void teardownGl()
+    {
+        GpuResources::deleteBuffer(m_quad);
+        GpuResources::deleteProgram(m_programs[0]);
+        GpuResources::deleteProgram(m_programs[1]);
+    }
+
+private:
+    // Where a quad is this frame and what colour, in the uniforms'
+    // layout. This is the per-draw CPU work that recording spreads out.
+    void animate(int row, int column, GLfloat transform[4], GLfloat color[4]) const
+    {
+        float cell = 2.0f / GRID;
+        float phase = m_time * 1.5f + (row * 0.37f + column * 0.23f);
+        float angle = m_time + (row + column) * 0.1f;
+        float scale = cell * (0.3f + 0.15f * sinf(phase));
+
+        transform[0] = -1 + cell * (column + 0.5f) + cell * 0.1f * cosf(phase * 1.3f);
+        transform[1] = -1 + cell * (row + 0.5f) + cell * 0.1f * sinf(phase * 0.7f);
+        transform[2] = scale * cosf(angle);
+        transform[3] = scale * sinf(angle);
+
+        color[0] = 0.5f + 0.5f * sinf(phase);
+        color[1] = 0.5f + 0.5f * sinf(phase + 2.094f);
+        color[2] = 0.5f + 0.5f * sinf(phase + 4.189f);
+        color[3] = 1;
+    }
+
+    static void recordRows(void* data, size_t begin, size_t end)
+    {
+        DrawListsWindow* self = static_cast<DrawListsWindow*>(data);
+
+        for (size_t row = begin; row < end; row++) {
+            self->recordRow(row);
+        }
+    }
+
+    void recordRow(int row)
+    {
+        CommandList& list = m_lists[row];
+        int program = row / PROGRAM_BAND % 2;
+
+        list.begin(m_arenas.current(jobs()));
+
+        for (int column = 0; column < GRID; column++) {
+            GLfloat transform[4], color[4];
+            animate(row, column, transform, color);
+
+            list.useProgram(m_programs[program]);
+            list.bindBuffer(GL_ARRAY_BUFFER, m_quad);
+            list.vertexAttribPointer(ATTRIB_POS, 2, GL_FLOAT, GL_FALSE, 0, 0);
+            list.enableVertexAttribArray(ATTRIB_POS);
+            list.uniform(m_uTransform[program], 4, transform);
+            list.uniform(m_uColor[program], 4, color);
+            list.drawArrays(GL_TRIANGLE_STRIP, 0, 4);
+        }
+    }
+
+    // What a single-threaded renderer would do: set what changes, as it
+    // goes
+    void drawDirect()
+    {
+        glBindBuffer(GL_ARRAY_BUFFER, m_quad);
+        glVertexAttribPointer(ATTRIB_POS, 2, GL_FLOAT, GL_FALSE, 0, 0);
+        glEnableVertexAttribArray(ATTRIB_POS);
+
+        for (int row = 0; row < GRID; row++) {
+            int program = row / PROGRAM_BAND % 2;
+            if (row % PROGRAM_BAND == 0) {
+                glUseProgram(m_programs[program]);
+            }
+
+            for (int column = 0; column < GRID; column++) {
+                GLfloat transform[4], color[4];
+                animate(row, column, transform, color);
+
+                glUniform4fv(m_uTransform[program], 1, transform);
+                glUniform4fv(m_uColor[program], 1, color);
+                glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+            }
+        }
+
+        glDisableVertexAttribArray(ATTRIB_POS);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+    }
+
+    void report()
+    {
+        uint32_t frames = frameStats().frameCount();
+        if (frames == 0 || frames % REPORT_INTERVAL != 0) {
+            return;
+        }
+
+        if (m_direct) {
+            printf("direct: %.1f fps, %.2f ms per frame building and issuing %d draws\n",
+                   frameStats().fps(), m_recordMs / REPORT_INTERVAL, GRID * GRID);
+        }
+        else {
+            printf("%d thread%s: %.1f fps, record %.2f ms, replay %.2f ms per frame; "
+                   "%.0f calls issued, %.0f skipped; %zu KB recorded\n",
+                   jobs().threads(), jobs().threads() == 1 ? "" : "s",
+                   frameStats().fps(), m_recordMs / REPORT_INTERVAL,
+                   m_replayMs / REPORT_INTERVAL, double(m_issued) / REPORT_INTERVAL,
+                   double(m_skipped) / REPORT_INTERVAL, m_arenas.bytesUsed() / 1024);
+        }
+
+        m_recordMs = m_replayMs = 0;
+        m_issued = m_skipped = 0;
+    }
+
+    bool m_direct;
+    float m_time;
+
+    GLuint m_programs[2];
+    GLint m_uTransform[2];
+    GLint m_uColor[2];
+    GLuint m_quad;
+
+    // One list per row
+    std::vector<CommandList> m_lists;
+    CommandArenas m_arenas;
+    CommandReplayer m_replayer;
+
+    // Accumulated since the last report
+    double m_recordMs;
+    double m_replayMs;
+    uint64_t m_issued;
+    uint64_t m_skipped;
+};
+
+int main(int argc, char* argv[])
+{
+    DrawListsWindow w;
+    w.init(&argc, argv);
+
+    // Positional arguments are what's left after the window options
+    w.setDirect(optind < argc && std::string(argv[optind]) == "direct");
+
+    w.run();
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,256 @@
+#include <assert.h>
+#include <errno.h>
+#include <sys/epoll.h>
+#include <sys/timerfd.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "event-loop.hpp"
+
+static const uint64_t NS_PER_MS = 1000000;
+
+// Assume 60Hz until real frames say otherwise
+static const uint64_t DEFAULT_FRAME_INTERVAL = 16666667;
+
+EventLoop::EventLoop()
+    : m_nextTimerId(1)
+    , m_idleMargin(1 * NS_PER_MS)
+    , m_lastFrame(0)
+    , m_frameInterval(DEFAULT_FRAME_INTERVAL)
+    , m_wakeups(0)
+{
+    m_epollFd = epoll_create1(EPOLL_CLOEXEC);
+    assert(m_epollFd >= 0);
+
+    m_timerFd = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC | TFD_NONBLOCK);
+    assert(m_timerFd >= 0);
+
+    addFd(m_timerFd, EPOLLIN, NULL, NULL);
+}
+
+EventLoop::~EventLoop()
+{
+    close(m_timerFd);
+    close(m_epollFd);
+}
+
+uint64_t EventLoop::now()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+void EventLoop::addFd(int fd, uint32_t events, FdCallback callback, void* data)
+{
+    struct epoll_event ev;
+    ev.events = events;
+    ev.data.fd = fd;
+
+    int ret = epoll_ctl(m_epollFd, EPOLL_CTL_ADD, fd, &ev);
+    assert(ret == 0);
+
+    FdWatch watch;
+    watch.m_callback = callback;
+    watch.m_data = data;
+    m_fds[fd] = watch;
+}
+
+void EventLoop::removeFd(int fd)
+{
+    epoll_ctl(m_epollFd, EPOLL_CTL_DEL, fd, NULL);
+    m_fds.erase(fd);
+}
+
+int EventLoop::addTimer(uint64_t deadline, TimerCallback callback, void* data)
+{
+    Timer timer;
+    timer.m_id = m_nextTimerId++;
+    timer.m_callback = callback;
+    timer.m_data = data;
+
+    m_timers.insert(std::make_pair(deadline, timer));
+    armTimerFd();
+
+    return timer.m_id;
+}
+
+void EventLoop::cancelTimer(int id)
+{
+    std::multimap<uint64_t, Timer>::iterator i;
+
+    for (i = m_timers.begin(); i != m_timers.end(); ++i) {
+        if (i->second.m_id == id) {
+            m_timers.erase(i);
+            armTimerFd();
+            return;
+        }
+    }
+}
+
+void EventLoop::armTimerFd()
+{
+    struct itimerspec spec = {};
+
+    // Zero disarms; the earliest deadline otherwise. A deadline already
+    // in the past still has to be non-zero to arm the timer.
+    if (!m_timers.empty()) {
+        uint64_t deadline = m_timers.begin()->first;
+        if (deadline == 0) {
+            deadline = 1;
+        }
+        spec.it_value.tv_sec = deadline / 1000000000ull;
+        spec.it_value.tv_nsec = deadline % 1000000000ull;
+    }
+
+    timerfd_settime(m_timerFd, TFD_TIMER_ABSTIME, &spec, NULL);
+}
+
+void EventLoop::fireTimers()
+{
+    uint64_t expirations;
+    while (read(m_timerFd, &expirations, sizeof(expirations)) > 0) {
+    }
+
+    uint64_t t = now();
+
+    // Callbacks may add or cancel timers, so take one at a time
+    while (!m_timers.empty() && m_timers.begin()->first <= t) {
+        Timer timer = m_timers.begin()->second;
+        m_timers.erase(m_timers.begin());
+        timer.m_callback(timer.m_data);
+    }
+
+    armTimerFd();
+}
+
+void EventLoop::addIdle(IdleCallback callback, void* data, uint64_t cost)
+{
+    IdleTask task;
+    task.m_callback = callback;
+    task.m_data = data;
+    task.m_cost = cost;
+    m_idle.push_back(task);
+}
+
+void EventLoop::frameRendered(uint64_t when)
+{
+    if (m_lastFrame) {
+        uint64_t delta = when - m_lastFrame;
+
+        // Windows that share an output are redrawn back to back from the
+        // same vblank, and long gaps are the application being idle.
+        // Neither says anything about the refresh rate.
+        if (delta > 2 * NS_PER_MS && delta < 250 * NS_PER_MS) {
+            m_frameInterval = (m_frameInterval * 7 + delta) / 8;
+        }
+    }
+
+    m_lastFrame = when;
+}
+
+uint64_t EventLoop::nextFrameDeadline(uint64_t when) const
+{
+    if (!m_lastFrame) {
+        return when + m_frameInterval;
+    }
+
+    uint64_t deadline = m_lastFrame + m_frameInterval;
+    if (deadline <= when) {
+        deadline += ((when - deadline) / m_frameInterval + 1) * m_frameInterval;
+    }
+    return deadline;
+}
+
+bool EventLoop::wait(int timeoutMs)
+{
+    struct epoll_event events[16];
+
+    m_ready.clear();
+
+    int n = epoll_wait(m_epollFd, events, 16, timeoutMs);
+    m_wakeups++;
+
+    if (n < 0) {
+        return errno == EINTR;
+    }
+
+    for (int i = 0; i < n; i++) {
+        int fd = events[i].data.fd;
+        uint32_t ready = events[i].events;
+        m_ready.push_back(std::make_pair(fd, ready));
+    }
+
+    return true;
+}
+
+bool EventLoop::isReady(int fd, uint32_t* events) const
+{
+    for (size_t i = 0; i < m_ready.size(); i++) {
+        if (m_ready[i].first == fd) {
+            if (events) {
+                *events = m_ready[i].second;
+            }
+            return true;
+        }
+    }
+    return false;
+}
+
+void EventLoop::dispatch()
+{
+    for (size_t i = 0; i < m_ready.size(); i++) {
+        int fd = m_ready[i].first;
+
+        if (fd == m_timerFd) {
+            fireTimers();
+            continue;
+        }
+
+        // Looked up again each time in case an earlier callback removed it
+        std::map<int, FdWatch>::iterator watch = m_fds.find(fd);
+        if (watch != m_fds.end() && watch->second.m_callback) {
+            watch->second.m_callback(watch->second.m_data, fd, m_ready[i].second);
+        }
+    }
+
+    m_ready.clear();
+}
+
+void EventLoop::runIdle()
+{
+    uint64_t t = now();
+    uint64_t deadline = nextFrameDeadline(t);
+
+    // Don't make a timer late either
+    if (!m_timers.empty() && m_timers.begin()->first < deadline) {
+        deadline = m_timers.begin()->first;
+    }
+
+    // Tasks that take longer than a whole frame never fit; they are
+    // expected to split their work across calls instead. One too big for
+    // what's left is passed over rather than waited on, so smaller ones
+    // queued behind it still get the time. Passes go round the queue,
+    // keeping its order, until one runs nothing.
+    bool ran = true;
+    while (ran && !m_idle.empty()) {
+        ran = false;
+
+        for (size_t n = m_idle.size(); n > 0; n--) {
+            IdleTask task = m_idle.front();
+            m_idle.pop_front();
+
+            if (t + task.m_cost + m_idleMargin > deadline) {
+                m_idle.push_back(task);
+                continue;
+            }
+
+            if (task.m_callback(task.m_data)) {
+                m_idle.push_back(task);
+            }
+            ran = true;
+
+            t = now();
+        }
+    }
+}
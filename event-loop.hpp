@@ -0,0 +1,116 @@
+#ifndef __EVENT_LOOP_HPP__
+#define __EVENT_LOOP_HPP__
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <deque>
+#include <map>
+#include <vector>
+
+// epoll-based main loop. WaylandDisplay drives it with the compositor
+// connection's fd; applications can add their own fds, deadline timers
+// (all multiplexed onto one timerfd) and idle tasks. Idle tasks only run
+// while there is time left before the next frame is expected, so work
+// like asset decoding can soak up the slack in each frame instead of the
+// loop sleeping through it.
+//
+// All times are CLOCK_MONOTONIC nanoseconds, as returned by now().
+class EventLoop
+{
+public:
+    typedef void (*FdCallback)(void* data, int fd, uint32_t events);
+    typedef void (*TimerCallback)(void* data);
+
+    // Return true to be called again on a later idle slot, false when the
+    // task is finished
+    typedef bool (*IdleCallback)(void* data);
+
+    EventLoop();
+    ~EventLoop();
+
+    static uint64_t now();
+
+    // Watch 'fd' for the given EPOLL* events. A NULL callback just
+    // records readiness, to be checked with isReady().
+    void addFd(int fd, uint32_t events, FdCallback callback, void* data);
+    void removeFd(int fd);
+
+    // One-shot timer firing at or after 'deadline'. Returns an id for
+    // cancelTimer().
+    int addTimer(uint64_t deadline, TimerCallback callback, void* data);
+    void cancelTimer(int id);
+
+    // Queue a task expected to take about 'cost' ns per call. It is only
+    // called when that much time is available before the next frame.
+    void addIdle(IdleCallback callback, void* data, uint64_t cost);
+    bool hasIdle() const    { return !m_idle.empty(); }
+
+    // Frame pacing hint, called once per rendered frame. The loop learns
+    // the frame interval from these and uses it to predict the next one.
+    void frameRendered(uint64_t when);
+    uint64_t nextFrameDeadline(uint64_t when) const;
+
+    // Idle tasks stop this long before the predicted next frame
+    void setIdleMargin(uint64_t margin)     { m_idleMargin = margin; }
+
+    // Block until something is ready or 'timeoutMs' passes (-1 waits
+    // forever, but never past the earliest timer). Returns false on error.
+    bool wait(int timeoutMs);
+
+    // Whether 'fd' came back ready from the last wait()
+    bool isReady(int fd, uint32_t* events = NULL) const;
+
+    // Call back ready fds and expired timers from the last wait()
+    void dispatch();
+
+    // Run idle tasks that fit before both the next frame and the next
+    // timer, in queue order, skipping any that don't fit what's left
+    void runIdle();
+
+    // Number of times wait() has returned, for power accounting
+    uint64_t wakeups() const    { return m_wakeups; }
+
+private:
+    struct FdWatch
+    {
+        FdCallback m_callback;
+        void* m_data;
+    };
+
+    struct Timer
+    {
+        int m_id;
+        TimerCallback m_callback;
+        void* m_data;
+    };
+
+    struct IdleTask
+    {
+        IdleCallback m_callback;
+        void* m_data;
+        uint64_t m_cost;
+    };
+
+    void armTimerFd();
+    void fireTimers();
+
+    int m_epollFd;
+    int m_timerFd;
+
+    std::map<int, FdWatch> m_fds;
+    std::multimap<uint64_t, Timer> m_timers;
+    int m_nextTimerId;
+
+    std::deque<IdleTask> m_idle;
+    uint64_t m_idleMargin;
+
+    uint64_t m_lastFrame;
+    uint64_t m_frameInterval;
+
+    // Results of the last wait(): fd and its ready events
+    std::vector<std::pair<int, uint32_t> > m_ready;
+    uint64_t m_wakeups;
+};
+
+#endif
@@ -0,0 +1,172 @@
+#include <cstdio>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "base.hpp"
+#include "shader.hpp"
+
+// Fill-rate benchmark. Every frame covers the whole window 'layers'
+// times with depth-tested, depth-writing quads and reports the pixel
+// throughput that the achieved frame rate implies. Run it once normally
+// and once with -l to compare the 32-bit path against the low-bandwidth
+// profile; pick enough layers that the frame rate drops below the
+// display's refresh rate, or vsync is all that gets measured.
+//
+// Usage: fillrate [window options] [layers]
+
+static const char* vert_shader_text =
+    "uniform float u_depth;\n"
+    "attribute vec2 a_pos;\n"
+    "void main() {\n"
+    "  gl_Position = vec4(a_pos, u_depth, 1);\n"
+    "}\n";
+
+static const char* frag_shader_text =
+    "precision mediump float;\n"
+    "uniform vec4 u_color;\n"
+    "void main() {\n"
+    "  gl_FragColor = u_color;\n"
+    "}\n";
+
+// Frames between reports
+static const uint32_t REPORT_INTERVAL = 120;
+
+class FillRateWindow: public WaylandWindow
+{
+public:
+    FillRateWindow()
+        : m_layers(8)
+    {
+    }
+
+    virtual ~FillRateWindow() {}
+
+    void setLayers(int layers)  { m_layers = layers; }
+
+protected:
+    virtual std::vector<EGLint> requiredEglConfigAttribs()
+    {
+        std::vector<EGLint> ret;
+        ret.push_back(EGL_DEPTH_SIZE);
+        ret.push_back(16);
+        return ret;
+    }
+
+    virtual void setupGl()
+    {
+        static char const* const attribs[] = { "a_pos", NULL };
+        static const GLfloat quad[] = {
+            -1, -1,
+            +1, -1,
+            -1, +1,
+            +1, +1,
+        };
+
+        GLuint vert = createShader(vert_shader_text, GL_VERTEX_SHADER);
+        GLuint frag = createShader(frag_shader_text, GL_FRAGMENT_SHADER);
+        m_program = linkProgram(vert, frag, attribs);
+        GpuResources::deleteShader(vert);
+        GpuResources::deleteShader(frag);
+
+        m_uDepth = glGetUniformLocation(m_program, "u_depth");
+        m_uColor = glGetUniformLocation(m_program, "u_color");
+
+        m_quad = GpuResources::createBuffer("fillrate quad");
+        glBindBuffer(GL_ARRAY_BUFFER, m_quad);
+        GpuResources::bufferData(m_quad, GL_ARRAY_BUFFER, sizeof(quad), quad, GL_STATIC_DRAW);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+        printConfig();
+    }
+
+    virtual void drawGl(uint32_t time)
+    {
+        uint32_t width = currentSize().m_width;
+        uint32_t height = currentSize().m_height;
+
+        glViewport(0, 0, width, height);
+        glClearColor(0, 0, 0, 1);
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+        // With -p the clear is timed in the default "scene" pass and the
+        // layers on their own
+        gpuPass("layers");
+
+        glEnable(GL_DEPTH_TEST);
+        glDepthFunc(GL_LEQUAL);
+
+        glUseProgram(m_program);
+        glBindBuffer(GL_ARRAY_BUFFER, m_quad);
+        glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 0, 0);
+        glEnableVertexAttribArray(0);
+
+        // Back to front, so that every layer passes the depth test and
+        // writes both color and depth
+        for (int i = 0; i < m_layers; i++) {
+            float shade = float(i + 1) / m_layers;
+            glUniform1f(m_uDepth, 1.0f - 2.0f * (i + 1) / (m_layers + 1));
+            glUniform4f(m_uColor, shade, 1.0f - shade, 0.5f, 1.0f);
+            glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+            recordDraw(GL_TRIANGLE_STRIP, 4);
+        }
+
+        glDisableVertexAttribArray(0);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+        glDisable(GL_DEPTH_TEST);
+
+        uint32_t frames = frameStats().frameCount();
+        if (frames > 0 && frames % REPORT_INTERVAL == 0) {
+            float fps = frameStats().fps();
+            double pixels = double(width) * height * m_layers;
+
+            printf("%ux%u x%d layers: %.1f fps, %.1f Mpixels/s\n",
+                   width, height, m_layers, fps, pixels * fps / 1e6);
+        }
+    }
+
+    virtual void teardownGl()
+    {
+        GpuResources::deleteBuffer(m_quad);
+        GpuResources::deleteProgram(m_program);
+    }
+
+private:
+    void printConfig()
+    {
+        EGLDisplay dpy = display()->eglDisplay();
+        EGLConfig config = display()->eglConfig();
+        EGLint r, g, b, a, depth, stencil;
+
+        eglGetConfigAttrib(dpy, config, EGL_RED_SIZE, &r);
+        eglGetConfigAttrib(dpy, config, EGL_GREEN_SIZE, &g);
+        eglGetConfigAttrib(dpy, config, EGL_BLUE_SIZE, &b);
+        eglGetConfigAttrib(dpy, config, EGL_ALPHA_SIZE, &a);
+        eglGetConfigAttrib(dpy, config, EGL_DEPTH_SIZE, &depth);
+        eglGetConfigAttrib(dpy, config, EGL_STENCIL_SIZE, &stencil);
+
+        printf("%s profile: R%dG%dB%dA%d depth %d stencil %d\n",
+               display()->lowBandwidth() ? "low-bandwidth" : "standard",
+               r, g, b, a, depth, stencil);
+    }
+
+    int m_layers;
+    GLuint m_program;
+    GLuint m_quad;
+    GLint m_uDepth;
+    GLint m_uColor;
+};
+
+int main(int argc, char* argv[])
+{
+    // The layer count is the positional argument left over after the
+    // window options, so it has to be parsed after init()
+    FillRateWindow w;
+    w.init(&argc, argv);
+
+    if (optind < argc && atoi(argv[optind]) > 0) {
+        w.setLayers(atoi(argv[optind]));
+    }
+
+    w.run();
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,177 @@
+#include <assert.h>
+#include <stdlib.h>
+
+#include <algorithm>
+
+#include "frame-arena.hpp"
+
+FrameArena::FrameArena(size_t initialSize)
+    : m_initialSize(initialSize)
+    , m_head(0)
+    , m_used(0)
+    , m_highWater(0)
+{
+}
+
+FrameArena::~FrameArena()
+{
+    freeBlocks();
+}
+
+void* FrameArena::allocate(size_t size, size_t alignment)
+{
+    assert((alignment & (alignment - 1)) == 0);
+
+    if (!m_blocks.empty()) {
+        Block const& block = m_blocks.back();
+
+        // Align the address rather than the offset, so alignments beyond
+        // what new[] guarantees work too
+        uintptr_t base = (uintptr_t)block.m_data;
+        uintptr_t start = (base + m_head + alignment - 1) & ~(uintptr_t)(alignment - 1);
+
+        if (start + size <= base + block.m_size) {
+            m_head = start + size - base;
+            return (void*)start;
+        }
+
+        m_used += m_head;
+    }
+
+    // Room for the worst-case alignment padding at the start of the block
+    addBlock(size + alignment);
+
+    uintptr_t base = (uintptr_t)m_blocks.back().m_data;
+    uintptr_t start = (base + alignment - 1) & ~(uintptr_t)(alignment - 1);
+    m_head = start + size - base;
+    return (void*)start;
+}
+
+void FrameArena::release(void* p, size_t size)
+{
+    if (m_blocks.empty()) {
+        return;
+    }
+
+    char* data = m_blocks.back().m_data;
+    if ((char*)p >= data && (char*)p + size == data + m_head) {
+        m_head = (char*)p - data;
+    }
+}
+
+void FrameArena::reset()
+{
+    m_highWater = std::max(m_highWater, bytesUsed());
+
+    // The frame spilled into more than one block: replace them with one
+    // that holds the lot, so the same frame fits in one next time
+    if (m_blocks.size() > 1) {
+        size_t total = capacity();
+        freeBlocks();
+        addBlock(total);
+    }
+
+    m_head = 0;
+    m_used = 0;
+}
+
+size_t FrameArena::capacity() const
+{
+    size_t total = 0;
+    for (size_t i = 0; i < m_blocks.size(); i++) {
+        total += m_blocks[i].m_size;
+    }
+    return total;
+}
+
+void FrameArena::addBlock(size_t minSize)
+{
+    // Grow geometrically so a frame that keeps growing spills rarely
+    size_t size = m_blocks.empty() ? m_initialSize : m_blocks.back().m_size * 2;
+
+    Block block;
+    block.m_size = std::max(size, minSize);
+    block.m_data = new char[block.m_size];
+    m_blocks.push_back(block);
+}
+
+void FrameArena::freeBlocks()
+{
+    for (size_t i = 0; i < m_blocks.size(); i++) {
+        delete[] m_blocks[i].m_data;
+    }
+    m_blocks.clear();
+}
+
+#ifdef COUNT_ALLOCATIONS
+
+#include <atomic>
+
+// Replacing the global operators is the one portable way to see every
+// allocation C++ code makes, including the ones inside the standard
+// library. Worker threads allocate too, hence the atomic.
+static std::atomic<uint64_t> s_allocations(0);
+
+static void* countedAlloc(size_t size)
+{
+    s_allocations.fetch_add(1, std::memory_order_relaxed);
+    return malloc(size ? size : 1);
+}
+
+void* operator new(size_t size)
+{
+    void* p = countedAlloc(size);
+    if (!p) {
+        throw std::bad_alloc();
+    }
+    return p;
+}
+
+void* operator new[](size_t size)
+{
+    return operator new(size);
+}
+
+void* operator new(size_t size, std::nothrow_t const&) noexcept
+{
+    return countedAlloc(size);
+}
+
+void* operator new[](size_t size, std::nothrow_t const&) noexcept
+{
+    return countedAlloc(size);
+}
+
+void operator delete(void* p) noexcept
+{
+    free(p);
+}
+
+void operator delete[](void* p) noexcept
+{
+    free(p);
+}
+
+void operator delete(void* p, size_t) noexcept
+{
+    free(p);
+}
+
+void operator delete[](void* p, size_t) noexcept
+{
+    free(p);
+}
+
+uint64_t heapAllocationCount()
+{
+    return s_allocations.load(std::memory_order_relaxed);
+}
+
+#else
+
+uint64_t heapAllocationCount()
+{
+    return 0;
+}
+
+#endif
@@ -0,0 +1,127 @@
+#ifndef __FRAME_ARENA_HPP__
+#define __FRAME_ARENA_HPP__
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <new>
+#include <vector>
+
+// Bump allocator for data that only lives until the end of the frame:
+// draw lists, sort keys, scratch vertex arrays. WaylandWindow owns one
+// and resets it after every redraw(), so nothing allocated from it is
+// ever freed individually.
+//
+// Memory comes in blocks. When a frame outgrows the current block
+// another one is added, and the next reset() merges them all into a
+// single block big enough for that frame, so after the first few frames
+// a steady workload never touches the heap. Not thread safe.
+class FrameArena
+{
+public:
+    // The first block is allocated on first use
+    FrameArena(size_t initialSize = 64 * 1024);
+    ~FrameArena();
+
+    // 'alignment' must be a power of two
+    void* allocate(size_t size, size_t alignment = sizeof(void*));
+
+    template <typename T>
+    T* allocate(size_t count) {
+        return static_cast<T*>(allocate(count * sizeof(T), alignof(T)));
+    }
+
+    // Hands memory back only if it was the last thing allocated, which
+    // lets a growing vector reuse its old storage. Otherwise a no-op.
+    void release(void* p, size_t size);
+
+    // Invalidates everything allocated since the last reset()
+    void reset();
+
+    size_t bytesUsed() const    { return m_used + m_head; }
+    size_t capacity() const;
+
+    // Most bytes used by any one frame so far
+    size_t highWater() const    { return m_highWater; }
+
+private:
+    struct Block
+    {
+        char* m_data;
+        size_t m_size;
+    };
+
+    FrameArena(FrameArena const&);
+    FrameArena& operator=(FrameArena const&);
+
+    void addBlock(size_t minSize);
+    void freeBlocks();
+
+    size_t m_initialSize;
+    std::vector<Block> m_blocks;
+
+    // Offset into the last block, and bytes handed out from earlier ones
+    size_t m_head;
+    size_t m_used;
+    size_t m_highWater;
+};
+
+// Lets standard containers live in a FrameArena:
+//
+//     FrameVector<DrawItem> items(ArenaAllocator<DrawItem>(frameArena()));
+//
+// Such a container must not outlive the frame it was created in.
+template <typename T>
+class ArenaAllocator
+{
+public:
+    typedef T value_type;
+
+    ArenaAllocator(FrameArena& arena)
+        : m_arena(&arena)
+    {
+    }
+
+    template <typename U>
+    ArenaAllocator(ArenaAllocator<U> const& other)
+        : m_arena(other.arena())
+    {
+    }
+
+    T* allocate(size_t n) {
+        return m_arena->allocate<T>(n);
+    }
+
+    void deallocate(T* p, size_t n) {
+        m_arena->release(p, n * sizeof(T));
+    }
+
+    FrameArena* arena() const   { return m_arena; }
+
+private:
+    FrameArena* m_arena;
+};
+
+template <typename T, typename U>
+bool operator==(ArenaAllocator<T> const& a, ArenaAllocator<U> const& b)
+{
+    return a.arena() == b.arena();
+}
+
+template <typename T, typename U>
+bool operator!=(ArenaAllocator<T> const& a, ArenaAllocator<U> const& b)
+{
+    return a.arena() != b.arena();
+}
+
+template <typename T>
+using FrameVector = std::vector<T, ArenaAllocator<T> >;
+
+// Number of operator new calls made by the process so far, on any
+// thread. Only counted when built with --count-allocations (which
+// defines COUNT_ALLOCATIONS); always 0 otherwise. Allocations made by
+// C libraries (EGL, the GL driver, libwayland) through malloc() are not
+// seen.
+uint64_t heapAllocationCount();
+
+#endif
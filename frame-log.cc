@@ -0,0 +1,70 @@
+#include <GLES2/gl2.h>
+#include <cstdio>
+#include <cstring>
+
+#include "frame-log.hpp"
+#include "frame-stats.hpp"
+#include "results.hpp"
+
+FrameLog::FrameLog()
+    : m_seen(0)
+{
+}
+
+void FrameLog::open(char const* path, char const* program)
+{
+    char const* slash = strrchr(program, '/');
+
+    m_path = path;
+    m_program = slash ? slash + 1 : program;
+    m_intervals.reserve(MAX_FRAMES);
+    m_cpuTimes.reserve(MAX_FRAMES);
+    m_seen = 0;
+}
+
+void FrameLog::record(FrameStats const& stats)
+{
+    if (m_seen++ < SKIP_FRAMES || m_intervals.size() == MAX_FRAMES) {
+        return;
+    }
+
+    m_intervals.push_back(stats.frameIntervalMs());
+    m_cpuTimes.push_back(stats.cpuTimeMs());
+}
+
+void FrameLog::write(int width, int height)
+{
+    if (m_intervals.empty()) {
+        fprintf(stderr, "%s: no frames to log\n", m_path.c_str());
+        return;
+    }
+
+    FILE* f = fopen(m_path.c_str(), "w");
+    if (!f) {
+        perror(m_path.c_str());
+        return;
+    }
+
+    if (m_seen > SKIP_FRAMES + m_intervals.size()) {
+        fprintf(stderr, "%s: only the first %d frames logged\n",
+                m_path.c_str(), MAX_FRAMES);
+    }
+
+    BenchResult result;
+    result.m_name = "frames";
+    result.m_unit = "ms";
+    result.m_renderer = (char const*)glGetString(GL_RENDERER);
+    result.m_version = (char const*)glGetString(GL_VERSION);
+    result.m_width = width;
+    result.m_height = height;
+
+    result.m_params = m_program + ",interval";
+    result.m_samples = m_intervals;
+    writeResult(f, result);
+
+    result.m_params = m_program + ",cpu";
+    result.m_samples = m_cpuTimes;
+    writeResult(f, result);
+
+    fclose(f);
+}
@@ -0,0 +1,48 @@
+#ifndef __FRAME_LOG_HPP__
+#define __FRAME_LOG_HPP__
+
+#include <string>
+#include <vector>
+
+class FrameStats;
+
+// Keeps every frame's interval and CPU time for a whole run and writes
+// them out as two BenchResults ("frames:PROGRAM,interval" and
+// "frames:PROGRAM,cpu", in ms) when the window goes away, for benchdb to
+// store and compare. WaylandWindow fills one in with -F FILE; with
+// several windows on one display, the second logs to FILE.1, the third
+// to FILE.2 and so on.
+//
+// Storage for MAX_FRAMES frames is taken up front so that logging
+// doesn't allocate while frames are being drawn; frames after that are
+// counted but not kept.
+class FrameLog
+{
+public:
+    static const int MAX_FRAMES = 1 << 16;
+
+    // Frames left out at the start, while caches fill and the compositor
+    // settles into a rhythm
+    static const int SKIP_FRAMES = 10;
+
+    FrameLog();
+
+    // 'program' is argv[0]; its base name identifies the results
+    void open(char const* path, char const* program);
+    bool isOpen() const         { return !m_path.empty(); }
+
+    // After FrameStats::endFrame()
+    void record(FrameStats const& stats);
+
+    // Needs a current context, for GL_RENDERER and GL_VERSION
+    void write(int width, int height);
+
+private:
+    std::string m_path;
+    std::string m_program;
+    std::vector<double> m_intervals;
+    std::vector<double> m_cpuTimes;
+    unsigned m_seen;
+};
+
+#endif
@@ -0,0 +1,136 @@
+#include <time.h>
+
+#include "frame-stats.hpp"
+
+FrameStats::FrameStats()
+    : m_frameStart(0)
+    , m_head(0)
+    , m_filled(0)
+    , m_frameCount(0)
+    , m_drawCalls(0)
+    , m_triangles(0)
+    , m_lastDrawCalls(0)
+    , m_lastTriangles(0)
+{
+    for (int i = 0; i < HISTORY; i++) {
+        m_intervals[i] = 0;
+        m_cpuTimes[i] = 0;
+        m_gpuTimes[i] = -1;
+    }
+}
+
+double FrameStats::nowMs()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000.0 + ts.tv_nsec / 1000000.0;
+}
+
+void FrameStats::beginFrame()
+{
+    double now = nowMs();
+
+    // The interval slot for this frame is only meaningful once there is
+    // a previous frame to measure against.
+    m_head = (m_head + 1) % HISTORY;
+    m_intervals[m_head] = m_frameStart > 0 ? now - m_frameStart : 0;
+    m_cpuTimes[m_head] = 0;
+    m_gpuTimes[m_head] = -1;
+    m_frameStart = now;
+
+    m_drawCalls = 0;
+    m_triangles = 0;
+}
+
+void FrameStats::endFrame()
+{
+    m_cpuTimes[m_head] = nowMs() - m_frameStart;
+
+    m_lastDrawCalls = m_drawCalls;
+    m_lastTriangles = m_triangles;
+
+    m_frameCount++;
+    if (m_filled < HISTORY) {
+        m_filled++;
+    }
+}
+
+void FrameStats::recordDraw(GLenum mode, GLsizei vertexCount)
+{
+    m_drawCalls++;
+
+    switch (mode) {
+        case GL_TRIANGLES:
+            m_triangles += vertexCount / 3;
+            break;
+
+        case GL_TRIANGLE_STRIP:
+        case GL_TRIANGLE_FAN:
+            if (vertexCount > 2) {
+                m_triangles += vertexCount - 2;
+            }
+            break;
+    }
+}
+
+float FrameStats::fps() const
+{
+    double total = 0;
+    int n = 0;
+
+    for (int i = 0; i < m_filled; i++) {
+        double interval = frameIntervalMs(i);
+        if (interval > 0) {
+            total += interval;
+            n++;
+        }
+    }
+
+    return total > 0 ? n * 1000.0 / total : 0;
+}
+
+float FrameStats::frameIntervalMs(int age) const
+{
+    if (age >= m_filled) {
+        return 0;
+    }
+    return m_intervals[(m_head - age + HISTORY) % HISTORY];
+}
+
+float FrameStats::cpuTimeMs(int age) const
+{
+    if (age >= m_filled) {
+        return 0;
+    }
+    return m_cpuTimes[(m_head - age + HISTORY) % HISTORY];
+}
+
+void FrameStats::recordGpuTime(uint32_t frame, float ms)
+{
+    if (m_frameCount - frame >= HISTORY) {
+        return;
+    }
+
+    // beginFrame() advances the head before frame 0, so frame n lives in
+    // slot n + 1
+    m_gpuTimes[(frame + 1) % HISTORY] = ms;
+}
+
+float FrameStats::gpuTimeMs(int age) const
+{
+    if (age >= m_filled) {
+        return -1;
+    }
+    return m_gpuTimes[(m_head - age + HISTORY) % HISTORY];
+}
+
+float FrameStats::latestGpuTimeMs() const
+{
+    for (int age = 0; age < m_filled; age++) {
+        float ms = gpuTimeMs(age);
+        if (ms >= 0) {
+            return ms;
+        }
+    }
+    return -1;
+}
@@ -0,0 +1,67 @@
+#ifndef __FRAME_STATS_HPP__
+#define __FRAME_STATS_HPP__
+
+#include <GLES2/gl2.h>
+#include <stdint.h>
+
+// Per-frame counters and a short history of frame timings. WaylandWindow
+// owns one of these and brackets every drawGl() with beginFrame() and
+// endFrame(); subclasses report their draws through recordDraw().
+class FrameStats
+{
+public:
+    // Number of frames of history kept for the frame-time graph
+    static const int HISTORY = 64;
+
+    FrameStats();
+
+    void beginFrame();
+    void endFrame();
+
+    void recordDraw(GLenum mode, GLsizei vertexCount);
+
+    // Frames per second, averaged over the retained history
+    float fps() const;
+
+    // Time between the starts of successive frames. 'age' 0 is the most
+    // recently completed frame.
+    float frameIntervalMs(int age = 0) const;
+
+    // CPU time spent between beginFrame() and endFrame()
+    float cpuTimeMs(int age = 0) const;
+
+    // GPU time reported by a GpuProfiler for frame number 'frame' (the
+    // frameCount() while that frame was being drawn). Results usually
+    // arrive a few frames late; ones older than the history are dropped.
+    void recordGpuTime(uint32_t frame, float ms);
+
+    // Negative until the GPU time for that frame has been recorded
+    float gpuTimeMs(int age = 0) const;
+
+    // The newest GPU time recorded, or negative if there is none
+    float latestGpuTimeMs() const;
+
+    // Counters for the most recently completed frame
+    uint32_t drawCalls() const  { return m_lastDrawCalls; }
+    uint32_t triangles() const  { return m_lastTriangles; }
+
+    uint32_t frameCount() const { return m_frameCount; }
+
+private:
+    static double nowMs();
+
+    double m_frameStart;
+    double m_intervals[HISTORY];
+    double m_cpuTimes[HISTORY];
+    float m_gpuTimes[HISTORY];
+    int m_head;
+    int m_filled;
+    uint32_t m_frameCount;
+
+    uint32_t m_drawCalls;
+    uint32_t m_triangles;
+    uint32_t m_lastDrawCalls;
+    uint32_t m_lastTriangles;
+};
+
+#endif
@@ -0,0 +1,1007 @@
+#include <GLES2/gl2.h>
+
+#include "gl-calls.hpp"
+
+#ifdef COUNT_GL_CALLS
+
+#include <assert.h>
+#include <dlfcn.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+
+// Everything here is fixed-size, so that counting doesn't allocate while
+// frames are being drawn
+static const int MAX_ENTRIES = 128;
+static const int MAX_ATTRIBS = 16;
+static const int MAX_TEXTURE_UNITS = 8;
+static const int MAX_PROGRAMS = 64;
+static const int MAX_UNIFORMS = 32;
+
+struct GlEntry
+{
+    explicit GlEntry(char const* name);
+
+    char const* m_name;
+    void* m_real;
+
+    // Since the last report
+    uint64_t m_calls;
+    uint64_t m_redundant;
+};
+
+static GlEntry* s_entries[MAX_ENTRIES];
+static int s_entryCount;
+
+GlEntry::GlEntry(char const* name)
+    : m_name(name)
+    , m_calls(0)
+    , m_redundant(0)
+{
+    m_real = dlsym(RTLD_NEXT, name);
+    if (!m_real) {
+        fprintf(stderr, "Can't find the driver's %s\n", name);
+        exit(EXIT_FAILURE);
+    }
+
+    assert(s_entryCount < MAX_ENTRIES);
+    s_entries[s_entryCount++] = this;
+}
+
+// Starts every entry point below: registers it the first time through,
+// counts the call, and leaves the driver's function in 'real'
+#define INTERPOSE(name) \
+    static GlEntry entry(#name); \
+    decltype(&name) real = reinterpret_cast<decltype(&name)>(entry.m_real); \
+    entry.m_calls++
+
+// A capability or attribute array
+struct Toggle
+{
+    bool m_on;
+
+    // The call that last changed it, while nothing has used it since
+    GlEntry* m_flipEntry;
+    uint64_t m_flipUses;
+
+    bool m_enabledThisFrame;
+    bool m_disabledThisFrame;
+    unsigned m_churnFrames;
+};
+
+struct Binding
+{
+    bool m_known;
+    GLuint m_name;
+};
+
+struct Value
+{
+    bool m_known;
+    GLfloat m_values[4];
+};
+
+struct AttribPointer
+{
+    bool m_known;
+    GLuint m_buffer;
+    GLint m_size;
+    GLenum m_type;
+    GLboolean m_normalized;
+    GLsizei m_stride;
+    void const* m_pointer;
+};
+
+struct Uniform
+{
+    // The entry point that set it, which says how to read m_values; NULL
+    // if unknown
+    GlEntry const* m_setter;
+    GLfloat m_values[16];
+};
+
+static const GLenum s_caps[] = {
+    GL_BLEND,
+    GL_CULL_FACE,
+    GL_DEPTH_TEST,
+    GL_DITHER,
+    GL_POLYGON_OFFSET_FILL,
+    GL_SAMPLE_ALPHA_TO_COVERAGE,
+    GL_SAMPLE_COVERAGE,
+    GL_SCISSOR_TEST,
+    GL_STENCIL_TEST,
+};
+
+static char const* const s_capNames[] = {
+    "GL_BLEND",
+    "GL_CULL_FACE",
+    "GL_DEPTH_TEST",
+    "GL_DITHER",
+    "GL_POLYGON_OFFSET_FILL",
+    "GL_SAMPLE_ALPHA_TO_COVERAGE",
+    "GL_SAMPLE_COVERAGE",
+    "GL_SCISSOR_TEST",
+    "GL_STENCIL_TEST",
+};
+
+static const int CAP_COUNT = sizeof(s_caps) / sizeof(s_caps[0]);
+
+struct ShadowState
+{
+    ShadowState();
+
+    // So far. Clears use capabilities (scissor, dither) but not arrays.
+    uint64_t m_draws;
+    uint64_t m_clears;
+
+    Binding m_program;
+    bool m_programDeleted;
+    Binding m_arrayBuffer;
+    Binding m_elementBuffer;
+    Binding m_framebuffer;
+    Binding m_renderbuffer;
+    Binding m_activeTexture;
+
+    // 2D and cube map, per unit
+    Binding m_textures[MAX_TEXTURE_UNITS][2];
+
+    Value m_viewport;
+    Value m_scissor;
+    Value m_clearColor;
+    Value m_blendFunc;
+    Value m_colorMask;
+    Value m_depthMask;
+    Value m_depthFunc;
+
+    Toggle m_caps[CAP_COUNT];
+    Toggle m_attribs[MAX_ATTRIBS];
+    AttribPointer m_pointers[MAX_ATTRIBS];
+
+    Uniform m_uniforms[MAX_PROGRAMS][MAX_UNIFORMS];
+};
+
+static void setKnown(Binding* binding, GLuint name)
+{
+    binding->m_known = true;
+    binding->m_name = name;
+}
+
+static void setKnown(Value* value, GLfloat a, GLfloat b = 0, GLfloat c = 0, GLfloat d = 0)
+{
+    value->m_known = true;
+    value->m_values[0] = a;
+    value->m_values[1] = b;
+    value->m_values[2] = c;
+    value->m_values[3] = d;
+}
+
+// GL's defaults for a new context
+ShadowState::ShadowState()
+{
+    memset(this, 0, sizeof(*this));
+
+    setKnown(&m_program, 0);
+    setKnown(&m_arrayBuffer, 0);
+    setKnown(&m_elementBuffer, 0);
+    setKnown(&m_framebuffer, 0);
+    setKnown(&m_renderbuffer, 0);
+    setKnown(&m_activeTexture, GL_TEXTURE0);
+
+    for (int i = 0; i < MAX_TEXTURE_UNITS; i++) {
+        setKnown(&m_textures[i][0], 0);
+        setKnown(&m_textures[i][1], 0);
+    }
+
+    setKnown(&m_clearColor, 0, 0, 0, 0);
+    setKnown(&m_blendFunc, GL_ONE, GL_ZERO);
+    setKnown(&m_colorMask, GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+    setKnown(&m_depthMask, GL_TRUE);
+    setKnown(&m_depthFunc, GL_LESS);
+
+    for (int i = 0; i < CAP_COUNT; i++) {
+        m_caps[i].m_on = s_caps[i] == GL_DITHER;
+    }
+}
+
+static ShadowState s_state;
+
+// Calls that change nothing count against 'entry'
+static void set(GlEntry& entry, Binding* binding, GLuint name)
+{
+    if (binding->m_known && binding->m_name == name) {
+        entry.m_redundant++;
+    }
+    setKnown(binding, name);
+}
+
+static void set(GlEntry& entry, Value* value, GLfloat a, GLfloat b = 0, GLfloat c = 0, GLfloat d = 0)
+{
+    if (value->m_known && value->m_values[0] == a && value->m_values[1] == b &&
+        value->m_values[2] == c && value->m_values[3] == d) {
+        entry.m_redundant++;
+    }
+    setKnown(value, a, b, c, d);
+}
+
+// 'uses' counts the calls so far that could have made use of it
+static void set(GlEntry& entry, Toggle* toggle, bool on, uint64_t uses)
+{
+    if (on) {
+        toggle->m_enabledThisFrame = true;
+    }
+    else {
+        toggle->m_disabledThisFrame = true;
+    }
+
+    if (toggle->m_on == on) {
+        entry.m_redundant++;
+        return;
+    }
+
+    if (toggle->m_flipEntry && toggle->m_flipUses == uses) {
+        // Put back before anything drew with it: both calls were wasted
+        toggle->m_flipEntry->m_redundant++;
+        entry.m_redundant++;
+        toggle->m_flipEntry = NULL;
+    }
+    else {
+        toggle->m_flipEntry = &entry;
+        toggle->m_flipUses = uses;
+    }
+
+    toggle->m_on = on;
+}
+
+static Toggle* findCap(GLenum cap)
+{
+    for (int i = 0; i < CAP_COUNT; i++) {
+        if (s_caps[i] == cap) {
+            return &s_state.m_caps[i];
+        }
+    }
+    return NULL;
+}
+
+// The current texture unit's binding for 'target', or NULL if that isn't
+// tracked
+static Binding* findTexture(GLenum target)
+{
+    int unit = s_state.m_activeTexture.m_name - GL_TEXTURE0;
+
+    if (!s_state.m_activeTexture.m_known || unit < 0 || unit >= MAX_TEXTURE_UNITS) {
+        return NULL;
+    }
+    return &s_state.m_textures[unit][target == GL_TEXTURE_2D ? 0 : 1];
+}
+
+// Deleting a bound object puts the binding back to 0
+static void unbind(Binding* binding, GLuint name)
+{
+    if (binding->m_known && binding->m_name == name) {
+        binding->m_name = 0;
+    }
+}
+
+static void forgetUniforms(GLuint program)
+{
+    if (program < (GLuint)MAX_PROGRAMS) {
+        memset(s_state.m_uniforms[program], 0, sizeof(s_state.m_uniforms[program]));
+    }
+}
+
+// Uniforms of the current program, or NULL if it's unknown or untracked
+static Uniform* findUniform(GLint location)
+{
+    GLuint program = s_state.m_program.m_name;
+
+    if (!s_state.m_program.m_known || program >= (GLuint)MAX_PROGRAMS ||
+        location < 0 || location >= MAX_UNIFORMS) {
+        return NULL;
+    }
+    return &s_state.m_uniforms[program][location];
+}
+
+static void setUniform(GlEntry& entry, GLint location, GLsizei count,
+                       void const* values, size_t size)
+{
+    // GL quietly ignores location -1
+    if (location == -1) {
+        entry.m_redundant++;
+        return;
+    }
+
+    // Only single values are compared; arrays just make their elements
+    // unknown
+    if (count != 1) {
+        for (GLsizei i = 0; i < count; i++) {
+            if (Uniform* uniform = findUniform(location + i)) {
+                uniform->m_setter = NULL;
+            }
+        }
+        return;
+    }
+
+    Uniform* uniform = findUniform(location);
+    if (!uniform) {
+        return;
+    }
+
+    if (uniform->m_setter == &entry && memcmp(uniform->m_values, values, size) == 0) {
+        entry.m_redundant++;
+        return;
+    }
+    uniform->m_setter = &entry;
+    memcpy(uniform->m_values, values, size);
+}
+
+void GL_APIENTRY glActiveTexture(GLenum texture)
+{
+    INTERPOSE(glActiveTexture);
+    set(entry, &s_state.m_activeTexture, texture);
+    real(texture);
+}
+
+void GL_APIENTRY glAttachShader(GLuint program, GLuint shader)
+{
+    INTERPOSE(glAttachShader);
+    real(program, shader);
+}
+
+void GL_APIENTRY glBindAttribLocation(GLuint program, GLuint index, GLchar const* name)
+{
+    INTERPOSE(glBindAttribLocation);
+    real(program, index, name);
+}
+
+void GL_APIENTRY glBindBuffer(GLenum target, GLuint buffer)
+{
+    INTERPOSE(glBindBuffer);
+    set(entry, target == GL_ARRAY_BUFFER ? &s_state.m_arrayBuffer : &s_state.m_elementBuffer,
+        buffer);
+    real(target, buffer);
+}
+
+void GL_APIENTRY glBindFramebuffer(GLenum target, GLuint framebuffer)
+{
+    INTERPOSE(glBindFramebuffer);
+    set(entry, &s_state.m_framebuffer, framebuffer);
+    real(target, framebuffer);
+}
+
+void GL_APIENTRY glBindRenderbuffer(GLenum target, GLuint renderbuffer)
+{
+    INTERPOSE(glBindRenderbuffer);
+    set(entry, &s_state.m_renderbuffer, renderbuffer);
+    real(target, renderbuffer);
+}
+
+void GL_APIENTRY glBindTexture(GLenum target, GLuint texture)
+{
+    INTERPOSE(glBindTexture);
+    if (Binding* binding = findTexture(target)) {
+        set(entry, binding, texture);
+    }
+    real(target, texture);
+}
+
+void GL_APIENTRY glBlendFunc(GLenum sfactor, GLenum dfactor)
+{
+    INTERPOSE(glBlendFunc);
+    set(entry, &s_state.m_blendFunc, sfactor, dfactor);
+    real(sfactor, dfactor);
+}
+
+void GL_APIENTRY glBufferData(GLenum target, GLsizeiptr size, void const* data, GLenum usage)
+{
+    INTERPOSE(glBufferData);
+    real(target, size, data, usage);
+}
+
+void GL_APIENTRY glBufferSubData(GLenum target, GLintptr offset, GLsizeiptr size,
+                                 void const* data)
+{
+    INTERPOSE(glBufferSubData);
+    real(target, offset, size, data);
+}
+
+GLenum GL_APIENTRY glCheckFramebufferStatus(GLenum target)
+{
+    INTERPOSE(glCheckFramebufferStatus);
+    return real(target);
+}
+
+void GL_APIENTRY glClear(GLbitfield mask)
+{
+    INTERPOSE(glClear);
+    s_state.m_clears++;
+    real(mask);
+}
+
+void GL_APIENTRY glClearColor(GLfloat red, GLfloat green, GLfloat blue, GLfloat alpha)
+{
+    INTERPOSE(glClearColor);
+    set(entry, &s_state.m_clearColor, red, green, blue, alpha);
+    real(red, green, blue, alpha);
+}
+
+void GL_APIENTRY glColorMask(GLboolean red, GLboolean green, GLboolean blue, GLboolean alpha)
+{
+    INTERPOSE(glColorMask);
+    set(entry, &s_state.m_colorMask, red, green, blue, alpha);
+    real(red, green, blue, alpha);
+}
+
+void GL_APIENTRY glCompileShader(GLuint shader)
+{
+    INTERPOSE(glCompileShader);
+    real(shader);
+}
+
+GLuint GL_APIENTRY glCreateProgram()
+{
+    INTERPOSE(glCreateProgram);
+    GLuint program = real();
+    forgetUniforms(program);
+    return program;
+}
+
+GLuint GL_APIENTRY glCreateShader(GLenum type)
+{
+    INTERPOSE(glCreateShader);
+    return real(type);
+}
+
+void GL_APIENTRY glDeleteBuffers(GLsizei n, GLuint const* buffers)
+{
+    INTERPOSE(glDeleteBuffers);
+
+    for (GLsizei i = 0; i < n; i++) {
+        unbind(&s_state.m_arrayBuffer, buffers[i]);
+        unbind(&s_state.m_elementBuffer, buffers[i]);
+
+        // So do attribute arrays reading from it
+        for (int a = 0; a < MAX_ATTRIBS; a++) {
+            if (s_state.m_pointers[a].m_buffer == buffers[i]) {
+                s_state.m_pointers[a].m_known = false;
+            }
+        }
+    }
+    real(n, buffers);
+}
+
+void GL_APIENTRY glDeleteFramebuffers(GLsizei n, GLuint const* framebuffers)
+{
+    INTERPOSE(glDeleteFramebuffers);
+
+    for (GLsizei i = 0; i < n; i++) {
+        unbind(&s_state.m_framebuffer, framebuffers[i]);
+    }
+    real(n, framebuffers);
+}
+
+void GL_APIENTRY glDeleteProgram(GLuint program)
+{
+    INTERPOSE(glDeleteProgram);
+
+    // A current program stays in use until another replaces it
+    if (s_state.m_program.m_known && s_state.m_program.m_name == program) {
+        s_state.m_programDeleted = true;
+    }
+    else {
+        forgetUniforms(program);
+    }
+    real(program);
+}
+
+void GL_APIENTRY glDeleteRenderbuffers(GLsizei n, GLuint const* renderbuffers)
+{
+    INTERPOSE(glDeleteRenderbuffers);
+
+    for (GLsizei i = 0; i < n; i++) {
+        unbind(&s_state.m_renderbuffer, renderbuffers[i]);
+    }
+    real(n, renderbuffers);
+}
+
+void GL_APIENTRY glDeleteShader(GLuint shader)
+{
+    INTERPOSE(glDeleteShader);
+    real(shader);
+}
+
+void GL_APIENTRY glDeleteTextures(GLsizei n, GLuint const* textures)
+{
+    INTERPOSE(glDeleteTextures);
+
+    for (GLsizei i = 0; i < n; i++) {
+        for (int unit = 0; unit < MAX_TEXTURE_UNITS; unit++) {
+            unbind(&s_state.m_textures[unit][0], textures[i]);
+            unbind(&s_state.m_textures[unit][1], textures[i]);
+        }
+    }
+    real(n, textures);
+}
+
+void GL_APIENTRY glDepthFunc(GLenum func)
+{
+    INTERPOSE(glDepthFunc);
+    set(entry, &s_state.m_depthFunc, func);
+    real(func);
+}
+
+void GL_APIENTRY glDepthMask(GLboolean flag)
+{
+    INTERPOSE(glDepthMask);
+    set(entry, &s_state.m_depthMask, flag);
+    real(flag);
+}
+
+void GL_APIENTRY glDisable(GLenum cap)
+{
+    INTERPOSE(glDisable);
+    if (Toggle* toggle = findCap(cap)) {
+        set(entry, toggle, false, s_state.m_draws + s_state.m_clears);
+    }
+    real(cap);
+}
+
+void GL_APIENTRY glDisableVertexAttribArray(GLuint index)
+{
+    INTERPOSE(glDisableVertexAttribArray);
+    if (index < (GLuint)MAX_ATTRIBS) {
+        set(entry, &s_state.m_attribs[index], false, s_state.m_draws);
+    }
+    real(index);
+}
+
+void GL_APIENTRY glDrawArrays(GLenum mode, GLint first, GLsizei count)
+{
+    INTERPOSE(glDrawArrays);
+    s_state.m_draws++;
+    real(mode, first, count);
+}
+
+void GL_APIENTRY glDrawElements(GLenum mode, GLsizei count, GLenum type, void const* indices)
+{
+    INTERPOSE(glDrawElements);
+    s_state.m_draws++;
+    real(mode, count, type, indices);
+}
+
+void GL_APIENTRY glEnable(GLenum cap)
+{
+    INTERPOSE(glEnable);
+    if (Toggle* toggle = findCap(cap)) {
+        set(entry, toggle, true, s_state.m_draws + s_state.m_clears);
+    }
+    real(cap);
+}
+
+void GL_APIENTRY glEnableVertexAttribArray(GLuint index)
+{
+    INTERPOSE(glEnableVertexAttribArray);
+    if (index < (GLuint)MAX_ATTRIBS) {
+        set(entry, &s_state.m_attribs[index], true, s_state.m_draws);
+    }
+    real(index);
+}
+
+void GL_APIENTRY glFinish()
+{
+    INTERPOSE(glFinish);
+    real();
+}
+
+void GL_APIENTRY glFlush()
+{
+    INTERPOSE(glFlush);
+    real();
+}
+
+void GL_APIENTRY glFramebufferRenderbuffer(GLenum target, GLenum attachment,
+                                           GLenum renderbuffertarget, GLuint renderbuffer)
+{
+    INTERPOSE(glFramebufferRenderbuffer);
+    real(target, attachment, renderbuffertarget, renderbuffer);
+}
+
+void GL_APIENTRY glFramebufferTexture2D(GLenum target, GLenum attachment, GLenum textarget,
+                                        GLuint texture, GLint level)
+{
+    INTERPOSE(glFramebufferTexture2D);
+    real(target, attachment, textarget, texture, level);
+}
+
+void GL_APIENTRY glGenBuffers(GLsizei n, GLuint* buffers)
+{
+    INTERPOSE(glGenBuffers);
+    real(n, buffers);
+}
+
+void GL_APIENTRY glGenerateMipmap(GLenum target)
+{
+    INTERPOSE(glGenerateMipmap);
+    real(target);
+}
+
+void GL_APIENTRY glGenFramebuffers(GLsizei n, GLuint* framebuffers)
+{
+    INTERPOSE(glGenFramebuffers);
+    real(n, framebuffers);
+}
+
+void GL_APIENTRY glGenRenderbuffers(GLsizei n, GLuint* renderbuffers)
+{
+    INTERPOSE(glGenRenderbuffers);
+    real(n, renderbuffers);
+}
+
+void GL_APIENTRY glGenTextures(GLsizei n, GLuint* textures)
+{
+    INTERPOSE(glGenTextures);
+    real(n, textures);
+}
+
+GLint GL_APIENTRY glGetAttribLocation(GLuint program, GLchar const* name)
+{
+    INTERPOSE(glGetAttribLocation);
+    return real(program, name);
+}
+
+void GL_APIENTRY glGetIntegerv(GLenum pname, GLint* data)
+{
+    INTERPOSE(glGetIntegerv);
+    real(pname, data);
+}
+
+void GL_APIENTRY glGetProgramInfoLog(GLuint program, GLsizei bufSize, GLsizei* length,
+                                     GLchar* infoLog)
+{
+    INTERPOSE(glGetProgramInfoLog);
+    real(program, bufSize, length, infoLog);
+}
+
+void GL_APIENTRY glGetProgramiv(GLuint program, GLenum pname, GLint* params)
+{
+    INTERPOSE(glGetProgramiv);
+    real(program, pname, params);
+}
+
+void GL_APIENTRY glGetShaderInfoLog(GLuint shader, GLsizei bufSize, GLsizei* length,
+                                    GLchar* infoLog)
+{
+    INTERPOSE(glGetShaderInfoLog);
+    real(shader, bufSize, length, infoLog);
+}
+
+void GL_APIENTRY glGetShaderiv(GLuint shader, GLenum pname, GLint* params)
+{
+    INTERPOSE(glGetShaderiv);
+    real(shader, pname, params);
+}
+
+GLubyte const* GL_APIENTRY glGetString(GLenum name)
+{
+    INTERPOSE(glGetString);
+    return real(name);
+}
+
+GLint GL_APIENTRY glGetUniformLocation(GLuint program, GLchar const* name)
+{
+    INTERPOSE(glGetUniformLocation);
+    return real(program, name);
+}
+
+GLboolean GL_APIENTRY glIsEnabled(GLenum cap)
+{
+    INTERPOSE(glIsEnabled);
+    return real(cap);
+}
+
+void GL_APIENTRY glLinkProgram(GLuint program)
+{
+    INTERPOSE(glLinkProgram);
+    forgetUniforms(program);
+    real(program);
+}
+
+void GL_APIENTRY glPixelStorei(GLenum pname, GLint param)
+{
+    INTERPOSE(glPixelStorei);
+    real(pname, param);
+}
+
+void GL_APIENTRY glReadPixels(GLint x, GLint y, GLsizei width, GLsizei height,
+                              GLenum format, GLenum type, void* pixels)
+{
+    INTERPOSE(glReadPixels);
+    real(x, y, width, height, format, type, pixels);
+}
+
+void GL_APIENTRY glRenderbufferStorage(GLenum target, GLenum internalformat,
+                                       GLsizei width, GLsizei height)
+{
+    INTERPOSE(glRenderbufferStorage);
+    real(target, internalformat, width, height);
+}
+
+void GL_APIENTRY glScissor(GLint x, GLint y, GLsizei width, GLsizei height)
+{
+    INTERPOSE(glScissor);
+    set(entry, &s_state.m_scissor, x, y, width, height);
+    real(x, y, width, height);
+}
+
+void GL_APIENTRY glShaderSource(GLuint shader, GLsizei count, GLchar const* const* string,
+                                GLint const* length)
+{
+    INTERPOSE(glShaderSource);
+    real(shader, count, string, length);
+}
+
+void GL_APIENTRY glTexImage2D(GLenum target, GLint level, GLint internalformat,
+                              GLsizei width, GLsizei height, GLint border,
+                              GLenum format, GLenum type, void const* pixels)
+{
+    INTERPOSE(glTexImage2D);
+    real(target, level, internalformat, width, height, border, format, type, pixels);
+}
+
+void GL_APIENTRY glTexParameteri(GLenum target, GLenum pname, GLint param)
+{
+    INTERPOSE(glTexParameteri);
+    real(target, pname, param);
+}
+
+void GL_APIENTRY glTexSubImage2D(GLenum target, GLint level, GLint xoffset, GLint yoffset,
+                                 GLsizei width, GLsizei height, GLenum format, GLenum type,
+                                 void const* pixels)
+{
+    INTERPOSE(glTexSubImage2D);
+    real(target, level, xoffset, yoffset, width, height, format, type, pixels);
+}
+
+void GL_APIENTRY glUniform1f(GLint location, GLfloat v0)
+{
+    INTERPOSE(glUniform1f);
+    GLfloat values[] = { v0 };
+    setUniform(entry, location, 1, values, sizeof(values));
+    real(location, v0);
+}
+
+void GL_APIENTRY glUniform1fv(GLint location, GLsizei count, GLfloat const* value)
+{
+    INTERPOSE(glUniform1fv);
+    setUniform(entry, location, count, value, 1 * sizeof(GLfloat));
+    real(location, count, value);
+}
+
+void GL_APIENTRY glUniform1i(GLint location, GLint v0)
+{
+    INTERPOSE(glUniform1i);
+    setUniform(entry, location, 1, &v0, sizeof(v0));
+    real(location, v0);
+}
+
+void GL_APIENTRY glUniform2f(GLint location, GLfloat v0, GLfloat v1)
+{
+    INTERPOSE(glUniform2f);
+    GLfloat values[] = { v0, v1 };
+    setUniform(entry, location, 1, values, sizeof(values));
+    real(location, v0, v1);
+}
+
+void GL_APIENTRY glUniform2fv(GLint location, GLsizei count, GLfloat const* value)
+{
+    INTERPOSE(glUniform2fv);
+    setUniform(entry, location, count, value, 2 * sizeof(GLfloat));
+    real(location, count, value);
+}
+
+void GL_APIENTRY glUniform3f(GLint location, GLfloat v0, GLfloat v1, GLfloat v2)
+{
+    INTERPOSE(glUniform3f);
+    GLfloat values[] = { v0, v1, v2 };
+    setUniform(entry, location, 1, values, sizeof(values));
+    real(location, v0, v1, v2);
+}
+
+void GL_APIENTRY glUniform3fv(GLint location, GLsizei count, GLfloat const* value)
+{
+    INTERPOSE(glUniform3fv);
+    setUniform(entry, location, count, value, 3 * sizeof(GLfloat));
+    real(location, count, value);
+}
+
+void GL_APIENTRY glUniform4f(GLint location, GLfloat v0, GLfloat v1, GLfloat v2, GLfloat v3)
+{
+    INTERPOSE(glUniform4f);
+    GLfloat values[] = { v0, v1, v2, v3 };
+    setUniform(entry, location, 1, values, sizeof(values));
+    real(location, v0, v1, v2, v3);
+}
+
+void GL_APIENTRY glUniform4fv(GLint location, GLsizei count, GLfloat const* value)
+{
+    INTERPOSE(glUniform4fv);
+    setUniform(entry, location, count, value, 4 * sizeof(GLfloat));
+    real(location, count, value);
+}
+
+void GL_APIENTRY glUniformMatrix2fv(GLint location, GLsizei count, GLboolean transpose,
+                                    GLfloat const* value)
+{
+    INTERPOSE(glUniformMatrix2fv);
+    setUniform(entry, location, count, value, 4 * sizeof(GLfloat));
+    real(location, count, transpose, value);
+}
+
+void GL_APIENTRY glUniformMatrix3fv(GLint location, GLsizei count, GLboolean transpose,
+                                    GLfloat const* value)
+{
+    INTERPOSE(glUniformMatrix3fv);
+    setUniform(entry, location, count, value, 9 * sizeof(GLfloat));
+    real(location, count, transpose, value);
+}
+
+void GL_APIENTRY glUniformMatrix4fv(GLint location, GLsizei count, GLboolean transpose,
+                                    GLfloat const* value)
+{
+    INTERPOSE(glUniformMatrix4fv);
+    setUniform(entry, location, count, value, 16 * sizeof(GLfloat));
+    real(location, count, transpose, value);
+}
+
+void GL_APIENTRY glUseProgram(GLuint program)
+{
+    INTERPOSE(glUseProgram);
+
+    // Leaving a deleted program behind frees it
+    if (s_state.m_programDeleted && s_state.m_program.m_name != program) {
+        forgetUniforms(s_state.m_program.m_name);
+        s_state.m_programDeleted = false;
+    }
+
+    set(entry, &s_state.m_program, program);
+    real(program);
+}
+
+void GL_APIENTRY glVertexAttribPointer(GLuint index, GLint size, GLenum type,
+                                       GLboolean normalized, GLsizei stride,
+                                       void const* pointer)
+{
+    INTERPOSE(glVertexAttribPointer);
+
+    if (index < (GLuint)MAX_ATTRIBS) {
+        AttribPointer& attrib = s_state.m_pointers[index];
+        bool buffered = s_state.m_arrayBuffer.m_known;
+        GLuint buffer = s_state.m_arrayBuffer.m_name;
+
+        // The pointer captures the array buffer binding along with the rest
+        if (attrib.m_known && buffered && attrib.m_buffer == buffer &&
+            attrib.m_size == size && attrib.m_type == type &&
+            attrib.m_normalized == normalized && attrib.m_stride == stride &&
+            attrib.m_pointer == pointer) {
+            entry.m_redundant++;
+        }
+
+        attrib.m_known = buffered;
+        attrib.m_buffer = buffer;
+        attrib.m_size = size;
+        attrib.m_type = type;
+        attrib.m_normalized = normalized;
+        attrib.m_stride = stride;
+        attrib.m_pointer = pointer;
+    }
+    real(index, size, type, normalized, stride, pointer);
+}
+
+void GL_APIENTRY glViewport(GLint x, GLint y, GLsizei width, GLsizei height)
+{
+    INTERPOSE(glViewport);
+    set(entry, &s_state.m_viewport, x, y, width, height);
+    real(x, y, width, height);
+}
+
+static bool busier(GlEntry const* a, GlEntry const* b)
+{
+    if (a->m_calls != b->m_calls) {
+        return a->m_calls > b->m_calls;
+    }
+    return strcmp(a->m_name, b->m_name) < 0;
+}
+
+static void report(unsigned frames, uint64_t draws)
+{
+    uint64_t calls = 0;
+    uint64_t redundant = 0;
+
+    for (int i = 0; i < s_entryCount; i++) {
+        calls += s_entries[i]->m_calls;
+        redundant += s_entries[i]->m_redundant;
+    }
+
+    printf("GL calls per frame, over %u frames: %.1f, of which %.1f redundant (%.0f%%); "
+           "%.1f draws and clears\n", frames, double(calls) / frames,
+           double(redundant) / frames, calls ? 100.0 * redundant / calls : 0.0,
+           double(draws) / frames);
+
+    std::sort(s_entries, s_entries + s_entryCount, busier);
+
+    printf("  %-28s %9s %9s\n", "entry point", "calls", "redundant");
+    for (int i = 0; i < s_entryCount && s_entries[i]->m_calls > 0; i++) {
+        printf("  %-28s %9.1f %9.1f\n", s_entries[i]->m_name,
+               double(s_entries[i]->m_calls) / frames,
+               double(s_entries[i]->m_redundant) / frames);
+    }
+
+    for (int i = 0; i < CAP_COUNT; i++) {
+        if (s_state.m_caps[i].m_churnFrames == frames) {
+            printf("  %s is enabled and disabled again every frame\n", s_capNames[i]);
+        }
+    }
+    for (int i = 0; i < MAX_ATTRIBS; i++) {
+        if (s_state.m_attribs[i].m_churnFrames == frames) {
+            printf("  Vertex attribute array %d is enabled and disabled again every frame\n", i);
+        }
+    }
+}
+
+static void endFrame(Toggle* toggle)
+{
+    if (toggle->m_enabledThisFrame && toggle->m_disabledThisFrame) {
+        toggle->m_churnFrames++;
+    }
+    toggle->m_enabledThisFrame = false;
+    toggle->m_disabledThisFrame = false;
+}
+
+static void resetCounts()
+{
+    for (int i = 0; i < s_entryCount; i++) {
+        s_entries[i]->m_calls = 0;
+        s_entries[i]->m_redundant = 0;
+    }
+    for (int i = 0; i < CAP_COUNT; i++) {
+        s_state.m_caps[i].m_churnFrames = 0;
+    }
+    for (int i = 0; i < MAX_ATTRIBS; i++) {
+        s_state.m_attribs[i].m_churnFrames = 0;
+    }
+}
+
+void GlCalls::endFrame()
+{
+    static bool s_started;
+    static unsigned s_frames;
+    static uint64_t s_draws;
+
+    for (int i = 0; i < CAP_COUNT; i++) {
+        ::endFrame(&s_state.m_caps[i]);
+    }
+    for (int i = 0; i < MAX_ATTRIBS; i++) {
+        ::endFrame(&s_state.m_attribs[i]);
+    }
+
+    // Setup and the first frame aren't what the rest look like
+    if (!s_started || ++s_frames == REPORT_INTERVAL) {
+        if (s_started) {
+            report(s_frames, s_state.m_draws + s_state.m_clears - s_draws);
+        }
+        resetCounts();
+        s_started = true;
+        s_frames = 0;
+        s_draws = s_state.m_draws + s_state.m_clears;
+    }
+}
+
+#else
+
+void GlCalls::endFrame()
+{
+}
+
+#endif
@@ -0,0 +1,51 @@
+#ifndef __GL_CALLS_HPP__
+#define __GL_CALLS_HPP__
+
+// Per-frame GL call counts, for finding driver overhead nobody meant to
+// pay for.
+//
+// Configure with --count-gl-calls to compile the counting in. gl-calls.cc
+// then defines the GLES2 entry points the framework and demos use, so
+// every call made from the program lands there first: it's counted,
+// checked against a shadow copy of the state it sets, and passed on to
+// the driver's own function (found with dlsym(RTLD_NEXT)). No call site
+// changes. A call counts as redundant when it
+//
+//  - sets state to what it already is: binding the bound buffer, enabling
+//    an enabled capability or attribute array, setting a uniform of the
+//    current program to the value it has;
+//  - is undone before anything uses it: glEnable(GL_BLEND), then
+//    glDisable(GL_BLEND) with no draw or clear in between, counts both;
+//  - does nothing at all, like setting a uniform at location -1.
+//
+// The display makes the only context and every call on it comes through
+// here, so the shadow state starts from GL's defaults. State that
+// depends on the surface (viewport, scissor box) is unknown until set,
+// and uniforms are unknown until set after each link.
+//
+// Every REPORT_INTERVAL frames the per-frame averages are printed on
+// stdout, busiest entry point first, followed by any capability or
+// attribute array that was turned on and off again in every one of those
+// frames. That's what drawing code that puts GL back as it found it
+// does, as CubeWindow::drawGl() does with its attribute arrays; with
+// nothing else drawing in between, those calls are also counted above.
+//
+// Every core entry point the tree calls has a definition there, setup
+// calls (glGen*, shader compiles and links, queries) included, so the
+// counts cover all of GL but the extensions: their entry points, reached
+// through glExtensions(), aren't counted. A call site using an entry
+// point gl-calls.cc doesn't define yet goes straight to the driver
+// uncounted, so add it there along with the call.
+// Counts are for the whole process: windows sharing the display each end
+// frames of their own.
+class GlCalls
+{
+public:
+    static const unsigned REPORT_INTERVAL = 120;
+
+    // After each frame is swapped. Does nothing unless built with
+    // --count-gl-calls.
+    static void endFrame();
+};
+
+#endif
@@ -0,0 +1,99 @@
+#include <EGL/egl.h>
+#include <cstring>
+
+#include "gl-ext.hpp"
+
+// Whether 'name' is in the space-separated list 'extensions', which may
+// be NULL
+static bool hasExtension(char const* extensions, char const* name)
+{
+    size_t len = strlen(name);
+
+    // Match whole space-separated names only; some extension names are
+    // prefixes of others
+    for (char const* p = extensions; p && (p = strstr(p, name)); p += len) {
+        bool start = p == extensions || p[-1] == ' ';
+        bool end = p[len] == ' ' || p[len] == '\0';
+        if (start && end) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool hasGlExtension(char const* name)
+{
+    return hasExtension((char const*)glGetString(GL_EXTENSIONS), name);
+}
+
+bool hasEglExtension(EGLDisplay display, char const* name)
+{
+    return hasExtension(eglQueryString(display, EGL_EXTENSIONS), name);
+}
+
+template <typename T>
+static T lookup(char const* name)
+{
+    return reinterpret_cast<T>(eglGetProcAddress(name));
+}
+
+static void load(GlExtensions* ext)
+{
+    memset(ext, 0, sizeof(*ext));
+
+    if (hasGlExtension("GL_EXT_discard_framebuffer")) {
+        ext->DiscardFramebufferEXT =
+            lookup<PFNGLDISCARDFRAMEBUFFEREXTPROC>("glDiscardFramebufferEXT");
+        ext->m_discardFramebuffer = ext->DiscardFramebufferEXT != NULL;
+    }
+
+    bool timerQuery = hasGlExtension("GL_EXT_disjoint_timer_query");
+    bool occlusionQuery = hasGlExtension("GL_EXT_occlusion_query_boolean");
+
+    if (timerQuery || occlusionQuery) {
+        ext->GenQueriesEXT =
+            lookup<PFNGLGENQUERIESEXTPROC>("glGenQueriesEXT");
+        ext->DeleteQueriesEXT =
+            lookup<PFNGLDELETEQUERIESEXTPROC>("glDeleteQueriesEXT");
+        ext->BeginQueryEXT =
+            lookup<PFNGLBEGINQUERYEXTPROC>("glBeginQueryEXT");
+        ext->EndQueryEXT =
+            lookup<PFNGLENDQUERYEXTPROC>("glEndQueryEXT");
+        ext->GetQueryObjectuivEXT =
+            lookup<PFNGLGETQUERYOBJECTUIVEXTPROC>("glGetQueryObjectuivEXT");
+
+        bool queries = ext->GenQueriesEXT &&
+                       ext->DeleteQueriesEXT &&
+                       ext->BeginQueryEXT &&
+                       ext->EndQueryEXT &&
+                       ext->GetQueryObjectuivEXT;
+
+        ext->m_occlusionQueryBoolean = occlusionQuery && queries;
+
+        if (timerQuery) {
+            ext->GetQueryObjectui64vEXT =
+                lookup<PFNGLGETQUERYOBJECTUI64VEXTPROC>("glGetQueryObjectui64vEXT");
+            ext->m_disjointTimerQuery = queries && ext->GetQueryObjectui64vEXT;
+        }
+    }
+
+    if (hasGlExtension("GL_OES_mapbuffer")) {
+        ext->MapBufferOES =
+            lookup<PFNGLMAPBUFFEROESPROC>("glMapBufferOES");
+        ext->UnmapBufferOES =
+            lookup<PFNGLUNMAPBUFFEROESPROC>("glUnmapBufferOES");
+        ext->m_mapBuffer = ext->MapBufferOES && ext->UnmapBufferOES;
+    }
+}
+
+GlExtensions const& glExtensions()
+{
+    static GlExtensions s_extensions;
+    static bool s_loaded = false;
+
+    if (!s_loaded) {
+        load(&s_extensions);
+        s_loaded = true;
+    }
+    return s_extensions;
+}
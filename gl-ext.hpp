@@ -0,0 +1,44 @@
+#ifndef __GL_EXT_HPP__
+#define __GL_EXT_HPP__
+
+#include <EGL/egl.h>
+#include <GLES2/gl2.h>
+#include <GLES2/gl2ext.h>
+
+// Optional GLES2 extensions used by the framework. Entry points are
+// looked up through eglGetProcAddress() the first time glExtensions() is
+// called, which needs a current context. The pointers stay NULL, and the
+// flag false, when the driver doesn't advertise the extension.
+struct GlExtensions
+{
+    // GL_EXT_discard_framebuffer
+    bool m_discardFramebuffer;
+    PFNGLDISCARDFRAMEBUFFEREXTPROC DiscardFramebufferEXT;
+
+    // GL_EXT_disjoint_timer_query and GL_EXT_occlusion_query_boolean.
+    // Both define the query object entry points; only the timer query
+    // adds the 64-bit result.
+    bool m_disjointTimerQuery;
+    bool m_occlusionQueryBoolean;
+    PFNGLGENQUERIESEXTPROC GenQueriesEXT;
+    PFNGLDELETEQUERIESEXTPROC DeleteQueriesEXT;
+    PFNGLBEGINQUERYEXTPROC BeginQueryEXT;
+    PFNGLENDQUERYEXTPROC EndQueryEXT;
+    PFNGLGETQUERYOBJECTUIVEXTPROC GetQueryObjectuivEXT;
+    PFNGLGETQUERYOBJECTUI64VEXTPROC GetQueryObjectui64vEXT;
+
+    // GL_OES_mapbuffer
+    bool m_mapBuffer;
+    PFNGLMAPBUFFEROESPROC MapBufferOES;
+    PFNGLUNMAPBUFFEROESPROC UnmapBufferOES;
+};
+
+GlExtensions const& glExtensions();
+
+// Whether 'name' appears in GL_EXTENSIONS for the current context
+bool hasGlExtension(char const* name);
+
+// Whether 'name' appears in EGL_EXTENSIONS for 'display'
+bool hasEglExtension(EGLDisplay display, char const* name);
+
+#endif
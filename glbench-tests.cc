@@ -0,0 +1,576 @@
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+
+#include "gl-ext.hpp"
+#include "gpu-resources.hpp"
+#include "glbench.hpp"
+#include "mesh-lod.hpp"
+#include "shader.hpp"
+
+#define N_ELEMENTS(_a) (sizeof(_a) / sizeof(_a[0]))
+
+// Draws per iteration for the tests that measure per-draw costs
+static const int DRAWS = 1000;
+
+static const char* flat_vert_shader_text =
+    "attribute vec2 a_pos;\n"
+    "void main() {\n"
+    "  gl_Position = vec4(a_pos, 0, 1);\n"
+    "}\n";
+
+static const char* flat_frag_shader_text =
+    "precision mediump float;\n"
+    "uniform vec4 u_color;\n"
+    "void main() {\n"
+    "  gl_FragColor = u_color;\n"
+    "}\n";
+
+static const char* textured_frag_shader_text =
+    "precision mediump float;\n"
+    "uniform sampler2D u_texture;\n"
+    "void main() {\n"
+    "  gl_FragColor = texture2D(u_texture, vec2(0.5));\n"
+    "}\n";
+
+// A triangle a few pixels across in the corner, for tests where the draw
+// itself rather than its pixels is being measured
+static const GLfloat s_tinyTriangle[] = {
+    -1.00f, -1.00f,
+    -0.98f, -1.00f,
+    -1.00f, -0.98f,
+};
+
+static const GLushort s_tinyTriangleIndices[] = { 0, 1, 2 };
+
+static const GLfloat s_fullScreenQuad[] = {
+    -1, -1,
+    +1, -1,
+    -1, +1,
+    +1, +1,
+};
+
+static GLuint buildProgram(std::string const& vertText, std::string const& fragText)
+{
+    static char const* const attribs[] = { "a_pos", NULL };
+
+    GLuint vert = compileShader(vertText, GL_VERTEX_SHADER);
+    GLuint frag = compileShader(fragText, GL_FRAGMENT_SHADER);
+    GLuint program = linkProgram(vert, frag, attribs);
+    GpuResources::deleteShader(vert);
+    GpuResources::deleteShader(frag);
+    return program;
+}
+
+static GLuint buildBuffer(GLenum target, void const* data, GLsizeiptr size)
+{
+    GLuint buffer = GpuResources::createBuffer("glbench buffer");
+    glBindBuffer(target, buffer);
+    GpuResources::bufferData(buffer, target, size, data, GL_STATIC_DRAW);
+    return buffer;
+}
+
+static std::string param(char const* key, int value)
+{
+    char text[64];
+    snprintf(text, sizeof(text), "%s=%d", key, value);
+    return text;
+}
+
+// Full-screen opaque quads, 'overdraw' of them per iteration, no depth
+// or blending: raw pixel write rate
+class FillBenchmark: public Benchmark
+{
+public:
+    FillBenchmark(int overdraw)
+        : m_overdraw(overdraw)
+    {
+    }
+
+    virtual char const* name() const        { return "fill"; }
+    virtual std::string params() const      { return param("overdraw", m_overdraw); }
+    virtual char const* unit() const        { return "Mpix/s"; }
+
+    virtual void setupGl(int width, int height)
+    {
+        m_pixels = (double)width * height;
+
+        m_program = buildProgram(flat_vert_shader_text, flat_frag_shader_text);
+        glUseProgram(m_program);
+        glUniform4f(glGetUniformLocation(m_program, "u_color"), 0.2, 0.4, 0.6, 1);
+
+        m_buffer = buildBuffer(GL_ARRAY_BUFFER, s_fullScreenQuad, sizeof(s_fullScreenQuad));
+        glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 0, 0);
+        glEnableVertexAttribArray(0);
+    }
+
+    virtual void teardownGl()
+    {
+        glDisableVertexAttribArray(0);
+        GpuResources::deleteBuffer(m_buffer);
+        GpuResources::deleteProgram(m_program);
+    }
+
+    virtual void run()
+    {
+        for (int i = 0; i < m_overdraw; i++) {
+            glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+        }
+    }
+
+    virtual double work() const             { return m_pixels * m_overdraw / 1e6; }
+
+private:
+    int m_overdraw;
+    double m_pixels;
+    GLuint m_program;
+    GLuint m_buffer;
+};
+
+// The geodesic sphere at one subdivision level, small on screen so that
+// vertex processing dominates
+class VertexBenchmark: public Benchmark
+{
+public:
+    VertexBenchmark(int subdivisions)
+        : m_subdivisions(subdivisions)
+    {
+    }
+
+    virtual char const* name() const        { return "vertex"; }
+    virtual std::string params() const      { return param("subdivisions", m_subdivisions); }
+    virtual char const* unit() const        { return "Mtri/s"; }
+
+    virtual void setupGl(int width, int height)
+    {
+        static const char* vert_shader_text =
+            "attribute vec3 a_pos;\n"
+            "varying vec3 v_color;\n"
+            "void main() {\n"
+            "  gl_Position = vec4(a_pos * 0.3, 1);\n"
+            "  float lambert = max(dot(a_pos, normalize(vec3(1, 1, 1))), 0.0);\n"
+            "  v_color = vec3(0.2 + 0.8 * lambert);\n"
+            "}\n";
+
+        static const char* frag_shader_text =
+            "precision mediump float;\n"
+            "varying vec3 v_color;\n"
+            "void main() {\n"
+            "  gl_FragColor = vec4(v_color, 1);\n"
+            "}\n";
+
+        m_program = buildProgram(vert_shader_text, frag_shader_text);
+        glUseProgram(m_program);
+
+        buildGeodesicSphere(m_mesh, m_subdivisions);
+        m_mesh.setupGl();
+        m_mesh.bindVertices();
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, 0);
+        glEnableVertexAttribArray(0);
+    }
+
+    virtual void teardownGl()
+    {
+        glDisableVertexAttribArray(0);
+        m_mesh.teardownGl();
+        GpuResources::deleteProgram(m_program);
+    }
+
+    virtual void run()
+    {
+        m_mesh.drawLevel(0);
+    }
+
+    virtual double work() const             { return m_mesh.triangleCount(0) / 1e6; }
+
+private:
+    int m_subdivisions;
+    LodMesh m_mesh;
+    GLuint m_program;
+};
+
+// DRAWS single-triangle draws with nothing changed in between: the fixed
+// cost of a draw call
+class DrawCallBenchmark: public Benchmark
+{
+public:
+    DrawCallBenchmark(bool indexed)
+        : m_indexed(indexed)
+    {
+    }
+
+    virtual char const* name() const        { return "drawcall"; }
+    virtual std::string params() const      { return m_indexed ? "elements" : "arrays"; }
+    virtual char const* unit() const        { return "kdraws/s"; }
+
+    virtual void setupGl(int width, int height)
+    {
+        m_program = buildProgram(flat_vert_shader_text, flat_frag_shader_text);
+        glUseProgram(m_program);
+        glUniform4f(glGetUniformLocation(m_program, "u_color"), 1, 1, 1, 1);
+
+        m_buffers[0] = buildBuffer(GL_ARRAY_BUFFER, s_tinyTriangle, sizeof(s_tinyTriangle));
+        m_buffers[1] = buildBuffer(GL_ELEMENT_ARRAY_BUFFER, s_tinyTriangleIndices,
+                                   sizeof(s_tinyTriangleIndices));
+        glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 0, 0);
+        glEnableVertexAttribArray(0);
+    }
+
+    virtual void teardownGl()
+    {
+        glDisableVertexAttribArray(0);
+        GpuResources::deleteBuffer(m_buffers[0]);
+        GpuResources::deleteBuffer(m_buffers[1]);
+        GpuResources::deleteProgram(m_program);
+    }
+
+    virtual void run()
+    {
+        for (int i = 0; i < DRAWS; i++) {
+            if (m_indexed) {
+                glDrawElements(GL_TRIANGLES, 3, GL_UNSIGNED_SHORT, 0);
+            } else {
+                glDrawArrays(GL_TRIANGLES, 0, 3);
+            }
+        }
+    }
+
+    virtual double work() const             { return DRAWS / 1e3; }
+
+private:
+    bool m_indexed;
+    GLuint m_program;
+    GLuint m_buffers[2];
+};
+
+// Like DrawCallBenchmark, but flipping one piece of state between every
+// draw. "none" is the baseline; the difference from it is the cost of
+// the change plus whatever revalidation it triggers at the next draw.
+class StateChangeBenchmark: public Benchmark
+{
+public:
+    enum Kind
+    {
+        KIND_NONE,
+        KIND_PROGRAM,
+        KIND_TEXTURE,
+        KIND_BLEND,
+        KIND_BUFFER,
+    };
+
+    StateChangeBenchmark(Kind kind)
+        : m_kind(kind)
+    {
+    }
+
+    virtual char const* name() const        { return "state"; }
+    virtual char const* unit() const        { return "kdraws/s"; }
+
+    virtual std::string params() const
+    {
+        static char const* const names[] = {
+            "none", "program", "texture", "blend", "buffer",
+        };
+        return names[m_kind];
+    }
+
+    virtual void setupGl(int width, int height)
+    {
+        // Two programs that differ only in source, so that switching
+        // between them can't be short-circuited
+        for (int i = 0; i < 2; i++) {
+            std::vector<std::string> defines(1, param("VARIANT", i));
+            m_programs[i] = buildProgram(withDefines(flat_vert_shader_text, defines),
+                                         m_kind == KIND_TEXTURE
+                                         ? textured_frag_shader_text
+                                         : flat_frag_shader_text);
+            glUseProgram(m_programs[i]);
+            glUniform4f(glGetUniformLocation(m_programs[i], "u_color"), 1, i, 1, 1);
+        }
+        glUseProgram(m_programs[0]);
+
+        // Two 4x4 textures of different colors
+        for (int i = 0; i < 2; i++) {
+            GLubyte texels[4 * 4 * 4];
+            memset(texels, i ? 0xff : 0x80, sizeof(texels));
+
+            m_textures[i] = GpuResources::createTexture("glbench texture");
+            glBindTexture(GL_TEXTURE_2D, m_textures[i]);
+            GpuResources::texImage2D(m_textures[i], GL_TEXTURE_2D, 0, GL_RGBA, 4, 4,
+                                     GL_UNSIGNED_BYTE, texels);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        }
+
+        for (int i = 0; i < 2; i++) {
+            m_buffers[i] = buildBuffer(GL_ARRAY_BUFFER, s_tinyTriangle, sizeof(s_tinyTriangle));
+        }
+        glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 0, 0);
+        glEnableVertexAttribArray(0);
+
+        glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    }
+
+    virtual void teardownGl()
+    {
+        glDisable(GL_BLEND);
+        glDisableVertexAttribArray(0);
+        GpuResources::deleteBuffer(m_buffers[0]);
+        GpuResources::deleteBuffer(m_buffers[1]);
+        GpuResources::deleteTexture(m_textures[0]);
+        GpuResources::deleteTexture(m_textures[1]);
+        GpuResources::deleteProgram(m_programs[0]);
+        GpuResources::deleteProgram(m_programs[1]);
+    }
+
+    virtual void run()
+    {
+        for (int i = 0; i < DRAWS; i++) {
+            int which = i & 1;
+
+            switch (m_kind) {
+                case KIND_NONE:
+                    break;
+
+                case KIND_PROGRAM:
+                    glUseProgram(m_programs[which]);
+                    break;
+
+                case KIND_TEXTURE:
+                    glBindTexture(GL_TEXTURE_2D, m_textures[which]);
+                    break;
+
+                case KIND_BLEND:
+                    if (which) {
+                        glEnable(GL_BLEND);
+                    } else {
+                        glDisable(GL_BLEND);
+                    }
+                    break;
+
+                case KIND_BUFFER:
+                    glBindBuffer(GL_ARRAY_BUFFER, m_buffers[which]);
+                    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 0, 0);
+                    break;
+            }
+
+            glDrawArrays(GL_TRIANGLES, 0, 3);
+        }
+    }
+
+    virtual double work() const             { return DRAWS / 1e3; }
+
+private:
+    Kind m_kind;
+    GLuint m_programs[2];
+    GLuint m_textures[2];
+    GLuint m_buffers[2];
+};
+
+// A glUniform4fv() of 'vectors' vec4s before every draw, all of them
+// read by the vertex shader
+class UniformBenchmark: public Benchmark
+{
+public:
+    UniformBenchmark(int vectors)
+        : m_vectors(vectors)
+        , m_data(vectors * 4, 0.0f)
+    {
+    }
+
+    virtual char const* name() const        { return "uniform"; }
+    virtual std::string params() const      { return param("vec4s", m_vectors); }
+    virtual char const* unit() const        { return "MB/s"; }
+
+    virtual void setupGl(int width, int height)
+    {
+        // The tiny scale keeps the sum from moving the triangle while
+        // stopping the compiler from dropping the uniforms
+        static const char* vert_shader_text =
+            "uniform vec4 u_data[VECTORS];\n"
+            "attribute vec2 a_pos;\n"
+            "void main() {\n"
+            "  vec4 sum = vec4(0);\n"
+            "  for (int i = 0; i < VECTORS; i++)\n"
+            "    sum += u_data[i];\n"
+            "  gl_Position = vec4(a_pos, 0, 1) + sum * 1e-9;\n"
+            "}\n";
+
+        std::vector<std::string> defines(1, param("VECTORS", m_vectors));
+        m_program = buildProgram(withDefines(vert_shader_text, defines), flat_frag_shader_text);
+        glUseProgram(m_program);
+        glUniform4f(glGetUniformLocation(m_program, "u_color"), 1, 1, 1, 1);
+        m_uData = glGetUniformLocation(m_program, "u_data");
+
+        m_buffer = buildBuffer(GL_ARRAY_BUFFER, s_tinyTriangle, sizeof(s_tinyTriangle));
+        glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 0, 0);
+        glEnableVertexAttribArray(0);
+    }
+
+    virtual void teardownGl()
+    {
+        glDisableVertexAttribArray(0);
+        GpuResources::deleteBuffer(m_buffer);
+        GpuResources::deleteProgram(m_program);
+    }
+
+    virtual void run()
+    {
+        for (int i = 0; i < DRAWS; i++) {
+            // Different every time, so the upload can't be skipped
+            m_data[0] = i;
+            glUniform4fv(m_uData, m_vectors, &m_data[0]);
+            glDrawArrays(GL_TRIANGLES, 0, 3);
+        }
+    }
+
+    virtual double work() const
+    {
+        return DRAWS * m_vectors * 4 * sizeof(GLfloat) / 1e6;
+    }
+
+private:
+    int m_vectors;
+    std::vector<GLfloat> m_data;
+    GLuint m_program;
+    GLint m_uData;
+    GLuint m_buffer;
+};
+
+// Replaces the whole contents of a 'size' byte vertex buffer, then draws
+// a triangle from it so the driver has to honor the upload
+class UploadBenchmark: public Benchmark
+{
+public:
+    enum Method
+    {
+        METHOD_SUB_DATA,
+        METHOD_ORPHAN,
+        METHOD_MAP,
+    };
+
+    UploadBenchmark(Method method, int size)
+        : m_method(method)
+        , m_size(size)
+    {
+    }
+
+    virtual char const* name() const        { return "upload"; }
+    virtual char const* unit() const        { return "MB/s"; }
+
+    virtual std::string params() const
+    {
+        static char const* const names[] = { "subdata", "orphan", "map" };
+        return std::string(names[m_method]) + "," + param("kb", m_size / 1024);
+    }
+
+    // Without GL_OES_mapbuffer, measuring glBufferSubData() instead would
+    // file its numbers under map's name
+    virtual bool supported() const
+    {
+        return m_method != METHOD_MAP || glExtensions().m_mapBuffer;
+    }
+
+    virtual void setupGl(int width, int height)
+    {
+        m_program = buildProgram(flat_vert_shader_text, flat_frag_shader_text);
+        glUseProgram(m_program);
+        glUniform4f(glGetUniformLocation(m_program, "u_color"), 1, 1, 1, 1);
+
+        // Zeros make a degenerate triangle, which is fine: the draw only
+        // needs to depend on the buffer
+        m_source.assign(m_size, 0);
+        m_buffer = buildBuffer(GL_ARRAY_BUFFER, &m_source[0], m_size);
+        glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 0, 0);
+        glEnableVertexAttribArray(0);
+    }
+
+    virtual void teardownGl()
+    {
+        glDisableVertexAttribArray(0);
+        GpuResources::deleteBuffer(m_buffer);
+        GpuResources::deleteProgram(m_program);
+        m_source.clear();
+    }
+
+    virtual void run()
+    {
+        switch (m_method) {
+            case METHOD_SUB_DATA:
+                glBufferSubData(GL_ARRAY_BUFFER, 0, m_size, &m_source[0]);
+                break;
+
+            case METHOD_ORPHAN:
+                GpuResources::bufferData(m_buffer, GL_ARRAY_BUFFER, m_size, NULL, GL_STREAM_DRAW);
+                glBufferSubData(GL_ARRAY_BUFFER, 0, m_size, &m_source[0]);
+                break;
+
+            case METHOD_MAP: {
+                // A failed map uploads nothing; the sample comes out fast,
+                // but the suite goes on
+                void* p = glExtensions().MapBufferOES(GL_ARRAY_BUFFER, GL_WRITE_ONLY_OES);
+                if (p) {
+                    memcpy(p, &m_source[0], m_size);
+                }
+                glExtensions().UnmapBufferOES(GL_ARRAY_BUFFER);
+                break;
+            }
+        }
+
+        glDrawArrays(GL_TRIANGLES, 0, 3);
+    }
+
+    virtual double work() const             { return m_size / 1e6; }
+
+private:
+    Method m_method;
+    int m_size;
+    std::vector<char> m_source;
+    GLuint m_program;
+    GLuint m_buffer;
+};
+
+void createBenchmarks(std::vector<Benchmark*>& benchmarks)
+{
+    static const int overdraws[] = { 1, 4, 16 };
+    for (size_t i = 0; i < N_ELEMENTS(overdraws); i++) {
+        benchmarks.push_back(new FillBenchmark(overdraws[i]));
+    }
+
+    // 320 to 81920 triangles
+    for (int subdivisions = 2; subdivisions <= 6; subdivisions++) {
+        benchmarks.push_back(new VertexBenchmark(subdivisions));
+    }
+
+    benchmarks.push_back(new DrawCallBenchmark(false));
+    benchmarks.push_back(new DrawCallBenchmark(true));
+
+    static const StateChangeBenchmark::Kind kinds[] = {
+        StateChangeBenchmark::KIND_NONE,
+        StateChangeBenchmark::KIND_PROGRAM,
+        StateChangeBenchmark::KIND_TEXTURE,
+        StateChangeBenchmark::KIND_BLEND,
+        StateChangeBenchmark::KIND_BUFFER,
+    };
+    for (size_t i = 0; i < N_ELEMENTS(kinds); i++) {
+        benchmarks.push_back(new StateChangeBenchmark(kinds[i]));
+    }
+
+    // GLES2 only promises 128 vertex uniform vectors
+    static const int vectors[] = { 1, 16, 64 };
+    for (size_t i = 0; i < N_ELEMENTS(vectors); i++) {
+        benchmarks.push_back(new UniformBenchmark(vectors[i]));
+    }
+
+    static const int sizes[] = { 4 << 10, 64 << 10, 1 << 20, 4 << 20 };
+    static const UploadBenchmark::Method methods[] = {
+        UploadBenchmark::METHOD_SUB_DATA,
+        UploadBenchmark::METHOD_ORPHAN,
+        UploadBenchmark::METHOD_MAP,
+    };
+    for (size_t m = 0; m < N_ELEMENTS(methods); m++) {
+        for (size_t i = 0; i < N_ELEMENTS(sizes); i++) {
+            benchmarks.push_back(new UploadBenchmark(methods[m], sizes[i]));
+        }
+    }
+}
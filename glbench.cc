@@ -0,0 +1,233 @@
+#include <cstdio>
+#include <cstring>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "base.hpp"
+#include "glbench.hpp"
+#include "results.hpp"
+
+// GL micro-benchmark suite. Runs every test in glbench-tests.cc in turn,
+// each for REPETITIONS timed repetitions, and prints the mean rate and
+// its spread. With a results file, also writes every repetition's rate
+// to it as a BenchResult, for benchdb to store and compare.
+//
+// Each repetition calls the test's run() enough times to take at least
+// MIN_REPETITION_MS, between two glFinish() calls, so it measures
+// completed GPU work and not just command submission. One repetition is
+// done per frame.
+//
+// Nothing depends on a real display: it runs just as well on llvmpipe
+// under a headless compositor, e.g.
+//
+//     weston --backend=headless-backend.so &
+//     LIBGL_ALWAYS_SOFTWARE=1 glbench -g 512x512 results.jsonl
+//
+// 'filter' picks the tests whose "name:params" contains it.
+//
+// Usage: glbench [window options] [results-file [filter]]
+
+static const int REPETITIONS = 7;
+static const double MIN_REPETITION_MS = 50;
+static const int MAX_ITERATIONS = 1 << 20;
+
+static double nowMs()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000.0 + ts.tv_nsec / 1000000.0;
+}
+
+class GlBenchWindow: public WaylandWindow
+{
+public:
+    GlBenchWindow()
+        : m_filter(NULL)
+        , m_results(NULL)
+        , m_started(false)
+        , m_current(0)
+        , m_caseReady(false)
+        , m_iterations(0)
+    {
+    }
+
+    virtual ~GlBenchWindow()
+    {
+        for (size_t i = 0; i < m_benchmarks.size(); i++) {
+            delete m_benchmarks[i];
+        }
+        if (m_results) {
+            fclose(m_results);
+        }
+    }
+
+    void setFilter(char const* filter)  { m_filter = filter; }
+
+    void setResultsFile(char const* path)
+    {
+        m_results = fopen(path, "w");
+        if (!m_results) {
+            perror(path);
+            exit(EXIT_FAILURE);
+        }
+    }
+
+protected:
+    virtual void setupGl()
+    {
+    }
+
+    virtual void drawGl(uint32_t time)
+    {
+        if (!m_started) {
+            start();
+        }
+
+        if (m_current >= m_benchmarks.size()) {
+            display()->quit();
+            return;
+        }
+
+        Benchmark* benchmark = m_benchmarks[m_current];
+
+        glViewport(0, 0, currentSize().m_width, currentSize().m_height);
+        glClearColor(0, 0, 0, 1);
+        glClear(GL_COLOR_BUFFER_BIT);
+
+        if (!m_caseReady) {
+            benchmark->setupGl(currentSize().m_width, currentSize().m_height);
+            calibrate(benchmark);
+            m_samples.clear();
+            m_caseReady = true;
+            return;
+        }
+
+        double ms = measure(benchmark, m_iterations);
+        m_samples.push_back(benchmark->work() * m_iterations / (ms / 1000));
+
+        if ((int)m_samples.size() == REPETITIONS) {
+            benchmark->teardownGl();
+            report(benchmark);
+
+            m_caseReady = false;
+            m_current++;
+        }
+    }
+
+    virtual void teardownGl()
+    {
+        if (m_caseReady) {
+            m_benchmarks[m_current]->teardownGl();
+            m_caseReady = false;
+        }
+    }
+
+private:
+    void start()
+    {
+        std::vector<Benchmark*> all;
+        createBenchmarks(all);
+
+        for (size_t i = 0; i < all.size(); i++) {
+            std::string id = std::string(all[i]->name()) + ":" + all[i]->params();
+            if (m_filter && id.find(m_filter) == std::string::npos) {
+                delete all[i];
+            } else if (!all[i]->supported()) {
+                fprintf(stderr, "glbench: %s not supported, skipped\n", id.c_str());
+                delete all[i];
+            } else {
+                m_benchmarks.push_back(all[i]);
+            }
+        }
+
+        m_renderer = (char const*)glGetString(GL_RENDERER);
+        m_version = (char const*)glGetString(GL_VERSION);
+
+        printf("%s, %ux%u, %d repetitions of at least %.0f ms\n",
+               m_renderer.c_str(), currentSize().m_width, currentSize().m_height,
+               REPETITIONS, MIN_REPETITION_MS);
+        printf("%-28s %12s %-9s %8s\n", "test", "mean", "unit", "cv");
+
+        m_started = true;
+    }
+
+    double measure(Benchmark* benchmark, int iterations)
+    {
+        glFinish();
+        double start = nowMs();
+
+        for (int i = 0; i < iterations; i++) {
+            benchmark->run();
+        }
+
+        glFinish();
+        return nowMs() - start;
+    }
+
+    // Double the iterations until a repetition is long enough to time
+    // reliably
+    void calibrate(Benchmark* benchmark)
+    {
+        // Drivers compile shaders and place buffers lazily, at the first
+        // draw; don't let that count towards the calibration
+        measure(benchmark, 1);
+
+        m_iterations = 1;
+        while (m_iterations < MAX_ITERATIONS &&
+               measure(benchmark, m_iterations) < MIN_REPETITION_MS) {
+            m_iterations *= 2;
+        }
+    }
+
+    void report(Benchmark* benchmark)
+    {
+        BenchResult result;
+        result.m_name = benchmark->name();
+        result.m_params = benchmark->params();
+        result.m_unit = benchmark->unit();
+        result.m_renderer = m_renderer;
+        result.m_version = m_version;
+        result.m_width = currentSize().m_width;
+        result.m_height = currentSize().m_height;
+        result.m_samples = m_samples;
+
+        SampleStats stats = summarize(m_samples);
+        printf("%-28s %12.2f %-9s %7.1f%%\n", result.id().c_str(),
+               stats.m_mean, result.m_unit.c_str(), 100 * stats.m_stddev / stats.m_mean);
+
+        if (m_results) {
+            writeResult(m_results, result);
+            fflush(m_results);
+        }
+    }
+
+    char const* m_filter;
+    FILE* m_results;
+    std::string m_renderer;
+    std::string m_version;
+
+    bool m_started;
+    std::vector<Benchmark*> m_benchmarks;
+    size_t m_current;
+    bool m_caseReady;
+    int m_iterations;
+    std::vector<double> m_samples;
+};
+
+int main(int argc, char* argv[])
+{
+    GlBenchWindow w;
+    w.init(&argc, argv);
+
+    // Positional arguments are what's left after the window options
+    if (optind < argc) {
+        w.setResultsFile(argv[optind++]);
+    }
+    if (optind < argc) {
+        w.setFilter(argv[optind++]);
+    }
+
+    w.run();
+    return EXIT_SUCCESS;
+}
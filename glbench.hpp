@@ -0,0 +1,45 @@
+#ifndef __GLBENCH_HPP__
+#define __GLBENCH_HPP__
+
+#include <GLES2/gl2.h>
+
+#include <string>
+#include <vector>
+
+// One isolated GL micro-benchmark at one setting, e.g. fill rate at 4x
+// overdraw. The glbench harness calls run() in a loop between two
+// glFinish() calls and divides the work done by the time taken.
+class Benchmark
+{
+public:
+    virtual ~Benchmark() {}
+
+    // Test name and setting, e.g. "fill" and "overdraw=4". Together they
+    // identify a result across runs, so keep them stable.
+    virtual char const* name() const = 0;
+    virtual std::string params() const = 0;
+
+    // What work() counts per second, e.g. "Mpix/s"
+    virtual char const* unit() const = 0;
+
+    // False if the GL can't run it, e.g. for want of an extension; it's
+    // skipped rather than measured some other way under its name. Called
+    // with the context current, before setupGl().
+    virtual bool supported() const          { return true; }
+
+    // The default framebuffer is 'width' x 'height'
+    virtual void setupGl(int width, int height) = 0;
+    virtual void teardownGl() = 0;
+
+    // Issues one iteration's worth of GL commands
+    virtual void run() = 0;
+
+    // Work per iteration, in the units of unit() times seconds
+    virtual double work() const = 0;
+};
+
+// Every benchmark glbench knows about, in the order they run. The caller
+// owns them.
+void createBenchmarks(std::vector<Benchmark*>& benchmarks);
+
+#endif
@@ -0,0 +1,269 @@
+#include <assert.h>
+#include <cstring>
+#include <time.h>
+
+#include "frame-stats.hpp"
+#include "gl-ext.hpp"
+#include "gpu-profiler.hpp"
+
+GpuProfiler::GpuProfiler(FrameStats& stats)
+    : m_stats(stats)
+    , m_setUp(false)
+    , m_timerQueries(false)
+    , m_current(0)
+    , m_inFrame(false)
+    , m_inPass(false)
+    , m_passStart(0)
+    , m_totalCount(0)
+    , m_resolved(0)
+    , m_dropped(0)
+{
+    memset(m_frames, 0, sizeof(m_frames));
+    memset(m_totals, 0, sizeof(m_totals));
+}
+
+GpuProfiler::~GpuProfiler()
+{
+}
+
+double GpuProfiler::nowMs()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000.0 + ts.tv_nsec / 1000000.0;
+}
+
+void GpuProfiler::setupGl()
+{
+    GlExtensions const& ext = glExtensions();
+
+    m_timerQueries = ext.m_disjointTimerQuery;
+
+    if (m_timerQueries) {
+        for (int i = 0; i < FRAMES_IN_FLIGHT; i++) {
+            ext.GenQueriesEXT(MAX_PASSES, m_frames[i].m_queries);
+            m_frames[i].m_pending = false;
+        }
+
+        // Reading the flag clears it, so only disjoint events that
+        // happen from here on are seen by collect()
+        GLint disjoint;
+        glGetIntegerv(GL_GPU_DISJOINT_EXT, &disjoint);
+    } else {
+        fprintf(stderr, "GL_EXT_disjoint_timer_query not supported; "
+                        "timing GPU passes with glFinish(), which slows "
+                        "rendering down\n");
+    }
+
+    m_setUp = true;
+}
+
+void GpuProfiler::teardownGl()
+{
+    if (m_timerQueries) {
+        for (int i = 0; i < FRAMES_IN_FLIGHT; i++) {
+            glExtensions().DeleteQueriesEXT(MAX_PASSES, m_frames[i].m_queries);
+            m_frames[i].m_pending = false;
+        }
+    }
+
+    m_setUp = false;
+}
+
+void GpuProfiler::beginFrame()
+{
+    if (!m_setUp) {
+        return;
+    }
+
+    assert(!m_inFrame);
+
+    collect();
+
+    m_current = (m_current + 1) % FRAMES_IN_FLIGHT;
+    Frame& frame = m_frames[m_current];
+
+    // Still nothing back after FRAMES_IN_FLIGHT frames. Waiting for it
+    // would stall, so reuse the queries and lose that frame's numbers.
+    if (frame.m_pending) {
+        frame.m_pending = false;
+        m_dropped++;
+    }
+
+    frame.m_count = 0;
+    frame.m_serial = m_stats.frameCount();
+    frame.m_submitted = nowMs();
+    m_inFrame = true;
+}
+
+void GpuProfiler::beginPass(char const* name)
+{
+    if (!m_inFrame) {
+        return;
+    }
+
+    endPass();
+
+    Frame& frame = m_frames[m_current];
+    if (frame.m_count == MAX_PASSES) {
+        return;
+    }
+
+    frame.m_names[frame.m_count] = name;
+
+    if (m_timerQueries) {
+        glExtensions().BeginQueryEXT(GL_TIME_ELAPSED_EXT,
+                                     frame.m_queries[frame.m_count]);
+    } else {
+        glFinish();
+        m_passStart = nowMs();
+    }
+
+    m_inPass = true;
+}
+
+void GpuProfiler::endPass()
+{
+    if (!m_inPass) {
+        return;
+    }
+
+    Frame& frame = m_frames[m_current];
+
+    if (m_timerQueries) {
+        glExtensions().EndQueryEXT(GL_TIME_ELAPSED_EXT);
+    } else {
+        glFinish();
+        frame.m_ms[frame.m_count] = nowMs() - m_passStart;
+    }
+
+    frame.m_count++;
+    m_inPass = false;
+}
+
+void GpuProfiler::endFrame()
+{
+    if (!m_inFrame) {
+        return;
+    }
+
+    endPass();
+    m_inFrame = false;
+
+    Frame& frame = m_frames[m_current];
+    if (frame.m_count == 0) {
+        return;
+    }
+
+    if (m_timerQueries) {
+        frame.m_pending = true;
+    } else {
+        publish(frame);
+    }
+}
+
+void GpuProfiler::collect()
+{
+    if (!m_timerQueries) {
+        return;
+    }
+
+    GlExtensions const& ext = glExtensions();
+
+    // Oldest frame first. Queries complete in submission order, so the
+    // first frame that isn't ready means none of the later ones are.
+    for (int i = 1; i <= FRAMES_IN_FLIGHT; i++) {
+        Frame& frame = m_frames[(m_current + i) % FRAMES_IN_FLIGHT];
+
+        if (!frame.m_pending) {
+            continue;
+        }
+
+        GLuint available = 0;
+        ext.GetQueryObjectuivEXT(frame.m_queries[frame.m_count - 1],
+                                 GL_QUERY_RESULT_AVAILABLE_EXT, &available);
+        if (!available) {
+            break;
+        }
+
+        double total = 0;
+        for (int p = 0; p < frame.m_count; p++) {
+            GLuint64 ns = 0;
+            ext.GetQueryObjectui64vEXT(frame.m_queries[p],
+                                       GL_QUERY_RESULT_EXT, &ns);
+            frame.m_ms[p] = ns / 1000000.0;
+            total += frame.m_ms[p];
+        }
+
+        // A disjoint event invalidates whatever was in flight when it
+        // happened, and there's no telling which queries those were
+        GLint disjoint = 0;
+        glGetIntegerv(GL_GPU_DISJOINT_EXT, &disjoint);
+        if (disjoint) {
+            dropPending();
+            return;
+        }
+
+        frame.m_pending = false;
+
+        // The GPU can't have spent longer on the frame than has passed
+        // since it was submitted. Mesa's llvmpipe, for one, reports a
+        // time since boot for the first query a context ever runs.
+        if (total > nowMs() - frame.m_submitted) {
+            m_dropped++;
+            continue;
+        }
+
+        publish(frame);
+    }
+}
+
+void GpuProfiler::dropPending()
+{
+    for (int i = 0; i < FRAMES_IN_FLIGHT; i++) {
+        if (m_frames[i].m_pending) {
+            m_frames[i].m_pending = false;
+            m_dropped++;
+        }
+    }
+}
+
+void GpuProfiler::publish(Frame const& frame)
+{
+    double total = 0;
+
+    for (int p = 0; p < frame.m_count; p++) {
+        total += frame.m_ms[p];
+
+        int t = 0;
+        while (t < m_totalCount && strcmp(m_totals[t].m_name, frame.m_names[p]) != 0) {
+            t++;
+        }
+
+        if (t == m_totalCount) {
+            if (m_totalCount == MAX_PASSES) {
+                continue;
+            }
+            m_totals[t].m_name = frame.m_names[p];
+            m_totalCount++;
+        }
+
+        m_totals[t].m_ms += frame.m_ms[p];
+        m_totals[t].m_frames++;
+    }
+
+    m_resolved++;
+    m_stats.recordGpuTime(frame.m_serial, total);
+}
+
+void GpuProfiler::printSummary(FILE* stream) const
+{
+    fprintf(stream, "GPU time per pass (%s), %u frames, %u dropped:\n",
+            m_timerQueries ? "timer queries" : "glFinish",
+            m_resolved, m_dropped);
+
+    for (int t = 0; t < m_totalCount; t++) {
+        fprintf(stream, "  %-16s %8.3f ms\n", m_totals[t].m_name,
+                m_totals[t].m_ms / m_totals[t].m_frames);
+    }
+}
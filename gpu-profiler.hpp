@@ -0,0 +1,90 @@
+#ifndef __GPU_PROFILER_HPP__
+#define __GPU_PROFILER_HPP__
+
+#include <GLES2/gl2.h>
+#include <stdint.h>
+#include <stdio.h>
+
+class FrameStats;
+
+// Measures how long the GPU spends on named passes of each frame.
+//
+// With GL_EXT_disjoint_timer_query every pass is wrapped in a
+// GL_TIME_ELAPSED_EXT query. Queries come from a pool FRAMES_IN_FLIGHT
+// frames deep and are only read back once their result is available, so
+// profiling never stalls the pipeline; results arrive a few frames late.
+// A GL_GPU_DISJOINT_EXT event (frequency change, context loss...) throws
+// away every result that was still in flight.
+//
+// Without the extension, passes are bracketed with glFinish() and timed
+// on the CPU. That measures GPU execution too, but it serializes the CPU
+// with the GPU and so lowers the frame rate being measured.
+//
+// Passes are contiguous and don't nest: beginPass() ends the pass before
+// it. Per-frame totals go to the FrameStats given at construction.
+class GpuProfiler
+{
+public:
+    static const int MAX_PASSES = 8;
+    static const int FRAMES_IN_FLIGHT = 4;
+
+    GpuProfiler(FrameStats& stats);
+    ~GpuProfiler();
+
+    void setupGl();
+    void teardownGl();
+
+    bool isSetUp() const            { return m_setUp; }
+    bool hasTimerQueries() const    { return m_timerQueries; }
+
+    // No-ops until setupGl() has been called
+    void beginFrame();
+    void beginPass(char const* name);
+    void endPass();
+    void endFrame();
+
+    // Per-pass averages over every frame that produced results
+    void printSummary(FILE* stream) const;
+
+private:
+    struct Frame
+    {
+        GLuint m_queries[MAX_PASSES];
+        char const* m_names[MAX_PASSES];
+        double m_ms[MAX_PASSES];
+        int m_count;
+        uint32_t m_serial;
+        double m_submitted;
+        bool m_pending;
+    };
+
+    struct Total
+    {
+        char const* m_name;
+        double m_ms;
+        uint32_t m_frames;
+    };
+
+    void collect();
+    void dropPending();
+    void publish(Frame const& frame);
+
+    static double nowMs();
+
+    FrameStats& m_stats;
+    bool m_setUp;
+    bool m_timerQueries;
+
+    Frame m_frames[FRAMES_IN_FLIGHT];
+    int m_current;
+    bool m_inFrame;
+    bool m_inPass;
+    double m_passStart;
+
+    Total m_totals[MAX_PASSES];
+    int m_totalCount;
+    uint32_t m_resolved;
+    uint32_t m_dropped;
+};
+
+#endif
@@ -0,0 +1,393 @@
+#include <GLES2/gl2.h>
+#include <GLES2/gl2ext.h>
+
+#include <map>
+#include <vector>
+
+#include "gpu-resources.hpp"
+
+// Mipmap levels kept track of per texture face: enough for 32768 texels
+// across
+static const int MAX_LEVELS = 16;
+static const int MAX_FACES = 6;
+
+struct GpuResource
+{
+    char const* m_tag;
+    size_t m_bytes;
+
+    // Textures: the bytes of each level of each face, face by face, so
+    // that specifying a level again replaces what it had. Empty until
+    // the first texImage2D().
+    std::vector<size_t> m_levelBytes;
+};
+
+typedef std::map<GLuint, GpuResource> GpuResourceMap;
+
+struct GpuRegistry
+{
+    GpuRegistry()
+        : m_totalBytes(0)
+        , m_peakBytes(0)
+    {
+        for (int i = 0; i < GpuResources::KIND_COUNT; i++) {
+            m_bytes[i] = 0;
+        }
+    }
+
+    GpuResourceMap m_resources[GpuResources::KIND_COUNT];
+    size_t m_bytes[GpuResources::KIND_COUNT];
+    size_t m_totalBytes;
+    size_t m_peakBytes;
+};
+
+// Constructed on first use, so that objects made during static
+// initialization (there shouldn't be any) still get counted
+static GpuRegistry& registry()
+{
+    static GpuRegistry s_registry;
+    return s_registry;
+}
+
+static void remove(GpuResources::Kind kind, GLuint name)
+{
+    GpuRegistry& r = registry();
+    GpuResourceMap::iterator it = r.m_resources[kind].find(name);
+
+    if (it != r.m_resources[kind].end()) {
+        r.m_bytes[kind] -= it->second.m_bytes;
+        r.m_totalBytes -= it->second.m_bytes;
+        r.m_resources[kind].erase(it);
+    }
+}
+
+static void add(GpuResources::Kind kind, GLuint name, char const* tag)
+{
+    // GL only hands a name out again once it's been deleted, so an entry
+    // already here is for an object deleted behind the registry's back
+    remove(kind, name);
+
+    GpuResource resource;
+    resource.m_tag = tag;
+    resource.m_bytes = 0;
+
+    registry().m_resources[kind][name] = resource;
+}
+
+// NULL for objects the registry wasn't told about
+static GpuResource* find(GpuResources::Kind kind, GLuint name)
+{
+    GpuResourceMap& resources = registry().m_resources[kind];
+    GpuResourceMap::iterator it = resources.find(name);
+
+    return it == resources.end() ? NULL : &it->second;
+}
+
+static void resize(GpuResources::Kind kind, GpuResource* resource, size_t bytes)
+{
+    GpuRegistry& r = registry();
+
+    r.m_bytes[kind] += bytes - resource->m_bytes;
+    r.m_totalBytes += bytes - resource->m_bytes;
+    resource->m_bytes = bytes;
+
+    if (r.m_totalBytes > r.m_peakBytes) {
+        r.m_peakBytes = r.m_totalBytes;
+    }
+}
+
+GLuint GpuResources::createShader(GLenum type, char const* tag)
+{
+    GLuint shader = glCreateShader(type);
+    if (shader) {
+        add(SHADER, shader, tag);
+    }
+    return shader;
+}
+
+GLuint GpuResources::createProgram(char const* tag)
+{
+    GLuint program = glCreateProgram();
+    if (program) {
+        add(PROGRAM, program, tag);
+    }
+    return program;
+}
+
+GLuint GpuResources::createBuffer(char const* tag)
+{
+    GLuint buffer;
+    glGenBuffers(1, &buffer);
+    add(BUFFER, buffer, tag);
+    return buffer;
+}
+
+GLuint GpuResources::createTexture(char const* tag)
+{
+    GLuint texture;
+    glGenTextures(1, &texture);
+    add(TEXTURE, texture, tag);
+    return texture;
+}
+
+GLuint GpuResources::createFramebuffer(char const* tag)
+{
+    GLuint framebuffer;
+    glGenFramebuffers(1, &framebuffer);
+    add(FRAMEBUFFER, framebuffer, tag);
+    return framebuffer;
+}
+
+GLuint GpuResources::createRenderbuffer(char const* tag)
+{
+    GLuint renderbuffer;
+    glGenRenderbuffers(1, &renderbuffer);
+    add(RENDERBUFFER, renderbuffer, tag);
+    return renderbuffer;
+}
+
+void GpuResources::deleteShader(GLuint shader)
+{
+    if (shader) {
+        glDeleteShader(shader);
+        remove(SHADER, shader);
+    }
+}
+
+void GpuResources::deleteProgram(GLuint program)
+{
+    if (program) {
+        glDeleteProgram(program);
+        remove(PROGRAM, program);
+    }
+}
+
+void GpuResources::deleteBuffer(GLuint buffer)
+{
+    if (buffer) {
+        glDeleteBuffers(1, &buffer);
+        remove(BUFFER, buffer);
+    }
+}
+
+void GpuResources::deleteTexture(GLuint texture)
+{
+    if (texture) {
+        glDeleteTextures(1, &texture);
+        remove(TEXTURE, texture);
+    }
+}
+
+void GpuResources::deleteFramebuffer(GLuint framebuffer)
+{
+    if (framebuffer) {
+        glDeleteFramebuffers(1, &framebuffer);
+        remove(FRAMEBUFFER, framebuffer);
+    }
+}
+
+void GpuResources::deleteRenderbuffer(GLuint renderbuffer)
+{
+    if (renderbuffer) {
+        glDeleteRenderbuffers(1, &renderbuffer);
+        remove(RENDERBUFFER, renderbuffer);
+    }
+}
+
+void GpuResources::bufferData(GLuint buffer, GLenum target, GLsizeiptr size,
+                              void const* data, GLenum usage)
+{
+    glBufferData(target, size, data, usage);
+
+    if (GpuResource* resource = find(BUFFER, buffer)) {
+        resize(BUFFER, resource, size);
+    }
+}
+
+static int faceIndex(GLenum target)
+{
+    return target == GL_TEXTURE_2D ? 0 : target - GL_TEXTURE_CUBE_MAP_POSITIVE_X;
+}
+
+// The texture's size is the sum of its levels
+static void recount(GpuResource* resource)
+{
+    size_t total = 0;
+    for (size_t i = 0; i < resource->m_levelBytes.size(); i++) {
+        total += resource->m_levelBytes[i];
+    }
+    resize(GpuResources::TEXTURE, resource, total);
+}
+
+void GpuResources::texImage2D(GLuint texture, GLenum target, GLint level, GLenum format,
+                              GLsizei width, GLsizei height, GLenum type, void const* pixels)
+{
+    glTexImage2D(target, level, format, width, height, 0, format, type, pixels);
+
+    GpuResource* resource = find(TEXTURE, texture);
+    int face = faceIndex(target);
+    if (!resource || level < 0 || level >= MAX_LEVELS || face < 0 || face >= MAX_FACES) {
+        return;
+    }
+
+    if (resource->m_levelBytes.empty()) {
+        resource->m_levelBytes.resize(MAX_FACES * MAX_LEVELS);
+    }
+    resource->m_levelBytes[face * MAX_LEVELS + level] =
+        width * height * bytesPerPixel(format, type);
+    recount(resource);
+}
+
+void GpuResources::generateMipmap(GLuint texture, GLenum target)
+{
+    glGenerateMipmap(target);
+
+    GpuResource* resource = find(TEXTURE, texture);
+    if (!resource || resource->m_levelBytes.empty()) {
+        return;
+    }
+
+    // Replaces every level below the base of each face, a quarter the
+    // size of the one above, so doing it again changes nothing
+    for (int face = 0; face < MAX_FACES; face++) {
+        size_t* levels = &resource->m_levelBytes[face * MAX_LEVELS];
+
+        for (int level = 1; level < MAX_LEVELS; level++) {
+            levels[level] = levels[level - 1] / 4;
+        }
+    }
+    recount(resource);
+}
+
+void GpuResources::renderbufferStorage(GLuint renderbuffer, GLenum format,
+                                       GLsizei width, GLsizei height)
+{
+    glRenderbufferStorage(GL_RENDERBUFFER, format, width, height);
+
+    GpuResource* resource = find(RENDERBUFFER, renderbuffer);
+    if (!resource) {
+        return;
+    }
+
+    size_t bytesPerPixel;
+    switch (format) {
+        case GL_DEPTH_COMPONENT16:
+        case GL_RGBA4:
+        case GL_RGB5_A1:
+        case GL_RGB565:
+            bytesPerPixel = 2;
+            break;
+
+        case GL_STENCIL_INDEX8:
+            bytesPerPixel = 1;
+            break;
+
+        default:
+            // 24-bit depth, packed depth-stencil and 8-bit color
+            bytesPerPixel = 4;
+            break;
+    }
+
+    resize(RENDERBUFFER, resource, width * height * bytesPerPixel);
+}
+
+size_t GpuResources::count(Kind kind)
+{
+    return registry().m_resources[kind].size();
+}
+
+size_t GpuResources::bytes(Kind kind)
+{
+    return registry().m_bytes[kind];
+}
+
+size_t GpuResources::totalCount()
+{
+    size_t total = 0;
+    for (int i = 0; i < KIND_COUNT; i++) {
+        total += count(Kind(i));
+    }
+    return total;
+}
+
+size_t GpuResources::totalBytes()
+{
+    return registry().m_totalBytes;
+}
+
+size_t GpuResources::peakBytes()
+{
+    return registry().m_peakBytes;
+}
+
+void GpuResources::printSummary(FILE* stream)
+{
+    fprintf(stream, "GPU resources: %zu live, %.1f MB (peak %.1f MB)\n",
+            totalCount(), totalBytes() / 1048576.0, peakBytes() / 1048576.0);
+
+    for (int i = 0; i < KIND_COUNT; i++) {
+        if (count(Kind(i)) > 0) {
+            fprintf(stream, "  %-13s %5zu  %8.1f KB\n", kindName(Kind(i)),
+                    count(Kind(i)), bytes(Kind(i)) / 1024.0);
+        }
+    }
+}
+
+size_t GpuResources::reportLeaks(FILE* stream)
+{
+    size_t leaks = totalCount();
+    if (leaks == 0) {
+        return 0;
+    }
+
+    fprintf(stream, "%zu GL object%s never deleted (%.1f KB):\n",
+            leaks, leaks == 1 ? "" : "s", totalBytes() / 1024.0);
+
+    for (int i = 0; i < KIND_COUNT; i++) {
+        GpuResourceMap const& resources = registry().m_resources[i];
+
+        for (GpuResourceMap::const_iterator it = resources.begin(); it != resources.end(); ++it) {
+            fprintf(stream, "  %s %u \"%s\", %zu bytes\n", kindName(Kind(i)),
+                    it->first, it->second.m_tag, it->second.m_bytes);
+        }
+    }
+
+    return leaks;
+}
+
+char const* GpuResources::kindName(Kind kind)
+{
+    switch (kind) {
+        case SHADER:        return "shader";
+        case PROGRAM:       return "program";
+        case BUFFER:        return "buffer";
+        case TEXTURE:       return "texture";
+        case FRAMEBUFFER:   return "framebuffer";
+        case RENDERBUFFER:  return "renderbuffer";
+        default:            return "?";
+    }
+}
+
+size_t GpuResources::bytesPerPixel(GLenum format, GLenum type)
+{
+    switch (type) {
+        case GL_UNSIGNED_SHORT_5_6_5:
+        case GL_UNSIGNED_SHORT_4_4_4_4:
+        case GL_UNSIGNED_SHORT_5_5_5_1:
+            return 2;
+    }
+
+    size_t channels;
+    switch (format) {
+        case GL_ALPHA:
+        case GL_LUMINANCE:          channels = 1; break;
+        case GL_LUMINANCE_ALPHA:    channels = 2; break;
+        default:                    channels = 4; break;
+    }
+
+    switch (type) {
+        case GL_HALF_FLOAT_OES:     return channels * 2;
+        case GL_FLOAT:              return channels * 4;
+        default:                    return channels;
+    }
+}
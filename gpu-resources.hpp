@@ -0,0 +1,90 @@
+#ifndef __GPU_RESOURCES_HPP__
+#define __GPU_RESOURCES_HPP__
+
+#include <GLES2/gl2.h>
+#include <stddef.h>
+#include <stdio.h>
+
+// Accounting for GL objects. Creating and deleting objects through here
+// instead of through GL directly keeps a registry of every live object,
+// with a tag saying what it's for and an estimate of the memory behind
+// it, so that
+//
+//     GLuint buffer = GpuResources::createBuffer("terrain vertices");
+//     glBindBuffer(GL_ARRAY_BUFFER, buffer);
+//     GpuResources::bufferData(buffer, GL_ARRAY_BUFFER, size, data, GL_STATIC_DRAW);
+//     ...
+//     GpuResources::deleteBuffer(buffer);
+//
+// shows up in the totals while it's alive and in the leak report if it's
+// never deleted. Sizes are what the driver most likely keeps, not what
+// it actually does: GL has no way of asking.
+//
+// Objects are per context, and every window shares the display's one
+// context, so there is one registry per process. Only the GL thread may
+// use it.
+class GpuResources
+{
+public:
+    enum Kind
+    {
+        SHADER,
+        PROGRAM,
+        BUFFER,
+        TEXTURE,
+        FRAMEBUFFER,
+        RENDERBUFFER,
+        KIND_COUNT,
+    };
+
+    // 'tag' must be a string literal, or otherwise outlive the object
+    static GLuint createShader(GLenum type, char const* tag);
+    static GLuint createProgram(char const* tag);
+    static GLuint createBuffer(char const* tag);
+    static GLuint createTexture(char const* tag);
+    static GLuint createFramebuffer(char const* tag);
+    static GLuint createRenderbuffer(char const* tag);
+
+    // Like their GL counterparts, these ignore 0. Objects created behind
+    // the registry's back are deleted without complaint.
+    static void deleteShader(GLuint shader);
+    static void deleteProgram(GLuint program);
+    static void deleteBuffer(GLuint buffer);
+    static void deleteTexture(GLuint texture);
+    static void deleteFramebuffer(GLuint framebuffer);
+    static void deleteRenderbuffer(GLuint renderbuffer);
+
+    // Storage. Each calls GL and records the size against the object,
+    // which must be the one bound to 'target'. Specifying a buffer or a
+    // texture level again replaces its size rather than adding to it.
+    static void bufferData(GLuint buffer, GLenum target, GLsizeiptr size,
+                           void const* data, GLenum usage);
+    static void texImage2D(GLuint texture, GLenum target, GLint level, GLenum format,
+                           GLsizei width, GLsizei height, GLenum type, void const* pixels);
+    static void generateMipmap(GLuint texture, GLenum target);
+    static void renderbufferStorage(GLuint renderbuffer, GLenum format,
+                                    GLsizei width, GLsizei height);
+
+    // Live objects and their estimated bytes, per kind and overall
+    static size_t count(Kind kind);
+    static size_t bytes(Kind kind);
+    static size_t totalCount();
+    static size_t totalBytes();
+
+    // Most estimated bytes alive at once
+    static size_t peakBytes();
+
+    // Live totals per kind
+    static void printSummary(FILE* stream);
+
+    // One line per object still alive, with its tag; returns how many
+    static size_t reportLeaks(FILE* stream);
+
+    static char const* kindName(Kind kind);
+
+    // What the driver most likely keeps per pixel. Three-channel formats
+    // are generally padded out to four.
+    static size_t bytesPerPixel(GLenum format, GLenum type);
+};
+
+#endif
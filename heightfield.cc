@@ -0,0 +1,80 @@
+#include <cmath>
+#include <cstdio>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "heightfield.hpp"
+
+Heightfield::Heightfield()
+    : m_data(NULL)
+    , m_bytes(0)
+    , m_width(0)
+    , m_height(0)
+{
+}
+
+Heightfield::~Heightfield()
+{
+    close();
+}
+
+bool Heightfield::open(char const* path, int width, int height)
+{
+    close();
+
+    int fd = ::open(path, O_RDONLY);
+    if (fd < 0) {
+        perror(path);
+        return false;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) < 0) {
+        perror(path);
+        ::close(fd);
+        return false;
+    }
+
+    size_t samples = st.st_size / 2;
+    if (width == 0 && height == 0) {
+        width = height = (int)sqrt((double)samples);
+    }
+
+    if (width <= 0 || height <= 0 || (size_t)width * height * 2 != (size_t)st.st_size) {
+        fprintf(stderr, "%s: %lld bytes isn't %dx%d 16-bit samples\n",
+                path, (long long)st.st_size, width, height);
+        ::close(fd);
+        return false;
+    }
+
+    void* data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+
+    if (data == MAP_FAILED) {
+        perror(path);
+        return false;
+    }
+
+    // Chunks read small patches scattered all over the file, so
+    // readahead would mostly fetch what nobody asked for
+    madvise(data, st.st_size, MADV_RANDOM);
+
+    m_data = static_cast<uint8_t const*>(data);
+    m_bytes = st.st_size;
+    m_width = width;
+    m_height = height;
+    return true;
+}
+
+void Heightfield::close()
+{
+    if (m_data) {
+        munmap(const_cast<uint8_t*>(m_data), m_bytes);
+    }
+
+    m_data = NULL;
+    m_bytes = 0;
+    m_width = m_height = 0;
+}
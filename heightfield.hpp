@@ -0,0 +1,47 @@
+#ifndef __HEIGHTFIELD_HPP__
+#define __HEIGHTFIELD_HPP__
+
+#include <stddef.h>
+#include <stdint.h>
+
+// A grid of 16-bit heights read straight out of a memory-mapped file:
+// raw little-endian samples, row after row, no header (the format
+// heightgen writes, and most terrain tools can export). Nothing is read
+// up front, so files far bigger than RAM are fine; the kernel pages in
+// whatever sample() touches and drops it again under memory pressure.
+//
+// Any number of threads can sample at once.
+class Heightfield
+{
+public:
+    Heightfield();
+    ~Heightfield();
+
+    // 'width' by 'height' samples; with 0 for both, the file is taken to
+    // be square. Prints why on stderr and returns false if the file
+    // can't be mapped or is the wrong size.
+    bool open(char const* path, int width = 0, int height = 0);
+    void close();
+
+    int width() const           { return m_width; }
+    int height() const          { return m_height; }
+    size_t bytes() const        { return m_bytes; }
+
+    // Coordinates outside the grid are clamped to its edges
+    uint16_t sample(int x, int y) const
+    {
+        x = x < 0 ? 0 : x >= m_width ? m_width - 1 : x;
+        y = y < 0 ? 0 : y >= m_height ? m_height - 1 : y;
+
+        uint8_t const* p = m_data + ((size_t)y * m_width + x) * 2;
+        return p[0] | p[1] << 8;
+    }
+
+private:
+    uint8_t const* m_data;
+    size_t m_bytes;
+    int m_width;
+    int m_height;
+};
+
+#endif
@@ -0,0 +1,155 @@
+#include <cmath>
+#include <cstdio>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <vector>
+
+#include "job-system.hpp"
+
+// Writes a synthetic heightfield for terrain to stream from: SIZE by
+// SIZE 16-bit little-endian heights, row after row, with ridged
+// mountains over rolling hills. Sizes of a power of two plus one fit
+// terrain's chunks exactly; the default of 32769 makes a 2 GB file.
+//
+// Rows are generated in blocks, in parallel over one thread per CPU, and
+// written out as each block is done, so memory use stays small however
+// big the file.
+//
+// Usage: heightgen FILE [SIZE]
+
+// Rows generated between writes
+static const int BLOCK_ROWS = 256;
+
+// The widest features are this many samples across, and each octave
+// after halves that, down to a couple of samples
+static const int BASE_PERIOD = 4096;
+static const int OCTAVES = 12;
+
+struct Block
+{
+    int m_size;
+    int m_firstRow;
+    std::vector<uint16_t> m_samples;
+};
+
+static float hash(int x, int y, int octave)
+{
+    uint32_t h = x * 374761393u + y * 668265263u + octave * 2246822519u;
+    h = (h ^ (h >> 13)) * 1274126177u;
+    h ^= h >> 16;
+    return (h & 0xffffff) / float(0x1000000);
+}
+
+static float smooth(float t)
+{
+    return t * t * (3 - 2 * t);
+}
+
+// Smoothly interpolated random values on a unit lattice
+static float valueNoise(float x, float y, int octave)
+{
+    int ix = (int)floorf(x);
+    int iy = (int)floorf(y);
+    float fx = smooth(x - ix);
+    float fy = smooth(y - iy);
+
+    float a = hash(ix, iy, octave);
+    float b = hash(ix + 1, iy, octave);
+    float c = hash(ix, iy + 1, octave);
+    float d = hash(ix + 1, iy + 1, octave);
+
+    return a + (b - a) * fx + (c - a) * fy + (a - b - c + d) * fx * fy;
+}
+
+// 0..1
+static float terrainHeight(int x, int y)
+{
+    float height = 0;
+    float amplitude = 1;
+    float total = 0;
+    float period = BASE_PERIOD;
+
+    for (int octave = 0; octave < OCTAVES; octave++) {
+        float n = valueNoise(x / period, y / period, octave);
+
+        // Ridges in the big octaves, plain noise in the detail
+        if (octave < 4) {
+            n = 1 - fabsf(2 * n - 1);
+            n *= n;
+        }
+
+        height += amplitude * n;
+        total += amplitude;
+        amplitude *= 0.5f;
+        period /= 2;
+    }
+
+    return height / total;
+}
+
+static void generateRows(void* data, size_t begin, size_t end)
+{
+    Block* block = static_cast<Block*>(data);
+
+    for (size_t row = begin; row < end; row++) {
+        int y = block->m_firstRow + row;
+        uint16_t* out = &block->m_samples[row * block->m_size];
+
+        for (int x = 0; x < block->m_size; x++) {
+            float h = terrainHeight(x, y);
+            out[x] = (uint16_t)(h * 65535);
+        }
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    int size = argc > 2 ? atoi(argv[2]) : 32769;
+
+    if (argc < 2 || argc > 3 || size <= 1) {
+        fprintf(stderr, "Usage: %s FILE [SIZE]\n", argv[0]);
+        exit(EXIT_FAILURE);
+    }
+
+    FILE* f = fopen(argv[1], "wb");
+    if (!f) {
+        perror(argv[1]);
+        exit(EXIT_FAILURE);
+    }
+
+    JobSystem jobs(sysconf(_SC_NPROCESSORS_ONLN));
+
+    Block block;
+    block.m_size = size;
+    block.m_samples.resize((size_t)BLOCK_ROWS * size);
+
+    printf("Writing %dx%d heights, %.1f MB, to %s\n", size, size,
+           (double)size * size * 2 / 1048576, argv[1]);
+
+    for (int row = 0; row < size; row += BLOCK_ROWS) {
+        int rows = row + BLOCK_ROWS <= size ? BLOCK_ROWS : size - row;
+        block.m_firstRow = row;
+
+        JobCounter generated;
+        jobs.parallelFor(generateRows, &block, rows, 1, generated);
+        jobs.wait(generated);
+
+        // The file is little-endian, like everything this runs on
+        if (fwrite(&block.m_samples[0], 2, (size_t)rows * size, f) != (size_t)rows * size) {
+            perror(argv[1]);
+            exit(EXIT_FAILURE);
+        }
+
+        printf("\r%d%%", (int)(100.0 * (row + rows) / size));
+        fflush(stdout);
+    }
+
+    printf("\n");
+
+    if (fclose(f) != 0) {
+        perror(argv[1]);
+        exit(EXIT_FAILURE);
+    }
+    return EXIT_SUCCESS;
+}
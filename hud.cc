@@ -0,0 +1,345 @@
+#include <assert.h>
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+
+#include "frame-stats.hpp"
+#include "gpu-resources.hpp"
+#include "hud.hpp"
+#include "shader.hpp"
+
+#define N_ELEMENTS(_a) (sizeof(_a) / sizeof(_a[0]))
+
+// Largest number of quads (glyphs, bars, backgrounds) in one frame
+static const int MAX_QUADS = 256;
+
+// Atlas geometry. Glyphs are 3x5 texels in 4x6 cells (one texel of
+// padding right and below), 16 cells per row. The cell right after the
+// last glyph is filled solid and is used for untextured quads.
+static const int ATLAS_WIDTH = 64;
+static const int ATLAS_HEIGHT = 32;
+static const int CELL_WIDTH = 4;
+static const int CELL_HEIGHT = 6;
+static const int GLYPH_WIDTH = 3;
+static const int GLYPH_HEIGHT = 5;
+static const int CELLS_PER_ROW = ATLAS_WIDTH / CELL_WIDTH;
+
+// On-screen glyph scale, in pixels per atlas texel
+static const int SCALE = 2;
+static const int ADVANCE = (GLYPH_WIDTH + 1) * SCALE;
+static const int LINE_HEIGHT = (GLYPH_HEIGHT + 2) * SCALE;
+
+// 3x5 bitmap font covering ' ' through '_'. Each glyph is five octal
+// digits, one per row from the top; within a row the high bit is the
+// leftmost pixel. Lowercase text is drawn with the uppercase glyphs.
+static const unsigned int s_font[] = {
+    000000, 022202, 055000, 057575, 036236, 051245, 025253, 022000, //  !"#$%&'
+    012221, 042224, 005250, 002720, 000024, 000700, 000002, 011244, // ()*+,-./
+    075557, 026227, 071747, 071717, 055711, 074717, 074757, 071111, // 01234567
+    075757, 075717, 002020, 002024, 012421, 007070, 042124, 071202, // 89:;<=>?
+    025743, 025755, 065656, 034443, 065556, 074647, 074644, 034553, // @ABCDEFG
+    055755, 072227, 011152, 055655, 044447, 057755, 065555, 025552, // HIJKLMNO
+    065644, 025563, 065655, 034216, 072222, 055557, 055552, 055775, // PQRSTUVW
+    055255, 055222, 071247, 032223, 044211, 062226, 025000, 000007, // XYZ[\]^_
+};
+
+static const char FIRST_GLYPH = ' ';
+static const int SOLID_CELL = N_ELEMENTS(s_font);
+
+static const char* vert_shader_text =
+    "uniform vec2 u_viewport;\n"
+    "attribute vec2 a_pos;\n"
+    "attribute vec2 a_uv;\n"
+    "attribute vec4 a_color;\n"
+    "varying vec2 v_uv;\n"
+    "varying vec4 v_color;\n"
+    "void main() {\n"
+    "  gl_Position = vec4(a_pos.x / u_viewport.x * 2.0 - 1.0,\n"
+    "                     1.0 - a_pos.y / u_viewport.y * 2.0, 0, 1);\n"
+    "  v_uv = a_uv;\n"
+    "  v_color = a_color;\n"
+    "}\n";
+
+static const char* frag_shader_text =
+    "precision mediump float;\n"
+    "uniform sampler2D u_atlas;\n"
+    "varying vec2 v_uv;\n"
+    "varying vec4 v_color;\n"
+    "void main() {\n"
+    "  gl_FragColor = vec4(v_color.rgb, v_color.a * texture2D(u_atlas, v_uv).a);\n"
+    "}\n";
+
+static char const* const s_attribs[] = { "a_pos", "a_uv", "a_color", NULL };
+
+Hud::Hud()
+    : m_program(0)
+    , m_texture(0)
+    , m_indexBuffer(0)
+    , m_uViewport(-1)
+    , m_uAtlas(-1)
+    , m_vertexStream(GL_ARRAY_BUFFER, MAX_QUADS * 4 * sizeof(Vertex))
+{
+}
+
+Hud::~Hud()
+{
+    assert(!isSetUp());
+}
+
+void Hud::setupGl()
+{
+    GLuint vert = compileShader(vert_shader_text, GL_VERTEX_SHADER, "hud");
+    GLuint frag = compileShader(frag_shader_text, GL_FRAGMENT_SHADER, "hud");
+    m_program = linkProgram(vert, frag, s_attribs, "hud");
+
+    // The program keeps the compiled code alive
+    GpuResources::deleteShader(vert);
+    GpuResources::deleteShader(frag);
+
+    m_uViewport = glGetUniformLocation(m_program, "u_viewport");
+    m_uAtlas = glGetUniformLocation(m_program, "u_atlas");
+
+    // Bake the atlas
+    GLubyte texels[ATLAS_WIDTH * ATLAS_HEIGHT];
+    memset(texels, 0, sizeof(texels));
+
+    for (int i = 0; i <= SOLID_CELL; i++) {
+        int cx = (i % CELLS_PER_ROW) * CELL_WIDTH;
+        int cy = (i / CELLS_PER_ROW) * CELL_HEIGHT;
+
+        for (int y = 0; y < CELL_HEIGHT; y++) {
+            for (int x = 0; x < CELL_WIDTH; x++) {
+                bool set;
+
+                if (i == SOLID_CELL) {
+                    set = true;
+                }
+                else if (x < GLYPH_WIDTH && y < GLYPH_HEIGHT) {
+                    unsigned int row = s_font[i] >> (3 * (GLYPH_HEIGHT - 1 - y));
+                    set = (row >> (GLYPH_WIDTH - 1 - x)) & 1;
+                }
+                else {
+                    set = false;
+                }
+
+                texels[(cy + y) * ATLAS_WIDTH + cx + x] = set ? 0xff : 0;
+            }
+        }
+    }
+
+    m_texture = GpuResources::createTexture("hud glyphs");
+    glBindTexture(GL_TEXTURE_2D, m_texture);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    GpuResources::texImage2D(m_texture, GL_TEXTURE_2D, 0, GL_ALPHA, ATLAS_WIDTH, ATLAS_HEIGHT,
+                             GL_UNSIGNED_BYTE, texels);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    // Quads are always drawn as two triangles over four consecutive
+    // vertices, so the index buffer never changes.
+    GLushort indices[MAX_QUADS * 6];
+    for (int i = 0; i < MAX_QUADS; i++) {
+        indices[i * 6 + 0] = i * 4 + 0;
+        indices[i * 6 + 1] = i * 4 + 1;
+        indices[i * 6 + 2] = i * 4 + 2;
+        indices[i * 6 + 3] = i * 4 + 2;
+        indices[i * 6 + 4] = i * 4 + 1;
+        indices[i * 6 + 5] = i * 4 + 3;
+    }
+
+    m_indexBuffer = GpuResources::createBuffer("hud indices");
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_indexBuffer);
+    GpuResources::bufferData(m_indexBuffer, GL_ELEMENT_ARRAY_BUFFER, sizeof(indices), indices,
+                             GL_STATIC_DRAW);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+
+    m_vertexStream.setupGl();
+
+    m_vertices.reserve(MAX_QUADS * 4);
+}
+
+void Hud::teardownGl()
+{
+    m_vertexStream.teardownGl();
+    GpuResources::deleteBuffer(m_indexBuffer);
+    GpuResources::deleteTexture(m_texture);
+    GpuResources::deleteProgram(m_program);
+
+    m_indexBuffer = m_texture = m_program = 0;
+}
+
+void Hud::addQuad(float x0, float y0, float x1, float y1,
+                  float u0, float v0, float u1, float v1,
+                  uint32_t rgba)
+{
+    if (m_vertices.size() + 4 > MAX_QUADS * 4) {
+        return;
+    }
+
+    Vertex v;
+    v.r = rgba >> 24;
+    v.g = rgba >> 16;
+    v.b = rgba >> 8;
+    v.a = rgba;
+
+    v.x = x0; v.y = y0; v.u = u0; v.v = v0; m_vertices.push_back(v);
+    v.x = x1; v.y = y0; v.u = u1; v.v = v0; m_vertices.push_back(v);
+    v.x = x0; v.y = y1; v.u = u0; v.v = v1; m_vertices.push_back(v);
+    v.x = x1; v.y = y1; v.u = u1; v.v = v1; m_vertices.push_back(v);
+}
+
+void Hud::addSolid(float x0, float y0, float x1, float y1, uint32_t rgba)
+{
+    // Sample the middle of the solid cell so filtering never reaches a
+    // neighbouring glyph
+    float u = ((SOLID_CELL % CELLS_PER_ROW) * CELL_WIDTH + 1.5f) / ATLAS_WIDTH;
+    float v = ((SOLID_CELL / CELLS_PER_ROW) * CELL_HEIGHT + 1.5f) / ATLAS_HEIGHT;
+
+    addQuad(x0, y0, x1, y1, u, v, u, v, rgba);
+}
+
+void Hud::addText(float x, float y, char const* text, uint32_t rgba)
+{
+    for (; *text; text++, x += ADVANCE) {
+        char c = *text;
+
+        if (c >= 'a' && c <= 'z') {
+            c = c - 'a' + 'A';
+        }
+
+        if (c <= FIRST_GLYPH || c >= FIRST_GLYPH + (int)N_ELEMENTS(s_font)) {
+            continue;
+        }
+
+        int i = c - FIRST_GLYPH;
+        float u0 = float((i % CELLS_PER_ROW) * CELL_WIDTH) / ATLAS_WIDTH;
+        float v0 = float((i / CELLS_PER_ROW) * CELL_HEIGHT) / ATLAS_HEIGHT;
+
+        addQuad(x, y, x + GLYPH_WIDTH * SCALE, y + GLYPH_HEIGHT * SCALE,
+                u0, v0,
+                u0 + float(GLYPH_WIDTH) / ATLAS_WIDTH,
+                v0 + float(GLYPH_HEIGHT) / ATLAS_HEIGHT,
+                rgba);
+    }
+}
+
+void Hud::draw(FrameStats const& stats, uint32_t width, uint32_t height)
+{
+    static const float margin = 8;
+    static const float barWidth = 2;
+    static const float barStride = 3;
+    static const float graphHeight = 40;
+    static const float graphMaxMs = 50;
+    static const float panelWidth = FrameStats::HISTORY * barStride + 2 * margin;
+    static const float panelHeight = 4 * LINE_HEIGHT + graphHeight + 3 * margin;
+
+    m_vertices.clear();
+
+    addSolid(margin, margin, margin + panelWidth, margin + panelHeight, 0x000000b0);
+
+    char line[64];
+    float x = 2 * margin;
+    float y = 2 * margin;
+
+    snprintf(line, sizeof(line), "FPS %.1f", stats.fps());
+    addText(x, y, line, 0xffffffff);
+    y += LINE_HEIGHT;
+
+    snprintf(line, sizeof(line), "FRAME %.1f CPU %.2f MS",
+             stats.frameIntervalMs(), stats.cpuTimeMs());
+    addText(x, y, line, 0xffffffff);
+    y += LINE_HEIGHT;
+
+    // Only there when a GpuProfiler feeds the stats; it lags the other
+    // numbers by a few frames
+    float gpuMs = stats.latestGpuTimeMs();
+    if (gpuMs >= 0) {
+        snprintf(line, sizeof(line), "GPU %.2f MS", gpuMs);
+    } else {
+        snprintf(line, sizeof(line), "GPU -");
+    }
+    addText(x, y, line, 0xffffffff);
+    y += LINE_HEIGHT;
+
+    snprintf(line, sizeof(line), "DRAWS %u TRIS %u",
+             stats.drawCalls(), stats.triangles());
+    addText(x, y, line, 0xffffffff);
+    y += LINE_HEIGHT;
+
+    // Frame-time graph, newest frame on the right, with a guide line at
+    // the 60Hz budget
+    float graphBottom = y + graphHeight;
+
+    for (int age = 0; age < FrameStats::HISTORY; age++) {
+        float ms = stats.frameIntervalMs(age);
+        float h = (ms > graphMaxMs ? graphMaxMs : ms) / graphMaxMs * graphHeight;
+        float bx = x + (FrameStats::HISTORY - 1 - age) * barStride;
+        uint32_t color = ms <= 17.5f ? 0x40e040ff
+                       : ms <= 34.0f ? 0xe0e040ff
+                       : 0xe04040ff;
+
+        if (h > 0) {
+            addSolid(bx, graphBottom - h, bx + barWidth, graphBottom, color);
+        }
+    }
+
+    float guide = graphBottom - 1000.0f / 60 / graphMaxMs * graphHeight;
+    addSolid(x, guide, x + FrameStats::HISTORY * barStride, guide + 1, 0xffffff60);
+
+    // Submit everything in one go
+    glViewport(0, 0, width, height);
+    glDisable(GL_DEPTH_TEST);
+    glEnable(GL_BLEND);
+    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+
+    glActiveTexture(GL_TEXTURE0);
+    glUseProgram(m_program);
+    glUniform2f(m_uViewport, width, height);
+    glUniform1i(m_uAtlas, 0);
+    glBindTexture(GL_TEXTURE_2D, m_texture);
+
+    // Never too big: addQuad() stops at MAX_QUADS
+    m_vertexStream.beginFrame();
+    StreamBuffer::Span span = m_vertexStream.allocate(m_vertices.size() * sizeof(Vertex));
+    if (!span.m_data) {
+        // The mapping failed; no overlay this frame
+        m_vertexStream.endFrame();
+        resetState();
+        return;
+    }
+    memcpy(span.m_data, &m_vertices[0], span.m_size);
+    m_vertexStream.flush();
+
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_indexBuffer);
+
+    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), span.pointer(offsetof(Vertex, x)));
+    glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), span.pointer(offsetof(Vertex, u)));
+    glVertexAttribPointer(2, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(Vertex), span.pointer(offsetof(Vertex, r)));
+    glEnableVertexAttribArray(0);
+    glEnableVertexAttribArray(1);
+    glEnableVertexAttribArray(2);
+
+    glDrawElements(GL_TRIANGLES, m_vertices.size() / 4 * 6, GL_UNSIGNED_SHORT, 0);
+    m_vertexStream.endFrame();
+
+    resetState();
+}
+
+void Hud::resetState()
+{
+    glDisableVertexAttribArray(0);
+    glDisableVertexAttribArray(1);
+    glDisableVertexAttribArray(2);
+
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    glUseProgram(0);
+
+    glBlendFunc(GL_ONE, GL_ZERO);
+    glDisable(GL_BLEND);
+}
@@ -0,0 +1,66 @@
+#ifndef __HUD_HPP__
+#define __HUD_HPP__
+
+#include <GLES2/gl2.h>
+#include <stdint.h>
+
+#include <vector>
+
+#include "stream-buffer.hpp"
+
+class FrameStats;
+
+// Performance overlay. All text and graph bars are written into one
+// streamed vertex buffer and submitted with a single draw call, sampling
+// glyphs out of a small atlas texture that is baked from a built-in 3x5
+// bitmap font when the HUD is first set up.
+class Hud
+{
+public:
+    Hud();
+    ~Hud();
+
+    void setupGl();
+    void teardownGl();
+
+    bool isSetUp() const { return m_program != 0; }
+
+    // Draws over whatever is in the current framebuffer. Nothing is read
+    // back from GL to be restored, since that would stall on exactly the
+    // frame being measured; instead it sets what it needs and leaves GL's
+    // defaults behind: no program, no array or element buffer, texture
+    // unit 0 active with no texture bound, attribute arrays 0-2
+    // disabled, blending off with glBlendFunc(GL_ONE, GL_ZERO), depth
+    // testing off, and the viewport covering the window. Demos set up
+    // whatever else they need each frame; ones that keep state from frame
+    // to frame, like glbench, can't be run with the overlay.
+    void draw(FrameStats const& stats, uint32_t width, uint32_t height);
+
+private:
+    struct Vertex
+    {
+        GLfloat x, y;
+        GLfloat u, v;
+        GLubyte r, g, b, a;
+    };
+
+    void addQuad(float x0, float y0, float x1, float y1,
+                 float u0, float v0, float u1, float v1,
+                 uint32_t rgba);
+    void addSolid(float x0, float y0, float x1, float y1, uint32_t rgba);
+    void addText(float x, float y, char const* text, uint32_t rgba);
+
+    // Back to the state draw() documents leaving behind
+    void resetState();
+
+    GLuint m_program;
+    GLuint m_texture;
+    GLuint m_indexBuffer;
+    GLint m_uViewport;
+    GLint m_uAtlas;
+    StreamBuffer m_vertexStream;
+
+    std::vector<Vertex> m_vertices;
+};
+
+#endif
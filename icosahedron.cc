@@ -1,4 +1,5 @@
 #include "base.hpp"
+#include "shader.hpp"
 
 #include <cstdio>
 #include <cstdlib>
@@ -12,7 +13,11 @@
 class IcosahedronWindow: public WaylandWindow
 {
 public:
-    IcosahedronWindow()             {}
+    IcosahedronWindow()
+        : m_program(0)
+    {
+    }
+
     virtual ~IcosahedronWindow()    {}
 
 protected:
@@ -22,6 +27,7 @@ protected:
     virtual std::vector<EGLint> requiredEglConfigAttribs();
 
 private:
+    GLuint m_program;
     GLuint m_rotationUniform;
     GLuint m_position;
     GLuint m_color;
@@ -69,17 +75,16 @@ static const GLfloat available_colors[][3] = {
 static GLfloat icosahedron_vertices[N_ELEMENTS(tindices) * 3][3];
 static GLfloat icosahedron_vertex_colors[N_ELEMENTS(tindices) * 3][3];
 
-#define str(s) _str(s)
-#define _str(s) #s
-
 static const char *vert_shader_text =
     "uniform mat4 rotation;\n"
 
+    "// Both constant for the whole draw, so worked out once on the CPU\n"
+    "uniform vec3 light_pos;\n"
+    "uniform float inv_max_distance;\n"
+
     "attribute vec4 pos;\n"
     "attribute vec3 color;\n"
 
-    "const vec3 light_pos = vec3(0, 0, +1);\n"
-
     "varying vec3 v_color;\n"
 
     "void main() {\n"
@@ -90,22 +95,14 @@ static const char *vert_shader_text =
     "  // presented with an interpolated value of 'v_color' for each specific\n"
     "  // pixel, saving us from doing a per-pixel lighting calculation.\n"
 
-    "  // Figure out the maximum conceivable distance to the light source\n"
-    "  float max_x_delta = -" str(X) " - light_pos.x;\n"
-    "  float max_y_delta = light_pos.y;\n"
-    "  float max_z_delta = -" str(Z) " - light_pos.z;\n"
-    "  float max_distance = sqrt(pow(max_x_delta, 2) + pow(max_y_delta, 2) + pow(max_z_delta, 2));\n"
-    "  float x_diff = gl_Position.x - light_pos.x;\n"
-    "  float y_diff = gl_Position.y - light_pos.y;\n"
-    "  float z_diff = gl_Position.z - light_pos.z;\n"
-
-    "  float distance_to_light = sqrt(x_diff * x_diff + y_diff * y_diff + z_diff * z_diff);\n"
+    "  float distance_to_light = distance(gl_Position.xyz, light_pos);\n"
 
     "  // This is a cheat. Luminance actually decreaes with the inverse square of\n"
     "  // distance, but that didn't produce a striking enough effect here. So we\n"
     "  // calculate the luminance as the inverse cube of distance to make it pop\n"
     "  // better.\n"
-    "  float luminance = pow((distance_to_light / max_distance), 3);\n"
+    "  float d = distance_to_light * inv_max_distance;\n"
+    "  float luminance = d * d * d;\n"
     "  v_color = color * luminance;\n"
     "}\n";
 
@@ -128,28 +125,32 @@ void IcosahedronWindow::setupGl()
 {
     GLuint frag, vert;
     GLuint program;
-    GLint status;
 
     frag = createShader(frag_shader_text, GL_FRAGMENT_SHADER);
     vert = createShader(vert_shader_text, GL_VERTEX_SHADER);
+    program = linkProgram(vert, frag, NULL, "icosahedron");
 
-    program = glCreateProgram();
-    glAttachShader(program, frag);
-    glAttachShader(program, vert);
-    glLinkProgram(program);
-
-    glGetProgramiv(program, GL_LINK_STATUS, &status);
-    if (!status) {
-    	char log[1000];
-    	GLsizei len;
-    	glGetProgramInfoLog(program, 1000, &len, log);
-    	fprintf(stderr, "Error: linking:\n%*s\n", len, log);
-    	exit(1);
-    }
+    // The program keeps the compiled code alive
+    GpuResources::deleteShader(vert);
+    GpuResources::deleteShader(frag);
+    m_program = program;
 
     glUseProgram(program);
 
     m_rotationUniform = glGetUniformLocation(program, "rotation");
+
+    // The maximum conceivable distance to the light source. Nothing else
+    // uses the program, so these only need setting once.
+    static const GLfloat light_pos[3] = { 0, 0, +1 };
+    GLfloat max_x_delta = -X - light_pos[0];
+    GLfloat max_y_delta = light_pos[1];
+    GLfloat max_z_delta = -Z - light_pos[2];
+    GLfloat max_distance = sqrt(max_x_delta * max_x_delta +
+                                max_y_delta * max_y_delta +
+                                max_z_delta * max_z_delta);
+
+    glUniform3fv(glGetUniformLocation(program, "light_pos"), 1, light_pos);
+    glUniform1f(glGetUniformLocation(program, "inv_max_distance"), 1 / max_distance);
     m_position = glGetAttribLocation(program, "pos");
     m_color = glGetAttribLocation(program, "color");
 
@@ -200,9 +201,10 @@ void IcosahedronWindow::drawGl(uint32_t time)
 
     glViewport(0, 0, currentSize().m_width, currentSize().m_width);
 
+    glUseProgram(m_program);
     glUniformMatrix4fv(m_rotationUniform, 1, GL_FALSE, (GLfloat *) rotation);
 
-    glClearColor(0.0, 0.0, 0.0, 0.5);
+    glClearColor(0.0, 0.0, 0.0, 1.0);
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
     glEnable(GL_DEPTH_TEST);
@@ -214,15 +216,20 @@ void IcosahedronWindow::drawGl(uint32_t time)
     glEnableVertexAttribArray(m_color);
 
     glDrawArrays(GL_TRIANGLES, 0, N_ELEMENTS(icosahedron_vertices));
+    recordDraw(GL_TRIANGLES, N_ELEMENTS(icosahedron_vertices));
 
     glDisableVertexAttribArray(m_position);
     glDisableVertexAttribArray(m_color);
 
     glDisable(GL_DEPTH_TEST);
+    glUseProgram(0);
 }
 
 void IcosahedronWindow::teardownGl()
 {
+    glUseProgram(0);
+    GpuResources::deleteProgram(m_program);
+    m_program = 0;
 }
 
 int
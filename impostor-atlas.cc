@@ -0,0 +1,234 @@
+#include <GLES2/gl2.h>
+#include <assert.h>
+#include <cmath>
+#include <cstdio>
+#include <stdlib.h>
+
+#include "gpu-resources.hpp"
+#include "impostor-atlas.hpp"
+
+ImpostorAtlas::ImpostorAtlas(GLsizei size, GLsizei slotSize)
+    : m_size(size)
+    , m_slotSize(slotSize)
+    , m_slotsPerRow(size / slotSize)
+    , m_framebuffer(0)
+    , m_texture(0)
+    , m_depth(0)
+    , m_slots(m_slotsPerRow * m_slotsPerRow)
+    , m_head(-1)
+    , m_tail(-1)
+    , m_captureBudget(m_slots.size())
+    , m_capturesThisFrame(0)
+    , m_frame(0)
+    , m_hits(0)
+    , m_captures(0)
+    , m_evictions(0)
+    , m_unavailable(0)
+{
+    assert(m_slotsPerRow > 0);
+    setTolerance(0.1f, 0.1f);
+}
+
+ImpostorAtlas::~ImpostorAtlas()
+{
+}
+
+void ImpostorAtlas::setupGl()
+{
+    m_texture = GpuResources::createTexture("ImpostorAtlas");
+    glBindTexture(GL_TEXTURE_2D, m_texture);
+    GpuResources::texImage2D(m_texture, GL_TEXTURE_2D, 0, GL_RGBA, m_size, m_size,
+                             GL_UNSIGNED_BYTE, NULL);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    m_depth = GpuResources::createRenderbuffer("ImpostorAtlas depth");
+    glBindRenderbuffer(GL_RENDERBUFFER, m_depth);
+    GpuResources::renderbufferStorage(m_depth, GL_DEPTH_COMPONENT16, m_size, m_size);
+    glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+    m_framebuffer = GpuResources::createFramebuffer("ImpostorAtlas");
+    glBindFramebuffer(GL_FRAMEBUFFER, m_framebuffer);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, m_texture, 0);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, m_depth);
+
+    GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+    if (status != GL_FRAMEBUFFER_COMPLETE) {
+        fprintf(stderr, "Impostor atlas %dx%d is incomplete (0x%x)\n", m_size, m_size, status);
+        exit(EXIT_FAILURE);
+    }
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+    // Every slot starts out empty, in order
+    m_head = m_tail = -1;
+    for (size_t i = 0; i < m_slots.size(); i++) {
+        m_slots[i].m_used = false;
+        m_slots[i].m_lastUsed = 0;
+        pushBack(i);
+    }
+
+    m_frame = 0;
+    m_hits = m_captures = m_evictions = m_unavailable = 0;
+}
+
+void ImpostorAtlas::teardownGl()
+{
+    GpuResources::deleteFramebuffer(m_framebuffer);
+    GpuResources::deleteRenderbuffer(m_depth);
+    GpuResources::deleteTexture(m_texture);
+    m_framebuffer = m_depth = m_texture = 0;
+}
+
+void ImpostorAtlas::setTolerance(float viewAngle, float lightAngle)
+{
+    m_viewCos = cosf(viewAngle);
+    m_lightCos = cosf(lightAngle);
+}
+
+void ImpostorAtlas::beginFrame()
+{
+    m_frame++;
+    m_capturesThisFrame = 0;
+}
+
+ImpostorAtlas::Status ImpostorAtlas::request(uint32_t key, int* slot,
+                                             float const view[3], float const light[3])
+{
+    int index = *slot;
+
+    if (index >= 0 && index < (int)m_slots.size() &&
+        m_slots[index].m_used && m_slots[index].m_key == key) {
+        Slot& existing = m_slots[index];
+
+        unlink(index);
+        pushBack(index);
+        existing.m_lastUsed = m_frame;
+
+        // Over budget, a picture slightly out of date beats a hitch
+        if (withinTolerance(existing, view, light) || m_capturesThisFrame >= m_captureBudget) {
+            m_hits++;
+            return READY;
+        }
+
+        record(existing, view, light);
+        return CAPTURE;
+    }
+
+    // A new slot, from whoever used theirs least recently. If that was
+    // this frame, every slot is spoken for.
+    index = m_head;
+    Slot& oldest = m_slots[index];
+
+    if (m_capturesThisFrame >= m_captureBudget || oldest.m_lastUsed == m_frame) {
+        m_unavailable++;
+        return UNAVAILABLE;
+    }
+
+    if (oldest.m_used) {
+        m_evictions++;
+    }
+    oldest.m_key = key;
+    oldest.m_used = true;
+    oldest.m_lastUsed = m_frame;
+
+    unlink(index);
+    pushBack(index);
+    record(oldest, view, light);
+
+    *slot = index;
+    return CAPTURE;
+}
+
+void ImpostorAtlas::beginCapture(int slot)
+{
+    GLint x = slot % m_slotsPerRow * m_slotSize;
+    GLint y = slot / m_slotsPerRow * m_slotSize;
+
+    glBindFramebuffer(GL_FRAMEBUFFER, m_framebuffer);
+    glViewport(x, y, m_slotSize, m_slotSize);
+
+    // Clears only go by the scissor box
+    glEnable(GL_SCISSOR_TEST);
+    glScissor(x, y, m_slotSize, m_slotSize);
+    glClearColor(0, 0, 0, 0);
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    glDisable(GL_SCISSOR_TEST);
+}
+
+void ImpostorAtlas::endCapture()
+{
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+void ImpostorAtlas::slotRect(int slot, GLfloat rect[4]) const
+{
+    // Half a texel in from the edges, so that filtering never reaches
+    // into the neighbours
+    GLfloat texel = 1.0f / m_size;
+    GLfloat left = slot % m_slotsPerRow * m_slotSize * texel;
+    GLfloat bottom = slot / m_slotsPerRow * m_slotSize * texel;
+
+    rect[0] = left + texel / 2;
+    rect[1] = bottom + texel / 2;
+    rect[2] = left + m_slotSize * texel - texel / 2;
+    rect[3] = bottom + m_slotSize * texel - texel / 2;
+}
+
+void ImpostorAtlas::unlink(int slot)
+{
+    Slot& s = m_slots[slot];
+
+    if (s.m_prev >= 0) {
+        m_slots[s.m_prev].m_next = s.m_next;
+    }
+    else {
+        m_head = s.m_next;
+    }
+
+    if (s.m_next >= 0) {
+        m_slots[s.m_next].m_prev = s.m_prev;
+    }
+    else {
+        m_tail = s.m_prev;
+    }
+}
+
+void ImpostorAtlas::pushBack(int slot)
+{
+    Slot& s = m_slots[slot];
+    s.m_prev = m_tail;
+    s.m_next = -1;
+
+    if (m_tail >= 0) {
+        m_slots[m_tail].m_next = slot;
+    }
+    else {
+        m_head = slot;
+    }
+    m_tail = slot;
+}
+
+static float dot(float const a[3], float const b[3])
+{
+    return a[0] * b[0] + a[1] * b[1] + a[2] * b[2];
+}
+
+bool ImpostorAtlas::withinTolerance(Slot const& slot, float const view[3],
+                                    float const light[3]) const
+{
+    return dot(slot.m_view, view) >= m_viewCos && dot(slot.m_light, light) >= m_lightCos;
+}
+
+void ImpostorAtlas::record(Slot& slot, float const view[3], float const light[3])
+{
+    for (int i = 0; i < 3; i++) {
+        slot.m_view[i] = view[i];
+        slot.m_light[i] = light[i];
+    }
+
+    m_captures++;
+    m_capturesThisFrame++;
+}
@@ -0,0 +1,135 @@
+#ifndef __IMPOSTOR_ATLAS_HPP__
+#define __IMPOSTOR_ATLAS_HPP__
+
+#include <GLES2/gl2.h>
+#include <stdint.h>
+
+#include <vector>
+
+// Cached pictures of objects too small on screen to be worth their
+// vertices. An object far enough away is rendered once into a square
+// slot of a shared atlas texture, looking at it from where the camera
+// is, and from then on drawn as a camera-facing quad showing that
+// picture. It's rendered again once the direction it's seen from, or
+// the direction of the light on it, has turned more than a tolerance
+// since.
+//
+// Each frame, for each object that should be an impostor:
+//
+//     switch (atlas.request(key, &object.m_slot, view, light)) {
+//         case ImpostorAtlas::CAPTURE:
+//             atlas.beginCapture(object.m_slot);
+//             ... draw the object, framed by an orthographic projection ...
+//             atlas.endCapture();
+//             // Fall through
+//         case ImpostorAtlas::READY:
+//             ... add a quad showing slotRect(object.m_slot) ...
+//             break;
+//         case ImpostorAtlas::UNAVAILABLE:
+//             ... draw the object as usual ...
+//             break;
+//     }
+//
+// The caller remembers the slot it was given for each object. Slots go
+// to whoever needs one, taking the least recently used, so a slot may
+// have been given to another object since; request() notices and finds
+// a new one. Captures switch framebuffers, which on a tiler flushes
+// whatever was drawn to the window so far, so make every request()
+// before drawing anything else in the frame.
+class ImpostorAtlas
+{
+public:
+    enum Status
+    {
+        READY,          // The slot holds a good enough picture
+        CAPTURE,        // The slot needs drawing into now
+        UNAVAILABLE,    // No picture this frame; draw the object itself
+    };
+
+    // A 'size' square texture cut into 'slotSize' squares
+    ImpostorAtlas(GLsizei size = 2048, GLsizei slotSize = 64);
+    ~ImpostorAtlas();
+
+    void setupGl();
+    void teardownGl();
+
+    // How far, in radians, the view and light directions may turn before
+    // a picture is taken again
+    void setTolerance(float viewAngle, float lightAngle);
+
+    // Most pictures taken in one frame; past that, out-of-date pictures
+    // are used as they are and objects without one are UNAVAILABLE
+    void setCaptureBudget(int captures)     { m_captureBudget = captures; }
+
+    void beginFrame();
+
+    // 'key' identifies the object and '*slot' is the slot last given for
+    // it (-1 at first). 'view' is the unit vector from the object to the
+    // eye and 'light' the unit vector towards the light, in any one
+    // space as long as it's the same every time.
+    Status request(uint32_t key, int* slot, float const view[3], float const light[3]);
+
+    // Binds the atlas framebuffer with the viewport on 'slot' and clears
+    // that slot to transparent. endCapture() puts framebuffer 0 back,
+    // but not the viewport.
+    void beginCapture(int slot);
+    void endCapture();
+
+    GLuint texture() const              { return m_texture; }
+    int slotCount() const               { return m_slots.size(); }
+
+    // Texture coordinates of 'slot': left, bottom, right, top
+    void slotRect(int slot, GLfloat rect[4]) const;
+
+    // Since setupGl()
+    uint64_t hits() const               { return m_hits; }
+    uint64_t captures() const           { return m_captures; }
+    uint64_t evictions() const          { return m_evictions; }
+    uint64_t unavailable() const        { return m_unavailable; }
+
+private:
+    struct Slot
+    {
+        uint32_t m_key;
+        bool m_used;            // Holds a picture of m_key
+        float m_view[3];        // Directions it was taken from
+        float m_light[3];
+        uint32_t m_lastUsed;    // Frame
+
+        // Least recently used first
+        int m_prev;
+        int m_next;
+    };
+
+    void unlink(int slot);
+    void pushBack(int slot);
+    bool withinTolerance(Slot const& slot, float const view[3], float const light[3]) const;
+    void record(Slot& slot, float const view[3], float const light[3]);
+
+    GLsizei m_size;
+    GLsizei m_slotSize;
+    int m_slotsPerRow;
+
+    GLuint m_framebuffer;
+    GLuint m_texture;
+    GLuint m_depth;
+
+    std::vector<Slot> m_slots;
+    int m_head;
+    int m_tail;
+
+    // Cosines of the tolerances
+    float m_viewCos;
+    float m_lightCos;
+
+    int m_captureBudget;
+    int m_capturesThisFrame;
+    uint32_t m_frame;
+
+    uint64_t m_hits;
+    uint64_t m_captures;
+    uint64_t m_evictions;
+    uint64_t m_unavailable;
+};
+
+#endif
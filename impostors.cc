@@ -0,0 +1,509 @@
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <stddef.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <vector>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/type_ptr.hpp>
+
+#include "base.hpp"
+#include "impostor-atlas.hpp"
+#include "mesh-lod.hpp"
+#include "shader.hpp"
+#include "stream-buffer.hpp"
+#include "transforms.hpp"
+
+// A field of full-detail geodesic spheres stretching away from the
+// camera, under a slowly turning light. Spheres smaller on screen than
+// 'max-pixels' across are drawn as impostors: a picture of the sphere
+// from about where the camera is, kept in an ImpostorAtlas and drawn on
+// a quad facing the camera, all of them in one draw. Pictures are taken
+// again once the camera or the light has moved them out of tolerance.
+//
+// Every REPORT_INTERVAL frames prints how many spheres were drawn each
+// way, the triangles and draws that took against drawing every sphere
+// as a mesh, and how much work the atlas did.
+//
+// Usage: impostors [window options] [max-pixels]
+//
+// 'max-pixels' defaults to 48; 0 turns impostors off.
+
+static const char* sphere_vert_shader_text =
+    "uniform mat4 u_mvp;\n"
+    "uniform mat3 u_normal_matrix;\n"
+    "uniform vec3 u_color;\n"
+    "uniform vec3 u_light;\n"
+
+    "attribute vec3 a_pos;\n"
+
+    "varying vec3 v_color;\n"
+
+    "void main() {\n"
+    "  gl_Position = u_mvp * vec4(a_pos, 1);\n"
+
+    "  // On a unit sphere the position is the normal\n"
+    "  vec3 norm = normalize(u_normal_matrix * a_pos);\n"
+    "  v_color = u_color * (0.3 + 0.7 * max(dot(norm, u_light), 0.0));\n"
+    "}\n";
+
+static const char* sphere_frag_shader_text =
+    "precision mediump float;\n"
+    "varying vec3 v_color;\n"
+    "void main() {\n"
+    "  gl_FragColor = vec4(v_color, 1);\n"
+    "}\n";
+
+static const char* impostor_vert_shader_text =
+    "uniform mat4 u_view_projection;\n"
+    "attribute vec3 a_pos;\n"
+    "attribute vec2 a_texcoord;\n"
+    "varying vec2 v_texcoord;\n"
+    "void main() {\n"
+    "  gl_Position = u_view_projection * vec4(a_pos, 1);\n"
+    "  v_texcoord = a_texcoord;\n"
+    "}\n";
+
+static const char* impostor_frag_shader_text =
+    "precision mediump float;\n"
+    "uniform sampler2D u_atlas;\n"
+    "varying vec2 v_texcoord;\n"
+    "void main() {\n"
+    "  vec4 color = texture2D(u_atlas, v_texcoord);\n"
+    "  if (color.a < 0.5)\n"
+    "    discard;\n"
+
+    "  // Filtering blends in the transparent black around the sphere\n"
+    "  gl_FragColor = vec4(color.rgb / color.a, 1);\n"
+    "}\n";
+
+// Frames between reports
+static const uint32_t REPORT_INTERVAL = 120;
+
+// Geodesic subdivisions: 5120 triangles a sphere
+static const int SUBDIVISIONS = 4;
+
+// The field: COLUMNS wide, ROWS deep, SPACING apart
+static const int COLUMNS = 21;
+static const int ROWS = 40;
+static const int SPHERES = COLUMNS * ROWS;
+static const float SPACING = 2.5f;
+static const float RADIUS = 0.8f;
+
+// Vertical field of view, in radians
+static const float FOVY = 0.8f;
+
+// How far the view and light directions may turn, in radians, before a
+// picture is taken again, and how many pictures may be taken per frame
+static const float VIEW_TOLERANCE = 0.05f;
+static const float LIGHT_TOLERANCE = 0.1f;
+static const int CAPTURE_BUDGET = 64;
+
+enum {
+    ATTRIB_POS,
+    ATTRIB_TEXCOORD,
+};
+
+struct QuadVertex
+{
+    GLfloat x, y, z;
+    GLfloat u, v;
+};
+
+class ImpostorsWindow: public WaylandWindow
+{
+public:
+    ImpostorsWindow()
+        : m_maxPixels(48)
+        , m_sphereProgram(0)
+        , m_uColor(-1)
+        , m_uLight(-1)
+        , m_impostorProgram(0)
+        , m_uViewProjection(-1)
+        , m_uAtlas(-1)
+        , m_indexBuffer(0)
+        , m_quadStream(GL_ARRAY_BUFFER, SPHERES * 4 * sizeof(QuadVertex))
+        , m_meshes(0)
+        , m_impostors(0)
+        , m_draws(0)
+        , m_triangles(0)
+        , m_lastCaptures(0)
+        , m_lastEvictions(0)
+    {
+        for (int i = 0; i < SPHERES; i++) {
+            int row = i / COLUMNS;
+            int column = i % COLUMNS;
+
+            m_spheres[i].m_center = glm::vec3((column - COLUMNS / 2) * SPACING, 0, -row * SPACING);
+            m_spheres[i].m_color = glm::vec3(0.5f + 0.5f * column / COLUMNS,
+                                             0.6f,
+                                             1.0f - 0.5f * row / ROWS);
+            m_spheres[i].m_slot = -1;
+        }
+
+        m_quads.reserve(SPHERES * 4);
+        m_meshDraws.reserve(SPHERES);
+    }
+
+    virtual ~ImpostorsWindow()
+    {
+    }
+
+    void setMaxPixels(float maxPixels)  { m_maxPixels = maxPixels; }
+
+protected:
+    virtual std::vector<EGLint> requiredEglConfigAttribs()
+    {
+        std::vector<EGLint> ret;
+        ret.push_back(EGL_DEPTH_SIZE);
+        ret.push_back(16);
+        return ret;
+    }
+
+    virtual void setupGl()
+    {
+        static char const* const sphereAttribs[] = { "a_pos", NULL };
+        static char const* const impostorAttribs[] = { "a_pos", "a_texcoord", NULL };
+
+        GLuint vert = createShader(sphere_vert_shader_text, GL_VERTEX_SHADER);
+        GLuint frag = createShader(sphere_frag_shader_text, GL_FRAGMENT_SHADER);
+        m_sphereProgram = linkProgram(vert, frag, sphereAttribs);
+        GpuResources::deleteShader(vert);
+        GpuResources::deleteShader(frag);
+
+        m_transforms.locate(m_sphereProgram);
+        m_uColor = glGetUniformLocation(m_sphereProgram, "u_color");
+        m_uLight = glGetUniformLocation(m_sphereProgram, "u_light");
+
+        vert = createShader(impostor_vert_shader_text, GL_VERTEX_SHADER);
+        frag = createShader(impostor_frag_shader_text, GL_FRAGMENT_SHADER);
+        m_impostorProgram = linkProgram(vert, frag, impostorAttribs);
+        GpuResources::deleteShader(vert);
+        GpuResources::deleteShader(frag);
+
+        m_uViewProjection = glGetUniformLocation(m_impostorProgram, "u_view_projection");
+        m_uAtlas = glGetUniformLocation(m_impostorProgram, "u_atlas");
+
+        buildGeodesicSphere(m_mesh, SUBDIVISIONS);
+        m_mesh.optimize(3 * sizeof(GLfloat));
+        m_mesh.setupGl();
+
+        // Two triangles per quad
+        std::vector<GLushort> indices;
+        for (int i = 0; i < SPHERES; i++) {
+            static const GLushort quad[] = { 0, 1, 2, 2, 1, 3 };
+            for (int j = 0; j < 6; j++) {
+                indices.push_back(i * 4 + quad[j]);
+            }
+        }
+        m_indexBuffer = GpuResources::createBuffer("impostor indices");
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_indexBuffer);
+        GpuResources::bufferData(m_indexBuffer, GL_ELEMENT_ARRAY_BUFFER,
+                                 indices.size() * sizeof(GLushort), &indices[0], GL_STATIC_DRAW);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+
+        m_quadStream.setupGl();
+
+        m_atlas.setTolerance(VIEW_TOLERANCE, LIGHT_TOLERANCE);
+        m_atlas.setCaptureBudget(CAPTURE_BUDGET);
+        m_atlas.setupGl();
+    }
+
+    virtual void drawGl(uint32_t time)
+    {
+        Size const& size = currentSize();
+
+        // Dolly in and out, and sway side to side, so that spheres keep
+        // crossing the threshold and being seen from new angles
+        float t = time / 1000.0f;
+        glm::vec3 eye(3 * sinf(t * 0.2f), 1.5f, 4 - 6 * (1 - cosf(t * 0.3f)));
+        glm::vec3 light = glm::normalize(glm::vec3(cosf(t * 0.1f), 1, sinf(t * 0.1f)));
+
+        float aspect = size.m_width * 1.0f / size.m_height;
+        float zNear = 0.5f, zFar = 150.0f;
+        float top = zNear * tanf(FOVY / 2);
+        glm::mat4 projection = glm::frustum(-top * aspect, top * aspect, -top, top, zNear, zFar);
+        glm::mat4 view = glm::translate(glm::mat4(1.f), -eye);
+
+        float scale = LodMesh::screenScale(size.m_height, FOVY);
+
+        // Pictures first: every capture switches framebuffers
+        glUseProgram(m_sphereProgram);
+        m_mesh.bindVertices();
+        glVertexAttribPointer(ATTRIB_POS, 3, GL_FLOAT, GL_FALSE, 0, 0);
+        glEnableVertexAttribArray(ATTRIB_POS);
+        glEnable(GL_DEPTH_TEST);
+
+        m_atlas.beginFrame();
+        m_quads.clear();
+        m_meshDraws.clear();
+
+        for (int i = 0; i < SPHERES; i++) {
+            Sphere& sphere = m_spheres[i];
+            float distance = glm::length(sphere.m_center - eye);
+
+            if (2 * RADIUS * scale / distance >= m_maxPixels) {
+                m_meshDraws.push_back(i);
+                continue;
+            }
+
+            glm::vec3 toEye = (eye - sphere.m_center) / distance;
+
+            switch (m_atlas.request(i, &sphere.m_slot, glm::value_ptr(toEye),
+                                    glm::value_ptr(light))) {
+                case ImpostorAtlas::CAPTURE:
+                    capture(sphere, toEye, light);
+                    // Fall through
+                case ImpostorAtlas::READY:
+                    addQuad(sphere, toEye);
+                    break;
+                case ImpostorAtlas::UNAVAILABLE:
+                    m_meshDraws.push_back(i);
+                    break;
+            }
+        }
+
+        // Then the window
+        glViewport(0, 0, size.m_width, size.m_height);
+        glClearColor(0.1, 0.1, 0.15, 1.0);
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+        glm::vec3 eyeLight = glm::mat3(view) * light;
+        glUniform3fv(m_uLight, 1, glm::value_ptr(eyeLight));
+
+        for (size_t i = 0; i < m_meshDraws.size(); i++) {
+            Sphere const& sphere = m_spheres[m_meshDraws[i]];
+            drawSphere(sphere, Transforms(model(sphere), view, projection));
+            m_draws++;
+        }
+        m_meshes += m_meshDraws.size();
+
+        glDisableVertexAttribArray(ATTRIB_POS);
+
+        drawImpostors(projection * view);
+
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+        glDisable(GL_DEPTH_TEST);
+
+        report();
+    }
+
+    virtual void teardownGl()
+    {
+        m_atlas.teardownGl();
+        m_quadStream.teardownGl();
+        GpuResources::deleteBuffer(m_indexBuffer);
+        m_mesh.teardownGl();
+        GpuResources::deleteProgram(m_sphereProgram);
+        GpuResources::deleteProgram(m_impostorProgram);
+    }
+
+private:
+    struct Sphere
+    {
+        glm::vec3 m_center;
+        glm::vec3 m_color;
+        int m_slot;
+    };
+
+    static glm::mat4 model(Sphere const& sphere)
+    {
+        return glm::scale(glm::translate(glm::mat4(1.f), sphere.m_center), glm::vec3(RADIUS));
+    }
+
+    // The directions across and up a picture taken from 'toEye'
+    static void pictureAxes(glm::vec3 const& toEye, glm::vec3* right, glm::vec3* up)
+    {
+        glm::vec3 worldUp = fabsf(toEye.y) > 0.99f ? glm::vec3(0.0f, 0.0f, 1.0f) : glm::vec3(0.0f, 1.0f, 0.0f);
+        *right = glm::normalize(glm::cross(worldUp, toEye));
+        *up = glm::cross(toEye, *right);
+    }
+
+    // Draws the sphere into its atlas slot, just filling it, as seen
+    // from 'toEye' with the same lighting it would get in the window
+    void capture(Sphere const& sphere, glm::vec3 const& toEye, glm::vec3 const& light)
+    {
+        glm::vec3 right, up;
+        pictureAxes(toEye, &right, &up);
+
+        glm::mat4 view = glm::lookAt(sphere.m_center + toEye * (2 * RADIUS), sphere.m_center, up);
+        glm::mat4 projection = glm::ortho(-RADIUS, RADIUS, -RADIUS, RADIUS, RADIUS, 3 * RADIUS);
+
+        glm::vec3 eyeLight = glm::mat3(view) * light;
+        glUniform3fv(m_uLight, 1, glm::value_ptr(eyeLight));
+
+        m_atlas.beginCapture(sphere.m_slot);
+        drawSphere(sphere, Transforms(model(sphere), view, projection));
+        m_atlas.endCapture();
+
+        m_draws++;
+    }
+
+    void drawSphere(Sphere const& sphere, Transforms const& transforms)
+    {
+        m_transforms.upload(transforms);
+        glUniform3fv(m_uColor, 1, glm::value_ptr(sphere.m_color));
+
+        GLsizei indices = m_mesh.drawLevel(0);
+        recordDraw(GL_TRIANGLES, indices);
+        m_triangles += indices / 3;
+    }
+
+    // A quad through the sphere's center, facing the eye, covering what
+    // its picture covers
+    void addQuad(Sphere const& sphere, glm::vec3 const& toEye)
+    {
+        glm::vec3 right, up;
+        pictureAxes(toEye, &right, &up);
+        right = right * RADIUS;
+        up = up * RADIUS;
+
+        GLfloat rect[4];
+        m_atlas.slotRect(sphere.m_slot, rect);
+
+        glm::vec3 corners[] = {
+            sphere.m_center - right - up,
+            sphere.m_center + right - up,
+            sphere.m_center - right + up,
+            sphere.m_center + right + up,
+        };
+
+        for (int i = 0; i < 4; i++) {
+            QuadVertex vertex;
+            vertex.x = corners[i].x;
+            vertex.y = corners[i].y;
+            vertex.z = corners[i].z;
+            vertex.u = rect[i & 1 ? 2 : 0];
+            vertex.v = rect[i & 2 ? 3 : 1];
+            m_quads.push_back(vertex);
+        }
+    }
+
+    void drawImpostors(glm::mat4 const& viewProjection)
+    {
+        size_t quads = m_quads.size() / 4;
+        m_impostors += quads;
+        if (quads == 0) {
+            return;
+        }
+
+        // The stream holds a quad for every sphere, so this only fails if
+        // something's badly wrong; the impostors just go missing
+        m_quadStream.beginFrame();
+        StreamBuffer::Span span = m_quadStream.allocate(m_quads.size() * sizeof(QuadVertex));
+        if (!span.m_data) {
+            m_quadStream.endFrame();
+            return;
+        }
+        memcpy(span.m_data, &m_quads[0], span.m_size);
+        m_quadStream.flush();
+
+        glUseProgram(m_impostorProgram);
+        glUniformMatrix4fv(m_uViewProjection, 1, GL_FALSE, glm::value_ptr(viewProjection));
+        glUniform1i(m_uAtlas, 0);
+        glBindTexture(GL_TEXTURE_2D, m_atlas.texture());
+
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_indexBuffer);
+        glVertexAttribPointer(ATTRIB_POS, 3, GL_FLOAT, GL_FALSE, sizeof(QuadVertex),
+                              span.pointer(offsetof(QuadVertex, x)));
+        glVertexAttribPointer(ATTRIB_TEXCOORD, 2, GL_FLOAT, GL_FALSE, sizeof(QuadVertex),
+                              span.pointer(offsetof(QuadVertex, u)));
+        glEnableVertexAttribArray(ATTRIB_POS);
+        glEnableVertexAttribArray(ATTRIB_TEXCOORD);
+
+        glDrawElements(GL_TRIANGLES, quads * 6, GL_UNSIGNED_SHORT, 0);
+        recordDraw(GL_TRIANGLES, quads * 6);
+        m_quadStream.endFrame();
+
+        glDisableVertexAttribArray(ATTRIB_POS);
+        glDisableVertexAttribArray(ATTRIB_TEXCOORD);
+        glBindTexture(GL_TEXTURE_2D, 0);
+
+        m_draws++;
+        m_triangles += quads * 2;
+    }
+
+    void report()
+    {
+        uint32_t frames = frameStats().frameCount();
+        if (frames == 0 || frames % REPORT_INTERVAL != 0) {
+            return;
+        }
+
+        double allMeshes = double(SPHERES) * m_mesh.triangleCount(0);
+
+        printf("Impostors %s: %.1f spheres as meshes, %.1f as impostors; "
+               "%.0f triangles in %.1f draws per frame (%.1f%% of the triangles "
+               "and %.1f%% of the draws of all meshes), %.1f fps\n",
+               m_maxPixels > 0 ? "on" : "off",
+               m_meshes / (double)REPORT_INTERVAL,
+               m_impostors / (double)REPORT_INTERVAL,
+               m_triangles / (double)REPORT_INTERVAL,
+               m_draws / (double)REPORT_INTERVAL,
+               100.0 * m_triangles / REPORT_INTERVAL / allMeshes,
+               100.0 * m_draws / REPORT_INTERVAL / SPHERES,
+               frameStats().fps());
+
+        if (m_maxPixels > 0) {
+            printf("    atlas: %.1f pictures taken and %.1f evicted per frame; "
+                   "%llu reused, %llu spheres without a slot since the start\n",
+                   (m_atlas.captures() - m_lastCaptures) / (double)REPORT_INTERVAL,
+                   (m_atlas.evictions() - m_lastEvictions) / (double)REPORT_INTERVAL,
+                   (unsigned long long)m_atlas.hits(),
+                   (unsigned long long)m_atlas.unavailable());
+        }
+
+        m_lastCaptures = m_atlas.captures();
+        m_lastEvictions = m_atlas.evictions();
+        m_meshes = m_impostors = m_draws = m_triangles = 0;
+    }
+
+    float m_maxPixels;
+
+    Sphere m_spheres[SPHERES];
+    LodMesh m_mesh;
+
+    GLuint m_sphereProgram;
+    TransformUniforms m_transforms;
+    GLint m_uColor;
+    GLint m_uLight;
+
+    GLuint m_impostorProgram;
+    GLint m_uViewProjection;
+    GLint m_uAtlas;
+
+    ImpostorAtlas m_atlas;
+    GLuint m_indexBuffer;
+    StreamBuffer m_quadStream;
+
+    // This frame's impostor quads, and spheres to draw as meshes
+    std::vector<QuadVertex> m_quads;
+    std::vector<int> m_meshDraws;
+
+    // Accumulated since the last report
+    uint64_t m_meshes;
+    uint64_t m_impostors;
+    uint64_t m_draws;
+    uint64_t m_triangles;
+    uint64_t m_lastCaptures;
+    uint64_t m_lastEvictions;
+};
+
+int main(int argc, char* argv[])
+{
+    ImpostorsWindow w;
+    w.init(&argc, argv);
+
+    // Positional arguments are what's left after the window options
+    if (optind < argc) {
+        w.setMaxPixels(atof(argv[optind++]));
+    }
+
+    w.run();
+    return EXIT_SUCCESS;
+}
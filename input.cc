@@ -0,0 +1,234 @@
+#include <algorithm>
+
+#include <linux/input.h>
+#include <wayland-client.h>
+
+#include "input.hpp"
+
+InputFrame::InputFrame()
+    : m_pointerInside(false)
+    , m_pointerX(0)
+    , m_pointerY(0)
+    , m_buttons(0)
+{
+    clear();
+}
+
+void InputFrame::clear()
+{
+    // clear() keeps the capacity, so after the first few frames the
+    // events don't cost an allocation
+    m_events.clear();
+    m_motionX = 0;
+    m_motionY = 0;
+    m_scroll = 0;
+    m_motionEvents = 0;
+    m_oldest = 0;
+}
+
+void InputFrame::merge(InputFrame const& later)
+{
+    m_events.insert(m_events.end(), later.m_events.begin(), later.m_events.end());
+
+    m_pointerInside = later.m_pointerInside;
+    m_pointerX = later.m_pointerX;
+    m_pointerY = later.m_pointerY;
+    m_buttons = later.m_buttons;
+
+    m_motionX += later.m_motionX;
+    m_motionY += later.m_motionY;
+    m_scroll += later.m_scroll;
+    m_motionEvents += later.m_motionEvents;
+
+    if (later.m_oldest && (!m_oldest || later.m_oldest < m_oldest)) {
+        m_oldest = later.m_oldest;
+    }
+}
+
+bool InputFrame::buttonHeld(uint32_t button) const
+{
+    return button >= BTN_MOUSE && button - BTN_MOUSE < 32 &&
+           (m_buttons & (1u << (button - BTN_MOUSE)));
+}
+
+InputQueue::InputQueue()
+{
+}
+
+void InputQueue::touch(InputFrame& frame, uint64_t time)
+{
+    if (!frame.m_oldest || time < frame.m_oldest) {
+        frame.m_oldest = time;
+    }
+}
+
+void InputQueue::pointerEnter(double x, double y)
+{
+    // Entering isn't motion: the pointer was somewhere else entirely
+    m_group.m_pointerInside = true;
+    m_group.m_pointerX = x;
+    m_group.m_pointerY = y;
+}
+
+void InputQueue::pointerLeave()
+{
+    // Whatever was held stays held as far as the compositor is concerned,
+    // but this surface won't hear about its release
+    m_group.m_pointerInside = false;
+    m_group.m_buttons = 0;
+}
+
+void InputQueue::pointerMotion(double x, double y, uint64_t time)
+{
+    m_group.m_motionX += x - m_group.m_pointerX;
+    m_group.m_motionY += y - m_group.m_pointerY;
+    m_group.m_pointerX = x;
+    m_group.m_pointerY = y;
+    m_group.m_motionEvents++;
+    touch(m_group, time);
+}
+
+void InputQueue::pointerButton(uint32_t serial, uint32_t button, uint32_t state, uint64_t time)
+{
+    InputEvent event = { InputEvent::BUTTON, serial, button, state, time };
+    m_group.m_events.push_back(event);
+
+    if (button >= BTN_MOUSE && button - BTN_MOUSE < 32) {
+        uint32_t bit = 1u << (button - BTN_MOUSE);
+        if (state == WL_POINTER_BUTTON_STATE_PRESSED) {
+            m_group.m_buttons |= bit;
+        } else {
+            m_group.m_buttons &= ~bit;
+        }
+    }
+    touch(m_group, time);
+}
+
+void InputQueue::pointerAxis(uint32_t axis, double value, uint64_t time)
+{
+    if (axis == WL_POINTER_AXIS_VERTICAL_SCROLL) {
+        m_group.m_scroll += value;
+        touch(m_group, time);
+    }
+}
+
+void InputQueue::pointerFrame()
+{
+    m_pending.merge(m_group);
+    m_group.clear();
+}
+
+void InputQueue::key(uint32_t serial, uint32_t key, uint32_t state, uint64_t time)
+{
+    // Keys aren't grouped; they go straight to the next frame
+    InputEvent event = { InputEvent::KEY, serial, key, state, time };
+    m_pending.m_events.push_back(event);
+    touch(m_pending, time);
+}
+
+InputFrame const& InputQueue::beginFrame()
+{
+    // The frames trade places rather than being copied, so both keep
+    // their event storage
+    std::swap(m_current, m_pending);
+
+    m_pending.clear();
+    m_pending.m_pointerInside = m_current.m_pointerInside;
+    m_pending.m_pointerX = m_current.m_pointerX;
+    m_pending.m_pointerY = m_current.m_pointerY;
+    m_pending.m_buttons = m_current.m_buttons;
+
+    return m_current;
+}
+
+uint64_t InputQueue::eventTime(uint32_t wlTime, uint64_t received)
+{
+    // Compare in wrapping 32-bit milliseconds, as the protocol sends them
+    uint32_t receivedMs = received / 1000000;
+    uint32_t age = receivedMs - wlTime;
+
+    // More than a second old, or from the future: some other clock
+    if (age > 1000) {
+        return received;
+    }
+    return received - (uint64_t)age * 1000000;
+}
+
+InputLatency::InputLatency()
+    : m_enabled(false)
+    , m_inFlight(0)
+    , m_motionFrames(0)
+    , m_motionEvents(0)
+{
+}
+
+void InputLatency::enable()
+{
+    m_enabled = true;
+    m_swap.reserve(MAX_SAMPLES);
+    m_present.reserve(MAX_SAMPLES);
+}
+
+void InputLatency::frameSwapped(InputFrame const& input, uint64_t now)
+{
+    if (!m_enabled || !input.hasInput()) {
+        return;
+    }
+
+    if (input.m_motionEvents) {
+        m_motionFrames++;
+        m_motionEvents += input.m_motionEvents;
+    }
+
+    if (m_swap.size() < MAX_SAMPLES) {
+        m_swap.push_back((now - input.m_oldest) / 1e6);
+    }
+    m_inFlight = input.m_oldest;
+}
+
+void InputLatency::framePresented(uint64_t now)
+{
+    if (!m_inFlight) {
+        return;
+    }
+
+    if (m_present.size() < MAX_SAMPLES) {
+        m_present.push_back((now - m_inFlight) / 1e6);
+    }
+    m_inFlight = 0;
+}
+
+static void printDistribution(FILE* stream, char const* name, std::vector<double> samples)
+{
+    if (samples.empty()) {
+        fprintf(stream, "  %-8s no samples\n", name);
+        return;
+    }
+
+    std::sort(samples.begin(), samples.end());
+
+    double sum = 0;
+    for (size_t i = 0; i < samples.size(); i++) {
+        sum += samples[i];
+    }
+
+    size_t n = samples.size();
+    fprintf(stream, "  %-8s %6zu %8.2f %8.2f %8.2f %8.2f %8.2f %8.2f\n", name, n,
+            samples[0], sum / n, samples[n / 2], samples[n * 9 / 10],
+            samples[n * 99 / 100], samples[n - 1]);
+}
+
+void InputLatency::printSummary(FILE* stream) const
+{
+    fprintf(stream, "Input latency (ms), from the oldest input in each frame to:\n");
+    fprintf(stream, "  %-8s %6s %8s %8s %8s %8s %8s %8s\n",
+            "", "frames", "min", "mean", "median", "90%", "99%", "max");
+    printDistribution(stream, "swap", m_swap);
+    printDistribution(stream, "present", m_present);
+
+    if (m_motionFrames) {
+        fprintf(stream, "  %llu motion events coalesced into %llu frames (%.1f per frame)\n",
+                (unsigned long long)m_motionEvents, (unsigned long long)m_motionFrames,
+                (double)m_motionEvents / m_motionFrames);
+    }
+}
@@ -0,0 +1,144 @@
+#ifndef __INPUT_HPP__
+#define __INPUT_HPP__
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include <vector>
+
+// A key or pointer button going up or down
+struct InputEvent
+{
+    enum Type
+    {
+        KEY,
+        BUTTON,
+    };
+
+    Type m_type;
+    uint32_t m_serial;
+    uint32_t m_code;            // KEY_* or BTN_* from linux/input.h
+    uint32_t m_state;           // Nonzero for pressed
+    uint64_t m_time;            // EventLoop::now() clock
+};
+
+// Everything that happened to a window's input since its last frame.
+// Motion and scrolling are coalesced: however many motion events came in,
+// the frame sees one position and one accumulated delta. Key and button
+// transitions are all kept, in order.
+struct InputFrame
+{
+    InputFrame();
+
+    // Forget the per-frame part, keeping the pointer position and the
+    // buttons held
+    void clear();
+
+    // Fold a later batch of input into this one
+    void merge(InputFrame const& later);
+
+    bool hasInput() const       { return m_oldest != 0; }
+    bool buttonHeld(uint32_t button) const;
+
+    std::vector<InputEvent> m_events;
+
+    // Where the pointer is now, in surface coordinates
+    bool m_pointerInside;
+    double m_pointerX;
+    double m_pointerY;
+
+    // How far it moved, and how far the vertical axis scrolled
+    double m_motionX;
+    double m_motionY;
+    double m_scroll;
+
+    uint32_t m_buttons;         // Bit (button - BTN_MOUSE) set while held
+    uint32_t m_motionEvents;    // Motion events coalesced into this frame
+
+    // Time of the oldest event in the frame, or 0 if there were none
+    uint64_t m_oldest;
+};
+
+// A window's input between the Wayland callbacks that deliver it and the
+// frame that acts on it. WaylandDisplay feeds it events as they are
+// dispatched; WaylandWindow::redraw() takes them all at once at the
+// start of each frame.
+//
+// Pointer events arrive in groups closed by wl_pointer.frame (wl_seat
+// version 5 and up). A group only becomes visible to a frame once it is
+// complete, so a button press and the motion that came with it are never
+// split across two frames. Without wl_pointer.frame every pointer event
+// is a group of its own.
+class InputQueue
+{
+public:
+    InputQueue();
+
+    void pointerEnter(double x, double y);
+    void pointerLeave();
+    void pointerMotion(double x, double y, uint64_t time);
+    void pointerButton(uint32_t serial, uint32_t button, uint32_t state, uint64_t time);
+    void pointerAxis(uint32_t axis, double value, uint64_t time);
+    void pointerFrame();
+
+    void key(uint32_t serial, uint32_t key, uint32_t state, uint64_t time);
+
+    // Makes everything queued since the last call the current frame
+    InputFrame const& beginFrame();
+    InputFrame const& current() const   { return m_current; }
+
+    // Wayland event times are milliseconds on the compositor's clock,
+    // which is CLOCK_MONOTONIC on every common compositor. Turns 'wlTime'
+    // into EventLoop::now() time if it looks like it is on the same
+    // clock as 'received', when the event was dispatched; otherwise
+    // falls back on 'received'.
+    static uint64_t eventTime(uint32_t wlTime, uint64_t received);
+
+private:
+    void touch(InputFrame& frame, uint64_t time);
+
+    InputFrame m_group;         // Pointer events before wl_pointer.frame
+    InputFrame m_pending;       // Complete, waiting for the next frame
+    InputFrame m_current;
+};
+
+// Input-to-photon latency: from each input event to the frame that first
+// reflects it reaching the screen. Every frame that took in input gives
+// one sample, measured from its oldest event, so it is the worst case
+// for that frame's input.
+//
+// Two end points are measured: eglSwapBuffers() returning, and the frame
+// callback requested with that swap. The compositor sends that callback
+// once it has used the frame, which is as close to presentation as
+// wl_shell lets a client see.
+class InputLatency
+{
+public:
+    static const int MAX_SAMPLES = 1 << 14;
+
+    InputLatency();
+
+    // Storage is taken here, so that measuring doesn't allocate per frame
+    void enable();
+    bool isEnabled() const      { return m_enabled; }
+
+    // After eglSwapBuffers() of a frame that took in 'input'
+    void frameSwapped(InputFrame const& input, uint64_t now);
+
+    // On that frame's frame callback
+    void framePresented(uint64_t now);
+
+    void printSummary(FILE* stream) const;
+
+private:
+    bool m_enabled;
+    uint64_t m_inFlight;        // Oldest input of the frame awaiting its callback
+    std::vector<double> m_swap;
+    std::vector<double> m_present;
+
+    // How much motion coalescing saved
+    uint64_t m_motionFrames;
+    uint64_t m_motionEvents;
+};
+
+#endif
@@ -0,0 +1,251 @@
+#include "job-system.hpp"
+
+// Which deque the current thread owns, and in which system: workers own
+// 1.. of theirs, and every other thread counts as 0 of any system
+static thread_local JobSystem const* s_owner = NULL;
+static thread_local int s_queue = 0;
+
+JobSystem::JobSystem(int threads)
+    : m_queued(0)
+    , m_quit(false)
+    , m_jobsRun(0)
+    , m_steals(0)
+{
+    if (threads < 1) {
+        threads = 1;
+    }
+
+    for (int i = 0; i < threads; i++) {
+        m_queues.push_back(new Queue());
+    }
+    for (int i = 1; i < threads; i++) {
+        m_threads.push_back(std::thread(&JobSystem::work, this, i));
+    }
+}
+
+JobSystem::~JobSystem()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_sleepMutex);
+        m_quit = true;
+    }
+    m_wake.notify_all();
+
+    for (size_t i = 0; i < m_threads.size(); i++) {
+        m_threads[i].join();
+    }
+    for (size_t i = 0; i < m_queues.size(); i++) {
+        delete m_queues[i];
+    }
+}
+
+void JobSystem::parallelFor(JobFunction function, void* data, size_t count, size_t grain,
+                            JobCounter& counter, JobCounter* after)
+{
+    if (count == 0) {
+        return;
+    }
+
+    Job job;
+    job.m_function = function;
+    job.m_data = data;
+    job.m_begin = 0;
+    job.m_end = count;
+    job.m_grain = grain ? grain : 1;
+    job.m_counter = &counter;
+
+    submit(job, after);
+}
+
+void JobSystem::run(JobFunction function, void* data, JobCounter& counter,
+                    JobCounter* after)
+{
+    parallelFor(function, data, 1, 1, counter, after);
+}
+
+void JobSystem::wait(JobCounter& counter)
+{
+    Job job;
+
+    while (!counter.isDone()) {
+        if (pop(job) || steal(job)) {
+            execute(job);
+            continue;
+        }
+
+        // Whatever's left is running on other threads. Sleep like an
+        // idle worker until there's something to help with or the
+        // counter is done; finish() wakes everyone for the latter.
+        std::unique_lock<std::mutex> lock(m_sleepMutex);
+        while (!counter.isDone() && m_queued.load() == 0) {
+            m_wake.wait(lock);
+        }
+    }
+
+    // The thread that finished the last job may still be holding the
+    // lock; the counter can go away once it has let go
+    std::lock_guard<std::mutex> lock(counter.m_mutex);
+}
+
+void JobSystem::submit(Job const& job, JobCounter* after)
+{
+    job.m_counter->m_pending++;
+
+    if (after) {
+        std::lock_guard<std::mutex> lock(after->m_mutex);
+
+        // finish() empties the list under the same lock, so either it
+        // sees this job or the counter is already done
+        if (!after->isDone()) {
+            after->m_continuations.push_back(job);
+            return;
+        }
+    }
+
+    push(job);
+}
+
+void JobSystem::push(Job const& job)
+{
+    Queue& queue = *m_queues[currentThread()];
+    bool queued = false;
+
+    {
+        std::lock_guard<std::mutex> lock(queue.m_mutex);
+
+        if (queue.m_tail - queue.m_head < Queue::CAPACITY) {
+            queue.m_jobs[queue.m_tail % Queue::CAPACITY] = job;
+            queue.m_tail++;
+            m_queued++;
+            queued = true;
+        }
+    }
+
+    if (!queued) {
+        // Full, so there's plenty for everyone else to be getting on with
+        execute(job);
+        return;
+    }
+
+    // Only bother the sleepers if there might be any
+    if (m_threads.size() > 0) {
+        std::lock_guard<std::mutex> lock(m_sleepMutex);
+        m_wake.notify_one();
+    }
+}
+
+bool JobSystem::pop(Job& job)
+{
+    Queue& queue = *m_queues[currentThread()];
+    std::lock_guard<std::mutex> lock(queue.m_mutex);
+
+    if (queue.m_tail == queue.m_head) {
+        return false;
+    }
+
+    queue.m_tail--;
+    job = queue.m_jobs[queue.m_tail % Queue::CAPACITY];
+    m_queued--;
+    return true;
+}
+
+bool JobSystem::steal(Job& job)
+{
+    int self = currentThread();
+    int count = m_queues.size();
+
+    for (int i = 1; i < count; i++) {
+        Queue& queue = *m_queues[(self + i) % count];
+        std::lock_guard<std::mutex> lock(queue.m_mutex);
+
+        if (queue.m_tail != queue.m_head) {
+            job = queue.m_jobs[queue.m_head % Queue::CAPACITY];
+            queue.m_head++;
+            m_queued--;
+            m_steals++;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+void JobSystem::execute(Job job)
+{
+    // Leave the back half for whoever's idle. Each split is counted so
+    // that the counter only reaches zero once every piece has run.
+    while (job.m_end - job.m_begin > job.m_grain) {
+        Job back = job;
+        back.m_begin = job.m_begin + (job.m_end - job.m_begin) / 2;
+        job.m_end = back.m_begin;
+
+        job.m_counter->m_pending++;
+        push(back);
+    }
+
+    job.m_function(job.m_data, job.m_begin, job.m_end);
+    m_jobsRun++;
+
+    finish(job.m_counter);
+}
+
+void JobSystem::finish(JobCounter* counter)
+{
+    // Anything but the last job just counts down
+    int pending = counter->m_pending.load();
+    while (pending > 1) {
+        if (counter->m_pending.compare_exchange_weak(pending, pending - 1)) {
+            return;
+        }
+    }
+
+    // The last one reaches zero under the lock, so that whoever attaches
+    // a continuation either sees the counter done or gets it run here,
+    // and so that wait() can tell when the counter is no longer in use
+    std::vector<Job> continuations;
+    {
+        std::lock_guard<std::mutex> lock(counter->m_mutex);
+        if (--counter->m_pending == 0) {
+            continuations.swap(counter->m_continuations);
+        }
+    }
+
+    for (size_t i = 0; i < continuations.size(); i++) {
+        push(continuations[i]);
+    }
+
+    // Someone may be asleep in wait() on this counter. With no workers
+    // the only thread is this one, so nobody is.
+    if (m_threads.size() > 0) {
+        std::lock_guard<std::mutex> lock(m_sleepMutex);
+        m_wake.notify_all();
+    }
+}
+
+void JobSystem::work(int index)
+{
+    s_owner = this;
+    s_queue = index;
+    Job job;
+
+    for (;;) {
+        if (pop(job) || steal(job)) {
+            execute(job);
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(m_sleepMutex);
+        while (!m_quit && m_queued.load() == 0) {
+            m_wake.wait(lock);
+        }
+        if (m_quit) {
+            return;
+        }
+    }
+}
+
+int JobSystem::currentThread() const
+{
+    // Workers of another JobSystem count as outsiders too
+    return s_owner == this ? s_queue : 0;
+}
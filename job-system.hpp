@@ -0,0 +1,149 @@
+#ifndef __JOB_SYSTEM_HPP__
+#define __JOB_SYSTEM_HPP__
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class JobSystem;
+
+// Work over the range [begin, end) of whatever 'data' indexes
+typedef void (*JobFunction)(void* data, size_t begin, size_t end);
+
+struct Job
+{
+    JobFunction m_function;
+    void* m_data;
+    size_t m_begin;
+    size_t m_end;
+    size_t m_grain;             // Ranges longer than this get split
+
+    class JobCounter* m_counter;
+};
+
+// Counts jobs that haven't finished. JobSystem::wait() blocks on one,
+// and jobs can be made to start only once one has reached zero. Can be
+// reused once it has.
+class JobCounter
+{
+public:
+    JobCounter()
+        : m_pending(0)
+    {
+    }
+
+    bool isDone() const         { return m_pending.load() == 0; }
+
+private:
+    friend class JobSystem;
+
+    std::atomic<int> m_pending;
+
+    // Jobs waiting for this to reach zero
+    std::mutex m_mutex;
+    std::vector<Job> m_continuations;
+};
+
+// A work-stealing thread pool for per-frame CPU work. Every thread, the
+// caller included, has a deque of jobs: it pushes and pops at the back,
+// so what it works on next is what it last split off and is still warm
+// in its cache, while idle threads steal from the front, where the
+// biggest ranges are. Ranges are split lazily: a thread halves its
+// range and pushes the back half only while it's longer than the grain,
+// so an even load costs a handful of pushes and an uneven one gets
+// rebalanced by stealing.
+//
+//     JobCounter transformed;
+//     jobs.parallelFor(transformCubes, this, cubeCount, 64, transformed);
+//
+//     // Sorting waits for the transforms, without blocking anyone
+//     JobCounter sorted;
+//     jobs.run(sortCubes, this, sorted, &transformed);
+//
+//     jobs.wait(sorted);       // helps out until done
+//     ...GL calls...
+//
+// Jobs mustn't call GL: only the thread that created the window has the
+// context. They can schedule more jobs and wait on counters.
+class JobSystem
+{
+public:
+    // 'threads' counts the caller, so 1 runs everything in wait()
+    JobSystem(int threads);
+    ~JobSystem();
+
+    int threads() const         { return m_queues.size(); }
+
+    // Which of those the calling thread is, from 0 to threads() - 1, for
+    // indexing per-thread scratch space. The constructing thread, and
+    // any other thread that isn't one of this system's workers
+    // (including another system's), is 0, so only one of those may use
+    // it at a time.
+    int currentThread() const;
+
+    // Calls function(data, begin, end) over subranges of [0, count), none
+    // longer than 'grain', counted against 'counter'. With 'after', no
+    // part of it starts until that counter has reached zero.
+    void parallelFor(JobFunction function, void* data, size_t count, size_t grain,
+                     JobCounter& counter, JobCounter* after = NULL);
+
+    // One job, called as function(data, 0, 1)
+    void run(JobFunction function, void* data, JobCounter& counter,
+             JobCounter* after = NULL);
+
+    // Runs jobs until 'counter' reaches zero, sleeping while the rest of
+    // its jobs are running elsewhere
+    void wait(JobCounter& counter);
+
+    // Since construction: jobs run (splits included) and jobs taken from
+    // another thread's deque
+    uint64_t jobsRun() const    { return m_jobsRun.load(); }
+    uint64_t steals() const     { return m_steals.load(); }
+
+private:
+    // A bounded deque; when full, pushers run the job themselves
+    struct Queue
+    {
+        static const size_t CAPACITY = 4096;
+
+        Queue()
+            : m_head(0)
+            , m_tail(0)
+            , m_jobs(CAPACITY)
+        {
+        }
+
+        std::mutex m_mutex;
+        size_t m_head;          // Steal from here
+        size_t m_tail;          // Push and pop here
+        std::vector<Job> m_jobs;
+    };
+
+    void submit(Job const& job, JobCounter* after);
+    void push(Job const& job);
+    bool pop(Job& job);
+    bool steal(Job& job);
+    void execute(Job job);
+    void finish(JobCounter* counter);
+
+    void work(int index);
+
+    std::vector<Queue*> m_queues;
+    std::vector<std::thread> m_threads;
+
+    // Jobs sitting in any deque, for sleeping workers to wait on
+    std::atomic<int> m_queued;
+    std::mutex m_sleepMutex;
+    std::condition_variable m_wake;
+    bool m_quit;
+
+    std::atomic<uint64_t> m_jobsRun;
+    std::atomic<uint64_t> m_steals;
+};
+
+#endif
@@ -0,0 +1,237 @@
+#include <cmath>
+#include <cstdio>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <vector>
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "command-list.hpp"
+#include "job-system.hpp"
+#include "transforms.hpp"
+
+// How the job system scales. Each frame spins every cube of a large
+// field, works out its Transforms as a demo's drawGl() would, then, as
+// jobs that wait on those, counts the cubes whose centres land inside
+// the view volume. The same frames are run with 1, 2, ... up to
+// THREADS threads (by default one per CPU) and the time per frame is
+// reported against one thread's.
+//
+// Then the same again for recording CommandLists for 10000 of those
+// cubes, each drawn with its own program, buffer, attribute and matrix
+// commands. Recording doesn't touch GL, so this is all of what moves
+// off the GL thread; replaying is measured by drawlists.
+//
+// No window or GL context is involved, so nothing else competes for the
+// CPUs; run it on an otherwise idle machine.
+//
+// Usage: jobbench [CUBES] [THREADS] [FRAMES]
+
+// Cubes per job, small enough to give every thread several
+static const size_t GRAIN = 256;
+
+// Draws recorded, and draws per CommandList
+static const size_t DRAWS = 10000;
+static const size_t DRAWS_PER_LIST = 100;
+
+struct Field
+{
+    int m_side;
+    float m_time;
+
+    glm::mat4 m_view;
+    glm::mat4 m_projection;
+
+    std::vector<Transforms> m_transforms;
+    std::atomic<size_t> m_visible;
+
+    JobSystem* m_jobs;
+    CommandArenas m_arenas;
+    std::vector<CommandList> m_lists;
+};
+
+static double nowMs()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000.0 + ts.tv_nsec / 1000000.0;
+}
+
+static void transformCubes(void* data, size_t begin, size_t end)
+{
+    Field* field = static_cast<Field*>(data);
+
+    for (size_t i = begin; i < end; i++) {
+        float x = float(i % field->m_side) - field->m_side / 2.0f;
+        float z = float(i / field->m_side) - field->m_side / 2.0f;
+
+        glm::mat4 model = glm::translate(glm::mat4(1.0f), glm::vec3(x * 2.5f, 0.0f, -z * 2.5f));
+        model = glm::rotate(model, field->m_time + i * 0.01f, glm::vec3(0.3f, 1.0f, 0.2f));
+
+        field->m_transforms[i] = Transforms(model, field->m_view, field->m_projection);
+    }
+}
+
+static void countVisible(void* data, size_t begin, size_t end)
+{
+    Field* field = static_cast<Field*>(data);
+    size_t visible = 0;
+
+    for (size_t i = begin; i < end; i++) {
+        glm::vec4 clip = field->m_transforms[i].m_mvp[3];
+
+        if (std::fabs(clip.x) <= clip.w && std::fabs(clip.y) <= clip.w &&
+            std::fabs(clip.z) <= clip.w) {
+            visible++;
+        }
+    }
+
+    field->m_visible += visible;
+}
+
+static void recordCubes(void* data, size_t begin, size_t end)
+{
+    Field* field = static_cast<Field*>(data);
+
+    // Names as a demo would have them; nothing here calls GL
+    static const GLuint PROGRAM = 1;
+    static const GLuint VERTICES = 1;
+    static const GLuint INDICES = 2;
+    static const GLint U_MVP = 0;
+    static const GLint U_COLOR = 1;
+
+    for (size_t l = begin; l < end; l++) {
+        CommandList& list = field->m_lists[l];
+        list.begin(field->m_arenas.current(*field->m_jobs));
+
+        for (size_t i = l * DRAWS_PER_LIST; i < (l + 1) * DRAWS_PER_LIST; i++) {
+            list.useProgram(PROGRAM);
+            list.bindBuffer(GL_ARRAY_BUFFER, VERTICES);
+            list.bindBuffer(GL_ELEMENT_ARRAY_BUFFER, INDICES);
+            list.vertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, 0);
+            list.enableVertexAttribArray(0);
+            list.uniformMatrix4fv(U_MVP, &field->m_transforms[i].m_mvp[0][0]);
+            list.uniform4f(U_COLOR, (i % 7) / 7.0f, (i % 11) / 11.0f, (i % 13) / 13.0f, 1);
+            list.drawElements(GL_TRIANGLES, 36, GL_UNSIGNED_SHORT, 0);
+        }
+    }
+}
+
+// Milliseconds per frame
+static double runFrames(JobSystem& jobs, Field& field, int frames)
+{
+    JobCounter transformed;
+    JobCounter counted;
+
+    double start = nowMs();
+
+    for (int frame = 0; frame < frames; frame++) {
+        field.m_time = frame / 60.0f;
+        field.m_visible = 0;
+
+        size_t count = field.m_transforms.size();
+        jobs.parallelFor(transformCubes, &field, count, GRAIN, transformed);
+        jobs.parallelFor(countVisible, &field, count, GRAIN, counted, &transformed);
+        jobs.wait(counted);
+    }
+
+    return (nowMs() - start) / frames;
+}
+
+static double recordFrames(JobSystem& jobs, Field& field, int frames)
+{
+    JobCounter recorded;
+
+    field.m_jobs = &jobs;
+    double start = nowMs();
+
+    for (int frame = 0; frame < frames; frame++) {
+        field.m_arenas.reset(jobs);
+        jobs.parallelFor(recordCubes, &field, field.m_lists.size(), 1, recorded);
+        jobs.wait(recorded);
+    }
+
+    return (nowMs() - start) / frames;
+}
+
+static void printRow(int threads, double ms, double baseline, uint64_t steals, int frames)
+{
+    printf("%7d  %8.3f  %6.2fx  %9.0f%%  %12.1f\n", threads, ms,
+           baseline / ms, 100 * baseline / ms / threads, double(steals) / frames);
+}
+
+int main(int argc, char* argv[])
+{
+    int cubes = argc > 1 ? atoi(argv[1]) : 65536;
+    int maxThreads = argc > 2 ? atoi(argv[2]) : sysconf(_SC_NPROCESSORS_ONLN);
+    int frames = argc > 3 ? atoi(argv[3]) : 200;
+
+    if (cubes <= 0 || maxThreads <= 0 || frames <= 0) {
+        fprintf(stderr, "Usage: %s [CUBES] [THREADS] [FRAMES]\n", argv[0]);
+        exit(EXIT_FAILURE);
+    }
+
+    Field field;
+    field.m_side = ceil(sqrt(cubes));
+    field.m_view = glm::lookAt(glm::vec3(0.0f, 20.0f, 30.0f), glm::vec3(0.0f, 0.0f, 0.0f),
+                               glm::vec3(0.0f, 1.0f, 0.0f));
+    field.m_projection = glm::perspective(0.8f, 16.0f / 9.0f, 0.5f, 500.0f);
+    field.m_transforms.resize(cubes, Transforms(glm::mat4(1.0f), glm::mat4(1.0f),
+                                                glm::mat4(1.0f)));
+
+    printf("%d cubes, %d frames, %zu per job\n", cubes, frames, GRAIN);
+    printf("threads  ms/frame  speedup  efficiency  steals/frame\n");
+
+    double baseline = 0;
+    size_t visible = 0;
+
+    for (int threads = 1; threads <= maxThreads; threads++) {
+        JobSystem jobs(threads);
+
+        // One frame to start the workers and fault everything in
+        runFrames(jobs, field, 1);
+        uint64_t steals = jobs.steals();
+
+        double ms = runFrames(jobs, field, frames);
+        if (threads == 1) {
+            baseline = ms;
+            visible = field.m_visible;
+        }
+        else if (field.m_visible != visible) {
+            fprintf(stderr, "%d threads saw %zu visible cubes, 1 thread saw %zu\n",
+                    threads, size_t(field.m_visible), visible);
+            exit(EXIT_FAILURE);
+        }
+
+        printRow(threads, ms, baseline, jobs.steals() - steals, frames);
+    }
+
+    if ((size_t)cubes < DRAWS) {
+        return EXIT_SUCCESS;
+    }
+
+    field.m_lists.resize(DRAWS / DRAWS_PER_LIST);
+
+    printf("\nRecording %zu draws, %zu per list\n", DRAWS, DRAWS_PER_LIST);
+    printf("threads  ms/frame  speedup  efficiency  steals/frame\n");
+
+    for (int threads = 1; threads <= maxThreads; threads++) {
+        JobSystem jobs(threads);
+
+        // Also grows the arenas to fit
+        recordFrames(jobs, field, 1);
+        uint64_t steals = jobs.steals();
+
+        double ms = recordFrames(jobs, field, frames);
+        if (threads == 1) {
+            baseline = ms;
+        }
+
+        printRow(threads, ms, baseline, jobs.steals() - steals, frames);
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,285 @@
+#include <cmath>
+#include <cstdio>
+#include <stdlib.h>
+#include <string>
+#include <unistd.h>
+
+#include "base.hpp"
+#include "shader.hpp"
+
+// Compositor-assisted composition. A window made of three kinds of
+// content: an expensive backdrop that only changes with the window
+// size, a status panel that changes once a second, and a spinning
+// triangle that changes every frame.
+//
+// Layered (the default), the backdrop is a layer below the window's
+// surface and the panel a layer above it, both opaque. Each is
+// drawn only when it changes, and drawGl() draws just the triangle
+// onto a transparent surface. Flat, everything is drawn into the one
+// opaque surface every frame.
+//
+// Prints the frame rate and the client's CPU time per frame every few
+// seconds; run with -p for GPU time per pass and -u for the whole
+// process. Layering trades client work for compositor work (the window
+// surface now has to be blended over the backdrop), so compare both
+// modes against the compositor's own CPU and GPU usage too, e.g. under
+// weston --backend=headless-backend.so.
+//
+// Usage: layers [window options] [flat]
+
+static const char* vert_shader_text =
+    "attribute vec2 a_pos;\n"
+    "void main() {\n"
+    "  gl_Position = vec4(a_pos, 0, 1);\n"
+    "}\n";
+
+// Interference of 48 plane waves; the loop is what makes it worth not
+// redrawing every frame
+static const char* backdrop_shader_text =
+    "precision mediump float;\n"
+    "uniform vec2 u_size;\n"
+    "void main() {\n"
+    "  vec2 p = (gl_FragCoord.xy * 2.0 - u_size) / min(u_size.x, u_size.y) * 24.0;\n"
+    "  float v = 0.0;\n"
+    "  for (int i = 0; i < 48; i++) {\n"
+    "    float a = float(i) * 0.4488;\n"
+    "    v += cos(dot(p, vec2(cos(a), sin(a))) * (1.0 + float(i / 7) * 0.1));\n"
+    "  }\n"
+    "  v /= 12.0;\n"
+    "  gl_FragColor = vec4((0.5 + 0.5 * cos(vec3(0.0, 1.0, 2.0) + v)) * vec3(0.25, 0.3, 0.5), 1.0);\n"
+    "}\n";
+
+static const char* triangle_vert_shader_text =
+    "uniform mat2 u_rotation;\n"
+    "attribute vec2 a_pos;\n"
+    "attribute vec3 a_color;\n"
+    "varying vec3 v_color;\n"
+    "void main() {\n"
+    "  gl_Position = vec4(u_rotation * a_pos, 0, 1);\n"
+    "  v_color = a_color;\n"
+    "}\n";
+
+static const char* triangle_frag_shader_text =
+    "precision mediump float;\n"
+    "varying vec3 v_color;\n"
+    "void main() {\n"
+    "  gl_FragColor = vec4(v_color, 1);\n"
+    "}\n";
+
+// Frames between reports
+static const uint32_t REPORT_INTERVAL = 300;
+
+// The panel: a row of cells, one more lit each second
+static const int PANEL_CELLS = 10;
+static const int PANEL_CELL_SIZE = 20;
+static const int PANEL_GAP = 4;
+static const int PANEL_MARGIN = 16;
+static const int PANEL_WIDTH = PANEL_CELLS * (PANEL_CELL_SIZE + PANEL_GAP) + PANEL_GAP;
+static const int PANEL_HEIGHT = PANEL_CELL_SIZE + 2 * PANEL_GAP;
+
+class LayersWindow: public WaylandWindow
+{
+public:
+    LayersWindow()
+        : m_backdropLayer(-1)
+        , m_panelLayer(-1)
+        , m_second(0)
+        , m_layerDraws(0)
+    {
+    }
+
+    virtual ~LayersWindow() {}
+
+    void setLayered(bool layered)
+    {
+        if (!layered) {
+            return;
+        }
+
+        m_backdropLayer = addLayer(LAYER_BELOW, true);
+        m_panelLayer = addLayer(LAYER_ABOVE, true);
+
+        if (m_backdropLayer < 0 || m_panelLayer < 0) {
+            printf("No wl_subcompositor; drawing flat\n");
+            return;
+        }
+
+        setLayerGeometry(m_panelLayer, PANEL_MARGIN, PANEL_MARGIN,
+                         PANEL_WIDTH, PANEL_HEIGHT);
+
+        // The backdrop shows through wherever the triangle isn't
+        setOpaque(false);
+    }
+
+    bool isLayered() const      { return m_backdropLayer >= 0 && m_panelLayer >= 0; }
+
+protected:
+    virtual void setupGl()
+    {
+        static char const* const attribs[] = { "a_pos", "a_color", NULL };
+
+        GLuint vert = createShader(vert_shader_text, GL_VERTEX_SHADER);
+        GLuint frag = createShader(backdrop_shader_text, GL_FRAGMENT_SHADER);
+        m_backdropProgram = linkProgram(vert, frag, attribs);
+        GpuResources::deleteShader(vert);
+        GpuResources::deleteShader(frag);
+
+        vert = createShader(triangle_vert_shader_text, GL_VERTEX_SHADER);
+        frag = createShader(triangle_frag_shader_text, GL_FRAGMENT_SHADER);
+        m_triangleProgram = linkProgram(vert, frag, attribs);
+        GpuResources::deleteShader(vert);
+        GpuResources::deleteShader(frag);
+
+        m_uSize = glGetUniformLocation(m_backdropProgram, "u_size");
+        m_uRotation = glGetUniformLocation(m_triangleProgram, "u_rotation");
+    }
+
+    virtual void drawLayer(int layer, uint32_t time)
+    {
+        m_layerDraws++;
+
+        if (layer == m_backdropLayer) {
+            drawBackdrop(layerSize(layer));
+        }
+        else if (layer == m_panelLayer) {
+            drawPanel(0, 0);
+        }
+    }
+
+    virtual void drawGl(uint32_t time)
+    {
+        Size const& size = currentSize();
+        glViewport(0, 0, size.m_width, size.m_height);
+
+        uint32_t second = time / 1000;
+        if (second != m_second) {
+            m_second = second;
+            if (isLayered()) {
+                invalidateLayer(m_panelLayer);
+            }
+        }
+
+        if (isLayered()) {
+            glClearColor(0, 0, 0, 0);
+            glClear(GL_COLOR_BUFFER_BIT);
+            drawTriangle(time);
+        }
+        else {
+            drawBackdrop(size);
+            drawTriangle(time);
+
+            // Where the layer would be: GL's origin is at the bottom
+            drawPanel(PANEL_MARGIN, size.m_height - PANEL_MARGIN - PANEL_HEIGHT);
+        }
+
+        uint32_t frames = frameStats().frameCount();
+        if (frames > 0 && frames % REPORT_INTERVAL == 0) {
+            printf("%s %ux%u: %.1f fps, %.2f ms CPU/frame, %u layer redraws\n",
+                   isLayered() ? "layered" : "flat", size.m_width, size.m_height,
+                   frameStats().fps(), frameStats().cpuTimeMs(), m_layerDraws);
+        }
+    }
+
+    virtual void teardownGl()
+    {
+        GpuResources::deleteProgram(m_backdropProgram);
+        GpuResources::deleteProgram(m_triangleProgram);
+    }
+
+private:
+    void drawBackdrop(Size const& size)
+    {
+        static const GLfloat triangle[] = {
+            -1, -1,
+            +3, -1,
+            -1, +3,
+        };
+
+        glUseProgram(m_backdropProgram);
+        glUniform2f(m_uSize, size.m_width, size.m_height);
+
+        glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 0, triangle);
+        glEnableVertexAttribArray(0);
+        glDrawArrays(GL_TRIANGLES, 0, 3);
+        recordDraw(GL_TRIANGLES, 3);
+        glDisableVertexAttribArray(0);
+    }
+
+    void drawTriangle(uint32_t time)
+    {
+        static const GLfloat verts[] = {
+            -0.433f, -0.25f,
+            +0.433f, -0.25f,
+             0.000f, +0.5f,
+        };
+        static const GLfloat colors[] = {
+            1, 0.3f, 0.3f,
+            0.3f, 1, 0.3f,
+            0.3f, 0.3f, 1,
+        };
+
+        float angle = time / 1000.0f;
+        GLfloat rotation[] = {
+            cosf(angle), sinf(angle),
+            -sinf(angle), cosf(angle),
+        };
+
+        glUseProgram(m_triangleProgram);
+        glUniformMatrix2fv(m_uRotation, 1, GL_FALSE, rotation);
+
+        glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 0, verts);
+        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 0, colors);
+        glEnableVertexAttribArray(0);
+        glEnableVertexAttribArray(1);
+        glDrawArrays(GL_TRIANGLES, 0, 3);
+        recordDraw(GL_TRIANGLES, 3);
+        glDisableVertexAttribArray(0);
+        glDisableVertexAttribArray(1);
+    }
+
+    // Cells are scissored clears, so no draws and no shaders
+    void drawPanel(GLint x, GLint y)
+    {
+        int lit = m_second % PANEL_CELLS + 1;
+
+        glEnable(GL_SCISSOR_TEST);
+        glScissor(x, y, PANEL_WIDTH, PANEL_HEIGHT);
+        glClearColor(0.05f, 0.05f, 0.05f, 1);
+        glClear(GL_COLOR_BUFFER_BIT);
+
+        for (int i = 0; i < PANEL_CELLS; i++) {
+            if (i < lit) {
+                glClearColor(0.3f, 0.9f, 0.4f, 1);
+            }
+            else {
+                glClearColor(0.15f, 0.15f, 0.15f, 1);
+            }
+            glScissor(x + PANEL_GAP + i * (PANEL_CELL_SIZE + PANEL_GAP), y + PANEL_GAP,
+                      PANEL_CELL_SIZE, PANEL_CELL_SIZE);
+            glClear(GL_COLOR_BUFFER_BIT);
+        }
+        glDisable(GL_SCISSOR_TEST);
+    }
+
+    GLuint m_backdropProgram;
+    GLuint m_triangleProgram;
+    GLint m_uSize;
+    GLint m_uRotation;
+
+    int m_backdropLayer;
+    int m_panelLayer;
+    uint32_t m_second;
+    uint32_t m_layerDraws;
+};
+
+int main(int argc, char* argv[])
+{
+    LayersWindow w;
+    w.init(&argc, argv);
+
+    // Positional arguments are what's left after the window options
+    w.setLayered(!(optind < argc && std::string(argv[optind]) == "flat"));
+
+    w.run();
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,274 @@
+#include <cmath>
+#include <cstdio>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/type_ptr.hpp>
+
+#include "base.hpp"
+#include "mesh-lod.hpp"
+#include "shader.hpp"
+#include "transforms.hpp"
+
+// A field of geodesic spheres stretching away from the camera, each one
+// drawn at the level of detail its size on screen calls for. Every
+// REPORT_INTERVAL frames prints how many triangles were submitted
+// against how many drawing every sphere at full detail would have
+// taken, and how many spheres were at each level.
+//
+// Usage: lod [window options] [pixel-error] [fade-range]
+//
+// 'pixel-error' is how far, in pixels, a level's surface may stray from
+// the full-detail one (default 1; 0 turns LOD off). 'fade-range' is how
+// far past that, as a fraction, the next level starts cross-fading in
+// (default 0.5; 0 switches levels abruptly).
+
+static const char* vert_shader_text =
+    "uniform mat4 u_mvp;\n"
+    "uniform mat3 u_normal_matrix;\n"
+    "uniform vec3 u_color;\n"
+
+    "attribute vec3 a_pos;\n"
+
+    "varying vec3 v_color;\n"
+
+    "void main() {\n"
+    "  gl_Position = u_mvp * vec4(a_pos, 1);\n"
+
+    "  // On a unit sphere the position is the normal\n"
+    "  vec3 norm = normalize(u_normal_matrix * a_pos);\n"
+    "  float lambert = max(dot(norm, normalize(vec3(0.5, 1, 1))), 0.0);\n"
+    "  v_color = u_color * (0.3 + 0.7 * lambert);\n"
+    "}\n";
+
+static const char* frag_shader_text =
+    "precision mediump float;\n"
+    LOD_DITHER_GLSL
+    "varying vec3 v_color;\n"
+    "void main() {\n"
+    "  lodDither();\n"
+    "  gl_FragColor = vec4(v_color, 1);\n"
+    "}\n";
+
+// Frames between reports
+static const uint32_t REPORT_INTERVAL = 120;
+
+// Geodesic subdivisions of the finest level: 5120 triangles
+static const int SUBDIVISIONS = 4;
+
+// The field: COLUMNS wide, ROWS deep, SPACING apart
+static const int COLUMNS = 11;
+static const int ROWS = 20;
+static const float SPACING = 2.5f;
+static const float RADIUS = 0.8f;
+
+// Vertical field of view, in radians
+static const float FOVY = 0.8f;
+
+class LodWindow: public WaylandWindow
+{
+public:
+    LodWindow()
+        : m_pixelError(1.0f)
+        , m_fadeRange(0.5f)
+        , m_program(0)
+        , m_uColor(-1)
+        , m_uFade(-1)
+        , m_uSide(-1)
+        , m_submitted(0)
+        , m_fullDetail(0)
+    {
+        for (int i = 0; i <= SUBDIVISIONS; i++) {
+            m_levelUse[i] = 0;
+        }
+    }
+
+    virtual ~LodWindow()
+    {
+    }
+
+    void setPixelError(float pixelError)    { m_pixelError = pixelError; }
+    void setFadeRange(float fadeRange)      { m_fadeRange = fadeRange; }
+
+protected:
+    virtual std::vector<EGLint> requiredEglConfigAttribs()
+    {
+        std::vector<EGLint> ret;
+        ret.push_back(EGL_DEPTH_SIZE);
+        ret.push_back(16);
+        return ret;
+    }
+
+    virtual void setupGl()
+    {
+        static char const* const attribs[] = { "a_pos", NULL };
+
+        GLuint vert = createShader(vert_shader_text, GL_VERTEX_SHADER);
+        GLuint frag = createShader(frag_shader_text, GL_FRAGMENT_SHADER);
+        m_program = linkProgram(vert, frag, attribs);
+        GpuResources::deleteShader(vert);
+        GpuResources::deleteShader(frag);
+
+        m_transforms.locate(m_program);
+        m_uColor = glGetUniformLocation(m_program, "u_color");
+        m_uFade = glGetUniformLocation(m_program, "u_lod_fade");
+        m_uSide = glGetUniformLocation(m_program, "u_lod_side");
+
+        buildGeodesicSphere(m_mesh, SUBDIVISIONS);
+
+        // Subdivision leaves triangles in a cache-hostile order
+        m_mesh.optimize(3 * sizeof(GLfloat), stdout);
+        m_mesh.setupGl();
+    }
+
+    virtual void drawGl(uint32_t time)
+    {
+        Size const& size = currentSize();
+        glViewport(0, 0, size.m_width, size.m_height);
+
+        glClearColor(0.1, 0.1, 0.15, 1.0);
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        glEnable(GL_DEPTH_TEST);
+
+        // Dolly in and out so that spheres keep crossing level boundaries
+        float t = time / 1000.0f;
+        glm::vec3 eye(0, 1.5f, 4 - 6 * (1 - cosf(t * 0.3f)));
+
+        float aspect = size.m_width * 1.0f / size.m_height;
+        float zNear = 0.5f, zFar = 100.0f;
+        float top = zNear * tanf(FOVY / 2);
+        glm::mat4 projection = glm::frustum(-top * aspect, top * aspect, -top, top, zNear, zFar);
+        glm::mat4 view = glm::translate(glm::mat4(1.f), -eye);
+
+        float scale = LodMesh::screenScale(size.m_height, FOVY);
+
+        glUseProgram(m_program);
+        m_mesh.bindVertices();
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, 0);
+        glEnableVertexAttribArray(0);
+
+        for (int row = 0; row < ROWS; row++) {
+            for (int column = 0; column < COLUMNS; column++) {
+                glm::vec3 center((column - COLUMNS / 2) * SPACING, 0, -row * SPACING);
+                glm::mat4 model = glm::scale(glm::translate(glm::mat4(1.f), center),
+                                             glm::vec3(RADIUS));
+
+                // Level errors are for the unit sphere, so scale the
+                // distance down rather than every error up
+                float distance = (glm::length(center - eye) - RADIUS) / RADIUS;
+
+                LodMesh::Selection lod;
+                if (m_pixelError > 0) {
+                    lod = m_mesh.select(scale, distance, m_pixelError, m_fadeRange);
+                } else {
+                    lod.m_level = 0;
+                    lod.m_fadeLevel = -1;
+                    lod.m_fade = 0;
+                }
+
+                m_transforms.upload(Transforms(model, view, projection));
+                glUniform3f(m_uColor,
+                            0.5f + 0.5f * column / COLUMNS,
+                            0.6f,
+                            1.0f - 0.5f * row / ROWS);
+
+                drawSphere(lod);
+            }
+        }
+
+        glDisableVertexAttribArray(0);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+        glDisable(GL_DEPTH_TEST);
+
+        report();
+    }
+
+    virtual void teardownGl()
+    {
+        m_mesh.teardownGl();
+        GpuResources::deleteProgram(m_program);
+    }
+
+private:
+    void drawSphere(LodMesh::Selection const& lod)
+    {
+        glUniform1f(m_uFade, lod.m_fade);
+        glUniform1f(m_uSide, 1);
+        submit(lod.m_level);
+
+        if (lod.m_fadeLevel >= 0) {
+            glUniform1f(m_uSide, -1);
+            submit(lod.m_fadeLevel);
+        }
+
+        m_fullDetail += m_mesh.triangleCount(0);
+    }
+
+    void submit(int level)
+    {
+        GLsizei indices = m_mesh.drawLevel(level);
+        recordDraw(GL_TRIANGLES, indices);
+
+        m_submitted += indices / 3;
+        m_levelUse[level]++;
+    }
+
+    void report()
+    {
+        uint32_t frames = frameStats().frameCount();
+        if (frames == 0 || frames % REPORT_INTERVAL != 0) {
+            return;
+        }
+
+        printf("LOD %s: %.0f triangles per frame, %.0f at full detail (%.1f%%), %.1f fps\n",
+               m_pixelError > 0 ? "on" : "off",
+               m_submitted / (double)REPORT_INTERVAL,
+               m_fullDetail / (double)REPORT_INTERVAL,
+               100.0 * m_submitted / m_fullDetail,
+               frameStats().fps());
+
+        // Draws per level, counting both halves of a cross-fade
+        printf("    draws per level (finest first):");
+        for (int i = 0; i < m_mesh.levelCount(); i++) {
+            printf(" %.1f", m_levelUse[i] / (double)REPORT_INTERVAL);
+            m_levelUse[i] = 0;
+        }
+        printf("\n");
+
+        m_submitted = m_fullDetail = 0;
+    }
+
+    float m_pixelError;
+    float m_fadeRange;
+
+    LodMesh m_mesh;
+    GLuint m_program;
+    TransformUniforms m_transforms;
+    GLint m_uColor;
+    GLint m_uFade;
+    GLint m_uSide;
+
+    uint64_t m_submitted;
+    uint64_t m_fullDetail;
+    uint32_t m_levelUse[SUBDIVISIONS + 1];
+};
+
+int main(int argc, char* argv[])
+{
+    LodWindow w;
+    w.init(&argc, argv);
+
+    // Positional arguments are what's left after the window options
+    if (optind < argc) {
+        w.setPixelError(atof(argv[optind++]));
+    }
+    if (optind < argc) {
+        w.setFadeRange(atof(argv[optind++]));
+    }
+
+    w.run();
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,268 @@
+#include <assert.h>
+#include <cmath>
+#include <cstring>
+
+#include <algorithm>
+#include <map>
+#include <utility>
+
+#include "gpu-resources.hpp"
+#include "mesh-lod.hpp"
+#include "mesh-optimizer.hpp"
+
+LodMesh::LodMesh()
+    : m_vertexBuffer(0)
+{
+}
+
+LodMesh::~LodMesh()
+{
+}
+
+void LodMesh::setVertices(void const* data, GLsizeiptr size)
+{
+    m_vertices.assign((char const*)data, (char const*)data + size);
+}
+
+void LodMesh::addLevel(std::vector<GLushort> const& indices, float error)
+{
+    Level level;
+    level.m_indices = indices;
+    level.m_indexBuffer = 0;
+    level.m_indexCount = indices.size();
+    level.m_error = error;
+    m_levels.push_back(level);
+}
+
+void LodMesh::optimize(size_t stride, FILE* report)
+{
+    size_t vertexCount = m_vertices.size() / stride;
+    std::vector<VertexCacheStats> before;
+    std::vector<GLushort> all;
+
+    for (size_t i = 0; i < m_levels.size(); i++) {
+        std::vector<GLushort>& indices = m_levels[i].m_indices;
+
+        before.push_back(analyzeVertexCache(indices, vertexCount));
+        optimizeVertexCache(indices, vertexCount);
+        optimizeOverdraw(indices, &m_vertices[0], stride, vertexCount);
+        all.insert(all.end(), indices.begin(), indices.end());
+    }
+
+    // Vertices that only coarser levels use go after the finest level's
+    std::vector<uint32_t> remap;
+    size_t used = optimizeVertexFetchRemap(all, vertexCount, remap);
+
+    std::vector<char> vertices(used * stride);
+    remapVertices(&vertices[0], MeshStream(&m_vertices[0], stride), vertexCount, remap);
+    m_vertices.swap(vertices);
+
+    for (size_t i = 0; i < m_levels.size(); i++) {
+        remapIndices(m_levels[i].m_indices, remap);
+
+        if (report) {
+            char name[64];
+            snprintf(name, sizeof(name), "level %zu (%zu triangles)", i,
+                     m_levels[i].m_indices.size() / 3);
+            printVertexCacheStats(report, name, before[i],
+                                  analyzeVertexCache(m_levels[i].m_indices, used));
+        }
+    }
+}
+
+void LodMesh::setupGl()
+{
+    m_vertexBuffer = GpuResources::createBuffer("LodMesh vertices");
+    glBindBuffer(GL_ARRAY_BUFFER, m_vertexBuffer);
+    GpuResources::bufferData(m_vertexBuffer, GL_ARRAY_BUFFER, m_vertices.size(), &m_vertices[0],
+                             GL_STATIC_DRAW);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    for (size_t i = 0; i < m_levels.size(); i++) {
+        Level& level = m_levels[i];
+
+        level.m_indexBuffer = GpuResources::createBuffer("LodMesh indices");
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, level.m_indexBuffer);
+        GpuResources::bufferData(level.m_indexBuffer, GL_ELEMENT_ARRAY_BUFFER,
+                                 level.m_indices.size() * sizeof(GLushort),
+                                 &level.m_indices[0], GL_STATIC_DRAW);
+    }
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+}
+
+void LodMesh::teardownGl()
+{
+    GpuResources::deleteBuffer(m_vertexBuffer);
+    m_vertexBuffer = 0;
+
+    for (size_t i = 0; i < m_levels.size(); i++) {
+        GpuResources::deleteBuffer(m_levels[i].m_indexBuffer);
+        m_levels[i].m_indexBuffer = 0;
+    }
+}
+
+float LodMesh::screenScale(float viewportHeight, float fovy)
+{
+    return viewportHeight / (2 * tanf(fovy / 2));
+}
+
+LodMesh::Selection LodMesh::select(float screenScale, float distance,
+                                   float pixelError, float fadeRange) const
+{
+    assert(!m_levels.empty());
+
+    Selection selection;
+    selection.m_level = 0;
+    selection.m_fadeLevel = -1;
+    selection.m_fade = 0;
+
+    // Inside the object, or a zero threshold: nothing but the finest will do
+    if (distance <= 0 || pixelError <= 0) {
+        return selection;
+    }
+
+    float pixelsPerUnit = screenScale / distance;
+
+    // Errors grow with each coarser level, so stop at the first one that
+    // shows
+    int level = 0;
+    while (level + 1 < (int)m_levels.size() &&
+           m_levels[level + 1].m_error * pixelsPerUnit <= pixelError) {
+        level++;
+    }
+    selection.m_level = level;
+
+    // Fade towards the next level over the last stretch before it would
+    // be picked: fully faded in exactly where it takes over
+    if (fadeRange > 0 && level + 1 < (int)m_levels.size()) {
+        float over = m_levels[level + 1].m_error * pixelsPerUnit / pixelError - 1;
+        if (over < fadeRange) {
+            selection.m_fadeLevel = level + 1;
+            selection.m_fade = 1 - over / fadeRange;
+        }
+    }
+
+    return selection;
+}
+
+void LodMesh::bindVertices() const
+{
+    glBindBuffer(GL_ARRAY_BUFFER, m_vertexBuffer);
+}
+
+GLsizei LodMesh::drawLevel(int level) const
+{
+    Level const& l = m_levels[level];
+
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, l.m_indexBuffer);
+    glDrawElements(GL_TRIANGLES, l.m_indexCount, GL_UNSIGNED_SHORT, NULL);
+    return l.m_indexCount;
+}
+
+#define X .525731112119133606
+#define Z .850650808352039932
+
+static const GLfloat s_icosahedronVertices[12][3] = {
+    {-X, 0.0, Z}, {X, 0.0, Z}, {-X, 0.0, -Z}, {X, 0.0, -Z},
+    {0.0, Z, X}, {0.0, Z, -X}, {0.0, -Z, X}, {0.0, -Z, -X},
+    {Z, X, 0.0}, {-Z, X, 0.0}, {Z, -X, 0.0}, {-Z, -X, 0.0}
+};
+
+static const GLushort s_icosahedronIndices[20][3] = {
+    {0,4,1}, {0,9,4}, {9,5,4}, {4,5,8}, {4,8,1},
+    {8,10,1}, {8,3,10}, {5,3,8}, {5,2,3}, {2,7,3},
+    {7,10,3}, {7,6,10}, {7,11,6}, {11,0,6}, {0,1,6},
+    {6,1,10}, {9,0,11}, {9,11,2}, {9,2,5}, {7,2,11}
+};
+
+#undef X
+#undef Z
+
+// The furthest the flat triangles get from the unit sphere: their
+// centroids sit deepest inside it
+static float sphereError(std::vector<GLfloat> const& positions,
+                         std::vector<GLushort> const& indices)
+{
+    float error = 0;
+
+    for (size_t i = 0; i < indices.size(); i += 3) {
+        float c[3] = { 0, 0, 0 };
+        for (int v = 0; v < 3; v++) {
+            for (int k = 0; k < 3; k++) {
+                c[k] += positions[indices[i + v] * 3 + k] / 3;
+            }
+        }
+        error = std::max(error, 1 - sqrtf(c[0] * c[0] + c[1] * c[1] + c[2] * c[2]));
+    }
+
+    return error;
+}
+
+void buildGeodesicSphere(LodMesh& mesh, int subdivisions)
+{
+    std::vector<GLfloat> positions(&s_icosahedronVertices[0][0],
+                                   &s_icosahedronVertices[12][0]);
+    std::vector<GLushort> indices(&s_icosahedronIndices[0][0],
+                                  &s_icosahedronIndices[20][0]);
+
+    // Built coarsest first, since each level comes from the one before;
+    // new vertices only ever get appended, so every level can index the
+    // final vertex array
+    std::vector<std::vector<GLushort> > levels;
+    levels.push_back(indices);
+
+    for (int s = 0; s < subdivisions; s++) {
+        std::map<std::pair<GLushort, GLushort>, GLushort> midpoints;
+        std::vector<GLushort> finer;
+
+        for (size_t i = 0; i < indices.size(); i += 3) {
+            GLushort m[3];
+
+            for (int e = 0; e < 3; e++) {
+                GLushort a = indices[i + e];
+                GLushort b = indices[i + (e + 1) % 3];
+                std::pair<GLushort, GLushort> key(std::min(a, b), std::max(a, b));
+
+                std::map<std::pair<GLushort, GLushort>, GLushort>::iterator it =
+                    midpoints.find(key);
+                if (it != midpoints.end()) {
+                    m[e] = it->second;
+                    continue;
+                }
+
+                assert(positions.size() / 3 < 65536);
+
+                GLfloat p[3];
+                float length = 0;
+                for (int k = 0; k < 3; k++) {
+                    p[k] = positions[a * 3 + k] + positions[b * 3 + k];
+                    length += p[k] * p[k];
+                }
+                length = sqrtf(length);
+
+                m[e] = positions.size() / 3;
+                for (int k = 0; k < 3; k++) {
+                    positions.push_back(p[k] / length);
+                }
+                midpoints[key] = m[e];
+            }
+
+            GLushort const* t = &indices[i];
+            GLushort const split[4][3] = {
+                { t[0], m[0], m[2] },
+                { m[0], t[1], m[1] },
+                { m[2], m[1], t[2] },
+                { m[0], m[1], m[2] },
+            };
+            finer.insert(finer.end(), &split[0][0], &split[4][0]);
+        }
+
+        indices.swap(finer);
+        levels.push_back(indices);
+    }
+
+    mesh.setVertices(&positions[0], positions.size() * sizeof(GLfloat));
+    for (int i = levels.size() - 1; i >= 0; i--) {
+        mesh.addLevel(levels[i], sphereError(positions, levels[i]));
+    }
+}
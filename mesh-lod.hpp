@@ -0,0 +1,116 @@
+#ifndef __MESH_LOD_HPP__
+#define __MESH_LOD_HPP__
+
+#include <GLES2/gl2.h>
+#include <stdio.h>
+
+#include <vector>
+
+// A mesh with several levels of detail. All levels share one vertex
+// buffer and each has its own index buffer, so a coarser level is just a
+// subset of the finer one's vertices (geodesic subdivisions, offline
+// simplification that keeps vertices in place, ...).
+//
+// Every level carries its geometric error: how far, in object units,
+// its surface strays from the real shape. At draw time select() projects
+// that to pixels for an object at a given distance and picks the
+// coarsest level that stays under the allowed pixel error.
+class LodMesh
+{
+public:
+    // The result of select(). While an object is close to switching to
+    // a coarser level, both levels are drawn with complementary dither
+    // patterns (see LOD_DITHER_GLSL), 'm_fade' of the pixels coming from
+    // 'm_fadeLevel', so that the switch doesn't pop.
+    struct Selection
+    {
+        int m_level;
+        int m_fadeLevel;    // -1 when not fading
+        float m_fade;       // 0..1
+    };
+
+    LodMesh();
+    ~LodMesh();
+
+    // Before setupGl(). Levels are added finest first; the data is
+    // copied.
+    void setVertices(void const* data, GLsizeiptr size);
+    void addLevel(std::vector<GLushort> const& indices, float error);
+
+    // Reorders every level's triangles for the vertex cache and overdraw
+    // (see mesh-optimizer.hpp), then the shared vertices into the order
+    // the levels use them, finest first. Vertices start with a 3 float
+    // position and are 'stride' bytes long. With 'report', prints each
+    // level's vertex cache stats before and after.
+    void optimize(size_t stride, FILE* report = NULL);
+
+    void setupGl();
+    void teardownGl();
+
+    int levelCount() const                  { return m_levels.size(); }
+    GLsizei triangleCount(int level) const  { return m_levels[level].m_indexCount / 3; }
+    float error(int level) const            { return m_levels[level].m_error; }
+
+    // Pixels per object unit at distance 1, for a perspective projection
+    // with vertical field of view 'fovy' (radians) onto a viewport
+    // 'viewportHeight' pixels tall
+    static float screenScale(float viewportHeight, float fovy);
+
+    // 'distance' is from the eye to the nearest point of the object; the
+    // distance to its center minus its bounding radius is conservative.
+    // 'fadeRange' is how far past 'pixelError', as a fraction of it, the
+    // next coarser level starts fading in; 0 switches abruptly.
+    Selection select(float screenScale, float distance,
+                     float pixelError, float fadeRange = 0) const;
+
+    // Leaves the shared vertex buffer bound to GL_ARRAY_BUFFER for the
+    // caller's glVertexAttribPointer() calls
+    void bindVertices() const;
+
+    // Draws one level as GL_TRIANGLES and returns the number of indices
+    // submitted. Leaves the level's index buffer bound.
+    GLsizei drawLevel(int level) const;
+
+private:
+    struct Level
+    {
+        std::vector<GLushort> m_indices;
+        GLuint m_indexBuffer;
+        GLsizei m_indexCount;
+        float m_error;
+    };
+
+    std::vector<char> m_vertices;
+    GLuint m_vertexBuffer;
+    std::vector<Level> m_levels;
+};
+
+// Fills 'mesh' with a unit geodesic sphere: the icosahedron, then each of
+// 'subdivisions' more levels splitting every triangle into four. Vertices
+// are bare positions (3 floats), which double as normals. Subdivisions
+// past 6 overflow 16-bit indices.
+void buildGeodesicSphere(LodMesh& mesh, int subdivisions);
+
+// Fragment shader code for LodMesh::Selection's cross-fade. Declares
+//
+//     uniform float u_lod_fade;
+//     uniform float u_lod_side;
+//     void lodDither();
+//
+// lodDither() discards this pixel if it belongs to the other level. Draw
+// the main level with u_lod_fade = m_fade and u_lod_side = 1, then the
+// fade level with the same u_lod_fade and u_lod_side = -1. Outside a
+// fade, u_lod_fade = 0 and u_lod_side = 1 keeps every pixel.
+#define LOD_DITHER_GLSL \
+    "uniform float u_lod_fade;\n" \
+    "uniform float u_lod_side;\n" \
+    "void lodDither() {\n" \
+    "  // Interleaved gradient noise: a stable, evenly spread threshold\n" \
+    "  // per pixel without needing a texture\n" \
+    "  float n = fract(52.9829189 * fract(dot(gl_FragCoord.xy,\n" \
+    "                                         vec2(0.06711056, 0.00583715))));\n" \
+    "  if ((n - u_lod_fade) * u_lod_side < 0.0)\n" \
+    "    discard;\n" \
+    "}\n"
+
+#endif
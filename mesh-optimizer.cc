@@ -0,0 +1,458 @@
+#include <assert.h>
+#include <cmath>
+#include <cstring>
+
+#include <algorithm>
+#include <utility>
+
+#include "mesh-optimizer.hpp"
+
+// Vertex cache simulated by the Forsyth scoring, and by the overdraw
+// pass when it decides where runs of triangles can be cut. Modern GPUs
+// don't have a FIFO this size as such, but the ordering that suits one
+// suits them too.
+static const int FORSYTH_CACHE_SIZE = 32;
+static const int OVERDRAW_CACHE_SIZE = 16;
+
+// FIFO vertex cache by timestamps: a vertex is in the cache if it was
+// last missed fewer than 'size' misses ago
+class FifoCache
+{
+public:
+    FifoCache(size_t vertexCount, int size)
+        : m_stamps(vertexCount, 0)
+        , m_time(size + 1)
+        , m_size(size)
+    {
+    }
+
+    // Returns true on a miss
+    bool access(GLushort vertex)
+    {
+        if (m_time - m_stamps[vertex] <= (uint32_t)m_size) {
+            return false;
+        }
+        m_stamps[vertex] = m_time++;
+        return true;
+    }
+
+    uint32_t triangleMisses(GLushort const* triangle)
+    {
+        return access(triangle[0]) + access(triangle[1]) + access(triangle[2]);
+    }
+
+    void reset()
+    {
+        m_time += m_size + 1;
+    }
+
+private:
+    std::vector<uint32_t> m_stamps;
+    uint32_t m_time;
+    int m_size;
+};
+
+static uint32_t hashVertex(std::vector<MeshStream> const& streams, size_t vertex)
+{
+    // FNV-1a
+    uint32_t hash = 2166136261u;
+
+    for (size_t s = 0; s < streams.size(); s++) {
+        unsigned char const* bytes = (unsigned char const*)streams[s].m_data +
+                                     vertex * streams[s].m_stride;
+        for (size_t i = 0; i < streams[s].m_size; i++) {
+            hash = (hash ^ bytes[i]) * 16777619u;
+        }
+    }
+
+    return hash;
+}
+
+static bool sameVertex(std::vector<MeshStream> const& streams, size_t a, size_t b)
+{
+    for (size_t s = 0; s < streams.size(); s++) {
+        char const* data = (char const*)streams[s].m_data;
+        if (memcmp(data + a * streams[s].m_stride, data + b * streams[s].m_stride,
+                   streams[s].m_size) != 0) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+size_t generateVertexRemap(std::vector<MeshStream> const& streams, size_t vertexCount,
+                           std::vector<uint32_t>& remap)
+{
+    remap.assign(vertexCount, ~0u);
+
+    // Open addressing, at most half full
+    size_t buckets = 1;
+    while (buckets < vertexCount * 2) {
+        buckets *= 2;
+    }
+    std::vector<uint32_t> table(buckets, ~0u);
+
+    size_t unique = 0;
+
+    for (size_t i = 0; i < vertexCount; i++) {
+        size_t bucket = hashVertex(streams, i) & (buckets - 1);
+
+        while (table[bucket] != ~0u && !sameVertex(streams, table[bucket], i)) {
+            bucket = (bucket + 1) & (buckets - 1);
+        }
+
+        if (table[bucket] == ~0u) {
+            table[bucket] = i;
+            remap[i] = unique++;
+        }
+        else {
+            remap[i] = remap[table[bucket]];
+        }
+    }
+
+    return unique;
+}
+
+void remapIndices(std::vector<GLushort>& indices, std::vector<uint32_t> const& remap)
+{
+    for (size_t i = 0; i < indices.size(); i++) {
+        assert(remap[indices[i]] != ~0u);
+        indices[i] = remap[indices[i]];
+    }
+}
+
+void remapVertices(void* destination, MeshStream const& source, size_t vertexCount,
+                   std::vector<uint32_t> const& remap)
+{
+    for (size_t i = 0; i < vertexCount; i++) {
+        if (remap[i] != ~0u) {
+            memcpy((char*)destination + remap[i] * source.m_size,
+                   (char const*)source.m_data + i * source.m_stride,
+                   source.m_size);
+        }
+    }
+}
+
+// How much emitting a triangle through this vertex is worth: more the
+// more recently the vertex was used, and the fewer triangles it has left
+// (so that lone triangles get picked up rather than stranded)
+static float forsythScore(int cachePosition, uint32_t remaining)
+{
+    if (remaining == 0) {
+        return -1;
+    }
+
+    float score = 0;
+    if (cachePosition >= 0) {
+        if (cachePosition < 3) {
+            // The triangle just emitted. A fixed score rather than the
+            // top one, or the order degenerates into long thin strips.
+            score = 0.75f;
+        }
+        else {
+            score = powf(1 - (cachePosition - 3) / float(FORSYTH_CACHE_SIZE - 3), 1.5f);
+        }
+    }
+
+    return score + 2.0f / sqrtf(remaining);
+}
+
+void optimizeVertexCache(std::vector<GLushort>& indices, size_t vertexCount)
+{
+    size_t triangleCount = indices.size() / 3;
+    if (triangleCount == 0) {
+        return;
+    }
+
+    // Triangles not yet emitted around each vertex, packed per vertex
+    std::vector<uint32_t> remaining(vertexCount, 0);
+    for (size_t i = 0; i < indices.size(); i++) {
+        remaining[indices[i]]++;
+    }
+
+    std::vector<uint32_t> offsets(vertexCount + 1, 0);
+    for (size_t v = 0; v < vertexCount; v++) {
+        offsets[v + 1] = offsets[v] + remaining[v];
+    }
+
+    std::vector<uint32_t> adjacency(indices.size());
+    std::vector<uint32_t> filled(offsets.begin(), offsets.end() - 1);
+    for (size_t i = 0; i < indices.size(); i++) {
+        adjacency[filled[indices[i]]++] = i / 3;
+    }
+
+    std::vector<int> cachePosition(vertexCount, -1);
+    std::vector<float> vertexScore(vertexCount);
+    for (size_t v = 0; v < vertexCount; v++) {
+        vertexScore[v] = forsythScore(-1, remaining[v]);
+    }
+
+    std::vector<float> triangleScore(triangleCount);
+    std::vector<bool> emitted(triangleCount, false);
+    int best = 0;
+
+    for (size_t t = 0; t < triangleCount; t++) {
+        triangleScore[t] = vertexScore[indices[t * 3]] +
+                           vertexScore[indices[t * 3 + 1]] +
+                           vertexScore[indices[t * 3 + 2]];
+        if (triangleScore[t] > triangleScore[best]) {
+            best = t;
+        }
+    }
+
+    std::vector<GLushort> result;
+    result.reserve(indices.size());
+
+    std::vector<GLushort> cache;
+    std::vector<GLushort> newCache;
+    size_t cursor = 0;
+
+    while (best >= 0) {
+        GLushort const* triangle = &indices[best * 3];
+        result.insert(result.end(), triangle, triangle + 3);
+        emitted[best] = true;
+
+        for (int k = 0; k < 3; k++) {
+            GLushort v = triangle[k];
+            uint32_t* around = &adjacency[offsets[v]];
+            uint32_t* last = around + remaining[v] - 1;
+
+            uint32_t* found = std::find(around, last + 1, (uint32_t)best);
+            if (found <= last) {
+                std::swap(*found, *last);
+                remaining[v]--;
+            }
+        }
+
+        // The triangle's vertices go to the front; whatever is pushed
+        // past the end falls out
+        newCache.assign(triangle, triangle + 3);
+        for (size_t i = 0; i < cache.size(); i++) {
+            if (cache[i] != triangle[0] && cache[i] != triangle[1] && cache[i] != triangle[2]) {
+                newCache.push_back(cache[i]);
+            }
+        }
+
+        for (size_t i = 0; i < newCache.size(); i++) {
+            GLushort v = newCache[i];
+            cachePosition[v] = (int)i < FORSYTH_CACHE_SIZE ? (int)i : -1;
+            vertexScore[v] = forsythScore(cachePosition[v], remaining[v]);
+        }
+
+        // Only triangles around those vertices changed score, and the
+        // next one is nearly always among them
+        best = -1;
+        float bestScore = 0;
+
+        for (size_t i = 0; i < newCache.size(); i++) {
+            GLushort v = newCache[i];
+
+            for (uint32_t j = 0; j < remaining[v]; j++) {
+                uint32_t t = adjacency[offsets[v] + j];
+                triangleScore[t] = vertexScore[indices[t * 3]] +
+                                   vertexScore[indices[t * 3 + 1]] +
+                                   vertexScore[indices[t * 3 + 2]];
+                if (best < 0 || triangleScore[t] > bestScore) {
+                    best = t;
+                    bestScore = triangleScore[t];
+                }
+            }
+        }
+
+        if (newCache.size() > (size_t)FORSYTH_CACHE_SIZE) {
+            newCache.resize(FORSYTH_CACHE_SIZE);
+        }
+        cache.swap(newCache);
+
+        // Nothing left touching the cache: start somewhere else
+        if (best < 0) {
+            while (cursor < triangleCount && emitted[cursor]) {
+                cursor++;
+            }
+            best = cursor < triangleCount ? (int)cursor : -1;
+        }
+    }
+
+    indices.swap(result);
+}
+
+static void position(void const* positions, size_t stride, GLushort vertex, float out[3])
+{
+    memcpy(out, (char const*)positions + vertex * stride, 3 * sizeof(float));
+}
+
+static bool byKeyDescending(std::pair<float, size_t> const& a,
+                            std::pair<float, size_t> const& b)
+{
+    return a.first > b.first;
+}
+
+void optimizeOverdraw(std::vector<GLushort>& indices, void const* positions,
+                      size_t stride, size_t vertexCount, float threshold)
+{
+    size_t triangleCount = indices.size() / 3;
+    if (triangleCount == 0) {
+        return;
+    }
+
+    FifoCache cache(vertexCount, OVERDRAW_CACHE_SIZE);
+
+    // Hard boundaries: triangles that miss on all three vertices start
+    // afresh anyway, so the runs between them can move about for free
+    std::vector<size_t> hard;
+    uint32_t misses = 0;
+
+    for (size_t t = 0; t < triangleCount; t++) {
+        uint32_t m = cache.triangleMisses(&indices[t * 3]);
+        if (m == 3) {
+            hard.push_back(t);
+        }
+        misses += m;
+    }
+    hard.push_back(triangleCount);
+
+    // Soft boundaries: cut a run wherever, counted from a cold cache, it
+    // has already got down to 'threshold' times the mesh's miss rate
+    float limit = float(misses) / triangleCount * threshold;
+    std::vector<size_t> clusters;
+
+    for (size_t h = 0; h + 1 < hard.size(); h++) {
+        size_t start = hard[h];
+        uint32_t clusterMisses = 0;
+
+        clusters.push_back(start);
+        cache.reset();
+
+        for (size_t t = start; t < hard[h + 1]; t++) {
+            clusterMisses += cache.triangleMisses(&indices[t * 3]);
+
+            if (t + 1 < hard[h + 1] && clusterMisses <= limit * (t + 1 - start)) {
+                start = t + 1;
+                clusterMisses = 0;
+                clusters.push_back(start);
+                cache.reset();
+            }
+        }
+    }
+    clusters.push_back(triangleCount);
+
+    // Area-weighted centroids and normals, of the mesh and each cluster
+    std::vector<float> clusterData((clusters.size() - 1) * 7, 0.0f);
+    float meshCentroid[3] = { 0, 0, 0 };
+    float meshArea = 0;
+
+    for (size_t c = 0; c + 1 < clusters.size(); c++) {
+        float* data = &clusterData[c * 7];
+
+        for (size_t t = clusters[c]; t < clusters[c + 1]; t++) {
+            float a[3], b[3], d[3];
+            position(positions, stride, indices[t * 3], a);
+            position(positions, stride, indices[t * 3 + 1], b);
+            position(positions, stride, indices[t * 3 + 2], d);
+
+            float e1[3] = { b[0] - a[0], b[1] - a[1], b[2] - a[2] };
+            float e2[3] = { d[0] - a[0], d[1] - a[1], d[2] - a[2] };
+            float n[3] = {
+                e1[1] * e2[2] - e1[2] * e2[1],
+                e1[2] * e2[0] - e1[0] * e2[2],
+                e1[0] * e2[1] - e1[1] * e2[0],
+            };
+            float area = sqrtf(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+
+            for (int k = 0; k < 3; k++) {
+                float centroid = (a[k] + b[k] + d[k]) / 3;
+                data[k] += centroid * area;
+                data[3 + k] += n[k];
+                meshCentroid[k] += centroid * area;
+            }
+            data[6] += area;
+            meshArea += area;
+        }
+    }
+
+    if (meshArea > 0) {
+        for (int k = 0; k < 3; k++) {
+            meshCentroid[k] /= meshArea;
+        }
+    }
+
+    // Clusters facing away from the middle come first: on a roughly
+    // convex mesh those are the ones in front, hiding the rest
+    std::vector<std::pair<float, size_t> > order;
+
+    for (size_t c = 0; c + 1 < clusters.size(); c++) {
+        float const* data = &clusterData[c * 7];
+        float length = sqrtf(data[3] * data[3] + data[4] * data[4] + data[5] * data[5]);
+        float key = 0;
+
+        if (data[6] > 0 && length > 0) {
+            for (int k = 0; k < 3; k++) {
+                key += (data[k] / data[6] - meshCentroid[k]) * data[3 + k] / length;
+            }
+        }
+        order.push_back(std::make_pair(key, c));
+    }
+
+    std::stable_sort(order.begin(), order.end(), byKeyDescending);
+
+    std::vector<GLushort> result;
+    result.reserve(indices.size());
+
+    for (size_t i = 0; i < order.size(); i++) {
+        size_t c = order[i].second;
+        result.insert(result.end(), indices.begin() + clusters[c] * 3,
+                      indices.begin() + clusters[c + 1] * 3);
+    }
+
+    indices.swap(result);
+}
+
+size_t optimizeVertexFetchRemap(std::vector<GLushort> const& indices, size_t vertexCount,
+                                std::vector<uint32_t>& remap)
+{
+    remap.assign(vertexCount, ~0u);
+
+    size_t next = 0;
+    for (size_t i = 0; i < indices.size(); i++) {
+        if (remap[indices[i]] == ~0u) {
+            remap[indices[i]] = next++;
+        }
+    }
+
+    return next;
+}
+
+VertexCacheStats analyzeVertexCache(std::vector<GLushort> const& indices,
+                                    size_t vertexCount, int cacheSize)
+{
+    FifoCache cache(vertexCount, cacheSize);
+    VertexCacheStats stats;
+
+    std::vector<bool> used(vertexCount, false);
+    size_t usedCount = 0;
+
+    stats.m_transformed = 0;
+    for (size_t i = 0; i < indices.size(); i++) {
+        stats.m_transformed += cache.access(indices[i]);
+
+        if (!used[indices[i]]) {
+            used[indices[i]] = true;
+            usedCount++;
+        }
+    }
+
+    size_t triangleCount = indices.size() / 3;
+    stats.m_acmr = triangleCount ? float(stats.m_transformed) / triangleCount : 0;
+    stats.m_atvr = usedCount ? float(stats.m_transformed) / usedCount : 0;
+    return stats;
+}
+
+void printVertexCacheStats(FILE* stream, char const* name,
+                           VertexCacheStats const& before,
+                           VertexCacheStats const& after)
+{
+    fprintf(stream, "%s: ACMR %.3f -> %.3f, ATVR %.3f -> %.3f (%u -> %u vertex shader runs)\n",
+            name, before.m_acmr, after.m_acmr, before.m_atvr, after.m_atvr,
+            before.m_transformed, after.m_transformed);
+}
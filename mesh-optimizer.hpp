@@ -0,0 +1,91 @@
+#ifndef __MESH_OPTIMIZER_HPP__
+#define __MESH_OPTIMIZER_HPP__
+
+#include <GLES2/gl2.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include <vector>
+
+// Load-time (or offline) reordering of indexed triangle lists so that
+// the GPU does less work for the same picture. The usual order is
+//
+//     remap = generateVertexRemap(...)    // weld, if not indexed yet
+//     optimizeVertexCache(indices, ...)   // fewer vertex shader runs
+//     optimizeOverdraw(indices, ...)      // fewer hidden pixels shaded
+//     optimizeVertexFetchRemap(...)       // vertices in the order used
+//
+// then remapIndices() and remapVertices() with the last remap. None of
+// this touches GL; it works on plain arrays.
+
+// One attribute of a vertex array: 'size' bytes per vertex, one vertex
+// every 'stride' bytes (0 for tightly packed)
+struct MeshStream
+{
+    MeshStream(void const* data, size_t size, size_t stride = 0)
+        : m_data(data)
+        , m_size(size)
+        , m_stride(stride ? stride : size)
+    {
+    }
+
+    void const* m_data;
+    size_t m_size;
+    size_t m_stride;
+};
+
+// Vertex welding. Gives every vertex its index in a deduplicated array,
+// where vertices whose bytes match in every stream become one, and
+// returns the number of unique vertices. For an unindexed triangle
+// list the remap is the index buffer of the welded mesh.
+size_t generateVertexRemap(std::vector<MeshStream> const& streams, size_t vertexCount,
+                           std::vector<uint32_t>& remap);
+
+// Rewrites indices through a remap
+void remapIndices(std::vector<GLushort>& indices, std::vector<uint32_t> const& remap);
+
+// Copies 'source' into 'destination' in remapped order, tightly packed.
+// 'destination' holds one vertex for each distinct remap entry; vertices
+// remapped to ~0 are dropped.
+void remapVertices(void* destination, MeshStream const& source, size_t vertexCount,
+                   std::vector<uint32_t> const& remap);
+
+// Reorders triangles for the post-transform vertex cache, with Tom
+// Forsyth's linear-speed algorithm: greedily emit the triangle whose
+// vertices are most recently used and have the fewest triangles left.
+void optimizeVertexCache(std::vector<GLushort>& indices, size_t vertexCount);
+
+// Reorders runs of cache-optimized triangles so that the ones facing
+// out from the middle of the mesh come first, where they hide more of
+// what follows (Sander, Nehab and Barczak's "Fast Triangle Reordering
+// for Vertex Locality and Reduced Overdraw"). Runs are cut wherever the
+// cache starts over, and more often where that costs no more than
+// 'threshold' times the mesh's vertex cache misses. Positions are 3
+// floats, 'stride' bytes apart.
+void optimizeOverdraw(std::vector<GLushort>& indices, void const* positions,
+                      size_t stride, size_t vertexCount, float threshold = 1.05f);
+
+// A remap putting vertices in the order the indices first use them, so
+// that vertex fetch walks memory forwards. Unused vertices map to ~0.
+// Returns the number of vertices in use.
+size_t optimizeVertexFetchRemap(std::vector<GLushort> const& indices, size_t vertexCount,
+                                std::vector<uint32_t>& remap);
+
+// Vertex shader runs for the indices, through a FIFO vertex cache of
+// 'cacheSize' entries
+struct VertexCacheStats
+{
+    uint32_t m_transformed;
+    float m_acmr;       // Per triangle: 0.5 is ideal, 3 is no reuse
+    float m_atvr;       // Per vertex the indices use: 1 is ideal
+};
+
+VertexCacheStats analyzeVertexCache(std::vector<GLushort> const& indices,
+                                    size_t vertexCount, int cacheSize = 16);
+
+void printVertexCacheStats(FILE* stream, char const* name,
+                           VertexCacheStats const& before,
+                           VertexCacheStats const& after);
+
+#endif
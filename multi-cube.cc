@@ -0,0 +1,47 @@
+#include <cstdio>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <vector>
+
+#include "cube-window.hpp"
+
+// Opens several cube windows from one process. They share a single
+// compositor connection, EGL context, shader program and vertex buffer,
+// while each one is paced by its own frame callbacks.
+//
+// Usage: multi-cube [window options] [count]
+//
+// Run with -u to print CPU usage on exit, and compare against the same
+// number of separate 'cube -u' processes.
+int
+main(int argc, char **argv)
+{
+    WaylandDisplay display;
+    std::vector<CubeWindow*> windows;
+
+    // Every window parses the same options, but those for the whole
+    // process (-j, -l, -m, -t, -u) are only applied once; the count is
+    // whatever positional argument is left after them.
+    windows.push_back(new CubeWindow(&display));
+    windows[0]->init(&argc, argv);
+
+    int count = optind < argc ? atoi(argv[optind]) : 4;
+    if (count < 1) {
+        fprintf(stderr, "Bad window count \"%s\"\n", argv[optind]);
+        return EXIT_FAILURE;
+    }
+
+    for (int i = 1; i < count; i++) {
+        windows.push_back(new CubeWindow(&display));
+        windows[i]->init(&argc, argv);
+    }
+
+    display.run();
+
+    for (size_t i = 0; i < windows.size(); i++) {
+        delete windows[i];
+    }
+
+    return EXIT_SUCCESS;
+}
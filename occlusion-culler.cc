@@ -0,0 +1,209 @@
+#include <assert.h>
+
+#include "gl-ext.hpp"
+#include "gpu-resources.hpp"
+#include "occlusion-culler.hpp"
+#include "shader.hpp"
+
+static const char* box_vert_shader_text =
+    "uniform mat4 u_mvp;\n"
+    "attribute vec3 a_pos;\n"
+    "void main() {\n"
+    "  gl_Position = u_mvp * vec4(a_pos, 1);\n"
+    "}\n";
+
+// Nothing is written, but a fragment shader is still required
+static const char* box_frag_shader_text =
+    "precision mediump float;\n"
+    "void main() {\n"
+    "  gl_FragColor = vec4(1);\n"
+    "}\n";
+
+static const GLfloat s_boxVertices[8][3] = {
+    { -1, -1, -1 }, { +1, -1, -1 }, { -1, +1, -1 }, { +1, +1, -1 },
+    { -1, -1, +1 }, { +1, -1, +1 }, { -1, +1, +1 }, { +1, +1, +1 },
+};
+
+static const GLubyte s_boxIndices[6][6] = {
+    { 0, 2, 1, 1, 2, 3 }, // z == -1
+    { 4, 5, 6, 5, 7, 6 }, // z == +1
+    { 0, 1, 4, 1, 5, 4 }, // y == -1
+    { 2, 6, 3, 3, 6, 7 }, // y == +1
+    { 0, 4, 2, 2, 4, 6 }, // x == -1
+    { 1, 3, 5, 3, 7, 5 }, // x == +1
+};
+
+OcclusionCuller::OcclusionCuller()
+    : m_queries(false)
+    , m_current(-1)
+    , m_frame(0)
+    , m_boxProgram(0)
+    , m_uBoxMvp(-1)
+    , m_queriesIssued(0)
+    , m_resultsRead(0)
+{
+    m_boxBuffers[0] = m_boxBuffers[1] = 0;
+}
+
+OcclusionCuller::~OcclusionCuller()
+{
+}
+
+void OcclusionCuller::setupGl(int objects)
+{
+    GlExtensions const& ext = glExtensions();
+    m_queries = ext.m_occlusionQueryBoolean;
+
+    m_objects.resize(objects);
+    for (int i = 0; i < objects; i++) {
+        m_objects[i].m_query = 0;
+        m_objects[i].m_pending = false;
+        m_objects[i].m_visible = true;
+        if (m_queries) {
+            ext.GenQueriesEXT(1, &m_objects[i].m_query);
+        }
+    }
+
+    static char const* const attribs[] = { "a_pos", NULL };
+    GLuint vert = compileShader(box_vert_shader_text, GL_VERTEX_SHADER, "OcclusionCuller");
+    GLuint frag = compileShader(box_frag_shader_text, GL_FRAGMENT_SHADER, "OcclusionCuller");
+    m_boxProgram = linkProgram(vert, frag, attribs, "OcclusionCuller");
+    GpuResources::deleteShader(vert);
+    GpuResources::deleteShader(frag);
+    m_uBoxMvp = glGetUniformLocation(m_boxProgram, "u_mvp");
+
+    m_boxBuffers[0] = GpuResources::createBuffer("OcclusionCuller box vertices");
+    m_boxBuffers[1] = GpuResources::createBuffer("OcclusionCuller box indices");
+    glBindBuffer(GL_ARRAY_BUFFER, m_boxBuffers[0]);
+    GpuResources::bufferData(m_boxBuffers[0], GL_ARRAY_BUFFER, sizeof(s_boxVertices),
+                             s_boxVertices, GL_STATIC_DRAW);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_boxBuffers[1]);
+    GpuResources::bufferData(m_boxBuffers[1], GL_ELEMENT_ARRAY_BUFFER, sizeof(s_boxIndices),
+                             s_boxIndices, GL_STATIC_DRAW);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+
+    m_frame = 0;
+}
+
+void OcclusionCuller::teardownGl()
+{
+    for (size_t i = 0; i < m_objects.size(); i++) {
+        if (m_objects[i].m_query) {
+            glExtensions().DeleteQueriesEXT(1, &m_objects[i].m_query);
+        }
+    }
+    m_objects.clear();
+
+    GpuResources::deleteBuffer(m_boxBuffers[0]);
+    GpuResources::deleteBuffer(m_boxBuffers[1]);
+    GpuResources::deleteProgram(m_boxProgram);
+    m_boxBuffers[0] = m_boxBuffers[1] = 0;
+    m_boxProgram = 0;
+}
+
+void OcclusionCuller::beginFrame()
+{
+    m_frame++;
+    m_queriesIssued = 0;
+    m_resultsRead = 0;
+
+    if (!m_queries) {
+        return;
+    }
+
+    GlExtensions const& ext = glExtensions();
+
+    for (size_t i = 0; i < m_objects.size(); i++) {
+        Object& object = m_objects[i];
+        if (!object.m_pending) {
+            continue;
+        }
+
+        GLuint available = GL_FALSE;
+        ext.GetQueryObjectuivEXT(object.m_query, GL_QUERY_RESULT_AVAILABLE_EXT, &available);
+        if (!available) {
+            continue;
+        }
+
+        GLuint passed = GL_TRUE;
+        ext.GetQueryObjectuivEXT(object.m_query, GL_QUERY_RESULT_EXT, &passed);
+        object.m_visible = passed != GL_FALSE;
+        object.m_pending = false;
+        m_resultsRead++;
+    }
+}
+
+void OcclusionCuller::beginObject(int object)
+{
+    assert(m_current < 0);
+
+    Object& o = m_objects[object];
+    if (!m_queries || o.m_pending ||
+        (m_frame + object) % VISIBLE_RETEST_INTERVAL != 0) {
+        return;
+    }
+
+    // Conservative queries may report a few false positives, which only
+    // cost a draw, and are cheaper on tilers that can answer them early
+    glExtensions().BeginQueryEXT(GL_ANY_SAMPLES_PASSED_CONSERVATIVE_EXT, o.m_query);
+    o.m_pending = true;
+    m_current = object;
+    m_queriesIssued++;
+}
+
+void OcclusionCuller::endObject()
+{
+    if (m_current >= 0) {
+        glExtensions().EndQueryEXT(GL_ANY_SAMPLES_PASSED_CONSERVATIVE_EXT);
+        m_current = -1;
+    }
+}
+
+void OcclusionCuller::beginBoxTests()
+{
+    if (!m_queries) {
+        return;
+    }
+
+    glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+    glDepthMask(GL_FALSE);
+
+    glUseProgram(m_boxProgram);
+    glBindBuffer(GL_ARRAY_BUFFER, m_boxBuffers[0]);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_boxBuffers[1]);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, 0);
+    glEnableVertexAttribArray(0);
+}
+
+void OcclusionCuller::testBox(int object, GLfloat const* mvp)
+{
+    Object& o = m_objects[object];
+    if (!m_queries || o.m_pending) {
+        return;
+    }
+
+    GlExtensions const& ext = glExtensions();
+
+    glUniformMatrix4fv(m_uBoxMvp, 1, GL_FALSE, mvp);
+    ext.BeginQueryEXT(GL_ANY_SAMPLES_PASSED_CONSERVATIVE_EXT, o.m_query);
+    glDrawElements(GL_TRIANGLES, sizeof(s_boxIndices), GL_UNSIGNED_BYTE, 0);
+    ext.EndQueryEXT(GL_ANY_SAMPLES_PASSED_CONSERVATIVE_EXT);
+
+    o.m_pending = true;
+    m_queriesIssued++;
+}
+
+void OcclusionCuller::endBoxTests()
+{
+    if (!m_queries) {
+        return;
+    }
+
+    glDisableVertexAttribArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+
+    glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+    glDepthMask(GL_TRUE);
+}
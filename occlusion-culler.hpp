@@ -0,0 +1,93 @@
+#ifndef __OCCLUSION_CULLER_HPP__
+#define __OCCLUSION_CULLER_HPP__
+
+#include <GLES2/gl2.h>
+#include <stdint.h>
+
+#include <vector>
+
+// Skips drawing objects hidden behind others, using
+// GL_EXT_occlusion_query_boolean. A frame goes:
+//
+//     culler.beginFrame();
+//     ...draw the occluders (walls, terrain) normally...
+//     for each object:
+//         if (culler.isVisible(i)) {
+//             culler.beginObject(i);
+//             ...draw it...
+//             culler.endObject();
+//         }
+//     culler.beginBoxTests();
+//     for each object that wasn't visible:
+//         culler.testBox(i, mvp of its bounding box);
+//     culler.endBoxTests();
+//
+// Visible objects are drawn inside a query, hidden ones only have their
+// bounding box tested, with color and depth writes off. Results are
+// picked up by a later beginFrame() once the GPU has them, never waited
+// for: until then an object keeps the visibility it had. The price of
+// never stalling is that an object coming out from behind a wall shows
+// up a frame or two late.
+//
+// Without the extension everything is always visible and the calls do
+// nothing.
+class OcclusionCuller
+{
+public:
+    // Objects believed visible are only queried every this many frames,
+    // staggered by object number, since they mostly stay visible
+    static const uint32_t VISIBLE_RETEST_INTERVAL = 4;
+
+    OcclusionCuller();
+    ~OcclusionCuller();
+
+    // Objects are numbered 0 to 'objects' - 1
+    void setupGl(int objects);
+    void teardownGl();
+
+    bool isSetUp() const                { return m_boxProgram != 0; }
+    bool hasQueries() const             { return m_queries; }
+
+    // Reads back every query result that is ready
+    void beginFrame();
+
+    bool isVisible(int object) const    { return m_objects[object].m_visible; }
+
+    void beginObject(int object);
+    void endObject();
+
+    // Box tests draw the unit cube (-1..1 on every axis) through 'mvp'
+    // with their own program, so the caller's program needs binding
+    // again afterwards. Vertex attribute 0 is left disabled. A box the
+    // eye is inside of has its front faces clipped away and may test as
+    // hidden; keep those objects out of the tests.
+    void beginBoxTests();
+    void testBox(int object, GLfloat const* mvp);
+    void endBoxTests();
+
+    // Counts for the current frame
+    uint32_t queriesIssued() const      { return m_queriesIssued; }
+    uint32_t resultsRead() const        { return m_resultsRead; }
+
+private:
+    struct Object
+    {
+        GLuint m_query;
+        bool m_pending;
+        bool m_visible;
+    };
+
+    bool m_queries;
+    std::vector<Object> m_objects;
+    int m_current;
+    uint32_t m_frame;
+
+    GLuint m_boxProgram;
+    GLint m_uBoxMvp;
+    GLuint m_boxBuffers[2];
+
+    uint32_t m_queriesIssued;
+    uint32_t m_resultsRead;
+};
+
+#endif
@@ -0,0 +1,392 @@
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/type_ptr.hpp>
+
+#include "base.hpp"
+#include "occlusion-culler.hpp"
+#include "shader.hpp"
+
+// Occlusion culling benchmark: a field of small cubes split up by rows
+// of walls, each with one doorway, seen by a camera strafing along the
+// front. Most cubes are behind a wall at any moment. The walls are drawn
+// first as occluders; each cube is then a draw call of its own, skipped
+// while an OcclusionCuller says it's hidden.
+//
+// Every REPORT_INTERVAL frames prints the cubes drawn and skipped per
+// frame, the queries issued, and the CPU time spent reading results and
+// running box tests. Run with -p for the GPU time of each stage
+// ("occluders", "objects", "queries").
+//
+// Usage: occlusion [window options] [on|off]
+
+static const char* vert_shader_text =
+    "uniform mat4 u_mvp;\n"
+    "uniform vec3 u_color;\n"
+
+    "attribute vec3 a_pos;\n"
+    "attribute vec3 a_norm;\n"
+
+    "varying vec3 v_color;\n"
+
+    "void main() {\n"
+    "  gl_Position = u_mvp * vec4(a_pos, 1);\n"
+
+    "  // Nothing rotates, so model space normals will do\n"
+    "  float lambert = max(dot(a_norm, normalize(vec3(0.3, 1, 0.6))), 0.0);\n"
+    "  v_color = u_color * (0.35 + 0.65 * lambert);\n"
+    "}\n";
+
+static const char* frag_shader_text =
+    "precision mediump float;\n"
+    "varying vec3 v_color;\n"
+    "void main() {\n"
+    "  gl_FragColor = vec4(v_color, 1);\n"
+    "}\n";
+
+// Frames between reports
+static const uint32_t REPORT_INTERVAL = 120;
+
+// Cubes: a GRID x GRID field, CUBE_SIZE half-extent
+static const int GRID = 40;
+static const float CUBE_SIZE = 0.3f;
+static const float FIELD_NEAR = -4.0f;
+static const float FIELD_FAR = -52.0f;
+static const float FIELD_WIDTH = 60.0f;
+
+// Walls: WALL_ROWS rows, WALL_SPACING apart, with a DOOR_WIDTH gap each
+static const int WALL_ROWS = 6;
+static const float WALL_SPACING = 8.0f;
+static const float WALL_HEIGHT = 4.0f;
+static const float WALL_WIDTH = 64.0f;
+static const float DOOR_WIDTH = 3.0f;
+
+static double nowMs()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000.0 + ts.tv_nsec / 1000000.0;
+}
+
+struct Box
+{
+    glm::vec3 m_center;
+    glm::vec3 m_halfSize;
+};
+
+class OcclusionWindow: public WaylandWindow
+{
+public:
+    OcclusionWindow()
+        : m_culling(true)
+        , m_program(0)
+        , m_uMvp(-1)
+        , m_uColor(-1)
+        , m_drawn(0)
+        , m_skipped(0)
+        , m_queries(0)
+        , m_readMs(0)
+        , m_testMs(0)
+        , m_cpuMs(0)
+    {
+        m_buffers[0] = m_buffers[1] = 0;
+    }
+
+    virtual ~OcclusionWindow()
+    {
+    }
+
+    void setCulling(bool culling)   { m_culling = culling; }
+
+protected:
+    virtual std::vector<EGLint> requiredEglConfigAttribs()
+    {
+        std::vector<EGLint> ret;
+        ret.push_back(EGL_DEPTH_SIZE);
+        ret.push_back(16);
+        return ret;
+    }
+
+    virtual void setupGl()
+    {
+        static char const* const attribs[] = { "a_pos", "a_norm", NULL };
+
+        GLuint vert = createShader(vert_shader_text, GL_VERTEX_SHADER);
+        GLuint frag = createShader(frag_shader_text, GL_FRAGMENT_SHADER);
+        m_program = linkProgram(vert, frag, attribs);
+        GpuResources::deleteShader(vert);
+        GpuResources::deleteShader(frag);
+
+        m_uMvp = glGetUniformLocation(m_program, "u_mvp");
+        m_uColor = glGetUniformLocation(m_program, "u_color");
+
+        buildCube();
+        buildScene();
+
+        m_culler.setupGl(m_cubes.size());
+        if (!m_culler.hasQueries()) {
+            printf("GL_EXT_occlusion_query_boolean not supported, drawing everything\n");
+        }
+    }
+
+    virtual void drawGl(uint32_t time)
+    {
+        Size const& size = currentSize();
+        glViewport(0, 0, size.m_width, size.m_height);
+
+        glClearColor(0.15, 0.15, 0.2, 1.0);
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        glEnable(GL_DEPTH_TEST);
+        glEnable(GL_CULL_FACE);
+
+        float t = time / 1000.0f;
+        glm::vec3 eye(12 * sinf(t * 0.25f), 1.7f, 2);
+
+        float aspect = size.m_width * 1.0f / size.m_height;
+        float top = 0.5f * tanf(0.4f);
+        glm::mat4 viewProjection =
+            glm::frustum(-top * aspect, top * aspect, -top, top, 0.5f, 100.0f) *
+            glm::translate(glm::mat4(1.f), -eye);
+
+        double start = nowMs();
+        if (m_culling) {
+            m_culler.beginFrame();
+        }
+        m_readMs += nowMs() - start;
+
+        glUseProgram(m_program);
+        bindCube();
+
+        // Walls
+        gpuPass("occluders");
+        glUniform3f(m_uColor, 0.8f, 0.75f, 0.7f);
+        for (size_t i = 0; i < m_walls.size(); i++) {
+            drawBox(viewProjection, m_walls[i]);
+        }
+
+        // Cubes believed visible. The rest are only box-tested, after
+        // everything else so that they're tested against as much depth
+        // as possible.
+        gpuPass("objects");
+        FrameVector<int> hidden((ArenaAllocator<int>(frameArena())));
+        hidden.reserve(m_cubes.size());
+
+        for (size_t i = 0; i < m_cubes.size(); i++) {
+            if (m_culling && !m_culler.isVisible(i)) {
+                hidden.push_back(i);
+                continue;
+            }
+
+            glUniform3f(m_uColor, 0.4f + 0.6f * (i % GRID) / GRID, 0.5f,
+                        1.0f - 0.6f * (i / GRID) / GRID);
+
+            if (m_culling) {
+                m_culler.beginObject(i);
+            }
+            drawBox(viewProjection, m_cubes[i]);
+            if (m_culling) {
+                m_culler.endObject();
+            }
+        }
+
+        gpuPass("queries");
+        start = nowMs();
+        if (m_culling) {
+            m_culler.beginBoxTests();
+            for (size_t i = 0; i < hidden.size(); i++) {
+                glm::mat4 mvp = viewProjection * modelMatrix(m_cubes[hidden[i]]);
+                m_culler.testBox(hidden[i], glm::value_ptr(mvp));
+            }
+            m_culler.endBoxTests();
+        }
+        m_testMs += nowMs() - start;
+
+        glDisableVertexAttribArray(0);
+        glDisableVertexAttribArray(1);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+        glDisable(GL_CULL_FACE);
+        glDisable(GL_DEPTH_TEST);
+
+        m_drawn += m_cubes.size() - hidden.size();
+        m_skipped += hidden.size();
+        m_queries += m_culler.queriesIssued();
+
+        report();
+    }
+
+    virtual void teardownGl()
+    {
+        m_culler.teardownGl();
+        GpuResources::deleteBuffer(m_buffers[0]);
+        GpuResources::deleteBuffer(m_buffers[1]);
+        GpuResources::deleteProgram(m_program);
+    }
+
+private:
+    void buildCube()
+    {
+        // Four corners per face, so that each face gets its own normal
+        GLfloat vertices[6 * 4][6];
+        GLubyte indices[6 * 6];
+
+        for (int face = 0; face < 6; face++) {
+            int axis = face / 2;
+            float sign = face % 2 ? 1 : -1;
+            int u = (axis + 1) % 3, v = (axis + 2) % 3;
+
+            for (int corner = 0; corner < 4; corner++) {
+                GLfloat* out = vertices[face * 4 + corner];
+                out[axis] = sign;
+                out[u] = corner & 1 ? 1 : -1;
+                out[v] = corner & 2 ? 1 : -1;
+                out[3] = out[4] = out[5] = 0;
+                out[3 + axis] = sign;
+            }
+
+            // Counter-clockwise seen from outside
+            static const GLubyte front[6] = { 0, 1, 2, 2, 1, 3 };
+            static const GLubyte back[6] = { 0, 2, 1, 1, 2, 3 };
+            for (int i = 0; i < 6; i++) {
+                indices[face * 6 + i] = face * 4 + (sign > 0 ? front[i] : back[i]);
+            }
+        }
+
+        m_buffers[0] = GpuResources::createBuffer("occlusion cube vertices");
+        m_buffers[1] = GpuResources::createBuffer("occlusion cube indices");
+        glBindBuffer(GL_ARRAY_BUFFER, m_buffers[0]);
+        GpuResources::bufferData(m_buffers[0], GL_ARRAY_BUFFER, sizeof(vertices), vertices,
+                                 GL_STATIC_DRAW);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_buffers[1]);
+        GpuResources::bufferData(m_buffers[1], GL_ELEMENT_ARRAY_BUFFER, sizeof(indices), indices,
+                                 GL_STATIC_DRAW);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+    }
+
+    void buildScene()
+    {
+        m_walls.clear();
+        m_cubes.clear();
+
+        for (int row = 0; row < WALL_ROWS; row++) {
+            float z = FIELD_NEAR - 2 - row * WALL_SPACING;
+            float door = ((row * 7) % 5 - 2) * 8.0f;
+            float left = -WALL_WIDTH / 2, right = WALL_WIDTH / 2;
+
+            // Either side of the doorway
+            Box box;
+            box.m_center = glm::vec3((left + door - DOOR_WIDTH / 2) / 2, WALL_HEIGHT / 2, z);
+            box.m_halfSize = glm::vec3((door - DOOR_WIDTH / 2 - left) / 2, WALL_HEIGHT / 2, 0.25f);
+            m_walls.push_back(box);
+
+            box.m_center = glm::vec3((door + DOOR_WIDTH / 2 + right) / 2, WALL_HEIGHT / 2, z);
+            box.m_halfSize = glm::vec3((right - door - DOOR_WIDTH / 2) / 2, WALL_HEIGHT / 2, 0.25f);
+            m_walls.push_back(box);
+        }
+
+        for (int row = 0; row < GRID; row++) {
+            for (int column = 0; column < GRID; column++) {
+                Box box;
+                box.m_center = glm::vec3(
+                    -FIELD_WIDTH / 2 + FIELD_WIDTH * column / (GRID - 1),
+                    CUBE_SIZE + 0.8f * ((row * 13 + column * 7) % 5) / 4,
+                    FIELD_NEAR + (FIELD_FAR - FIELD_NEAR) * row / (GRID - 1));
+                box.m_halfSize = glm::vec3(CUBE_SIZE);
+                m_cubes.push_back(box);
+            }
+        }
+    }
+
+    void bindCube()
+    {
+        glBindBuffer(GL_ARRAY_BUFFER, m_buffers[0]);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_buffers[1]);
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(GLfloat), 0);
+        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(GLfloat),
+                              (void*)(3 * sizeof(GLfloat)));
+        glEnableVertexAttribArray(0);
+        glEnableVertexAttribArray(1);
+    }
+
+    static glm::mat4 modelMatrix(Box const& box)
+    {
+        return glm::scale(glm::translate(glm::mat4(1.f), box.m_center), box.m_halfSize);
+    }
+
+    void drawBox(glm::mat4 const& viewProjection, Box const& box)
+    {
+        glm::mat4 mvp = viewProjection * modelMatrix(box);
+        glUniformMatrix4fv(m_uMvp, 1, GL_FALSE, glm::value_ptr(mvp));
+        glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_BYTE, 0);
+        recordDraw(GL_TRIANGLES, 36);
+    }
+
+    void report()
+    {
+        // The frame being drawn hasn't been timed yet
+        m_cpuMs += frameStats().cpuTimeMs(1);
+
+        uint32_t frames = frameStats().frameCount();
+        if (frames == 0 || frames % REPORT_INTERVAL != 0) {
+            return;
+        }
+
+        double n = REPORT_INTERVAL;
+        printf("culling %s: %.1f of %d cubes drawn, %.1f skipped, "
+               "%.1f queries per frame\n",
+               m_culling ? "on" : "off", m_drawn / n, (int)m_cubes.size(),
+               m_skipped / n, m_queries / n);
+        printf("    %.2f ms reading results, %.2f ms box tests, "
+               "%.2f ms CPU per frame, %.1f fps\n",
+               m_readMs / n, m_testMs / n, m_cpuMs / n, frameStats().fps());
+
+        m_drawn = m_skipped = m_queries = 0;
+        m_readMs = m_testMs = m_cpuMs = 0;
+    }
+
+    bool m_culling;
+
+    GLuint m_program;
+    GLint m_uMvp;
+    GLint m_uColor;
+    GLuint m_buffers[2];
+
+    std::vector<Box> m_walls;
+    std::vector<Box> m_cubes;
+    OcclusionCuller m_culler;
+
+    uint64_t m_drawn;
+    uint64_t m_skipped;
+    uint64_t m_queries;
+    double m_readMs;
+    double m_testMs;
+    double m_cpuMs;
+};
+
+int main(int argc, char* argv[])
+{
+    OcclusionWindow w;
+    w.init(&argc, argv);
+
+    // Positional arguments are what's left after the window options
+    if (optind < argc) {
+        if (strcmp(argv[optind], "on") == 0) {
+            w.setCulling(true);
+        } else if (strcmp(argv[optind], "off") == 0) {
+            w.setCulling(false);
+        } else {
+            fprintf(stderr, "Expected \"on\" or \"off\", not \"%s\"\n", argv[optind]);
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    w.run();
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,516 @@
+#include <algorithm>
+#include <assert.h>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <vector>
+
+#include "base.hpp"
+#include "shader.hpp"
+#include "stream-buffer.hpp"
+#include "trace.hpp"
+
+// Particle fountain, as a high-count dynamic workload. Particles live in
+// structure-of-arrays form and are updated four at a time with GCC
+// vector extensions, in chunks spread over the window's job system, then
+// streamed to GL every frame and drawn as point sprites.
+//
+// Prints the population and the time spent updating, uploading and
+// submitting the draw every few seconds; add -p for the GPU side.
+//
+// The thread count defaults to the number of CPUs, or what -j says.
+//
+// Usage: particles [window options] [particles] [threads]
+
+typedef float v4sf __attribute__((vector_size(16)));
+typedef int v4si __attribute__((vector_size(16)));
+
+static inline v4sf splat(float f)
+{
+    v4sf v = { f, f, f, f };
+    return v;
+}
+
+// Lanes of 'a' where 'mask' is set, 'b' elsewhere
+static inline v4sf blend(v4si mask, v4sf a, v4sf b)
+{
+    return (v4sf)((mask & (v4si)a) | (~mask & (v4si)b));
+}
+
+// Frames between reports
+static const uint32_t REPORT_INTERVAL = 300;
+
+// Seconds a particle lives, on average
+static const float LIFETIME = 3.0f;
+
+static double nowMs()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000.0 + ts.tv_nsec / 1000000.0;
+}
+
+// The simulation, independent of GL. Arrays are padded to a multiple of
+// four and 16-byte aligned so the update never needs a scalar tail.
+class ParticleSystem
+{
+public:
+    ParticleSystem(int capacity, JobSystem& jobs)
+        : m_capacity((capacity + 3) & ~3)
+        , m_count(0)
+        , m_spawnDebt(0)
+        , m_seed(12345)
+        , m_jobs(jobs)
+    {
+        float** arrays[] = { &m_x, &m_y, &m_vx, &m_vy, &m_life };
+
+        for (size_t i = 0; i < sizeof(arrays) / sizeof(arrays[0]); i++) {
+            void* p;
+            if (posix_memalign(&p, 16, m_capacity * sizeof(float)) != 0) {
+                fprintf(stderr, "Out of memory for %d particles\n", m_capacity);
+                exit(EXIT_FAILURE);
+            }
+            memset(p, 0, m_capacity * sizeof(float));
+            *arrays[i] = (float*)p;
+        }
+
+        // Start at the steady-state population, with ages spread out so
+        // that they don't all die at once
+        spawn(capacity);
+        for (int i = 0; i < m_count; i++) {
+            m_life[i] *= random01();
+        }
+    }
+
+    ~ParticleSystem()
+    {
+        free(m_x);
+        free(m_y);
+        free(m_vx);
+        free(m_vy);
+        free(m_life);
+    }
+
+    int count() const               { return m_count; }
+    int capacity() const            { return m_capacity; }
+    int threads() const             { return m_jobs.threads(); }
+
+    float const* x() const          { return m_x; }
+    float const* y() const          { return m_y; }
+    float const* life() const       { return m_life; }
+
+    void update(float dt)
+    {
+        TRACE_SCOPE("ParticleSystem::update");
+
+        // Integrate and compact each chunk in parallel, then close the
+        // gaps between chunks and top the population back up. There are
+        // a few chunks per thread so that stealing can even things out.
+        int chunks = m_jobs.threads() * 4;
+        int chunkSize = ((m_count + chunks - 1) / chunks + 3) & ~3;
+
+        m_chunks.resize(chunks);
+        for (int c = 0; c < chunks; c++) {
+            Chunk& chunk = m_chunks[c];
+            chunk.m_begin = std::min(c * chunkSize, m_count);
+            chunk.m_end = std::min(chunk.m_begin + chunkSize, m_count);
+            chunk.m_live = chunk.m_begin;
+        }
+
+        m_dt = dt;
+        m_jobs.parallelFor(updateChunks, this, chunks, 1, m_updated);
+        m_jobs.wait(m_updated);
+
+        m_count = gather();
+
+        // Spawn at the rate that holds the population at capacity
+        m_spawnDebt += m_capacity * dt / LIFETIME;
+        int n = std::min(int(m_spawnDebt), m_capacity - m_count);
+        m_spawnDebt -= int(m_spawnDebt);
+        spawn(n);
+    }
+
+private:
+    struct Chunk
+    {
+        int m_begin;
+        int m_end;
+        int m_live;     // one past the last survivor, after compaction
+    };
+
+    static void updateChunks(void* data, size_t begin, size_t end)
+    {
+        ParticleSystem* self = static_cast<ParticleSystem*>(data);
+
+        for (size_t c = begin; c < end; c++) {
+            Chunk& chunk = self->m_chunks[c];
+
+            self->integrate(chunk.m_begin, chunk.m_end);
+            chunk.m_live = self->compact(chunk.m_begin, chunk.m_end);
+        }
+    }
+
+    // 'begin' is a multiple of four. Lanes past 'end' hold dead or stale
+    // particles and are updated along with the rest but never kept.
+    void integrate(int begin, int end)
+    {
+        v4sf dt = splat(m_dt);
+        v4sf gravity = splat(-1.5f * m_dt);
+        v4sf floor = splat(-1.0f);
+        v4sf bounce = splat(-0.6f);
+
+        for (int i = begin; i < end; i += 4) {
+            v4sf x = *(v4sf*)&m_x[i];
+            v4sf y = *(v4sf*)&m_y[i];
+            v4sf vx = *(v4sf*)&m_vx[i];
+            v4sf vy = *(v4sf*)&m_vy[i];
+            v4sf life = *(v4sf*)&m_life[i];
+
+            vy += gravity;
+            x += vx * dt;
+            y += vy * dt;
+            life -= dt;
+
+            // Bounce off the bottom of the window, losing some energy
+            v4si below = y < floor;
+            y = blend(below, floor, y);
+            vy = blend(below, vy * bounce, vy);
+
+            *(v4sf*)&m_x[i] = x;
+            *(v4sf*)&m_y[i] = y;
+            *(v4sf*)&m_vx[i] = vx;
+            *(v4sf*)&m_vy[i] = vy;
+            *(v4sf*)&m_life[i] = life;
+        }
+    }
+
+    // Moves the survivors in [begin, end) to the front of the range and
+    // returns one past the last of them
+    int compact(int begin, int end)
+    {
+        int out = begin;
+
+        for (int i = begin; i < end; i++) {
+            if (m_life[i] > 0) {
+                if (out != i) {
+                    move(i, out);
+                }
+                out++;
+            }
+        }
+        return out;
+    }
+
+    // Fills the dead space at the end of early chunks with survivors
+    // taken from the end of late ones. Moves one particle per death
+    // instead of sliding whole chunks down.
+    int gather()
+    {
+        int lo = 0;
+        int hi = m_chunks.size() - 1;
+
+        while (lo < hi) {
+            Chunk& dst = m_chunks[lo];
+            Chunk& src = m_chunks[hi];
+
+            if (dst.m_live == dst.m_end) {
+                lo++;
+            } else if (src.m_live == src.m_begin) {
+                hi--;
+            } else {
+                move(--src.m_live, dst.m_live++);
+            }
+        }
+
+        int count = 0;
+        for (size_t c = 0; c < m_chunks.size(); c++) {
+            count += m_chunks[c].m_live - m_chunks[c].m_begin;
+        }
+        return count;
+    }
+
+    void move(int from, int to)
+    {
+        m_x[to] = m_x[from];
+        m_y[to] = m_y[from];
+        m_vx[to] = m_vx[from];
+        m_vy[to] = m_vy[from];
+        m_life[to] = m_life[from];
+    }
+
+    void spawn(int n)
+    {
+        for (int i = m_count; i < m_count + n; i++) {
+            float angle = M_PI / 2 + (random01() - 0.5f) * 0.5f;
+            float speed = 1.2f + random01() * 0.8f;
+
+            m_x[i] = (random01() - 0.5f) * 0.05f;
+            m_y[i] = -0.9f;
+            m_vx[i] = cosf(angle) * speed;
+            m_vy[i] = sinf(angle) * speed;
+            m_life[i] = LIFETIME * (0.5f + random01());
+        }
+        m_count += n;
+    }
+
+    float random01()
+    {
+        // Numerical Recipes LCG; plenty for scattering particles
+        m_seed = m_seed * 1664525u + 1013904223u;
+        return (m_seed >> 8) / float(1 << 24);
+    }
+
+    int m_capacity;
+    int m_count;
+    float m_dt;
+    float m_spawnDebt;
+    uint32_t m_seed;
+
+    float* m_x;
+    float* m_y;
+    float* m_vx;
+    float* m_vy;
+    float* m_life;
+
+    std::vector<Chunk> m_chunks;
+    JobSystem& m_jobs;
+    JobCounter m_updated;
+};
+
+static const char* vert_shader_text =
+    "uniform float u_point_size;\n"
+    "uniform float u_brightness;\n"
+    "attribute float a_x;\n"
+    "attribute float a_y;\n"
+    "attribute float a_life;\n"
+    "varying vec4 v_color;\n"
+    "void main() {\n"
+    "  gl_Position = vec4(a_x, a_y, 0, 1);\n"
+    "  gl_PointSize = u_point_size * clamp(a_life, 0.3, 1.0);\n"
+    "  // White hot when young, cooling through orange to dark red\n"
+    "  float t = clamp(a_life / 3.0, 0.0, 1.0);\n"
+    "  v_color = vec4(1.0, t * 1.2, t * t, (0.4 * t + 0.1) * u_brightness);\n"
+    "}\n";
+
+static const char* frag_shader_text =
+    "precision mediump float;\n"
+    "varying vec4 v_color;\n"
+    "void main() {\n"
+    "  // Round, soft-edged sprite\n"
+    "  vec2 d = gl_PointCoord - vec2(0.5);\n"
+    "  float falloff = 1.0 - smoothstep(0.2, 0.5, length(d));\n"
+    "  gl_FragColor = vec4(v_color.rgb, v_color.a * falloff);\n"
+    "}\n";
+
+enum {
+    ATTRIB_X,
+    ATTRIB_Y,
+    ATTRIB_LIFE,
+};
+
+class ParticleWindow: public WaylandWindow
+{
+public:
+    ParticleWindow()
+        : m_particles(100000)
+        , m_system(NULL)
+        , m_stream(NULL)
+        , m_lastTime(0)
+        , m_updateMs(0)
+        , m_uploadMs(0)
+        , m_drawMs(0)
+    {
+    }
+
+    virtual ~ParticleWindow()
+    {
+        delete m_system;
+        delete m_stream;
+    }
+
+    void setParticles(int particles)   { m_particles = particles; }
+
+    // Before the first frame, which is when the job system starts
+    void setThreads(int threads)       { display()->setJobThreads(threads); }
+
+protected:
+    virtual void setupGl()
+    {
+        static char const* const attribs[] = { "a_x", "a_y", "a_life", NULL };
+
+        GLuint vert = createShader(vert_shader_text, GL_VERTEX_SHADER);
+        GLuint frag = createShader(frag_shader_text, GL_FRAGMENT_SHADER);
+        m_program = linkProgram(vert, frag, attribs);
+        GpuResources::deleteShader(vert);
+        GpuResources::deleteShader(frag);
+
+        m_uPointSize = glGetUniformLocation(m_program, "u_point_size");
+        m_uBrightness = glGetUniformLocation(m_program, "u_brightness");
+    }
+
+    virtual void drawGl(uint32_t time)
+    {
+        // The particle count and thread count are parsed after init(),
+        // which is where setupGl() runs
+        if (!m_system) {
+            m_system = new ParticleSystem(m_particles, jobs());
+            m_stream = new StreamBuffer(GL_ARRAY_BUFFER,
+                                        3 * m_system->capacity() * sizeof(float) + 32);
+            // Written once and flushed once per frame, which is the
+            // pattern mapping suits; falls back to glBufferSubData()
+            m_stream->setupGl(StreamBuffer::UPLOAD_MAP_BUFFER);
+            m_lastTime = time;
+
+            printf("%d particles, %d thread%s\n", m_system->capacity(),
+                   m_system->threads(), m_system->threads() == 1 ? "" : "s");
+        }
+
+        // Large steps would make everything bounce at once after a stall
+        float dt = (time - m_lastTime) / 1000.0f;
+        m_lastTime = time;
+        if (dt > 0.05f) {
+            dt = 0.05f;
+        }
+
+        double start = nowMs();
+        m_system->update(dt);
+        double updated = nowMs();
+
+        StreamBuffer::Span x, y, life;
+        bool mapped;
+        {
+            TRACE_SCOPE("upload");
+            size_t bytes = m_system->count() * sizeof(float);
+
+            m_stream->beginFrame();
+            x = m_stream->allocate(bytes, 16);
+            y = m_stream->allocate(bytes, 16);
+            life = m_stream->allocate(bytes, 16);
+
+            // NULL if the buffer couldn't be mapped; the frame then
+            // draws no particles
+            mapped = x.m_data && y.m_data && life.m_data;
+            if (mapped) {
+                memcpy(x.m_data, m_system->x(), bytes);
+                memcpy(y.m_data, m_system->y(), bytes);
+                memcpy(life.m_data, m_system->life(), bytes);
+            }
+            m_stream->flush();
+        }
+        GLsizei drawCount = mapped ? m_system->count() : 0;
+        double uploaded = nowMs();
+
+        {
+            TRACE_SCOPE("draw");
+            gpuPass("particles");
+
+            glViewport(0, 0, currentSize().m_width, currentSize().m_height);
+            glClearColor(0, 0, 0, 1);
+            glClear(GL_COLOR_BUFFER_BIT);
+
+            glEnable(GL_BLEND);
+            glBlendFunc(GL_SRC_ALPHA, GL_ONE);
+
+            glUseProgram(m_program);
+            glUniform1f(m_uPointSize, currentSize().m_height / 200.0f);
+
+            // Blending is additive, so dim each sprite as the population
+            // grows or the fountain turns into a white blob
+            glUniform1f(m_uBrightness, std::min(1.0f, 20000.0f / m_system->count()));
+
+            glVertexAttribPointer(ATTRIB_X, 1, GL_FLOAT, GL_FALSE, 0, x.pointer());
+            glVertexAttribPointer(ATTRIB_Y, 1, GL_FLOAT, GL_FALSE, 0, y.pointer());
+            glVertexAttribPointer(ATTRIB_LIFE, 1, GL_FLOAT, GL_FALSE, 0, life.pointer());
+            glEnableVertexAttribArray(ATTRIB_X);
+            glEnableVertexAttribArray(ATTRIB_Y);
+            glEnableVertexAttribArray(ATTRIB_LIFE);
+
+            if (drawCount > 0) {
+                glDrawArrays(GL_POINTS, 0, drawCount);
+                recordDraw(GL_POINTS, drawCount);
+            }
+
+            glDisableVertexAttribArray(ATTRIB_X);
+            glDisableVertexAttribArray(ATTRIB_Y);
+            glDisableVertexAttribArray(ATTRIB_LIFE);
+            glBindBuffer(GL_ARRAY_BUFFER, 0);
+            glDisable(GL_BLEND);
+
+            m_stream->endFrame();
+        }
+        double drawn = nowMs();
+
+        m_updateMs += updated - start;
+        m_uploadMs += uploaded - updated;
+        m_drawMs += drawn - uploaded;
+
+        report();
+    }
+
+    virtual void teardownGl()
+    {
+        if (m_stream) {
+            m_stream->teardownGl();
+            delete m_stream;
+            m_stream = NULL;
+        }
+        delete m_system;
+        m_system = NULL;
+
+        GpuResources::deleteProgram(m_program);
+    }
+
+private:
+    void report()
+    {
+        uint32_t frames = frameStats().frameCount();
+        if (frames == 0 || frames % REPORT_INTERVAL != 0) {
+            return;
+        }
+
+        printf("%d particles, %.1f fps: update %.2f ms, upload %.2f ms, "
+               "draw %.2f ms per frame\n",
+               m_system->count(), frameStats().fps(),
+               m_updateMs / REPORT_INTERVAL,
+               m_uploadMs / REPORT_INTERVAL,
+               m_drawMs / REPORT_INTERVAL);
+
+        m_updateMs = m_uploadMs = m_drawMs = 0;
+    }
+
+    int m_particles;
+
+    ParticleSystem* m_system;
+    StreamBuffer* m_stream;
+    uint32_t m_lastTime;
+
+    GLuint m_program;
+    GLint m_uPointSize;
+    GLint m_uBrightness;
+
+    // Accumulated since the last report
+    double m_updateMs;
+    double m_uploadMs;
+    double m_drawMs;
+};
+
+int main(int argc, char* argv[])
+{
+    ParticleWindow w;
+    w.init(&argc, argv);
+
+    // Positional arguments are what's left after the window options
+    if (optind < argc && atoi(argv[optind]) > 0) {
+        w.setParticles(atoi(argv[optind]));
+    }
+    if (optind + 1 < argc && atoi(argv[optind + 1]) > 0) {
+        w.setThreads(atoi(argv[optind + 1]));
+    }
+
+    w.run();
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,223 @@
+#include <assert.h>
+#include <algorithm>
+#include <cmath>
+
+#include "gpu-resources.hpp"
+#include "post-chain.hpp"
+#include "shader.hpp"
+
+static const char* vert_shader_text =
+    "attribute vec2 a_pos;\n"
+    "varying vec2 v_uv;\n"
+    "void main() {\n"
+    "  v_uv = a_pos * 0.5 + 0.5;\n"
+    "  gl_Position = vec4(a_pos, 0, 1);\n"
+    "}\n";
+
+// The rects map v_uv onto the used part of each target and keep linear
+// filtering from reaching past it: xy is the scale, zw the clamp
+static const char* post_prelude =
+    "precision mediump float;\n"
+    "varying vec2 v_uv;\n"
+    "uniform sampler2D u_source;\n"
+    "uniform sampler2D u_scene;\n"
+    "uniform vec4 u_source_rect;\n"
+    "uniform vec4 u_scene_rect;\n"
+    "uniform vec2 u_source_texel;\n"
+    "vec4 source(vec2 uv) {\n"
+    "  return texture2D(u_source, min(uv * u_source_rect.xy, u_source_rect.zw));\n"
+    "}\n"
+    "vec4 scene(vec2 uv) {\n"
+    "  return texture2D(u_scene, min(uv * u_scene_rect.xy, u_scene_rect.zw));\n"
+    "}\n";
+
+// One triangle covering the window; cheaper than a quad's two, which
+// would shade the pixels along the diagonal twice
+static const GLfloat triangle[] = {
+    -1, -1,
+    +3, -1,
+    -1, +3,
+};
+
+static void uploadRect(GLint location, RenderTarget const* target)
+{
+    glUniform4f(location,
+                target->uvScaleX(), target->uvScaleY(),
+                (target->m_usedWidth - 0.5f) / target->m_width,
+                (target->m_usedHeight - 0.5f) / target->m_height);
+}
+
+PostChain::PostChain()
+    : m_quad(0)
+    , m_scene(NULL)
+    , m_width(0)
+    , m_height(0)
+{
+}
+
+PostChain::~PostChain()
+{
+}
+
+int PostChain::addPass(char const* name, char const* fragmentShader, float scale)
+{
+    Pass pass;
+    pass.m_name = name;
+    pass.m_fragmentShader = fragmentShader;
+    pass.m_scale = scale;
+    pass.m_program = 0;
+    pass.m_uSourceRect = -1;
+    pass.m_uSourceTexel = -1;
+    pass.m_uSceneRect = -1;
+
+    m_passes.push_back(pass);
+    return m_passes.size() - 1;
+}
+
+void PostChain::setParameter(int pass, char const* name, float value)
+{
+    std::vector<Parameter>& parameters = m_passes[pass].m_parameters;
+
+    for (size_t i = 0; i < parameters.size(); i++) {
+        if (parameters[i].m_name == name) {
+            parameters[i].m_value = value;
+            return;
+        }
+    }
+
+    Parameter parameter;
+    parameter.m_name = name;
+    parameter.m_location = m_passes[pass].m_program
+                         ? glGetUniformLocation(m_passes[pass].m_program, name)
+                         : -1;
+    parameter.m_value = value;
+    parameters.push_back(parameter);
+}
+
+void PostChain::setupGl()
+{
+    static char const* const attribs[] = { "a_pos", NULL };
+
+    assert(!m_passes.empty());
+
+    GLuint vert = compileShader(vert_shader_text, GL_VERTEX_SHADER, "PostChain");
+
+    for (size_t i = 0; i < m_passes.size(); i++) {
+        Pass& pass = m_passes[i];
+
+        GLuint frag = compileShader(std::string(post_prelude) + pass.m_fragmentShader,
+                                    GL_FRAGMENT_SHADER, "PostChain");
+        pass.m_program = linkProgram(vert, frag, attribs, "PostChain");
+        GpuResources::deleteShader(frag);
+
+        pass.m_uSourceRect = glGetUniformLocation(pass.m_program, "u_source_rect");
+        pass.m_uSourceTexel = glGetUniformLocation(pass.m_program, "u_source_texel");
+        pass.m_uSceneRect = glGetUniformLocation(pass.m_program, "u_scene_rect");
+
+        glUseProgram(pass.m_program);
+        glUniform1i(glGetUniformLocation(pass.m_program, "u_source"), 0);
+        glUniform1i(glGetUniformLocation(pass.m_program, "u_scene"), 1);
+
+        for (size_t j = 0; j < pass.m_parameters.size(); j++) {
+            Parameter& parameter = pass.m_parameters[j];
+            parameter.m_location = glGetUniformLocation(pass.m_program,
+                                                        parameter.m_name.c_str());
+        }
+    }
+
+    glUseProgram(0);
+    GpuResources::deleteShader(vert);
+
+    m_quad = GpuResources::createBuffer("PostChain triangle");
+    glBindBuffer(GL_ARRAY_BUFFER, m_quad);
+    GpuResources::bufferData(m_quad, GL_ARRAY_BUFFER, sizeof(triangle), triangle,
+                             GL_STATIC_DRAW);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void PostChain::teardownGl()
+{
+    for (size_t i = 0; i < m_passes.size(); i++) {
+        GpuResources::deleteProgram(m_passes[i].m_program);
+        m_passes[i].m_program = 0;
+    }
+
+    GpuResources::deleteBuffer(m_quad);
+    m_quad = 0;
+}
+
+void PostChain::begin(RenderTargetPool& pool, GLsizei width, GLsizei height, bool depth)
+{
+    assert(!m_scene);
+
+    m_width = width;
+    m_height = height;
+    m_scene = pool.acquire(width, height, GL_RGBA, GL_UNSIGNED_BYTE, depth);
+    m_scene->bind();
+}
+
+void PostChain::end(RenderTargetPool& pool, GLuint framebuffer)
+{
+    assert(m_scene);
+
+    glDisable(GL_DEPTH_TEST);
+    glDisable(GL_BLEND);
+
+    glBindBuffer(GL_ARRAY_BUFFER, m_quad);
+    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 0, 0);
+    glEnableVertexAttribArray(0);
+
+    glActiveTexture(GL_TEXTURE1);
+    glBindTexture(GL_TEXTURE_2D, m_scene->m_color);
+
+    RenderTarget* source = m_scene;
+
+    for (size_t i = 0; i < m_passes.size(); i++) {
+        Pass const& pass = m_passes[i];
+        bool last = i + 1 == m_passes.size();
+
+        RenderTarget* output = NULL;
+        if (last) {
+            glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+            glViewport(0, 0, m_width, m_height);
+        } else {
+            GLsizei width = std::max(1, (int)ceilf(m_width * pass.m_scale));
+            GLsizei height = std::max(1, (int)ceilf(m_height * pass.m_scale));
+            output = pool.acquire(width, height);
+            output->bind();
+        }
+
+        glUseProgram(pass.m_program);
+        uploadRect(pass.m_uSourceRect, source);
+        uploadRect(pass.m_uSceneRect, m_scene);
+        glUniform2f(pass.m_uSourceTexel, 1.0f / source->m_usedWidth,
+                    1.0f / source->m_usedHeight);
+
+        for (size_t j = 0; j < pass.m_parameters.size(); j++) {
+            glUniform1f(pass.m_parameters[j].m_location, pass.m_parameters[j].m_value);
+        }
+
+        glActiveTexture(GL_TEXTURE0);
+        glBindTexture(GL_TEXTURE_2D, source->m_color);
+
+        glDrawArrays(GL_TRIANGLES, 0, 3);
+
+        // Read for the last time; the scene can still be read by any pass
+        if (source != m_scene) {
+            pool.release(source);
+        }
+        source = output;
+    }
+
+    glBindTexture(GL_TEXTURE_2D, 0);
+    glActiveTexture(GL_TEXTURE1);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    glActiveTexture(GL_TEXTURE0);
+
+    glDisableVertexAttribArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    glUseProgram(0);
+
+    pool.release(m_scene);
+    m_scene = NULL;
+}
@@ -0,0 +1,100 @@
+#ifndef __POST_CHAIN_HPP__
+#define __POST_CHAIN_HPP__
+
+#include <GLES2/gl2.h>
+
+#include <string>
+#include <vector>
+
+#include "render-target-pool.hpp"
+
+// Full-window post-processing: the scene is drawn into an offscreen
+// target, then a sequence of passes each draw a full-window triangle
+// reading the pass before. The last pass draws to the window.
+//
+//     chain.addPass("bright", brightPassShader, 0.5f);
+//     chain.addPass("blur-x", blurXShader, 0.5f);
+//     chain.addPass("blur-y", blurYShader, 0.5f);
+//     chain.addPass("composite", compositeShader, 1.0f);
+//     chain.setupGl();
+//
+//     // Every frame
+//     chain.begin(pool, width, height);   // the scene target is bound
+//     ...draw the scene...
+//     chain.end(pool);
+//
+// Intermediate targets come from a RenderTargetPool and go back to it as
+// soon as the next pass has read them, so passes of the same size and
+// format share memory: above, "blur-y" draws into the target "bright"
+// used.
+//
+// Fragment shaders get POST_PRELUDE put in front of them, which gives
+// them v_uv (0 to 1 across the window) and:
+//
+//     vec4 source(vec2 uv);   // the previous pass (the scene, for the first)
+//     vec4 scene(vec2 uv);    // the scene
+//     uniform vec2 u_source_texel;    // one texel of source(), in uv
+//
+// Targets can be bigger than the part in use (see RenderTargetPool), so
+// shaders should sample through source() and scene() rather than the
+// samplers directly.
+class PostChain
+{
+public:
+    PostChain();
+    ~PostChain();
+
+    // Before setupGl(). 'scale' is the pass's output size relative to
+    // the window; it doesn't apply to the last pass. Returns the pass's
+    // number, for setParameter().
+    int addPass(char const* name, char const* fragmentShader, float scale = 1.0f);
+
+    // Sets 'uniform float NAME' in a pass, from now on
+    void setParameter(int pass, char const* name, float value);
+
+    void setupGl();
+    void teardownGl();
+    bool isSetUp() const        { return m_quad != 0; }
+
+    // Acquires the scene target at the window's size and binds it. With
+    // 'depth' it gets a depth buffer too.
+    void begin(RenderTargetPool& pool, GLsizei width, GLsizei height, bool depth = true);
+
+    // Runs the passes, the last one into 'framebuffer' (the window's
+    // unless told otherwise) over the whole window size. Leaves blending
+    // and depth testing off.
+    void end(RenderTargetPool& pool, GLuint framebuffer = 0);
+
+    size_t passCount() const    { return m_passes.size(); }
+    char const* passName(int pass) const    { return m_passes[pass].m_name.c_str(); }
+
+private:
+    struct Parameter
+    {
+        std::string m_name;
+        GLint m_location;
+        float m_value;
+    };
+
+    struct Pass
+    {
+        std::string m_name;
+        std::string m_fragmentShader;
+        float m_scale;
+
+        GLuint m_program;
+        GLint m_uSourceRect;
+        GLint m_uSourceTexel;
+        GLint m_uSceneRect;
+        std::vector<Parameter> m_parameters;
+    };
+
+    std::vector<Pass> m_passes;
+    GLuint m_quad;
+
+    RenderTarget* m_scene;
+    GLsizei m_width;
+    GLsizei m_height;
+};
+
+#endif
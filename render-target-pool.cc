@@ -0,0 +1,182 @@
+#include <GLES2/gl2.h>
+#include <GLES2/gl2ext.h>
+#include <cstdio>
+#include <stdlib.h>
+
+#include "gpu-resources.hpp"
+#include "render-target-pool.hpp"
+
+void RenderTarget::bind() const
+{
+    glBindFramebuffer(GL_FRAMEBUFFER, m_framebuffer);
+    glViewport(0, 0, m_usedWidth, m_usedHeight);
+}
+
+static GLsizei roundUp(GLsizei size, GLsizei granularity)
+{
+    return (size + granularity - 1) / granularity * granularity;
+}
+
+RenderTargetPool::RenderTargetPool()
+    : m_frame(0)
+    , m_resizing(false)
+    , m_currentBytes(0)
+    , m_peakBytes(0)
+    , m_allocations(0)
+{
+}
+
+RenderTargetPool::~RenderTargetPool()
+{
+    // Without a context all that can go is our side of things
+    for (size_t i = 0; i < m_targets.size(); i++) {
+        delete m_targets[i];
+    }
+}
+
+void RenderTargetPool::teardownGl()
+{
+    for (size_t i = 0; i < m_targets.size(); i++) {
+        destroy(m_targets[i]);
+    }
+    m_targets.clear();
+}
+
+void RenderTargetPool::beginFrame(bool resizing)
+{
+    m_frame++;
+    m_resizing = resizing;
+
+    for (size_t i = 0; i < m_targets.size();) {
+        RenderTarget* target = m_targets[i];
+
+        if (!target->m_inUse && m_frame - target->m_lastUsed > MAX_IDLE_FRAMES) {
+            destroy(target);
+            m_targets[i] = m_targets.back();
+            m_targets.pop_back();
+        } else {
+            i++;
+        }
+    }
+}
+
+RenderTarget* RenderTargetPool::acquire(GLsizei width, GLsizei height,
+                                        GLenum format, GLenum type, bool depth)
+{
+    GLsizei maxWidth = roundUp(width, RESIZE_GRANULARITY);
+    GLsizei maxHeight = roundUp(height, RESIZE_GRANULARITY);
+    RenderTarget* best = NULL;
+
+    for (size_t i = 0; i < m_targets.size(); i++) {
+        RenderTarget* target = m_targets[i];
+
+        if (target->m_inUse || target->m_format != format ||
+            target->m_type != type || (target->m_depth != 0) != depth) {
+            continue;
+        }
+
+        if (target->m_width == width && target->m_height == height) {
+            best = target;
+            break;
+        }
+
+        // Mid-resize, anything big enough will do; the smallest of them
+        // leaves the bigger ones for bigger requests
+        if (m_resizing &&
+            target->m_width >= width && target->m_width <= maxWidth &&
+            target->m_height >= height && target->m_height <= maxHeight &&
+            (!best || target->m_bytes < best->m_bytes)) {
+            best = target;
+        }
+    }
+
+    if (!best) {
+        best = m_resizing ? allocate(maxWidth, maxHeight, format, type, depth)
+                          : allocate(width, height, format, type, depth);
+    }
+
+    best->m_inUse = true;
+    best->m_lastUsed = m_frame;
+    best->m_usedWidth = width;
+    best->m_usedHeight = height;
+    return best;
+}
+
+void RenderTargetPool::release(RenderTarget* target)
+{
+    target->m_inUse = false;
+}
+
+RenderTarget* RenderTargetPool::allocate(GLsizei width, GLsizei height,
+                                         GLenum format, GLenum type, bool depth)
+{
+    RenderTarget* target = new RenderTarget();
+    target->m_format = format;
+    target->m_type = type;
+    target->m_width = width;
+    target->m_height = height;
+    target->m_depth = 0;
+    target->m_inUse = false;
+    target->m_lastUsed = m_frame;
+
+    target->m_color = GpuResources::createTexture("render target");
+    glBindTexture(GL_TEXTURE_2D, target->m_color);
+    GpuResources::texImage2D(target->m_color, GL_TEXTURE_2D, 0, format, width, height, type, NULL);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    target->m_framebuffer = GpuResources::createFramebuffer("render target");
+    glBindFramebuffer(GL_FRAMEBUFFER, target->m_framebuffer);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D,
+                           target->m_color, 0);
+
+    target->m_bytes = width * height * GpuResources::bytesPerPixel(format, type);
+
+    if (depth) {
+        target->m_depth = GpuResources::createRenderbuffer("render target depth");
+        glBindRenderbuffer(GL_RENDERBUFFER, target->m_depth);
+        GpuResources::renderbufferStorage(target->m_depth, GL_DEPTH_COMPONENT16, width, height);
+        glBindRenderbuffer(GL_RENDERBUFFER, 0);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT,
+                                  GL_RENDERBUFFER, target->m_depth);
+
+        target->m_bytes += width * height * 2;
+    }
+
+    GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+    if (status != GL_FRAMEBUFFER_COMPLETE) {
+        fprintf(stderr, "Render target %dx%d of format 0x%x/0x%x is incomplete (0x%x)\n",
+                width, height, format, type, status);
+        exit(EXIT_FAILURE);
+    }
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+    m_targets.push_back(target);
+    m_allocations++;
+    m_currentBytes += target->m_bytes;
+    if (m_currentBytes > m_peakBytes) {
+        m_peakBytes = m_currentBytes;
+    }
+
+    return target;
+}
+
+void RenderTargetPool::destroy(RenderTarget* target)
+{
+    GpuResources::deleteFramebuffer(target->m_framebuffer);
+    GpuResources::deleteTexture(target->m_color);
+    GpuResources::deleteRenderbuffer(target->m_depth);
+
+    m_currentBytes -= target->m_bytes;
+    delete target;
+}
+
+void RenderTargetPool::printSummary(FILE* stream) const
+{
+    fprintf(stream, "Render targets: %zu now (%.1f MB), peak %.1f MB, %u allocations\n",
+            m_targets.size(), m_currentBytes / 1048576.0, m_peakBytes / 1048576.0,
+            m_allocations);
+}
@@ -0,0 +1,105 @@
+#ifndef __RENDER_TARGET_POOL_HPP__
+#define __RENDER_TARGET_POOL_HPP__
+
+#include <GLES2/gl2.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include <vector>
+
+// An offscreen framebuffer: a color texture and optionally a 16-bit
+// depth renderbuffer. The texture can be bigger than the part in use
+// (see RenderTargetPool); anything sampling it should scale its texture
+// coordinates by uvScale().
+struct RenderTarget
+{
+    GLuint m_framebuffer;
+    GLuint m_color;
+    GLuint m_depth;             // 0 without depth
+
+    GLenum m_format;            // glTexImage2D() format and type
+    GLenum m_type;
+
+    // Allocated size, and the part asked for by the last acquire()
+    GLsizei m_width;
+    GLsizei m_height;
+    GLsizei m_usedWidth;
+    GLsizei m_usedHeight;
+
+    size_t m_bytes;
+
+    // Binds the framebuffer with the viewport on the used part
+    void bind() const;
+
+    float uvScaleX() const      { return float(m_usedWidth) / m_width; }
+    float uvScaleY() const      { return float(m_usedHeight) / m_height; }
+
+private:
+    friend class RenderTargetPool;
+
+    bool m_inUse;
+    uint32_t m_lastUsed;        // Pool frame it was last acquired in
+};
+
+// Hands out RenderTargets by size and format, and takes them back for
+// reuse by later passes of the same frame or by later frames. Targets
+// nobody has asked for in MAX_IDLE_FRAMES frames are freed.
+//
+// While the window is being resized, sizes are rounded up to multiples
+// of RESIZE_GRANULARITY and any free target at least as big as asked for
+// (but not more than that rounding) is reused, so the steps of an
+// interactive resize don't each reallocate. Once the size has settled,
+// exact-size targets get allocated and the oversized ones age out.
+//
+// Allocation is lazy: nothing touches GL until the first acquire().
+class RenderTargetPool
+{
+public:
+    static const uint32_t MAX_IDLE_FRAMES = 4;
+    static const GLsizei RESIZE_GRANULARITY = 128;
+
+    RenderTargetPool();
+    ~RenderTargetPool();
+
+    // Deletes every target. Needs the context current.
+    void teardownGl();
+
+    // Once per frame, before any acquire(). Frees idle targets.
+    void beginFrame(bool resizing);
+
+    // 'format' and 'type' as for glTexImage2D(): GL_RGBA and
+    // GL_UNSIGNED_BYTE, GL_RGB and GL_UNSIGNED_SHORT_5_6_5, ...
+    RenderTarget* acquire(GLsizei width, GLsizei height,
+                          GLenum format = GL_RGBA,
+                          GLenum type = GL_UNSIGNED_BYTE,
+                          bool depth = false);
+
+    // The target can be handed out again, even within this frame, so
+    // only release it once nothing more will be drawn into or sampled
+    // from it
+    void release(RenderTarget* target);
+
+    // GPU memory held by targets, by this estimate of bytes per pixel
+    size_t currentBytes() const         { return m_currentBytes; }
+    size_t peakBytes() const            { return m_peakBytes; }
+    size_t targetCount() const          { return m_targets.size(); }
+    uint32_t allocations() const        { return m_allocations; }
+
+    void printSummary(FILE* stream) const;
+
+private:
+    RenderTarget* allocate(GLsizei width, GLsizei height,
+                           GLenum format, GLenum type, bool depth);
+    void destroy(RenderTarget* target);
+
+    std::vector<RenderTarget*> m_targets;
+    uint32_t m_frame;
+    bool m_resizing;
+
+    size_t m_currentBytes;
+    size_t m_peakBytes;
+    uint32_t m_allocations;
+};
+
+#endif
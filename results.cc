@@ -0,0 +1,312 @@
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+
+#include "results.hpp"
+
+BenchResult::BenchResult()
+    : m_width(0)
+    , m_height(0)
+    , m_run(0)
+{
+}
+
+std::string BenchResult::id() const
+{
+    return m_name + ":" + m_params;
+}
+
+bool BenchResult::higherIsBetter() const
+{
+    size_t len = m_unit.size();
+    return len >= 2 && m_unit.compare(len - 2, 2, "/s") == 0;
+}
+
+SampleStats summarize(std::vector<double> const& samples)
+{
+    SampleStats stats;
+    memset(&stats, 0, sizeof(stats));
+
+    size_t n = samples.size();
+    if (n == 0) {
+        return stats;
+    }
+
+    std::vector<double> sorted(samples);
+    std::sort(sorted.begin(), sorted.end());
+
+    for (size_t i = 0; i < n; i++) {
+        stats.m_mean += sorted[i];
+    }
+    stats.m_mean /= n;
+
+    double variance = 0;
+    for (size_t i = 0; i < n; i++) {
+        variance += (sorted[i] - stats.m_mean) * (sorted[i] - stats.m_mean);
+    }
+    stats.m_stddev = n > 1 ? sqrt(variance / (n - 1)) : 0;
+
+    stats.m_median = n % 2 ? sorted[n / 2] : (sorted[n / 2 - 1] + sorted[n / 2]) / 2;
+    stats.m_min = sorted.front();
+    stats.m_max = sorted.back();
+    return stats;
+}
+
+// Control characters are escaped too: a raw newline, say in a driver's
+// GL_RENDERER, would split the record across lines
+static void writeString(FILE* f, std::string const& s)
+{
+    fputc('"', f);
+    for (size_t i = 0; i < s.size(); i++) {
+        unsigned char c = s[i];
+
+        if (c == '"' || c == '\\') {
+            fputc('\\', f);
+            fputc(c, f);
+        } else if (c == '\n') {
+            fputs("\\n", f);
+        } else if (c == '\t') {
+            fputs("\\t", f);
+        } else if (c < 0x20) {
+            fprintf(f, "\\u%04x", c);
+        } else {
+            fputc(c, f);
+        }
+    }
+    fputc('"', f);
+}
+
+static void writeKey(FILE* f, char const* key, std::string const& value)
+{
+    fprintf(f, ", \"%s\": ", key);
+    writeString(f, value);
+}
+
+void writeResult(FILE* f, BenchResult const& result)
+{
+    fprintf(f, "{\"name\": ");
+    writeString(f, result.m_name);
+    writeKey(f, "params", result.m_params);
+    writeKey(f, "unit", result.m_unit);
+    writeKey(f, "renderer", result.m_renderer);
+    writeKey(f, "version", result.m_version);
+    fprintf(f, ", \"width\": %d, \"height\": %d", result.m_width, result.m_height);
+
+    if (!result.m_commit.empty()) {
+        writeKey(f, "commit", result.m_commit);
+    }
+    if (result.m_run) {
+        fprintf(f, ", \"run\": %lld", (long long)result.m_run);
+    }
+
+    fprintf(f, ", \"samples\": [");
+    for (size_t i = 0; i < result.m_samples.size(); i++) {
+        fprintf(f, "%s%.6g", i ? ", " : "", result.m_samples[i]);
+    }
+
+    SampleStats stats = summarize(result.m_samples);
+    fprintf(f, "], \"mean\": %.6g, \"median\": %.6g, \"stddev\": %.6g, "
+            "\"min\": %.6g, \"max\": %.6g}\n",
+            stats.m_mean, stats.m_median, stats.m_stddev, stats.m_min, stats.m_max);
+}
+
+// Just enough JSON for the flat objects writeResult() produces
+
+static void skipSpace(char const*& p)
+{
+    while (*p == ' ' || *p == '\t' || *p == '\n' || *p == '\r') {
+        p++;
+    }
+}
+
+static bool parseString(char const*& p, std::string& out)
+{
+    skipSpace(p);
+    if (*p != '"') {
+        return false;
+    }
+    p++;
+
+    out.clear();
+    while (*p && *p != '"') {
+        if (*p != '\\' || !p[1]) {
+            out += *p++;
+            continue;
+        }
+
+        p++;
+        switch (*p) {
+            case 'n':   out += '\n'; p++; break;
+            case 't':   out += '\t'; p++; break;
+            case 'r':   out += '\r'; p++; break;
+            case 'b':   out += '\b'; p++; break;
+            case 'f':   out += '\f'; p++; break;
+
+            case 'u': {
+                // writeString() only makes these for control characters,
+                // but anything else in the basic plane goes back as UTF-8
+                char hex[5] = { 0 };
+                for (int i = 0; i < 4 && isxdigit((unsigned char)p[1 + i]); i++) {
+                    hex[i] = p[1 + i];
+                }
+                if (strlen(hex) != 4) {
+                    return false;
+                }
+                p += 5;
+
+                long code = strtol(hex, NULL, 16);
+                if (code < 0x80) {
+                    out += (char)code;
+                } else if (code < 0x800) {
+                    out += (char)(0xc0 | code >> 6);
+                    out += (char)(0x80 | (code & 0x3f));
+                } else {
+                    out += (char)(0xe0 | code >> 12);
+                    out += (char)(0x80 | (code >> 6 & 0x3f));
+                    out += (char)(0x80 | (code & 0x3f));
+                }
+                break;
+            }
+
+            default:    out += *p++; break;
+        }
+    }
+
+    if (*p != '"') {
+        return false;
+    }
+    p++;
+    return true;
+}
+
+static bool parseNumber(char const*& p, double& out)
+{
+    skipSpace(p);
+    char* end;
+    out = strtod(p, &end);
+    if (end == p) {
+        return false;
+    }
+    p = end;
+    return true;
+}
+
+static bool parseNumbers(char const*& p, std::vector<double>& out)
+{
+    skipSpace(p);
+    if (*p++ != '[') {
+        return false;
+    }
+
+    out.clear();
+    skipSpace(p);
+    if (*p == ']') {
+        p++;
+        return true;
+    }
+
+    for (;;) {
+        double value;
+        if (!parseNumber(p, value)) {
+            return false;
+        }
+        out.push_back(value);
+
+        skipSpace(p);
+        if (*p == ']') {
+            p++;
+            return true;
+        }
+        if (*p++ != ',') {
+            return false;
+        }
+    }
+}
+
+// Any value of a key we don't know: a string, a number, or an array of
+// numbers
+static bool skipValue(char const*& p)
+{
+    skipSpace(p);
+
+    std::string s;
+    std::vector<double> numbers;
+    double number;
+
+    if (*p == '"') {
+        return parseString(p, s);
+    } else if (*p == '[') {
+        return parseNumbers(p, numbers);
+    } else {
+        return parseNumber(p, number);
+    }
+}
+
+bool parseResult(char const* line, BenchResult& result)
+{
+    char const* p = line;
+    result = BenchResult();
+
+    skipSpace(p);
+    if (*p++ != '{') {
+        return false;
+    }
+
+    for (;;) {
+        std::string key;
+        if (!parseString(p, key)) {
+            return false;
+        }
+
+        skipSpace(p);
+        if (*p++ != ':') {
+            return false;
+        }
+
+        bool ok;
+        double number = 0;
+
+        if (key == "name") {
+            ok = parseString(p, result.m_name);
+        } else if (key == "params") {
+            ok = parseString(p, result.m_params);
+        } else if (key == "unit") {
+            ok = parseString(p, result.m_unit);
+        } else if (key == "renderer") {
+            ok = parseString(p, result.m_renderer);
+        } else if (key == "version") {
+            ok = parseString(p, result.m_version);
+        } else if (key == "commit") {
+            ok = parseString(p, result.m_commit);
+        } else if (key == "samples") {
+            ok = parseNumbers(p, result.m_samples);
+        } else if (key == "width" || key == "height" || key == "run") {
+            ok = parseNumber(p, number);
+            if (key == "width") {
+                result.m_width = number;
+            } else if (key == "height") {
+                result.m_height = number;
+            } else {
+                result.m_run = number;
+            }
+        } else {
+            ok = skipValue(p);
+        }
+
+        if (!ok) {
+            return false;
+        }
+
+        skipSpace(p);
+        if (*p == '}') {
+            break;
+        }
+        if (*p++ != ',') {
+            return false;
+        }
+    }
+
+    return !result.m_name.empty() && !result.m_samples.empty();
+}
@@ -0,0 +1,67 @@
+#ifndef __RESULTS_HPP__
+#define __RESULTS_HPP__
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include <string>
+#include <vector>
+
+// One measured quantity from one run: every repetition of a glbench
+// test, or every frame time of a demo run with -F. Stored as a single
+// line of JSON so that result files can simply be appended to, grepped
+// and concatenated:
+//
+//     {"name": "fill", "params": "overdraw=4", "unit": "Mpix/s",
+//      "renderer": "...", "version": "...", "samples": [...], ...}
+//
+// The commit and run time are filled in by benchdb when a result goes
+// into a store.
+struct BenchResult
+{
+    BenchResult();
+
+    // "name:params", what results are matched on across runs
+    std::string id() const;
+
+    // Rates ("Mpix/s") go up when things improve; times ("ms") go down
+    bool higherIsBetter() const;
+
+    std::string m_name;
+    std::string m_params;
+    std::string m_unit;
+
+    // GL_RENDERER and GL_VERSION of the context it was measured on
+    std::string m_renderer;
+    std::string m_version;
+
+    int m_width;
+    int m_height;
+
+    std::string m_commit;
+    int64_t m_run;              // Seconds since the epoch; 0 if unknown
+
+    std::vector<double> m_samples;
+};
+
+struct SampleStats
+{
+    double m_mean;
+    double m_median;
+    double m_stddev;            // Sample standard deviation
+    double m_min;
+    double m_max;
+};
+
+SampleStats summarize(std::vector<double> const& samples);
+
+// Writes 'result' as one line, with its SampleStats alongside the
+// samples for the benefit of other tools
+void writeResult(FILE* f, BenchResult const& result);
+
+// Reads back a line written by writeResult(). Unknown keys are skipped,
+// the stats are recomputed from the samples rather than read. Returns
+// false on anything else.
+bool parseResult(char const* line, BenchResult& result);
+
+#endif
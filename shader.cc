@@ -0,0 +1,137 @@
+#include <assert.h>
+#include <cstdio>
+#include <stdlib.h>
+
+#include <algorithm>
+
+#include "gpu-resources.hpp"
+#include "shader.hpp"
+#include "trace.hpp"
+
+GLuint compileShader(std::string const& shaderText, GLenum shaderType, char const* tag)
+{
+    TRACE_SCOPE("compileShader");
+
+    GLuint shader;
+    GLint status;
+
+    shader = GpuResources::createShader(shaderType, tag);
+    assert(shader != 0);
+
+    GLchar* sources[] = {
+        (GLchar*)shaderText.c_str(),
+        NULL
+    };
+
+    glShaderSource(shader, 1, sources, NULL);
+    glCompileShader(shader);
+
+    glGetShaderiv(shader, GL_COMPILE_STATUS, &status);
+    if (!status) {
+        char log[1000];
+        GLsizei len;
+        glGetShaderInfoLog(shader, 1000, &len, log);
+        std::fprintf(stderr, "Error: compiling %s: %*s\n",
+                     shaderType == GL_VERTEX_SHADER ? "vertex" : "fragment",
+                     len, log);
+        exit(EXIT_FAILURE);
+    }
+
+    return shader;
+}
+
+GLuint linkProgram(GLuint vert, GLuint frag, char const* const* attribs, char const* tag)
+{
+    TRACE_SCOPE("linkProgram");
+
+    GLuint program;
+    GLint status;
+
+    program = GpuResources::createProgram(tag);
+    glAttachShader(program, frag);
+    glAttachShader(program, vert);
+
+    for (GLuint i = 0; attribs && attribs[i]; i++) {
+        glBindAttribLocation(program, i, attribs[i]);
+    }
+
+    glLinkProgram(program);
+
+    glGetProgramiv(program, GL_LINK_STATUS, &status);
+    if (!status) {
+        char log[1000];
+        GLsizei len;
+        glGetProgramInfoLog(program, 1000, &len, log);
+        std::fprintf(stderr, "Error: linking:\n%*s\n", len, log);
+        exit(EXIT_FAILURE);
+    }
+
+    return program;
+}
+
+std::string withDefines(std::string const& shaderText,
+                        std::vector<std::string> const& defines)
+{
+    std::string ret;
+
+    for (size_t i = 0; i < defines.size(); i++) {
+        std::string define = defines[i];
+        size_t eq = define.find('=');
+        if (eq != std::string::npos) {
+            define[eq] = ' ';
+        }
+        ret += "#define " + define + "\n";
+    }
+
+    return ret + shaderText;
+}
+
+ShaderVariants::ShaderVariants(char const* vertText, char const* fragText,
+                               char const* const* attribs)
+    : m_vertText(vertText)
+    , m_fragText(fragText)
+    , m_attribs(attribs)
+{
+}
+
+ShaderVariants::~ShaderVariants()
+{
+}
+
+GLuint ShaderVariants::program(std::vector<std::string> const& defines)
+{
+    std::vector<std::string> sorted(defines);
+    std::sort(sorted.begin(), sorted.end());
+
+    std::string key;
+    for (size_t i = 0; i < sorted.size(); i++) {
+        key += sorted[i] + " ";
+    }
+
+    std::map<std::string, GLuint>::const_iterator it = m_programs.find(key);
+    if (it != m_programs.end()) {
+        return it->second;
+    }
+
+    TRACE_SCOPE("ShaderVariants::program");
+
+    GLuint vert = compileShader(withDefines(m_vertText, sorted), GL_VERTEX_SHADER,
+                                "ShaderVariants");
+    GLuint frag = compileShader(withDefines(m_fragText, sorted), GL_FRAGMENT_SHADER,
+                                "ShaderVariants");
+    GLuint program = linkProgram(vert, frag, m_attribs, "ShaderVariants");
+    GpuResources::deleteShader(vert);
+    GpuResources::deleteShader(frag);
+
+    m_programs[key] = program;
+    return program;
+}
+
+void ShaderVariants::teardownGl()
+{
+    std::map<std::string, GLuint>::const_iterator it;
+    for (it = m_programs.begin(); it != m_programs.end(); ++it) {
+        GpuResources::deleteProgram(it->second);
+    }
+    m_programs.clear();
+}
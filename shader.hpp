@@ -0,0 +1,54 @@
+#ifndef __SHADER_HPP__
+#define __SHADER_HPP__
+
+#include <GLES2/gl2.h>
+
+#include <map>
+#include <string>
+#include <vector>
+
+// Compiles a single shader stage. Exits the process with the driver's
+// info log on failure, like the rest of the framework does for setup
+// errors. 'tag' names it in GpuResources; delete it with
+// GpuResources::deleteShader().
+GLuint compileShader(std::string const& shaderText, GLenum shaderType,
+                     char const* tag = "shader");
+
+// Links 'vert' and 'frag' into a program. 'attribs' is an optional
+// NULL-terminated list of attribute names that get bound to locations
+// 0, 1, 2, ... in order before linking. Delete the program with
+// GpuResources::deleteProgram().
+GLuint linkProgram(GLuint vert, GLuint frag, char const* const* attribs = NULL,
+                   char const* tag = "program");
+
+// 'shaderText' with a "#define NAME" line in front of it for each entry
+// of 'defines'. "NAME=VALUE" entries become "#define NAME VALUE".
+std::string withDefines(std::string const& shaderText,
+                        std::vector<std::string> const& defines);
+
+// #define permutations of one vertex/fragment shader pair. Each set of
+// defines is compiled and linked the first time it is asked for and
+// reused after that, so cheaper variants (per-vertex lighting, mediump
+// instead of highp, ...) can be picked per device at startup without
+// maintaining several copies of the source.
+class ShaderVariants
+{
+public:
+    ShaderVariants(char const* vertText, char const* fragText,
+                   char const* const* attribs = NULL);
+    ~ShaderVariants();
+
+    // The order of 'defines' doesn't matter
+    GLuint program(std::vector<std::string> const& defines);
+
+    // Deletes every variant built so far
+    void teardownGl();
+
+private:
+    char const* m_vertText;
+    char const* m_fragText;
+    char const* const* m_attribs;
+    std::map<std::string, GLuint> m_programs;
+};
+
+#endif
@@ -31,7 +31,7 @@ public:
     {
         GLint status;
 
-        m_program = glCreateProgram();
+        m_program = GpuResources::createProgram("spinny-triangle");
 
         m_fragShader = createShader(frag_shader_text, GL_FRAGMENT_SHADER);
         glAttachShader(m_program, m_fragShader);
@@ -84,9 +84,10 @@ public:
         rotation[1][1] = cos(angle);
 
         glViewport(0, 0, currentSize().m_width, currentSize().m_height);
-        glClearColor(0, 0, 0, 0.5);
+        glClearColor(0, 0, 0, 1);
         glClear(GL_COLOR_BUFFER_BIT);
 
+        glUseProgram(m_program);
         glVertexAttribPointer(m_pos, 2, GL_FLOAT, GL_FALSE, 0, verts);
         glVertexAttribPointer(m_col, 3, GL_FLOAT, GL_FALSE, 0, colors);
         glEnableVertexAttribArray(m_pos);
@@ -95,17 +96,19 @@ public:
         glUniformMatrix4fv(m_rotation, 1, GL_FALSE, (GLfloat *)rotation);
 
         glDrawArrays(GL_TRIANGLES, 0, 3);
+        recordDraw(GL_TRIANGLES, 3);
 
         glDisableVertexAttribArray(m_pos);
         glDisableVertexAttribArray(m_col);
+        glUseProgram(0);
     }
 
     virtual void teardownGl()
     {
         glUseProgram(0);
-        glDeleteShader(m_fragShader);
-        glDeleteShader(m_vertShader);
-        glDeleteProgram(m_program);
+        GpuResources::deleteShader(m_fragShader);
+        GpuResources::deleteShader(m_vertShader);
+        GpuResources::deleteProgram(m_program);
     }
 
 private:
@@ -0,0 +1,187 @@
+#include <assert.h>
+#include <cstdio>
+
+#include "gl-ext.hpp"
+#include "gpu-resources.hpp"
+#include "stream-buffer.hpp"
+
+static PFNEGLCREATESYNCKHRPROC s_createSync;
+static PFNEGLDESTROYSYNCKHRPROC s_destroySync;
+static PFNEGLCLIENTWAITSYNCKHRPROC s_clientWaitSync;
+
+static bool loadFenceSync(EGLDisplay display)
+{
+    if (!hasEglExtension(display, "EGL_KHR_fence_sync")) {
+        return false;
+    }
+
+    s_createSync = (PFNEGLCREATESYNCKHRPROC)eglGetProcAddress("eglCreateSyncKHR");
+    s_destroySync = (PFNEGLDESTROYSYNCKHRPROC)eglGetProcAddress("eglDestroySyncKHR");
+    s_clientWaitSync = (PFNEGLCLIENTWAITSYNCKHRPROC)eglGetProcAddress("eglClientWaitSyncKHR");
+
+    return s_createSync && s_destroySync && s_clientWaitSync;
+}
+
+StreamBuffer::StreamBuffer(GLenum target, GLsizeiptr segmentSize)
+    : m_target(target)
+    , m_segmentSize(segmentSize)
+    , m_upload(UPLOAD_SUB_DATA)
+    , m_fences(false)
+    , m_current(0)
+    , m_head(0)
+    , m_flushed(0)
+    , m_mapped(NULL)
+    , m_frameOpen(false)
+    , m_stalls(0)
+{
+    for (int i = 0; i < SEGMENTS; i++) {
+        m_segments[i].m_buffer = 0;
+        m_segments[i].m_fence = EGL_NO_SYNC_KHR;
+    }
+}
+
+StreamBuffer::~StreamBuffer()
+{
+}
+
+void StreamBuffer::setupGl(Upload upload)
+{
+    m_upload = upload;
+    if (m_upload == UPLOAD_MAP_BUFFER && !glExtensions().m_mapBuffer) {
+        m_upload = UPLOAD_SUB_DATA;
+    }
+
+    if (m_upload == UPLOAD_SUB_DATA) {
+        m_staging.resize(m_segmentSize);
+    }
+
+    m_fences = loadFenceSync(eglGetCurrentDisplay());
+
+    for (int i = 0; i < SEGMENTS; i++) {
+        m_segments[i].m_buffer = GpuResources::createBuffer("StreamBuffer segment");
+        glBindBuffer(m_target, m_segments[i].m_buffer);
+        GpuResources::bufferData(m_segments[i].m_buffer, m_target, m_segmentSize, NULL,
+                                 GL_STREAM_DRAW);
+    }
+    glBindBuffer(m_target, 0);
+
+    m_current = 0;
+    m_head = m_flushed = 0;
+    m_frameOpen = false;
+    m_stalls = 0;
+}
+
+void StreamBuffer::teardownGl()
+{
+    EGLDisplay display = eglGetCurrentDisplay();
+
+    if (m_mapped) {
+        glBindBuffer(m_target, m_segments[m_current].m_buffer);
+        glExtensions().UnmapBufferOES(m_target);
+        m_mapped = NULL;
+    }
+
+    for (int i = 0; i < SEGMENTS; i++) {
+        if (m_segments[i].m_fence != EGL_NO_SYNC_KHR) {
+            s_destroySync(display, m_segments[i].m_fence);
+            m_segments[i].m_fence = EGL_NO_SYNC_KHR;
+        }
+        GpuResources::deleteBuffer(m_segments[i].m_buffer);
+        m_segments[i].m_buffer = 0;
+    }
+
+    m_staging.clear();
+}
+
+void StreamBuffer::beginFrame()
+{
+    EGLDisplay display = eglGetCurrentDisplay();
+
+    // Fence the previous frame's buffer here rather than in endFrame().
+    // By now eglSwapBuffers() has flushed that frame, whereas creating a
+    // fence mid-frame forces a flush of its own, which costs whole
+    // milliseconds on some drivers (llvmpipe). Commands issued since are
+    // covered as well, which only makes the wait more conservative.
+    if (m_fences && m_frameOpen) {
+        m_segments[m_current].m_fence =
+            s_createSync(display, EGL_SYNC_FENCE_KHR, NULL);
+    }
+    m_frameOpen = true;
+
+    m_current = (m_current + 1) % SEGMENTS;
+    m_head = m_flushed = 0;
+
+    Segment& segment = m_segments[m_current];
+    if (segment.m_fence == EGL_NO_SYNC_KHR) {
+        return;
+    }
+
+    // Usually signalled long ago; only count the waits that block
+    EGLint status = s_clientWaitSync(display, segment.m_fence, 0, 0);
+    if (status == EGL_TIMEOUT_EXPIRED_KHR) {
+        m_stalls++;
+        s_clientWaitSync(display, segment.m_fence,
+                         EGL_SYNC_FLUSH_COMMANDS_BIT_KHR, EGL_FOREVER_KHR);
+    }
+
+    s_destroySync(display, segment.m_fence);
+    segment.m_fence = EGL_NO_SYNC_KHR;
+}
+
+void StreamBuffer::endFrame()
+{
+    flush();
+}
+
+StreamBuffer::Span StreamBuffer::allocate(GLsizeiptr size, GLsizeiptr alignment)
+{
+    assert((alignment & (alignment - 1)) == 0);
+
+    Span span;
+    span.m_buffer = m_segments[m_current].m_buffer;
+    span.m_offset = (m_head + alignment - 1) & ~(alignment - 1);
+    span.m_size = size;
+    span.m_data = NULL;
+
+    if (span.m_offset + size > m_segmentSize) {
+        return span;
+    }
+
+    if (m_upload == UPLOAD_MAP_BUFFER) {
+        if (!m_mapped) {
+            glBindBuffer(m_target, span.m_buffer);
+            m_mapped = (char*)glExtensions().MapBufferOES(m_target, GL_WRITE_ONLY_OES);
+            if (!m_mapped) {
+                return span;
+            }
+        }
+        span.m_data = m_mapped + span.m_offset;
+    } else {
+        span.m_data = &m_staging[span.m_offset];
+    }
+
+    m_head = span.m_offset + size;
+    return span;
+}
+
+void StreamBuffer::flush()
+{
+    glBindBuffer(m_target, m_segments[m_current].m_buffer);
+
+    if (m_upload == UPLOAD_MAP_BUFFER) {
+        if (m_mapped) {
+            m_mapped = NULL;
+
+            // Only fails if the contents were lost, e.g. to a mode
+            // switch; the frame draws garbage and the next one is fine
+            if (!glExtensions().UnmapBufferOES(m_target)) {
+                fprintf(stderr, "StreamBuffer: buffer contents lost\n");
+            }
+        }
+    } else if (m_head > m_flushed) {
+        glBufferSubData(m_target, m_flushed, m_head - m_flushed,
+                        &m_staging[m_flushed]);
+    }
+
+    m_flushed = m_head;
+}
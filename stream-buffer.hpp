@@ -0,0 +1,97 @@
+#ifndef __STREAM_BUFFER_HPP__
+#define __STREAM_BUFFER_HPP__
+
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#include <GLES2/gl2.h>
+
+#include <vector>
+
+// Home for geometry that is generated fresh every frame (text, debug
+// lines, particles...). A few large buffer objects are used as a ring,
+// one per frame: allocate() hands out aligned spans of the current one
+// and flush() gets what was written into them to GL, either with one
+// glBufferSubData() or by unmapping a GL_OES_mapbuffer mapping.
+//
+// A buffer is only written again SEGMENTS frames later. With
+// EGL_KHR_fence_sync beginFrame() waits on a fence from the last time
+// round to make sure the GPU is done reading it; without, it relies on
+// the swap chain never letting the CPU get more than SEGMENTS - 1 frames
+// ahead. Either way, frames are expected to be separated by a swap.
+class StreamBuffer
+{
+public:
+    enum Upload
+    {
+        UPLOAD_SUB_DATA,
+        UPLOAD_MAP_BUFFER,
+    };
+
+    static const int SEGMENTS = 3;
+
+    struct Span
+    {
+        GLuint m_buffer;
+        GLintptr m_offset;
+        GLsizeiptr m_size;
+
+        // Where to write. NULL if the allocation didn't fit.
+        void* m_data;
+
+        // For glVertexAttribPointer() and glDrawElements() once the
+        // buffer is bound
+        void const* pointer(GLsizeiptr within = 0) const {
+            return (char const*)0 + m_offset + within;
+        }
+    };
+
+    // 'segmentSize' is the most that can be allocated in one frame
+    StreamBuffer(GLenum target, GLsizeiptr segmentSize);
+    ~StreamBuffer();
+
+    // Falls back to UPLOAD_SUB_DATA without GL_OES_mapbuffer
+    void setupGl(Upload upload = UPLOAD_SUB_DATA);
+    void teardownGl();
+
+    bool isSetUp() const        { return m_segments[0].m_buffer != 0; }
+    Upload upload() const       { return m_upload; }
+    bool hasFences() const      { return m_fences; }
+
+    void beginFrame();
+    void endFrame();
+
+    // 'alignment' must be a power of two
+    Span allocate(GLsizeiptr size, GLsizeiptr alignment = 4);
+
+    // Makes everything allocated so far usable for drawing and leaves the
+    // current buffer bound to the target. With UPLOAD_MAP_BUFFER, call it
+    // once per frame if possible: allocating again afterwards maps the
+    // buffer again, which many drivers serialize against the GPU.
+    void flush();
+
+    // Times beginFrame() had to wait for the GPU since setupGl()
+    unsigned stalls() const     { return m_stalls; }
+
+private:
+    struct Segment
+    {
+        GLuint m_buffer;
+        EGLSyncKHR m_fence;
+    };
+
+    GLenum m_target;
+    GLsizeiptr m_segmentSize;
+    Upload m_upload;
+    bool m_fences;
+
+    Segment m_segments[SEGMENTS];
+    int m_current;
+    GLsizeiptr m_head;
+    GLsizeiptr m_flushed;
+    std::vector<char> m_staging;
+    char* m_mapped;
+    bool m_frameOpen;
+    unsigned m_stalls;
+};
+
+#endif
@@ -0,0 +1,321 @@
+#include <cmath>
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <vector>
+
+#include "base.hpp"
+#include "shader.hpp"
+#include "stream-buffer.hpp"
+
+#define N_ELEMENTS(_a) (sizeof(_a) / sizeof(_a[0]))
+
+// Dynamic-geometry upload benchmark. Every frame regenerates 'triangles'
+// small triangles on the CPU and draws them, getting the vertices to GL
+// one of four ways:
+//
+//   ring       StreamBuffer, glBufferSubData() into a ring of buffers
+//   ring-map   StreamBuffer, writing through a GL_OES_mapbuffer mapping
+//   orphan     one buffer, re-specified with glBufferData() every frame
+//   client     client-side vertex arrays
+//
+// Reports frame rate, average CPU time per frame and upload bandwidth.
+// Run with -s to watch, and without vsync in the way if the compositor
+// allows it, or the frame rate just tracks the display.
+//
+// Usage: streambench [window options] [ring|ring-map|orphan|client] [triangles]
+
+static const char* vert_shader_text =
+    "attribute vec2 a_pos;\n"
+    "attribute vec4 a_color;\n"
+    "varying vec4 v_color;\n"
+    "void main() {\n"
+    "  gl_Position = vec4(a_pos, 0, 1);\n"
+    "  v_color = a_color;\n"
+    "}\n";
+
+static const char* frag_shader_text =
+    "precision mediump float;\n"
+    "varying vec4 v_color;\n"
+    "void main() {\n"
+    "  gl_FragColor = v_color;\n"
+    "}\n";
+
+// Frames between reports
+static const uint32_t REPORT_INTERVAL = 120;
+
+enum Method
+{
+    METHOD_RING,
+    METHOD_RING_MAP,
+    METHOD_ORPHAN,
+    METHOD_CLIENT,
+};
+
+static char const* const s_methodNames[] = {
+    "ring",
+    "ring-map",
+    "orphan",
+    "client",
+};
+
+struct Vertex
+{
+    GLfloat x, y;
+    GLubyte r, g, b, a;
+};
+
+class StreamBenchWindow: public WaylandWindow
+{
+public:
+    StreamBenchWindow()
+        : m_method(METHOD_RING)
+        , m_triangles(20000)
+        , m_methodReady(false)
+        , m_orphanBuffer(0)
+        , m_stream(NULL)
+        , m_cpuMs(0)
+    {
+    }
+
+    virtual ~StreamBenchWindow()
+    {
+        delete m_stream;
+    }
+
+    void setMethod(Method method)   { m_method = method; }
+    void setTriangles(int triangles) { m_triangles = triangles; }
+
+protected:
+    virtual void setupGl()
+    {
+        static char const* const attribs[] = { "a_pos", "a_color", NULL };
+
+        GLuint vert = createShader(vert_shader_text, GL_VERTEX_SHADER);
+        GLuint frag = createShader(frag_shader_text, GL_FRAGMENT_SHADER);
+        m_program = linkProgram(vert, frag, attribs);
+        GpuResources::deleteShader(vert);
+        GpuResources::deleteShader(frag);
+    }
+
+    virtual void drawGl(uint32_t time)
+    {
+        // The method and size come from arguments parsed after init(),
+        // which is where setupGl() runs
+        if (!m_methodReady) {
+            setupMethod();
+            m_methodReady = true;
+        }
+
+        glViewport(0, 0, currentSize().m_width, currentSize().m_height);
+        glClearColor(0, 0, 0, 1);
+        glClear(GL_COLOR_BUFFER_BIT);
+
+        glUseProgram(m_program);
+
+        // The ring and mapped paths write straight into GL's memory; the
+        // others fill m_vertices and hand it over
+        Vertex* out = &m_vertices[0];
+        StreamBuffer::Span span;
+
+        if (m_stream) {
+            m_stream->beginFrame();
+            span = m_stream->allocate(m_vertices.size() * sizeof(Vertex));
+
+            // If the buffer couldn't be mapped, fill m_vertices and copy
+            // that in with glBufferSubData() instead
+            if (span.m_data) {
+                out = (Vertex*)span.m_data;
+            }
+        }
+
+        generate(out, time);
+
+        void const* base = &m_vertices[0];
+
+        switch (m_method) {
+            case METHOD_RING:
+            case METHOD_RING_MAP:
+                m_stream->flush();
+                if (!span.m_data) {
+                    glBufferSubData(GL_ARRAY_BUFFER, span.m_offset, span.m_size, &m_vertices[0]);
+                }
+                base = span.pointer();
+                break;
+
+            case METHOD_ORPHAN:
+                // Detaching the old storage lets the driver hand out new
+                // memory instead of waiting for the GPU to finish with it
+                glBindBuffer(GL_ARRAY_BUFFER, m_orphanBuffer);
+                GpuResources::bufferData(m_orphanBuffer, GL_ARRAY_BUFFER,
+                                         m_vertices.size() * sizeof(Vertex), NULL, GL_STREAM_DRAW);
+                glBufferSubData(GL_ARRAY_BUFFER, 0, m_vertices.size() * sizeof(Vertex),
+                                &m_vertices[0]);
+                base = NULL;
+                break;
+
+            case METHOD_CLIENT:
+                glBindBuffer(GL_ARRAY_BUFFER, 0);
+                break;
+        }
+
+        glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex),
+                              (char const*)base + offsetof(Vertex, x));
+        glVertexAttribPointer(1, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(Vertex),
+                              (char const*)base + offsetof(Vertex, r));
+        glEnableVertexAttribArray(0);
+        glEnableVertexAttribArray(1);
+
+        glDrawArrays(GL_TRIANGLES, 0, m_vertices.size());
+        recordDraw(GL_TRIANGLES, m_vertices.size());
+
+        glDisableVertexAttribArray(0);
+        glDisableVertexAttribArray(1);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+        if (m_stream) {
+            m_stream->endFrame();
+        }
+
+        report();
+    }
+
+    virtual void teardownGl()
+    {
+        if (m_stream) {
+            m_stream->teardownGl();
+            delete m_stream;
+            m_stream = NULL;
+        }
+        GpuResources::deleteBuffer(m_orphanBuffer);
+        GpuResources::deleteProgram(m_program);
+
+        m_orphanBuffer = 0;
+        m_methodReady = false;
+    }
+
+private:
+    void setupMethod()
+    {
+        GLsizeiptr frameBytes = m_triangles * 3 * sizeof(Vertex);
+        m_vertices.resize(m_triangles * 3);
+
+        switch (m_method) {
+            case METHOD_RING:
+            case METHOD_RING_MAP:
+                m_stream = new StreamBuffer(GL_ARRAY_BUFFER, frameBytes);
+                m_stream->setupGl(m_method == METHOD_RING_MAP
+                                  ? StreamBuffer::UPLOAD_MAP_BUFFER
+                                  : StreamBuffer::UPLOAD_SUB_DATA);
+                if (m_method == METHOD_RING_MAP &&
+                    m_stream->upload() != StreamBuffer::UPLOAD_MAP_BUFFER) {
+                    printf("GL_OES_mapbuffer not supported, using glBufferSubData()\n");
+                }
+                break;
+
+            case METHOD_ORPHAN:
+                m_orphanBuffer = GpuResources::createBuffer("streambench orphan");
+                break;
+
+            case METHOD_CLIENT:
+                break;
+        }
+
+        printf("%s: %d triangles, %.1f KiB per frame%s\n",
+               s_methodNames[m_method], m_triangles, frameBytes / 1024.0,
+               m_stream && m_stream->hasFences() ? ", fenced" : "");
+    }
+
+    // A ring of small triangles that wobbles over time, so nothing about
+    // the vertices can be cached from one frame to the next
+    void generate(Vertex* out, uint32_t time)
+    {
+        float t = time / 1000.0f;
+
+        for (int i = 0; i < m_triangles; i++) {
+            float a = i * 2 * M_PI / m_triangles;
+            float r = 0.6f + 0.3f * sinf(a * 7 + t * 2);
+            float x = r * cosf(a);
+            float y = r * sinf(a);
+            GLubyte shade = 128 + 127 * sinf(a * 3 + t);
+
+            for (int v = 0; v < 3; v++) {
+                float va = a + v * 2 * M_PI / 3;
+                out->x = x + 0.01f * cosf(va + t);
+                out->y = y + 0.01f * sinf(va + t);
+                out->r = shade;
+                out->g = 255 - shade;
+                out->b = 128;
+                out->a = 255;
+                out++;
+            }
+        }
+    }
+
+    void report()
+    {
+        // The frame being drawn hasn't been timed yet
+        m_cpuMs += frameStats().cpuTimeMs(1);
+
+        uint32_t frames = frameStats().frameCount();
+        if (frames == 0 || frames % REPORT_INTERVAL != 0) {
+            return;
+        }
+
+        float fps = frameStats().fps();
+        double bytes = m_vertices.size() * sizeof(Vertex);
+
+        printf("%s: %.1f fps, %.2f ms CPU per frame, %.1f MB/s",
+               s_methodNames[m_method], fps, m_cpuMs / REPORT_INTERVAL,
+               bytes * fps / 1e6);
+        if (m_stream && m_stream->hasFences()) {
+            printf(", %u fence stalls", m_stream->stalls());
+        }
+        printf("\n");
+
+        m_cpuMs = 0;
+    }
+
+    Method m_method;
+    int m_triangles;
+    bool m_methodReady;
+
+    GLuint m_program;
+    GLuint m_orphanBuffer;
+    StreamBuffer* m_stream;
+    std::vector<Vertex> m_vertices;
+
+    double m_cpuMs;
+};
+
+int main(int argc, char* argv[])
+{
+    StreamBenchWindow w;
+    w.init(&argc, argv);
+
+    // Positional arguments are what's left after the window options
+    if (optind < argc) {
+        int i;
+        for (i = 0; i < (int)N_ELEMENTS(s_methodNames); i++) {
+            if (strcmp(argv[optind], s_methodNames[i]) == 0) {
+                break;
+            }
+        }
+        if (i == (int)N_ELEMENTS(s_methodNames)) {
+            fprintf(stderr, "Unknown method \"%s\"\n", argv[optind]);
+            exit(EXIT_FAILURE);
+        }
+        w.setMethod(Method(i));
+        optind++;
+    }
+
+    if (optind < argc && atoi(argv[optind]) > 0) {
+        w.setTriangles(atoi(argv[optind]));
+    }
+
+    w.run();
+    return EXIT_SUCCESS;
+}
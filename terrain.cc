@@ -0,0 +1,1037 @@
+#include <cmath>
+#include <cstdio>
+#include <stddef.h>
+#include <stdlib.h>
+#include <sys/resource.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <vector>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/type_ptr.hpp>
+
+#include "base.hpp"
+#include "heightfield.hpp"
+#include "job-system.hpp"
+#include "mesh-lod.hpp"
+#include "shader.hpp"
+
+// A flight over a heightfield too big to load, streamed a chunk at a
+// time out of a memory-mapped file (heightgen writes one).
+//
+// The map is a quadtree of chunks, each CHUNK by CHUNK quads; the root
+// covers the whole map a sample every 2^levels, its children a quarter
+// of it each at twice the detail, and so on down to a sample per quad.
+// A chunk is split when its error, projected to the screen, is more than
+// 'pixel-error' pixels, but only once all four children it can see are
+// on the GPU; until then it's drawn itself and the children are asked
+// for, the most visibly wrong first. Worker threads build asked-for
+// chunks from the heightfield, then the GL thread uploads a few each
+// frame, and evicts the least recently used to stay within a fixed
+// budget of GPU memory. Neighbours of different detail leave cracks;
+// every chunk hangs a skirt down from its edges to fill them.
+//
+// Streaming allocates whenever new ground comes into view, so there is
+// no steady state for -a or -m to check.
+//
+// Every REPORT_INTERVAL frames prints what's resident against the
+// budget, what was uploaded and built each frame, how long chunks took
+// from being asked for to being ready, and the page faults that cost.
+//
+// Usage: terrain [window options] HEIGHTFIELD [pixel-error] [budget-MB]
+//
+// The heightfield must be square. 'pixel-error' defaults to 2 and
+// 'budget-MB' to 64.
+
+static const char* vert_shader_text =
+    "uniform mat4 u_view_projection;\n"
+    "uniform vec3 u_offset;\n"
+    "uniform vec3 u_light;\n"
+    "uniform float u_view_distance;\n"
+
+    "attribute vec3 a_pos;\n"
+    "attribute vec3 a_normal;\n"
+
+    "varying vec3 v_color;\n"
+    "varying float v_fog;\n"
+
+    "void main() {\n"
+    "  // Everything is relative to the camera, which keeps positions\n"
+    "  // small enough for floats however far across the map it is\n"
+    "  vec3 pos = a_pos + u_offset;\n"
+    "  gl_Position = u_view_projection * vec4(pos, 1);\n"
+
+    "  vec3 grass = vec3(0.3, 0.5, 0.2);\n"
+    "  vec3 rock = vec3(0.45, 0.4, 0.35);\n"
+    "  vec3 snow = vec3(0.95, 0.95, 1.0);\n"
+    "  vec3 color = mix(rock, grass, smoothstep(0.7, 0.85, a_normal.y));\n"
+    "  color = mix(color, snow, smoothstep(1300.0, 1500.0, a_pos.y) * step(0.6, a_normal.y));\n"
+
+    "  v_color = color * (0.3 + 0.7 * max(dot(normalize(a_normal), u_light), 0.0));\n"
+    "  v_fog = clamp(length(pos) / u_view_distance, 0.0, 1.0);\n"
+    "}\n";
+
+static const char* frag_shader_text =
+    "precision mediump float;\n"
+    "uniform vec3 u_sky;\n"
+    "varying vec3 v_color;\n"
+    "varying float v_fog;\n"
+    "void main() {\n"
+    "  gl_FragColor = vec4(mix(v_color, u_sky, v_fog * v_fog), 1);\n"
+    "}\n";
+
+// Frames between reports
+static const uint32_t REPORT_INTERVAL = 120;
+
+// Quads along a side of a chunk, at every level
+static const int CHUNK = 64;
+static const int CHUNK_SIDE = CHUNK + 1;
+
+// The grid, then a skirt vertex under each edge vertex
+static const int GRID_VERTICES = CHUNK_SIDE * CHUNK_SIDE;
+static const int CHUNK_VERTICES = GRID_VERTICES + 4 * CHUNK_SIDE;
+static const int CHUNK_INDICES = CHUNK * CHUNK * 6 + 4 * CHUNK * 6;
+
+// World units per sample across, and per step of height
+static const float HORIZONTAL_SCALE = 1.0f;
+static const float VERTICAL_SCALE = 1 / 32.0f;
+
+// Nothing further than this is drawn, or fetched
+static const float VIEW_DISTANCE = 8000.0f;
+
+// Vertical field of view, in radians
+static const float FOVY = 0.8f;
+
+// The camera goes around the middle of the map at this speed, this high
+// over the highest ground a little ahead of it
+static const float FLIGHT_SPEED = 150.0f;
+static const float ALTITUDE = 120.0f;
+
+// Chunks handed to the workers at a time, and built but not yet uploaded
+// ones held at most: that's how many CPU vertex blocks there are
+static const int BUILD_BATCH = 32;
+static const int VERTEX_BLOCKS = BUILD_BATCH * 4;
+
+// Vertex bytes uploaded per frame at most, a little over 14 chunks
+static const size_t UPLOAD_BUDGET = 1024 * 1024;
+
+// Built chunks nobody has asked for in this many frames are thrown away
+static const uint32_t DISCARD_FRAMES = 60;
+
+static const GLfloat SKY[] = { 0.6f, 0.7f, 0.85f };
+
+enum {
+    ATTRIB_POS,
+    ATTRIB_NORMAL,
+};
+
+struct Vertex
+{
+    GLfloat x, y, z;
+    GLbyte nx, ny, nz, pad;
+};
+
+static const size_t CHUNK_BYTES = CHUNK_VERTICES * sizeof(Vertex);
+
+static double nowMs()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000.0 + ts.tv_nsec / 1000000.0;
+}
+
+static long majorFaults()
+{
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_majflt;
+}
+
+struct Chunk
+{
+    enum State {
+        EMPTY,
+        QUEUED,                 // Asked for, not yet building
+        BUILDING,               // With the workers
+        BUILT,                  // Vertices ready, waiting to upload
+        RESIDENT,               // In m_buffer
+    };
+
+    Chunk(Chunk* parent, int level, int x, int y)
+        : m_parent(parent)
+        , m_level(level)
+        , m_x(x)
+        , m_y(y)
+        , m_hasChildren(false)
+        , m_state(EMPTY)
+        , m_vertices(NULL)
+        , m_buffer(0)
+        , m_error(0)
+        , m_minY(0)
+        , m_maxY(0)
+        , m_lastUsed(0)
+        , m_lastWanted(0)
+        , m_priority(0)
+        , m_requestedMs(0)
+        , m_builtMs(0)
+        , m_buildMs(0)
+    {
+        for (int i = 0; i < 4; i++) {
+            m_children[i] = NULL;
+        }
+    }
+
+    ~Chunk()
+    {
+        for (int i = 0; i < 4; i++) {
+            delete m_children[i];
+        }
+    }
+
+    // Samples between vertices
+    int spacing() const         { return 1 << m_level; }
+
+    Chunk* m_parent;
+    Chunk* m_children[4];       // NULL where off the map
+
+    int m_level;                // 0 has a vertex per sample
+    int m_x, m_y;               // First sample
+    bool m_hasChildren;
+
+    State m_state;
+    Vertex* m_vertices;         // From BUILDING until uploaded
+    GLuint m_buffer;
+
+    // How far, in world units, the chunk strays from the next level's
+    // samples, and the heights it spans; known from BUILT on
+    float m_error;
+    float m_minY, m_maxY;
+
+    uint32_t m_lastUsed;        // Frame last drawn or split
+    uint32_t m_lastWanted;      // Frame last asked for
+    float m_priority;           // Pixels of error its parent shows meanwhile
+
+    double m_requestedMs;
+    double m_builtMs;
+    double m_buildMs;           // Of that, spent building
+};
+
+class TerrainWindow: public WaylandWindow
+{
+public:
+    TerrainWindow()
+        : m_pixelError(2.0f)
+        , m_maxResident(0)
+        , m_root(NULL)
+        , m_program(0)
+        , m_uViewProjection(-1)
+        , m_uOffset(-1)
+        , m_uLight(-1)
+        , m_uViewDistance(-1)
+        , m_uSky(-1)
+        , m_indexBuffer(0)
+        , m_frame(0)
+        , m_scale(0)
+        , m_altitude(-1)
+        , m_blocks(0)
+        , m_builds(0)
+        , m_latencyMs(0)
+        , m_maxLatencyMs(0)
+        , m_buildMs(0)
+        , m_uploads(0)
+        , m_uploadBytes(0)
+        , m_maxUploadBytes(0)
+        , m_evictions(0)
+        , m_discards(0)
+        , m_drawn(0)
+        , m_triangles(0)
+        , m_lastFaults(0)
+    {
+        setBudget(64);
+    }
+
+    virtual ~TerrainWindow()
+    {
+        delete m_root;
+
+        for (size_t i = 0; i < m_freeBlocks.size(); i++) {
+            delete[] m_freeBlocks[i];
+        }
+    }
+
+    void open(char const* path)
+    {
+        if (!m_heightfield.open(path)) {
+            exit(EXIT_FAILURE);
+        }
+
+        // Fewest levels whose root reaches across the whole map
+        int levels = 0;
+        while ((CHUNK << levels) < m_heightfield.width() - 1) {
+            levels++;
+        }
+
+        m_root = new Chunk(NULL, levels, 0, 0);
+
+        printf("%s: %dx%d samples, %.1f MB, %d levels of detail\n", path,
+               m_heightfield.width(), m_heightfield.height(),
+               m_heightfield.bytes() / 1048576.0, levels + 1);
+    }
+
+    void setPixelError(float pixelError)    { m_pixelError = pixelError; }
+
+    void setBudget(int megabytes)
+    {
+        m_maxResident = (size_t)megabytes * 1048576 / CHUNK_BYTES;
+        if (m_maxResident < 1) {
+            m_maxResident = 1;
+        }
+    }
+
+protected:
+    virtual std::vector<EGLint> requiredEglConfigAttribs()
+    {
+        // The view reaches thousands of units from a near plane a few
+        // units out
+        std::vector<EGLint> ret;
+        ret.push_back(EGL_DEPTH_SIZE);
+        ret.push_back(24);
+        return ret;
+    }
+
+    virtual void setupGl()
+    {
+        static char const* const attribs[] = { "a_pos", "a_normal", NULL };
+
+        GLuint vert = createShader(vert_shader_text, GL_VERTEX_SHADER);
+        GLuint frag = createShader(frag_shader_text, GL_FRAGMENT_SHADER);
+        m_program = linkProgram(vert, frag, attribs);
+        GpuResources::deleteShader(vert);
+        GpuResources::deleteShader(frag);
+
+        m_uViewProjection = glGetUniformLocation(m_program, "u_view_projection");
+        m_uOffset = glGetUniformLocation(m_program, "u_offset");
+        m_uLight = glGetUniformLocation(m_program, "u_light");
+        m_uViewDistance = glGetUniformLocation(m_program, "u_view_distance");
+        m_uSky = glGetUniformLocation(m_program, "u_sky");
+
+        // Every chunk has the same layout, so they share one index buffer
+        std::vector<GLushort> indices;
+        indices.reserve(CHUNK_INDICES);
+
+        for (int j = 0; j < CHUNK; j++) {
+            for (int i = 0; i < CHUNK; i++) {
+                addQuad(indices, gridVertex(i, j), gridVertex(i + 1, j),
+                        gridVertex(i, j + 1), gridVertex(i + 1, j + 1));
+            }
+        }
+
+        for (int edge = 0; edge < 4; edge++) {
+            for (int k = 0; k < CHUNK; k++) {
+                addQuad(indices, edgeVertex(edge, k), edgeVertex(edge, k + 1),
+                        skirtVertex(edge, k), skirtVertex(edge, k + 1));
+            }
+        }
+
+        m_indexBuffer = GpuResources::createBuffer("terrain indices");
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_indexBuffer);
+        GpuResources::bufferData(m_indexBuffer, GL_ELEMENT_ARRAY_BUFFER,
+                                 indices.size() * sizeof(GLushort), &indices[0], GL_STATIC_DRAW);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+
+        m_lastFaults = majorFaults();
+    }
+
+    virtual void drawGl(uint32_t time)
+    {
+        Size const& size = currentSize();
+        m_frame++;
+
+        glm::vec3 eye, forward;
+        fly(time, &eye, &forward);
+
+        float aspect = size.m_width * 1.0f / size.m_height;
+        float zNear = 2.0f;
+        float top = zNear * tanf(FOVY / 2);
+        glm::mat4 projection = glm::frustum(-top * aspect, top * aspect, -top, top,
+                                            zNear, VIEW_DISTANCE);
+
+        // Looking from the origin: chunks are placed relative to the eye
+        glm::mat4 view = glm::lookAt(glm::vec3(0.0f, 0.0f, 0.0f), forward,
+                                     glm::vec3(0.0f, 1.0f, 0.0f));
+        glm::mat4 viewProjection = projection * view;
+
+        // What the workers finished goes up first, so that it can be
+        // drawn straight away
+        collectBuilds();
+        upload();
+
+        m_drawList.clear();
+        m_wanted.clear();
+
+        m_scale = LodMesh::screenScale(size.m_height, FOVY);
+        m_eye = eye;
+        m_viewProjection = viewProjection;
+
+        if (m_root->m_state == Chunk::RESIDENT) {
+            select(m_root);
+        }
+        else {
+            want(m_root, HUGE_VALF);
+        }
+
+        launchBuilds();
+
+        glViewport(0, 0, size.m_width, size.m_height);
+        glClearColor(SKY[0], SKY[1], SKY[2], 1.0);
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+        draw(viewProjection);
+        report();
+    }
+
+    virtual void teardownGl()
+    {
+        // The workers may still be filling vertex blocks
+        jobs().wait(m_batchCounter);
+        collectBuilds();
+
+        for (size_t i = 0; i < m_resident.size(); i++) {
+            Chunk* chunk = m_resident[i];
+            GpuResources::deleteBuffer(chunk->m_buffer);
+            chunk->m_buffer = 0;
+            chunk->m_state = Chunk::EMPTY;
+        }
+        m_resident.clear();
+
+        for (size_t i = 0; i < m_built.size(); i++) {
+            releaseVertices(m_built[i]);
+            m_built[i]->m_state = Chunk::EMPTY;
+        }
+        m_built.clear();
+
+        GpuResources::deleteBuffer(m_indexBuffer);
+        GpuResources::deleteProgram(m_program);
+    }
+
+private:
+    static GLushort gridVertex(int i, int j)
+    {
+        return j * CHUNK_SIDE + i;
+    }
+
+    // Along the top, bottom, left and right edges
+    static GLushort edgeVertex(int edge, int k)
+    {
+        switch (edge) {
+            case 0:     return gridVertex(k, 0);
+            case 1:     return gridVertex(k, CHUNK);
+            case 2:     return gridVertex(0, k);
+            default:    return gridVertex(CHUNK, k);
+        }
+    }
+
+    static GLushort skirtVertex(int edge, int k)
+    {
+        return GRID_VERTICES + edge * CHUNK_SIDE + k;
+    }
+
+    static void addQuad(std::vector<GLushort>& indices,
+                        GLushort a, GLushort b, GLushort c, GLushort d)
+    {
+        indices.push_back(a);
+        indices.push_back(c);
+        indices.push_back(b);
+        indices.push_back(b);
+        indices.push_back(c);
+        indices.push_back(d);
+    }
+
+    float heightAt(int x, int y) const
+    {
+        return m_heightfield.sample(x, y) * VERTICAL_SCALE;
+    }
+
+    // Round the middle of the map, banking nowhere, always looking a
+    // little down
+    void fly(uint32_t time, glm::vec3* eye, glm::vec3* forward)
+    {
+        float centerX = m_heightfield.width() / 2.0f;
+        float centerY = m_heightfield.height() / 2.0f;
+        float radius = 0.35f * std::min(m_heightfield.width(), m_heightfield.height());
+
+        float angle = time / 1000.0f * FLIGHT_SPEED / radius;
+        float x = centerX + radius * cosf(angle);
+        float y = centerY + radius * sinf(angle);
+
+        glm::vec3 ahead(-sinf(angle), 0.0f, cosf(angle));
+
+        float ground = 0;
+        for (int i = 0; i <= 4; i++) {
+            float distance = i * 100.0f;
+            ground = std::max(ground, heightAt(x + ahead.x * distance, y + ahead.z * distance));
+        }
+
+        // Climbs and dives are eased, so that ridges don't jolt the view
+        if (m_altitude < 0) {
+            m_altitude = ground + ALTITUDE;
+        }
+        m_altitude += (ground + ALTITUDE - m_altitude) * 0.05f;
+
+        *eye = glm::vec3(x * HORIZONTAL_SCALE, m_altitude, y * HORIZONTAL_SCALE);
+        *forward = glm::normalize(ahead + glm::vec3(0.0f, -0.15f, 0.0f));
+    }
+
+    // Of unbuilt chunks only the parent's heights are known; it's close,
+    // give or take its error
+    void bounds(Chunk const* chunk, glm::vec3* min, glm::vec3* max) const
+    {
+        Chunk const* known = chunk;
+        float slack = 0;
+        if (known->m_state != Chunk::RESIDENT && known->m_parent) {
+            known = known->m_parent;
+            slack = known->m_error;
+        }
+
+        float size = CHUNK * chunk->spacing() * HORIZONTAL_SCALE;
+        *min = glm::vec3(chunk->m_x * HORIZONTAL_SCALE, known->m_minY - slack,
+                         chunk->m_y * HORIZONTAL_SCALE) - m_eye;
+        *max = *min + glm::vec3(size, known->m_maxY - known->m_minY + 2 * slack, size);
+    }
+
+    // Whether any of the box, relative to the eye, is in view; if so,
+    // how far its nearest point is
+    bool visible(glm::vec3 const& min, glm::vec3 const& max, float* distance) const
+    {
+        glm::vec3 nearest(std::min(std::max(0.0f, min.x), max.x),
+                          std::min(std::max(0.0f, min.y), max.y),
+                          std::min(std::max(0.0f, min.z), max.z));
+        *distance = glm::length(nearest);
+        if (*distance > VIEW_DISTANCE) {
+            return false;
+        }
+
+        // Outside the frustum if every corner is past the same plane
+        int outside[6] = { 0, 0, 0, 0, 0, 0 };
+        for (int i = 0; i < 8; i++) {
+            glm::vec4 corner(i & 1 ? max.x : min.x, i & 2 ? max.y : min.y,
+                             i & 4 ? max.z : min.z, 1.0f);
+            glm::vec4 clip = m_viewProjection * corner;
+
+            outside[0] += clip.x < -clip.w;
+            outside[1] += clip.x > clip.w;
+            outside[2] += clip.y < -clip.w;
+            outside[3] += clip.y > clip.w;
+            outside[4] += clip.z < -clip.w;
+            outside[5] += clip.z > clip.w;
+        }
+
+        for (int i = 0; i < 6; i++) {
+            if (outside[i] == 8) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    void makeChildren(Chunk* chunk)
+    {
+        if (chunk->m_hasChildren) {
+            return;
+        }
+        chunk->m_hasChildren = true;
+
+        int half = CHUNK * chunk->spacing() / 2;
+        for (int i = 0; i < 4; i++) {
+            int x = chunk->m_x + (i & 1 ? half : 0);
+            int y = chunk->m_y + (i & 2 ? half : 0);
+
+            if (x < m_heightfield.width() - 1 && y < m_heightfield.height() - 1) {
+                chunk->m_children[i] = new Chunk(chunk, chunk->m_level - 1, x, y);
+            }
+        }
+    }
+
+    // Called on resident chunks in view
+    void select(Chunk* chunk)
+    {
+        chunk->m_lastUsed = m_frame;
+
+        glm::vec3 min, max;
+        float distance;
+        bounds(chunk, &min, &max);
+        visible(min, max, &distance);
+
+        float pixels = chunk->m_error * m_scale / std::max(distance, 1.0f);
+
+        if (chunk->m_level > 0 && pixels > m_pixelError) {
+            makeChildren(chunk);
+
+            Chunk* children[4];
+            int count = 0;
+            bool ready = true;
+
+            for (int i = 0; i < 4; i++) {
+                Chunk* child = chunk->m_children[i];
+                float childDistance;
+
+                if (!child) {
+                    continue;
+                }
+
+                bounds(child, &min, &max);
+                if (!visible(min, max, &childDistance)) {
+                    continue;
+                }
+
+                if (child->m_state != Chunk::RESIDENT) {
+                    want(child, pixels);
+                    ready = false;
+                }
+                children[count++] = child;
+            }
+
+            if (ready) {
+                for (int i = 0; i < count; i++) {
+                    select(children[i]);
+                }
+                return;
+            }
+        }
+
+        m_drawList.push_back(chunk);
+    }
+
+    void want(Chunk* chunk, float priority)
+    {
+        // Latency counts from when it was last asked for without a break
+        if (chunk->m_state == Chunk::EMPTY ||
+            (chunk->m_state == Chunk::QUEUED && chunk->m_lastWanted + 1 < m_frame)) {
+            chunk->m_state = Chunk::QUEUED;
+            chunk->m_requestedMs = nowMs();
+        }
+
+        chunk->m_lastWanted = m_frame;
+        chunk->m_priority = priority;
+
+        if (chunk->m_state == Chunk::QUEUED) {
+            m_wanted.push_back(chunk);
+        }
+    }
+
+    static bool morePressing(Chunk const* a, Chunk const* b)
+    {
+        return a->m_priority > b->m_priority;
+    }
+
+    // Hands the most pressing chunks asked for this frame to the workers,
+    // unless they're still busy with the last lot
+    void launchBuilds()
+    {
+        if (!m_batchCounter.isDone() || m_wanted.empty()) {
+            return;
+        }
+
+        collectBuilds();
+        std::sort(m_wanted.begin(), m_wanted.end(), morePressing);
+
+        for (size_t i = 0; i < m_wanted.size() && m_batch.size() < (size_t)BUILD_BATCH; i++) {
+            Chunk* chunk = m_wanted[i];
+            Vertex* vertices = takeBlock();
+            if (!vertices) {
+                break;
+            }
+
+            chunk->m_vertices = vertices;
+            chunk->m_state = Chunk::BUILDING;
+            m_batch.push_back(chunk);
+        }
+
+        if (m_batch.empty()) {
+            return;
+        }
+
+        jobs().parallelFor(buildChunks, this, m_batch.size(), 1, m_batchCounter);
+
+        // With no workers, nobody else would ever get to it
+        if (jobs().threads() == 1) {
+            jobs().wait(m_batchCounter);
+        }
+    }
+
+    void collectBuilds()
+    {
+        if (!m_batchCounter.isDone()) {
+            return;
+        }
+
+        for (size_t i = 0; i < m_batch.size(); i++) {
+            Chunk* chunk = m_batch[i];
+            chunk->m_state = Chunk::BUILT;
+            m_built.push_back(chunk);
+
+            double latency = chunk->m_builtMs - chunk->m_requestedMs;
+            m_latencyMs += latency;
+            m_maxLatencyMs = std::max(m_maxLatencyMs, latency);
+            m_buildMs += chunk->m_buildMs;
+            m_builds++;
+        }
+        m_batch.clear();
+    }
+
+    static void buildChunks(void* data, size_t begin, size_t end)
+    {
+        TerrainWindow* self = static_cast<TerrainWindow*>(data);
+
+        for (size_t i = begin; i < end; i++) {
+            self->build(self->m_batch[i]);
+        }
+    }
+
+    // On a worker thread: only touches the chunk's own vertices and what
+    // it learns about them
+    void build(Chunk* chunk) const
+    {
+        double start = nowMs();
+        int s = chunk->spacing();
+        Vertex* vertices = chunk->m_vertices;
+
+        float minY = HUGE_VALF, maxY = -HUGE_VALF;
+        float error = 0;
+
+        for (int j = 0; j <= CHUNK; j++) {
+            for (int i = 0; i <= CHUNK; i++) {
+                int x = chunk->m_x + i * s;
+                int y = chunk->m_y + j * s;
+                float h = heightAt(x, y);
+
+                // Central differences, a vertex apart
+                float dx = heightAt(x + s, y) - heightAt(x - s, y);
+                float dz = heightAt(x, y + s) - heightAt(x, y - s);
+                glm::vec3 normal = glm::normalize(glm::vec3(-dx, 2 * s * HORIZONTAL_SCALE, -dz));
+
+                Vertex& v = vertices[gridVertex(i, j)];
+                v.x = i * s * HORIZONTAL_SCALE;
+                v.y = h;
+                v.z = j * s * HORIZONTAL_SCALE;
+                v.nx = (GLbyte)(normal.x * 127);
+                v.ny = (GLbyte)(normal.y * 127);
+                v.nz = (GLbyte)(normal.z * 127);
+                v.pad = 0;
+
+                minY = std::min(minY, h);
+                maxY = std::max(maxY, h);
+
+                // Against the samples between vertices: along the two
+                // edges leading here and across the diagonal the quad
+                // is split on
+                if (s > 1 && i > 0 && j > 0) {
+                    int half = s / 2;
+                    float left = heightAt(x - s, y);
+                    float up = heightAt(x, y - s);
+
+                    error = std::max(error, fabsf(heightAt(x - half, y) - (left + h) / 2));
+                    error = std::max(error, fabsf(heightAt(x, y - half) - (up + h) / 2));
+                    error = std::max(error, fabsf(heightAt(x - half, y - half) - (left + up) / 2));
+                }
+            }
+        }
+
+        // Deep enough to cover any neighbour's detail, and at least a
+        // vertex apart so that flat ground gets one too
+        float depth = std::max(2 * error, s * HORIZONTAL_SCALE);
+
+        for (int edge = 0; edge < 4; edge++) {
+            for (int k = 0; k <= CHUNK; k++) {
+                Vertex& skirt = vertices[skirtVertex(edge, k)];
+                skirt = vertices[edgeVertex(edge, k)];
+                skirt.y -= depth;
+            }
+        }
+
+        chunk->m_error = error;
+        chunk->m_minY = minY - depth;
+        chunk->m_maxY = maxY;
+
+        chunk->m_builtMs = nowMs();
+        chunk->m_buildMs = chunk->m_builtMs - start;
+    }
+
+    Vertex* takeBlock()
+    {
+        if (m_freeBlocks.empty()) {
+            if (m_blocks == (size_t)VERTEX_BLOCKS) {
+                return NULL;
+            }
+            m_blocks++;
+            return new Vertex[CHUNK_VERTICES];
+        }
+
+        Vertex* block = m_freeBlocks.back();
+        m_freeBlocks.pop_back();
+        return block;
+    }
+
+    void releaseVertices(Chunk* chunk)
+    {
+        m_freeBlocks.push_back(chunk->m_vertices);
+        chunk->m_vertices = NULL;
+    }
+
+    // Uploads built chunks, the most pressing first, until this frame's
+    // share of bandwidth or the memory budget runs out
+    void upload()
+    {
+        std::sort(m_built.begin(), m_built.end(), morePressing);
+
+        size_t bytes = 0;
+        size_t kept = 0;
+
+        for (size_t i = 0; i < m_built.size(); i++) {
+            Chunk* chunk = m_built[i];
+
+            if (chunk->m_lastWanted + DISCARD_FRAMES < m_frame) {
+                releaseVertices(chunk);
+                chunk->m_state = Chunk::EMPTY;
+                m_discards++;
+                continue;
+            }
+
+            GLuint buffer = 0;
+            if (bytes + CHUNK_BYTES <= UPLOAD_BUDGET) {
+                buffer = takeBuffer();
+            }
+            if (!buffer) {
+                m_built[kept++] = chunk;
+                continue;
+            }
+
+            glBindBuffer(GL_ARRAY_BUFFER, buffer);
+            glBufferSubData(GL_ARRAY_BUFFER, 0, CHUNK_BYTES, chunk->m_vertices);
+            bytes += CHUNK_BYTES;
+
+            releaseVertices(chunk);
+            chunk->m_state = Chunk::RESIDENT;
+            chunk->m_buffer = buffer;
+            chunk->m_lastUsed = m_frame;
+            m_resident.push_back(chunk);
+            m_uploads++;
+        }
+
+        m_built.resize(kept);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+        m_uploadBytes += bytes;
+        m_maxUploadBytes = std::max(m_maxUploadBytes, bytes);
+    }
+
+    // A buffer for one more chunk: a new one while under budget, else
+    // the one of the least recently used chunk that wasn't drawn last
+    // frame and has no resident children leaning on it
+    GLuint takeBuffer()
+    {
+        if (m_resident.size() < m_maxResident) {
+            GLuint buffer = GpuResources::createBuffer("terrain chunk");
+            glBindBuffer(GL_ARRAY_BUFFER, buffer);
+            GpuResources::bufferData(buffer, GL_ARRAY_BUFFER, CHUNK_BYTES, NULL, GL_STATIC_DRAW);
+            return buffer;
+        }
+
+        size_t oldest = m_resident.size();
+        for (size_t i = 0; i < m_resident.size(); i++) {
+            Chunk* chunk = m_resident[i];
+
+            if (chunk == m_root || chunk->m_lastUsed + 1 >= m_frame || hasResidentChildren(chunk)) {
+                continue;
+            }
+            if (oldest == m_resident.size() || chunk->m_lastUsed < m_resident[oldest]->m_lastUsed) {
+                oldest = i;
+            }
+        }
+
+        if (oldest == m_resident.size()) {
+            return 0;
+        }
+
+        Chunk* chunk = m_resident[oldest];
+        GLuint buffer = chunk->m_buffer;
+        chunk->m_buffer = 0;
+        chunk->m_state = Chunk::EMPTY;
+
+        m_resident[oldest] = m_resident.back();
+        m_resident.pop_back();
+        m_evictions++;
+        return buffer;
+    }
+
+    static bool hasResidentChildren(Chunk const* chunk)
+    {
+        for (int i = 0; i < 4; i++) {
+            if (chunk->m_children[i] && chunk->m_children[i]->m_state == Chunk::RESIDENT) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void draw(glm::mat4 const& viewProjection)
+    {
+        glm::vec3 light = glm::normalize(glm::vec3(0.4f, 0.8f, 0.3f));
+
+        glUseProgram(m_program);
+        glUniformMatrix4fv(m_uViewProjection, 1, GL_FALSE, glm::value_ptr(viewProjection));
+        glUniform3fv(m_uLight, 1, glm::value_ptr(light));
+        glUniform1f(m_uViewDistance, VIEW_DISTANCE);
+        glUniform3fv(m_uSky, 1, SKY);
+
+        glEnable(GL_DEPTH_TEST);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_indexBuffer);
+        glEnableVertexAttribArray(ATTRIB_POS);
+        glEnableVertexAttribArray(ATTRIB_NORMAL);
+
+        for (size_t i = 0; i < m_drawList.size(); i++) {
+            Chunk const* chunk = m_drawList[i];
+
+            glm::vec3 offset = glm::vec3(chunk->m_x * HORIZONTAL_SCALE, 0.0f,
+                                         chunk->m_y * HORIZONTAL_SCALE) - m_eye;
+            glUniform3fv(m_uOffset, 1, glm::value_ptr(offset));
+
+            glBindBuffer(GL_ARRAY_BUFFER, chunk->m_buffer);
+            glVertexAttribPointer(ATTRIB_POS, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex),
+                                  (GLvoid const*)offsetof(Vertex, x));
+            glVertexAttribPointer(ATTRIB_NORMAL, 3, GL_BYTE, GL_TRUE, sizeof(Vertex),
+                                  (GLvoid const*)offsetof(Vertex, nx));
+
+            glDrawElements(GL_TRIANGLES, CHUNK_INDICES, GL_UNSIGNED_SHORT, 0);
+            recordDraw(GL_TRIANGLES, CHUNK_INDICES);
+        }
+
+        m_drawn += m_drawList.size();
+        m_triangles += m_drawList.size() * CHUNK_INDICES / 3;
+
+        glDisableVertexAttribArray(ATTRIB_POS);
+        glDisableVertexAttribArray(ATTRIB_NORMAL);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+        glDisable(GL_DEPTH_TEST);
+    }
+
+    void report()
+    {
+        uint32_t frames = frameStats().frameCount();
+        if (frames == 0 || frames % REPORT_INTERVAL != 0) {
+            return;
+        }
+
+        long faults = majorFaults();
+
+        printf("Terrain: %zu chunks resident (%.1f of %.1f MB), "
+               "%.1f drawn (%.0f triangles) per frame, %.1f fps\n",
+               m_resident.size(),
+               m_resident.size() * CHUNK_BYTES / 1048576.0,
+               m_maxResident * CHUNK_BYTES / 1048576.0,
+               m_drawn / (double)REPORT_INTERVAL,
+               m_triangles / (double)REPORT_INTERVAL,
+               frameStats().fps());
+
+        printf("    uploads: %.2f chunks, %.1f KB per frame (%.1f KB at most); "
+               "%llu evicted, %llu built ones thrown away\n",
+               m_uploads / (double)REPORT_INTERVAL,
+               m_uploadBytes / (double)REPORT_INTERVAL / 1024,
+               m_maxUploadBytes / 1024.0,
+               (unsigned long long)m_evictions,
+               (unsigned long long)m_discards);
+
+        printf("    builds: %.2f per frame, %.1f ms from asked for to built (%.1f ms at most), "
+               "%.2f ms of it building; %zu asked for and waiting; %ld major page faults\n",
+               m_builds / (double)REPORT_INTERVAL,
+               m_builds ? m_latencyMs / m_builds : 0.0,
+               m_maxLatencyMs,
+               m_builds ? m_buildMs / m_builds : 0.0,
+               m_wanted.size(),
+               faults - m_lastFaults);
+
+        m_lastFaults = faults;
+        m_builds = m_uploads = m_uploadBytes = m_maxUploadBytes = 0;
+        m_latencyMs = m_maxLatencyMs = m_buildMs = 0;
+        m_drawn = m_triangles = 0;
+        m_evictions = m_discards = 0;
+    }
+
+    float m_pixelError;
+    size_t m_maxResident;
+
+    Heightfield m_heightfield;
+    Chunk* m_root;
+
+    GLuint m_program;
+    GLint m_uViewProjection;
+    GLint m_uOffset;
+    GLint m_uLight;
+    GLint m_uViewDistance;
+    GLint m_uSky;
+    GLuint m_indexBuffer;
+
+    uint32_t m_frame;
+
+    // This frame's view, for selection
+    glm::vec3 m_eye;
+    glm::mat4 m_viewProjection;
+    float m_scale;
+    float m_altitude;
+
+    // This frame's chunks to draw, and ones asked for
+    std::vector<Chunk*> m_drawList;
+    std::vector<Chunk*> m_wanted;
+
+    // With the workers, counted against m_batchCounter; then built and
+    // waiting for upload; then resident
+    std::vector<Chunk*> m_batch;
+    JobCounter m_batchCounter;
+    std::vector<Chunk*> m_built;
+    std::vector<Chunk*> m_resident;
+
+    std::vector<Vertex*> m_freeBlocks;
+    size_t m_blocks;
+
+    // Accumulated since the last report
+    uint64_t m_builds;
+    double m_latencyMs;
+    double m_maxLatencyMs;
+    double m_buildMs;
+    uint64_t m_uploads;
+    size_t m_uploadBytes;
+    size_t m_maxUploadBytes;
+    uint64_t m_evictions;
+    uint64_t m_discards;
+    uint64_t m_drawn;
+    uint64_t m_triangles;
+    long m_lastFaults;
+};
+
+int main(int argc, char* argv[])
+{
+    TerrainWindow w;
+    w.init(&argc, argv);
+
+    // Positional arguments are what's left after the window options
+    if (optind >= argc) {
+        fprintf(stderr, "Usage: %s [window options] HEIGHTFIELD [pixel-error] [budget-MB]\n",
+                argv[0]);
+        exit(EXIT_FAILURE);
+    }
+    w.open(argv[optind++]);
+
+    if (optind < argc) {
+        w.setPixelError(atof(argv[optind++]));
+    }
+    if (optind < argc) {
+        w.setBudget(atoi(argv[optind++]));
+    }
+
+    w.run();
+    return EXIT_SUCCESS;
+}
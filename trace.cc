@@ -0,0 +1,152 @@
+#include <atomic>
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+#include <vector>
+
+#include "trace.hpp"
+
+bool Trace::s_enabled = false;
+
+#ifdef ENABLE_TRACING
+
+// Events each thread can hold before further spans are dropped
+static const uint32_t BUFFER_EVENTS = 65536;
+
+struct TraceEvent
+{
+    char const* m_name;
+    uint64_t m_start;
+    uint64_t m_end;
+};
+
+// Written only by its own thread. 'm_count' is published with release
+// ordering so that finish() sees every event below it fully written.
+struct TraceBuffer
+{
+    pid_t m_tid;
+    std::atomic<uint32_t> m_count;
+    uint32_t m_dropped;
+    TraceEvent m_events[BUFFER_EVENTS];
+};
+
+static std::mutex s_buffersLock;
+static std::vector<TraceBuffer*> s_buffers;
+static std::string s_path;
+
+static uint64_t now_ns()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+static TraceBuffer* thread_buffer()
+{
+    static thread_local TraceBuffer* t_buffer = NULL;
+
+    if (!t_buffer) {
+        t_buffer = new TraceBuffer;
+        t_buffer->m_tid = syscall(SYS_gettid);
+        t_buffer->m_count.store(0, std::memory_order_relaxed);
+        t_buffer->m_dropped = 0;
+
+        // Buffers live until the process exits, since finish() may run
+        // after the thread that owned one is gone
+        std::lock_guard<std::mutex> lock(s_buffersLock);
+        s_buffers.push_back(t_buffer);
+    }
+
+    return t_buffer;
+}
+
+void TraceSpan::begin(char const* name)
+{
+    m_buffer = thread_buffer();
+    m_name = name;
+    m_start = now_ns();
+}
+
+void TraceSpan::end()
+{
+    uint64_t end = now_ns();
+    uint32_t i = m_buffer->m_count.load(std::memory_order_relaxed);
+
+    if (i >= BUFFER_EVENTS) {
+        m_buffer->m_dropped++;
+        return;
+    }
+
+    TraceEvent& event = m_buffer->m_events[i];
+    event.m_name = m_name;
+    event.m_start = m_start;
+    event.m_end = end;
+
+    m_buffer->m_count.store(i + 1, std::memory_order_release);
+}
+
+void Trace::start(char const* path)
+{
+    s_path = path;
+    s_enabled = true;
+}
+
+void Trace::finish()
+{
+    if (!enabled()) {
+        return;
+    }
+    s_enabled = false;
+
+    FILE* f = fopen(s_path.c_str(), "w");
+    if (!f) {
+        perror(s_path.c_str());
+        return;
+    }
+
+    pid_t pid = getpid();
+    bool first = true;
+
+    fprintf(f, "{\"traceEvents\":[\n");
+
+    std::lock_guard<std::mutex> lock(s_buffersLock);
+
+    for (size_t b = 0; b < s_buffers.size(); b++) {
+        TraceBuffer* buffer = s_buffers[b];
+        uint32_t count = buffer->m_count.load(std::memory_order_acquire);
+
+        for (uint32_t i = 0; i < count; i++) {
+            TraceEvent const& event = buffer->m_events[i];
+
+            fprintf(f, "%s{\"name\":\"%s\",\"ph\":\"X\",\"pid\":%d,\"tid\":%d,"
+                       "\"ts\":%.3f,\"dur\":%.3f}",
+                    first ? "" : ",\n", event.m_name, pid, buffer->m_tid,
+                    event.m_start / 1000.0, (event.m_end - event.m_start) / 1000.0);
+            first = false;
+        }
+
+        if (buffer->m_dropped) {
+            fprintf(stderr, "trace: thread %d dropped %u spans\n",
+                    buffer->m_tid, buffer->m_dropped);
+        }
+    }
+
+    fprintf(f, "\n],\"displayTimeUnit\":\"ms\"}\n");
+    fclose(f);
+}
+
+#else
+
+void Trace::start(char const* path)
+{
+    fprintf(stderr, "Tracing was not compiled in; configure with --enable-tracing\n");
+}
+
+void Trace::finish()
+{
+}
+
+#endif
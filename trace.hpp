@@ -0,0 +1,81 @@
+#ifndef __TRACE_HPP__
+#define __TRACE_HPP__
+
+#include <stdint.h>
+
+// Span tracing exported as Chrome trace JSON (chrome://tracing, Perfetto).
+//
+// Configure with --enable-tracing to compile spans in at all. Even then
+// recording is off until Trace::start() (the -t option on any window),
+// and a disabled span costs one load of a flag, inlined. Each thread records
+// into its own fixed-size buffer, so recording takes no locks; only the
+// first span on a new thread registers its buffer.
+//
+//     void Foo::bar()
+//     {
+//         TRACE_SCOPE("Foo::bar");
+//         ...
+//     }
+//
+// Span names must be string literals, or otherwise outlive the trace.
+
+class Trace
+{
+public:
+    // Begin recording; the trace is written to 'path' by finish()
+    static void start(char const* path);
+
+    // Stop recording and write everything recorded so far
+    static void finish();
+
+    static bool enabled()       { return s_enabled; }
+
+private:
+    // A plain flag, read by every span on every thread. It only changes
+    // in start(), called while parsing options before any thread
+    // records, and in finish(), called once the display stops running.
+    static bool s_enabled;
+};
+
+#ifdef ENABLE_TRACING
+
+struct TraceBuffer;
+
+class TraceSpan
+{
+public:
+    explicit TraceSpan(char const* name)
+        : m_buffer(0)
+    {
+        if (Trace::enabled()) {
+            begin(name);
+        }
+    }
+
+    ~TraceSpan()
+    {
+        if (m_buffer) {
+            end();
+        }
+    }
+
+private:
+    void begin(char const* name);
+    void end();
+
+    TraceBuffer* m_buffer;
+    char const* m_name;
+    uint64_t m_start;
+};
+
+#define TRACE_CONCAT_(a, b) a ## b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_(a, b)
+#define TRACE_SCOPE(name) TraceSpan TRACE_CONCAT(trace_span_, __LINE__)(name)
+
+#else
+
+#define TRACE_SCOPE(name) do { } while (0)
+
+#endif
+
+#endif
@@ -0,0 +1,45 @@
+#include <glm/gtc/type_ptr.hpp>
+
+#include "transforms.hpp"
+
+Transforms::Transforms(glm::mat4 const& model,
+                       glm::mat4 const& view,
+                       glm::mat4 const& projection)
+    : m_model(model)
+    , m_modelView(view * model)
+    , m_mvp(projection * view * model)
+    , m_normal(glm::transpose(glm::inverse(glm::mat3(view * model))))
+{
+}
+
+TransformUniforms::TransformUniforms()
+    : m_uModel(-1)
+    , m_uModelView(-1)
+    , m_uMvp(-1)
+    , m_uNormal(-1)
+{
+}
+
+void TransformUniforms::locate(GLuint program)
+{
+    m_uModel = glGetUniformLocation(program, "u_model");
+    m_uModelView = glGetUniformLocation(program, "u_model_view");
+    m_uMvp = glGetUniformLocation(program, "u_mvp");
+    m_uNormal = glGetUniformLocation(program, "u_normal_matrix");
+}
+
+void TransformUniforms::upload(Transforms const& t) const
+{
+    if (m_uModel >= 0) {
+        glUniformMatrix4fv(m_uModel, 1, GL_FALSE, glm::value_ptr(t.m_model));
+    }
+    if (m_uModelView >= 0) {
+        glUniformMatrix4fv(m_uModelView, 1, GL_FALSE, glm::value_ptr(t.m_modelView));
+    }
+    if (m_uMvp >= 0) {
+        glUniformMatrix4fv(m_uMvp, 1, GL_FALSE, glm::value_ptr(t.m_mvp));
+    }
+    if (m_uNormal >= 0) {
+        glUniformMatrix3fv(m_uNormal, 1, GL_FALSE, glm::value_ptr(t.m_normal));
+    }
+}
@@ -0,0 +1,52 @@
+#ifndef __TRANSFORMS_HPP__
+#define __TRANSFORMS_HPP__
+
+#include <GLES2/gl2.h>
+
+#include <glm/glm.hpp>
+
+// Everything a vertex shader would otherwise derive from the model, view
+// and projection matrices for every vertex it runs on. Computed once per
+// draw on the CPU.
+struct Transforms
+{
+    Transforms(glm::mat4 const& model,
+               glm::mat4 const& view,
+               glm::mat4 const& projection);
+
+    glm::mat4 m_model;
+    glm::mat4 m_modelView;
+    glm::mat4 m_mvp;
+
+    // Inverse transpose of the model-view's upper 3x3, for taking
+    // normals to eye space
+    glm::mat3 m_normal;
+};
+
+// Locations of the derived uniforms in one program. Shaders declare
+// whichever of these they use:
+//
+//     uniform mat4 u_model;
+//     uniform mat4 u_model_view;
+//     uniform mat4 u_mvp;
+//     uniform mat3 u_normal_matrix;
+//
+// and upload() skips the ones they don't.
+class TransformUniforms
+{
+public:
+    TransformUniforms();
+
+    void locate(GLuint program);
+
+    // 'program' must be current
+    void upload(Transforms const& transforms) const;
+
+private:
+    GLint m_uModel;
+    GLint m_uModelView;
+    GLint m_uMvp;
+    GLint m_uNormal;
+};
+
+#endif